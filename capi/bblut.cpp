@@ -0,0 +1,61 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#include "bblut/bblut.h"
+#include "bb/LutNetEngine.h"
+
+
+struct bblut_engine
+{
+    bb::LutNetEngine    engine;
+};
+
+
+BBLUT_DLL_EXPORT bblut_engine *bblut_Load(char const *filename, int max_frame_size)
+{
+    auto self = new bblut_engine;
+    if ( !self->engine.LoadBinary(filename, max_frame_size) ) {
+        delete self;
+        return nullptr;
+    }
+    return self;
+}
+
+BBLUT_DLL_EXPORT void bblut_Delete(bblut_engine *engine)
+{
+    delete engine;
+}
+
+BBLUT_DLL_EXPORT int bblut_GetInputNodeSize(bblut_engine const *engine)
+{
+    return (int)engine->engine.GetInputNodeSize();
+}
+
+BBLUT_DLL_EXPORT int bblut_GetOutputNodeSize(bblut_engine const *engine)
+{
+    return (int)engine->engine.GetOutputNodeSize();
+}
+
+BBLUT_DLL_EXPORT int bblut_Forward
+        (
+            bblut_engine        *engine,
+            unsigned char const *x,
+            unsigned char       *y,
+            int                 frame_size
+        )
+{
+    if ( engine == nullptr || x == nullptr || y == nullptr || frame_size < 0 ) {
+        return 1;
+    }
+    engine->engine.Forward((std::uint8_t const *)x, (std::uint8_t *)y, (bb::index_t)frame_size);
+    return 0;
+}
+
+
+// end of file
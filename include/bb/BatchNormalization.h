@@ -19,7 +19,7 @@
 #include "bb/DataType.h"
 #include "bb/Activation.h"
 #include "bb/FrameBuffer.h"
-#include "bb/SimdSupport.h"
+#include "bb/SimdKernel.h"
 
 #if BB_WITH_CUDA
 #include "bbcu/bbcu.h"
@@ -39,6 +39,7 @@ class BatchNormalization : public Activation<T, T>
 protected:
     bool                        m_host_only = false;
     bool                        m_host_simd = true;
+    bool                        m_running_stat_lock = false;    // true の間は running_mean/var を更新しない
 
 
     index_t 		            m_node_size;
@@ -80,6 +81,12 @@ protected:
         {
             m_host_simd = EvalBool(args[1]);
         }
+
+        // 学習時の running_mean/var 更新の停止設定 (forward 再計算用)
+        if (args.size() == 2 && args[0] == "running_stat_lock")
+        {
+            m_running_stat_lock = EvalBool(args[1]);
+        }
 	}
 
 public:
@@ -106,6 +113,11 @@ public:
 
     std::string GetClassName(void) const { return "BatchNormalization"; }
 
+    T GetMomentum(void) const { return m_momentum; }
+
+    //! 学習時の running_mean/var の更新に使う momentum (running_stat_lock 中は 1)
+    T GetRunningStatMomentum(void) const { return m_running_stat_lock ? (T)1 : m_momentum; }
+
 
 
     // Serialize
@@ -304,7 +316,7 @@ public:
 					    (float       *)dev_rstd_ptr.GetAddr(),
 					    (float       *)dev_running_mean_ptr.GetAddr(),
 					    (float       *)dev_running_var_ptr.GetAddr(),
-					    (float        )m_momentum,
+					    (float        )GetRunningStatMomentum(),
 					    (int          )m_x.GetNodeSize(),
 					    (int          )m_x.GetFrameSize(),
 					    (int          )m_x.GetFrameStride() / sizeof(float)
@@ -342,8 +354,6 @@ public:
             auto frame_size   = x.GetFrameSize();
             auto frame_stride = x.GetFrameStride() / sizeof(float);
         
-            const int	mm256_frame_size = ((int)frame_size + 7) / 8 * 8;
-
             auto x_buf_ptr = m_x.LockConst<T>();
             auto y_buf_ptr = m_y.Lock<T>();
 
@@ -356,81 +366,31 @@ public:
             auto running_var_ptr  = m_running_var.Lock();
 
             if (train) {
-                const __m256	reciprocal_frame_size = _mm256_set1_ps(1.0f / (float)frame_size);
-                const __m256	epsilon = _mm256_set1_ps(10e-7f);
+                auto kernel = BB_SIMD_KERNEL(BatchNormalization_ForwardTraining);
+                T    momentum = GetRunningStatMomentum();
 
 		  	    #pragma omp parallel for
                 for (int node = 0; node < (int)m_node_size; ++node) {
-                    float const *x_ptr = x_buf_ptr.GetAddr(node);
-                    float       *y_ptr = y_buf_ptr.GetAddr(node);
-
-                    // 平均と分散計算
-                    __m256 mean_sum = _mm256_set1_ps(0.0f);
-                    __m256 mean_c   = _mm256_set1_ps(0.0f);
-                    __m256 var_sum  = _mm256_set1_ps(0.0f);
-                    __m256 var_c    = _mm256_set1_ps(0.0f);
-                    for ( int frame = 0; frame < mm256_frame_size; frame += 8) {
-                        __m256 x = _mm256_load_ps(&x_ptr[frame + 0]);
-                        __m256 mean_y = _mm256_sub_ps(x, mean_c);
-                        __m256 mean_t = _mm256_add_ps(mean_sum, mean_y);
-                        __m256 mean_c = _mm256_sub_ps(_mm256_sub_ps(mean_t, mean_sum), mean_y);
-                        mean_sum = mean_t;
-
-                        __m256 var_y = _mm256_fmsub_ps(x, x, var_c);
-                        __m256 var_t = _mm256_add_ps(var_sum, var_y);
-                        __m256 var_c = _mm256_sub_ps(_mm256_sub_ps(var_t, var_sum), var_y);
-                        var_sum = var_t;
-                    }
-                    __m256 mean = _mm256_mul_ps(bb_mm256_hsum_ps(mean_sum), reciprocal_frame_size);
-                    __m256 var = _mm256_fmsub_ps(bb_mm256_hsum_ps(var_sum), reciprocal_frame_size, _mm256_mul_ps(mean, mean));
-                    var = _mm256_max_ps(var, _mm256_set1_ps(0.0f));	// 誤差対策(負にならないようにクリップ)
-
-                    __m256 varx = _mm256_max_ps(var, epsilon);
-                    __m256 rstd = _mm256_rsqrt_ps(varx);
-
-                    varx = _mm256_mul_ps(varx, _mm256_set1_ps(0.5f));
-                    rstd = _mm256_mul_ps(rstd, _mm256_fnmadd_ps(varx, _mm256_mul_ps(rstd, rstd), _mm256_set1_ps(1.5f)));
-                    rstd = _mm256_mul_ps(rstd, _mm256_fnmadd_ps(varx, _mm256_mul_ps(rstd, rstd), _mm256_set1_ps(1.5f)));
+                    // 平均と分散を求めて正規化
+                    float mean, var, rstd;
+                    kernel(y_buf_ptr.GetAddr(node), x_buf_ptr.GetAddr(node), frame_size, gamma_ptr[node], beta_ptr[node], mean, var, rstd);
 
                     // 実行時の mean と var 保存
-                    running_mean_ptr[node] = running_mean_ptr[node] * m_momentum + bb_mm256_cvtss_f32(mean) * (1 - m_momentum);
-                    running_var_ptr[node]  = running_var_ptr[node] * m_momentum + bb_mm256_cvtss_f32(var) * (1 - m_momentum);
+                    running_mean_ptr[node] = running_mean_ptr[node] * momentum + mean * (1 - momentum);
+                    running_var_ptr[node]  = running_var_ptr[node] * momentum + var * (1 - momentum);
 
                     // 結果の保存
-                    mean_ptr[node] = bb_mm256_cvtss_f32(mean);
-                    rstd_ptr[node] = bb_mm256_cvtss_f32(rstd);
-
-                    // 正規化 と gamma/beta 処理
-                    __m256 gamma = _mm256_set1_ps(gamma_ptr[node]);
-                    __m256 beta = _mm256_set1_ps(beta_ptr[node]);
-    //				for (int frame = 0; frame < mm256_frame_size; frame += 8) {
-                    for (int frame = mm256_frame_size-8; frame >= 0; frame -= 8) {
-                    __m256 x = _mm256_load_ps(&x_ptr[frame]);
-                        __m256 xn = _mm256_mul_ps(_mm256_sub_ps(x, mean), rstd);
-                        __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
-                        _mm256_store_ps(&y_ptr[frame], y);
-                    }
+                    mean_ptr[node] = mean;
+                    rstd_ptr[node] = rstd;
                 }
             }
             else {
+                auto kernel = BB_SIMD_KERNEL(BatchNormalization_ForwardInference);
+
                 #pragma omp parallel for
                 for (int node = 0; node < (int)m_node_size; ++node) {
-                    auto x_ptr = x_buf_ptr.GetAddr(node);
-                    auto y_ptr = y_buf_ptr.GetAddr(node);
-
-                    __m256 running_mean = _mm256_set1_ps(running_mean_ptr[node]);
-                    __m256 running_var = _mm256_set1_ps(1.0f / (sqrt(running_var_ptr[node]) + 10e-7f));
-
-                    __m256 gamma = _mm256_set1_ps(gamma_ptr[node]);
-                    __m256 beta = _mm256_set1_ps(beta_ptr[node]);
-
-                    for (int frame = 0; frame < mm256_frame_size; frame += 8) {
-                        __m256 x = _mm256_load_ps(&x_ptr[frame]);
-                        __m256 xc = _mm256_sub_ps(x, running_mean);
-                        __m256 xn = _mm256_mul_ps(xc, running_var);
-                        __m256 y = _mm256_fmadd_ps(xn, gamma, beta);
-                        _mm256_store_ps(&y_ptr[frame], y);
-                    }
+                    float rstd = 1.0f / (sqrt(running_var_ptr[node]) + 10e-7f);
+                    kernel(y_buf_ptr.GetAddr(node), x_buf_ptr.GetAddr(node), frame_size, running_mean_ptr[node], rstd, gamma_ptr[node], beta_ptr[node]);
                 }
             }
 
@@ -485,73 +445,26 @@ public:
             auto frame_size   = dy.GetFrameSize();
             auto frame_stride = dy.GetFrameStride() / sizeof(float);
             
-            const int	mm256_frame_size = ((int)frame_size + 7) / 8 * 8;
-            
             auto gamma_ptr        = lock_gamma_const();
-    //      auto beta_ptr         = lock_beta_const();
             auto dgamma_ptr       = lock_dgamma();
             auto dbeta_ptr        = lock_dbeta();
 
             auto mean_ptr         = m_mean.LockConst();
             auto rstd_ptr         = m_rstd.LockConst();
-       
-        
-            // 逆数生成
-            const __m256	reciprocal_frame_size = _mm256_set1_ps(1.0f / (float)frame_size);
 
             auto x_buf_ptr  = m_x.LockConst<T>();
-            auto y_buf_ptr  = m_y.LockConst<T>();
             auto dx_buf_ptr = m_dx.Lock<T>();
             auto dy_buf_ptr = dy.LockConst<T>();
 
+            auto kernel = BB_SIMD_KERNEL(BatchNormalization_Backward);
+
             #pragma omp parallel for
             for (int node = 0; node < (int)m_node_size; ++node) {
-                auto dy_ptr = dy_buf_ptr.GetAddr(node);
-                auto dx_ptr = dx_buf_ptr.GetAddr(node);
-                auto x_ptr  = x_buf_ptr.GetAddr(node);
-
-                __m256 mean   = _mm256_set1_ps(mean_ptr[node]);
-                __m256 rstd   = _mm256_set1_ps(rstd_ptr[node]);
-                __m256 gamma  = _mm256_set1_ps(gamma_ptr[node]);
-                __m256 dbeta  = _mm256_set1_ps(0);
-                __m256 dgamma = _mm256_set1_ps(0);
-                __m256 dstd = _mm256_set1_ps(0);
-                __m256 dmeanx = _mm256_set1_ps(0);
-                __m256 rstd2 = _mm256_mul_ps(rstd, rstd);
-
-                for (int frame = 0; frame < mm256_frame_size; frame += 8) {
-                    __m256 x = _mm256_load_ps(&x_ptr[frame]);
-                    __m256 xc = _mm256_sub_ps(x, mean);
-                    __m256 xn = _mm256_mul_ps(xc, rstd);
-
-                    __m256 dy = _mm256_load_ps(&dy_ptr[frame]);
-                    dbeta = _mm256_add_ps(dy, dbeta);
-                    dgamma = _mm256_fmadd_ps(xn, dy, dgamma);
-
-                    __m256 dxn = _mm256_mul_ps(dy, gamma);
-                    dstd = _mm256_fnmadd_ps(_mm256_mul_ps(dxn, xc), rstd2, dstd);
-                    dmeanx = _mm256_fnmadd_ps(dxn, rstd, dmeanx);
-                }
-                dbeta = bb_mm256_hsum_ps(dbeta);
-                dgamma = bb_mm256_hsum_ps(dgamma);
-                dgamma_ptr[node] = bb_mm256_cvtss_f32(dgamma);
-                dbeta_ptr[node] = bb_mm256_cvtss_f32(dbeta);
-
-                dstd = bb_mm256_hsum_ps(dstd);
-                dmeanx = bb_mm256_hsum_ps(dmeanx);
-
-                __m256 dvar  = _mm256_mul_ps(dstd, rstd);
-                __m256 dmean = _mm256_mul_ps(_mm256_fnmadd_ps(mean, dvar, dmeanx), reciprocal_frame_size);
-
-    //			for (int frame = 0; frame < mm256_frame_size; frame += 8) {
-                for (int frame = mm256_frame_size - 8; frame >= 0; frame -= 8) {
-                    __m256 dy = _mm256_load_ps(&dy_ptr[frame]);
-                    __m256 x = _mm256_load_ps(&x_ptr[frame]);
-                    __m256 dxn = _mm256_mul_ps(dy, gamma);
-                    __m256 dxc = _mm256_fmadd_ps(dxn, rstd, dmean);
-                    __m256 dx = _mm256_fmadd_ps(_mm256_mul_ps(x, dvar), reciprocal_frame_size, dxc);
-                    _mm256_store_ps(&dx_ptr[frame], dx);
-                }
+                float dgamma, dbeta;
+                kernel(dx_buf_ptr.GetAddr(node), x_buf_ptr.GetAddr(node), dy_buf_ptr.GetAddr(node), frame_size,
+                            mean_ptr[node], rstd_ptr[node], gamma_ptr[node], dgamma, dbeta);
+                dgamma_ptr[node] = dgamma;
+                dbeta_ptr[node]  = dbeta;
             }
 
             return m_dx;
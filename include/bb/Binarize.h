@@ -13,6 +13,7 @@
 
 #include "bb/Manager.h"
 #include "bb/Activation.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
@@ -181,15 +182,15 @@ inline FrameBuffer Binarize<float>::Forward(FrameBuffer x, bool train)
 #endif
 
     {
-        // CPU版
+        // SIMD版(実行時に命令セットを選択)
         auto x_ptr = m_x.LockConst<float>();
 	    auto y_ptr = m_y.Lock<float>();
 
-#pragma omp parallel for
+        auto kernel = BB_SIMD_KERNEL(Binarize_Forward);
+
+        #pragma omp parallel for
 		for (index_t node = 0; node < node_size; ++node) {
-			for (index_t frame = 0; frame < frame_size; ++frame) {
-				y_ptr.Set(frame, node, x_ptr.Get(frame, node) > 0.0f ? 1.0f : 0.0f);
-			}
+            kernel(y_ptr.GetAddr(node), x_ptr.GetAddr(node), frame_size);
 		}
         return m_y;
     }
@@ -233,19 +234,17 @@ inline FrameBuffer Binarize<float>::Backward(FrameBuffer dy)
 #endif
 
     {
-        // CPU版
+        // SIMD版(実行時に命令セットを選択)
         auto x_ptr  = m_x.LockConst<float>();
 	    auto dy_ptr = dy.LockConst<float>();
 	    auto dx_ptr = m_dx.Lock<float>(true);
 
-#pragma omp parallel for
+        auto kernel = BB_SIMD_KERNEL(Binarize_Backward);
+
+        // hard-tanh
+        #pragma omp parallel for
 		for (index_t node = 0; node < node_size; ++node) {
-			for (index_t frame = 0; frame < frame_size; ++frame) {
-				// hard-tanh
-				auto grad = dy_ptr.Get(frame, node);
-				auto sig  = x_ptr.Get(frame, node);
-				dx_ptr.Set(frame, node, (sig >= -1.0f && sig <= 1.0f) ? grad : 0);
-			}
+            kernel(dx_ptr.GetAddr(node), x_ptr.GetAddr(node), dy_ptr.GetAddr(node), frame_size);
 		}
         return m_dx;
     }
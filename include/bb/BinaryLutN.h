@@ -13,6 +13,8 @@
 #include <array>
 #include <vector>
 #include "bb/LutLayer.h"
+#include "bb/LutProgram.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
@@ -25,6 +27,8 @@ class BinaryLutN : public LutLayer<FT, BT>
 protected:
     bool                    m_host_only = false;
     bool                    m_host_simd = true;
+    bool                    m_host_program = false;
+    bool                    m_host_avx512 = true;
 
     indices_t               m_input_shape;
     indices_t               m_output_shape;
@@ -35,10 +39,19 @@ protected:
     static int const        m_table_size = (1 << N);
     static int const        m_table_bits = sizeof(std::int32_t) * 8;
     static int const        m_table_unit = (m_table_size + (m_table_bits - 1)) / m_table_bits;
+
+    // SIMD版の対応入力数(テンプレート展開の上限)
+    static int const        m_simd_max        = 8;
+    static int const        m_simd_level      = (N <= m_simd_max) ? N : 1;
     Tensor_<std::int32_t>   m_table;
 
     Tensor_<std::int32_t>   m_input_index;
 
+    // 推論用に変換したLUT演算プログラム(テーブル変更時に再生成)
+    std::vector<LutProgram> m_program;
+    bool                    m_program_dirty = true;
+    bool                    m_program_ternlog = false;
+
     std::mt19937_64         m_mt;
 
 protected:
@@ -63,6 +76,21 @@ protected:
         {
             m_host_simd = EvalBool(args[1]);
         }
+
+        // 論理演算プログラムによる推論モード設定 (既定は off)
+        //   AVX2 では多くの層で host_simd の方が速い(特に lut4 や cnv2 のような
+        //   フレーム数の少ない層では倍以上遅くなる)ので、AVX-512 の VPTERNLOG で
+        //   効果がある層に限って使うこと (test/bench の BinaryLut6(program) で比較できる)
+        if (args.size() == 2 && args[0] == "host_program")
+        {
+            m_host_program = EvalBool(args[1]);
+        }
+
+        // Host AVX-512 利用設定(CPUが対応している場合のみ有効)
+        if (args.size() == 2 && args[0] == "host_avx512")
+        {
+            m_host_avx512 = EvalBool(args[1]);
+        }
 	}
 
 public:
@@ -149,6 +177,8 @@ public:
         int idx = bitpos / m_table_bits;
         int bit = bitpos % m_table_bits;
 
+        m_program_dirty = true;
+
         auto ptr = m_table.Lock();
         if ( value ) {
             ptr(node, idx) |= (1 << bit);
@@ -235,34 +265,42 @@ public:
     
 
 private:
-    template<int LUT, int VAL>
-    inline __m256i lut_mask_unit(__m256i& val, __m256i& lut)
+    inline bool GetLutTableFromPtr(Tensor_<std::int32_t>::ConstPtr ptr, index_t node, int index)
     {
-        if ((LUT & (1 << VAL)) == 0) {
-            return _mm256_andnot_si256(val, lut);
-        }
-	    else {
-	        return _mm256_and_si256(val, lut);
-	    }
+        auto idx = index / m_table_bits;
+        auto bit = index % m_table_bits;
+        return (((ptr(node, idx) >> bit) & 1) != 0);
     }
-    
-    template<int LUT>
-    inline void lut6_mask(__m256i& msk, __m256i lut, __m256i val[6])
+
+    // ノードの真理値表を取得
+    std::uint64_t GetLutTableBits(Tensor_<std::int32_t>::ConstPtr ptr, index_t node)
     {
-	    lut = lut_mask_unit<LUT, 0>(val[0], lut);
-	    lut = lut_mask_unit<LUT, 1>(val[1], lut);
-	    lut = lut_mask_unit<LUT, 2>(val[2], lut);
-	    lut = lut_mask_unit<LUT, 3>(val[3], lut);
-	    lut = lut_mask_unit<LUT, 4>(val[4], lut);
-	    lut = lut_mask_unit<LUT, 5>(val[5], lut);
-	    msk = _mm256_or_si256(msk, lut);
+        std::uint64_t bits = 0;
+        for ( int i = 0; i < m_table_unit; ++i ) {
+            bits |= (std::uint64_t)(std::uint32_t)ptr(node, i) << (i * m_table_bits);
+        }
+        return bits;
     }
 
-    inline bool GetLutTableFromPtr(Tensor_<std::int32_t>::ConstPtr ptr, index_t node, int index)
+    // テーブルを論理演算プログラムに変換(ノード毎にShannon展開/積和形の速い方を選択)
+    void BuildProgram(bool ternlog)
     {
-        auto idx = index / m_table_bits;
-        auto bit = index % m_table_bits;
-        return (((ptr(node, idx) >> bit) & 1) != 0);
+        if ( !m_program_dirty && m_program_ternlog == ternlog ) {
+            return;
+        }
+
+        auto    table_ptr = m_table.LockConst();
+        index_t node_size = this->GetOutputNodeSize();
+
+        m_program.resize(node_size);
+
+        #pragma omp parallel for
+        for ( index_t node = 0; node < node_size; ++node ) {
+            m_program[node] = LutProgram::Compile(N, GetLutTableBits(table_ptr, node), ternlog);
+        }
+
+        m_program_dirty   = false;
+        m_program_ternlog = ternlog;
     }
 
 public:
@@ -300,115 +338,94 @@ public:
         }
 #endif
 
-        if ( N == 6 && DataType<FT>::type == BB_TYPE_BIT && m_host_simd ) {
+        if ( N <= LutProgram::MAX_INPUT && DataType<FT>::type == BB_TYPE_BIT && m_host_program && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            bool avx512 = m_host_avx512 && bb_simd_get_level() >= BB_SIMD_AVX512F;
+            BuildProgram(avx512);
+
+            auto x_ptr = x_buf.LockConst<Bit>();
+            auto y_ptr = m_y_buf.Lock<Bit>(true);
+
+            auto input_index_ptr = m_input_index.LockConst();
+
+            index_t node_size = m_y_buf.GetNodeSize();
+            index_t unit_size = m_y_buf.GetFrameStride() / sizeof(__m256i);
+
+            #pragma omp parallel for
+            for (index_t node = 0; node < node_size; ++node) {
+                __m256i const *x_addr[LutProgram::MAX_INPUT];
+                for (int i = 0; i < N; ++i) {
+                    x_addr[i] = (__m256i const *)x_ptr.GetAddr(input_index_ptr(node, i));
+                }
+                __m256i *y_addr = (__m256i *)y_ptr.GetAddr(node);
+
+                if ( avx512 ) {
+                    m_program[node].ExecuteAvx512(x_addr, y_addr, unit_size);
+                }
+                else {
+                    m_program[node].ExecuteAvx2(x_addr, y_addr, unit_size);
+                }
+            }
+
+            return m_y_buf;
+        }
+
+        if ( N <= m_simd_max && DataType<FT>::type == BB_TYPE_BIT && m_host_simd ) {
             auto x_ptr = x_buf.LockConst<Bit>();
             auto y_ptr = m_y_buf.Lock<Bit>(true);
 
             auto input_index_ptr = m_input_index.LockConst();
             auto table_ptr       = m_table.LockConst();
 
+            index_t node_size = m_y_buf.GetNodeSize();
+            index_t word_size = m_y_buf.GetFrameStride() / sizeof(std::int32_t);
+
+            auto kernel = BB_SIMD_KERNEL(BinaryLutN_ForwardBit<m_simd_level>);
+
+            #pragma omp parallel for
+            for (index_t node = 0; node < node_size; ++node) {
+                std::int32_t const *x_addr[N];
+                for (int i = 0; i < N; ++i) {
+                    x_addr[i] = (std::int32_t const *)x_ptr.GetAddr(input_index_ptr(node, i));
+                }
+
+                std::uint32_t table[m_table_unit];
+                for (int i = 0; i < m_table_unit; ++i) {
+                    table[i] = (std::uint32_t)table_ptr(node, i);
+                }
+
+                kernel((std::int32_t *)y_ptr.GetAddr(node), x_addr, table, word_size);
+            }
+
+            return m_y_buf;
+        }
+
+        if ( N <= m_simd_max && DataType<FT>::type == BB_TYPE_FP32 && m_host_simd ) {
+            auto x_ptr = x_buf.LockConst<float>();
+            auto y_ptr = m_y_buf.Lock<float>(true);
+
+            auto input_index_ptr = m_input_index.LockConst();
+            auto table_ptr       = m_table.LockConst();
+
             index_t node_size  = m_y_buf.GetNodeSize();
-            index_t frame_size = m_y_buf.GetFrameStride() / sizeof(__m256i);
+            index_t frame_size = m_y_buf.GetFrameSize();
+
+            auto kernel = BB_SIMD_KERNEL(BinaryLutN_ForwardFp32<m_simd_level>);
 
             #pragma omp parallel for
             for (index_t node = 0; node < node_size; ++node) {
-		        __m256i*	x_addr[6];
-		        __m256i*	y_addr;
-		        __m256i		x[6];
-
-		        x_addr[0] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 0));
-		        x_addr[1] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 1));
-		        x_addr[2] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 2));
-		        x_addr[3] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 3));
-		        x_addr[4] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 4));
-		        x_addr[5] = (__m256i*)x_ptr.GetAddr(input_index_ptr(node, 5));
-		        y_addr    = (__m256i*)y_ptr.GetAddr(node);
-
-                char    table[64];
-                std::int32_t t0 = table_ptr(node, 0);
-                std::int32_t t1 = table_ptr(node, 1);
-		        for (int i = 0; i < 32; ++i) { table[i]    = (t0 & (1 << i)) ? -1 : 0; }
-		        for (int i = 0; i < 32; ++i) { table[i+32] = (t1 & (1 << i)) ? -1 : 0; }
-
-		        for (index_t frame = 0; frame < frame_size; ++frame) {
-			        // input
-			        x[0] = _mm256_loadu_si256(&x_addr[0][frame]);
-			        x[1] = _mm256_loadu_si256(&x_addr[1][frame]);
-			        x[2] = _mm256_loadu_si256(&x_addr[2][frame]);
-			        x[3] = _mm256_loadu_si256(&x_addr[3][frame]);
-			        x[4] = _mm256_loadu_si256(&x_addr[4][frame]);
-			        x[5] = _mm256_loadu_si256(&x_addr[5][frame]);
-
-			        // LUT
-			        __m256i y = _mm256_set1_epi8(0);
-			        lut6_mask< 0>(y, _mm256_set1_epi8(table[0]), x);
-			        lut6_mask< 1>(y, _mm256_set1_epi8(table[1]), x);
-			        lut6_mask< 2>(y, _mm256_set1_epi8(table[2]), x);
-			        lut6_mask< 3>(y, _mm256_set1_epi8(table[3]), x);
-			        lut6_mask< 4>(y, _mm256_set1_epi8(table[4]), x);
-			        lut6_mask< 5>(y, _mm256_set1_epi8(table[5]), x);
-			        lut6_mask< 6>(y, _mm256_set1_epi8(table[6]), x);
-			        lut6_mask< 7>(y, _mm256_set1_epi8(table[7]), x);
-			        lut6_mask< 8>(y, _mm256_set1_epi8(table[8]), x);
-			        lut6_mask< 9>(y, _mm256_set1_epi8(table[9]), x);
-			        lut6_mask<10>(y, _mm256_set1_epi8(table[10]), x);
-			        lut6_mask<11>(y, _mm256_set1_epi8(table[11]), x);
-			        lut6_mask<12>(y, _mm256_set1_epi8(table[12]), x);
-			        lut6_mask<13>(y, _mm256_set1_epi8(table[13]), x);
-			        lut6_mask<14>(y, _mm256_set1_epi8(table[14]), x);
-			        lut6_mask<15>(y, _mm256_set1_epi8(table[15]), x);
-			        lut6_mask<16>(y, _mm256_set1_epi8(table[16]), x);
-			        lut6_mask<17>(y, _mm256_set1_epi8(table[17]), x);
-			        lut6_mask<18>(y, _mm256_set1_epi8(table[18]), x);
-			        lut6_mask<19>(y, _mm256_set1_epi8(table[19]), x);
-			        lut6_mask<20>(y, _mm256_set1_epi8(table[20]), x);
-			        lut6_mask<21>(y, _mm256_set1_epi8(table[21]), x);
-			        lut6_mask<22>(y, _mm256_set1_epi8(table[22]), x);
-			        lut6_mask<23>(y, _mm256_set1_epi8(table[23]), x);
-			        lut6_mask<24>(y, _mm256_set1_epi8(table[24]), x);
-			        lut6_mask<25>(y, _mm256_set1_epi8(table[25]), x);
-			        lut6_mask<26>(y, _mm256_set1_epi8(table[26]), x);
-			        lut6_mask<27>(y, _mm256_set1_epi8(table[27]), x);
-			        lut6_mask<28>(y, _mm256_set1_epi8(table[28]), x);
-			        lut6_mask<29>(y, _mm256_set1_epi8(table[29]), x);
-			        lut6_mask<30>(y, _mm256_set1_epi8(table[30]), x);
-			        lut6_mask<31>(y, _mm256_set1_epi8(table[31]), x);
-			        lut6_mask<32>(y, _mm256_set1_epi8(table[32]), x);
-			        lut6_mask<33>(y, _mm256_set1_epi8(table[33]), x);
-			        lut6_mask<34>(y, _mm256_set1_epi8(table[34]), x);
-			        lut6_mask<35>(y, _mm256_set1_epi8(table[35]), x);
-			        lut6_mask<36>(y, _mm256_set1_epi8(table[36]), x);
-			        lut6_mask<37>(y, _mm256_set1_epi8(table[37]), x);
-			        lut6_mask<38>(y, _mm256_set1_epi8(table[38]), x);
-			        lut6_mask<39>(y, _mm256_set1_epi8(table[39]), x);
-			        lut6_mask<40>(y, _mm256_set1_epi8(table[40]), x);
-			        lut6_mask<41>(y, _mm256_set1_epi8(table[41]), x);
-			        lut6_mask<42>(y, _mm256_set1_epi8(table[42]), x);
-			        lut6_mask<43>(y, _mm256_set1_epi8(table[43]), x);
-			        lut6_mask<44>(y, _mm256_set1_epi8(table[44]), x);
-			        lut6_mask<45>(y, _mm256_set1_epi8(table[45]), x);
-			        lut6_mask<46>(y, _mm256_set1_epi8(table[46]), x);
-			        lut6_mask<47>(y, _mm256_set1_epi8(table[47]), x);
-			        lut6_mask<48>(y, _mm256_set1_epi8(table[48]), x);
-			        lut6_mask<49>(y, _mm256_set1_epi8(table[49]), x);
-			        lut6_mask<50>(y, _mm256_set1_epi8(table[50]), x);
-			        lut6_mask<51>(y, _mm256_set1_epi8(table[51]), x);
-			        lut6_mask<52>(y, _mm256_set1_epi8(table[52]), x);
-			        lut6_mask<53>(y, _mm256_set1_epi8(table[53]), x);
-			        lut6_mask<54>(y, _mm256_set1_epi8(table[54]), x);
-			        lut6_mask<55>(y, _mm256_set1_epi8(table[55]), x);
-			        lut6_mask<56>(y, _mm256_set1_epi8(table[56]), x);
-			        lut6_mask<57>(y, _mm256_set1_epi8(table[57]), x);
-			        lut6_mask<58>(y, _mm256_set1_epi8(table[58]), x);
-			        lut6_mask<59>(y, _mm256_set1_epi8(table[59]), x);
-			        lut6_mask<60>(y, _mm256_set1_epi8(table[60]), x);
-			        lut6_mask<61>(y, _mm256_set1_epi8(table[61]), x);
-			        lut6_mask<62>(y, _mm256_set1_epi8(table[62]), x);
-			        lut6_mask<63>(y, _mm256_set1_epi8(table[63]), x);
-
-			        _mm256_storeu_si256(&y_addr[frame], y);
-		        }
-	        }
+                float const *x_addr[N];
+                for (int i = 0; i < N; ++i) {
+                    x_addr[i] = x_ptr.GetAddr(input_index_ptr(node, i));
+                }
+
+                // テーブル(最大256bit)を渡してインデックスで引く
+                std::int32_t table[8] = {0};
+                for (int i = 0; i < m_table_unit; ++i) {
+                    table[i] = table_ptr(node, i);
+                }
+
+                kernel(y_ptr.GetAddr(node), x_addr, table, frame_size);
+            }
 
             return m_y_buf;
         }
@@ -13,6 +13,7 @@
 #include <random>
 
 #include "bb/Model.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
@@ -161,6 +162,45 @@ public:
         }
 #endif
 
+        // SIMD版 (Bit入力はフレーム方向に詰まっているので popcount で数える)
+        //   入力ノードが出力ノードの整数倍でない場合は汎用版で出力ノード毎に平均する
+        if ( DataType<FYT>::type == BB_TYPE_FP32 && (DataType<FXT>::type == BB_TYPE_BIT || DataType<FXT>::type == BB_TYPE_FP32)
+                && GetInputNodeSize() >= GetOutputNodeSize() && GetInputNodeSize() % GetOutputNodeSize() == 0 ) {
+		    auto x_ptr = x.LockConst<FXT>();
+		    auto y_ptr = m_y.Lock<float>(true);
+
+            index_t input_node_size   = GetInputNodeSize();
+            index_t output_node_size  = GetOutputNodeSize();
+            index_t output_frame_size = m_y.GetFrameSize();
+            int     node_mux_size     = (int)(input_node_size / output_node_size);
+            float   gain              = 1.0f / ((float)node_mux_size * (float)m_frame_mux_size);
+
+            bool bit_input   = (DataType<FXT>::type == BB_TYPE_BIT);
+            auto bit_kernel  = BB_SIMD_KERNEL(BinaryToReal_ForwardBit);
+            auto fp32_kernel = BB_SIMD_KERNEL(BinaryToReal_ForwardFp32);
+
+            #pragma omp parallel
+            {
+                std::vector<void const *> x_addr(node_mux_size);
+
+                #pragma omp for
+                for ( index_t node = 0; node < output_node_size; ++node ) {
+                    for ( int i = 0; i < node_mux_size; ++i ) {
+                        x_addr[i] = x_ptr.GetAddr(node + i * output_node_size);
+                    }
+
+                    if ( bit_input ) {
+                        bit_kernel((float *)y_ptr.GetAddr(node), (std::int32_t const * const *)&x_addr[0], node_mux_size, m_frame_mux_size, gain, output_frame_size);
+                    }
+                    else {
+                        fp32_kernel((float *)y_ptr.GetAddr(node), (float const * const *)&x_addr[0], node_mux_size, m_frame_mux_size, gain, output_frame_size);
+                    }
+                }
+            }
+
+            return m_y;
+        }
+
         {
 		    auto x_ptr = x.LockConst<FXT>();
 		    auto y_ptr = m_y.Lock<FYT>(true);
@@ -233,6 +273,19 @@ public:
             auto dx_ptr = m_dx.Lock<BT>();
 
 		    BT	gain = (BT)output_node_size / ((BT)input_node_size * (BT)m_frame_mux_size);
+
+            // SIMD版
+            if ( DataType<BT>::type == BB_TYPE_FP32 ) {
+                auto kernel = BB_SIMD_KERNEL(BinaryToReal_Backward);
+
+                #pragma omp parallel for
+		        for (index_t node = 0; node < input_node_size; node++) {
+                    kernel((float *)dx_ptr.GetAddr(node), (float const *)dy_ptr.GetAddr(node % output_node_size), m_frame_mux_size, (float)gain, output_frame_size);
+                }
+                return m_dx;
+            }
+
+            #pragma omp parallel for
 		    for (index_t node = 0; node < input_node_size; node++) {
 			    for (index_t frame = 0; frame < output_frame_size; ++frame) {
 				    for (index_t i = 0; i < m_frame_mux_size; i++) {
@@ -12,8 +12,11 @@
 
 #include <vector>
 #include <random>
+#include <cstdint>
+#include <algorithm>
 
 #include "bb/Model.h"
+#include "bb/SimdSupport.h"
 
 
 namespace bb {
@@ -26,6 +29,7 @@ protected:
     indices_t       m_input_shape;
 
     bool            m_host_only = false;
+    bool            m_host_simd = true;
 
 	index_t			m_c_size = 1;
 	index_t			m_h_size = 1;
@@ -49,6 +53,12 @@ protected:
         {
             m_host_only = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
 	}
 
 public:
@@ -120,10 +130,151 @@ public:
     }
 
 
+protected:
+    // 入力ノード(チャネル)毎に (frame, pos) -> (pos, frame) へ 8x8 ブロック転置 (FP32)
+    BB_TARGET_AVX2
+    void ForwardHostSimdFP32(FrameBuffer const &x, FrameBuffer &y)
+    {
+        auto x_ptr = x.LockMemoryConst();
+        auto y_ptr = y.LockMemory(true);
+        float const *x_addr = (float const *)x_ptr.GetAddr();
+        float       *y_addr = (float       *)y_ptr.GetAddr();
+
+        index_t const x_stride    = x.GetFrameStride() / sizeof(float);
+        index_t const y_stride    = y.GetFrameStride() / sizeof(float);
+        index_t const pos_size    = m_h_size * m_w_size;
+        index_t const pos_blocks  = (pos_size + 7) / 8;
+        index_t const frame_size  = y.GetFrameSize();
+
+        // チャネル数が少なくてもスレッドが余らないよう 8座標ブロック単位で分配
+        #pragma omp parallel for
+        for (index_t blk = 0; blk < m_c_size * pos_blocks; ++blk) {
+            index_t c     = blk / pos_blocks;
+            index_t pos   = (blk % pos_blocks) * 8;
+            int     pos_n = (int)std::min((index_t)8, pos_size - pos);
+            __m256i pos_mask = _mm256_castps_si256(bb_mm256_mask_ps(pos_n));
+            float const *x_node = &x_addr[c * x_stride];
+            float       *y_node = &y_addr[(c * pos_size + pos) * y_stride];
+
+            for (index_t frame = 0; frame < frame_size; frame += 8) {
+                int    frame_n = (int)std::min((index_t)8, frame_size - frame);
+                __m256 r[8];
+                for (int i = 0; i < 8; ++i) {
+                    float const *src = &x_node[(frame + i) * pos_size + pos];
+                    if ( i >= frame_n ) {
+                        r[i] = _mm256_setzero_ps();
+                    }
+                    else if ( pos_n == 8 ) {
+                        r[i] = _mm256_loadu_ps(src);
+                    }
+                    else {
+                        r[i] = _mm256_maskload_ps(src, pos_mask);
+                    }
+                }
+                bb_mm256_transpose8x8_ps(r);
+                for (int j = 0; j < pos_n; ++j) {
+                    _mm256_store_ps(&y_node[j * y_stride + frame], r[j]);
+                }
+            }
+        }
+    }
+
+    // 出力ノード毎に 32フレーム分のビットを集めて書き込む (Bit)
+    BB_TARGET_AVX2
+    void ForwardHostSimdBit(FrameBuffer const &x, FrameBuffer &y)
+    {
+        auto x_ptr = x.LockMemoryConst();
+        auto y_ptr = y.LockMemory(true);
+        int const     *x_addr = (int const     *)x_ptr.GetAddr();
+        std::uint32_t *y_addr = (std::uint32_t *)y_ptr.GetAddr();
+
+        index_t const x_stride    = x.GetFrameStride() / sizeof(int);
+        index_t const y_stride    = y.GetFrameStride() / sizeof(std::uint32_t);
+        index_t const pos_size    = m_h_size * m_w_size;
+        index_t const node_size   = m_c_size * pos_size;
+        index_t const frame_size  = y.GetFrameSize();
+
+        __m256i const lane     = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i const lane_pos = _mm256_mullo_epi32(lane, _mm256_set1_epi32((int)pos_size));
+        __m256i const bit_mask = _mm256_set1_epi32(31);
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < node_size; ++node) {
+            index_t c   = node / pos_size;
+            index_t pos = node % pos_size;
+            int const     *x_node = &x_addr[c * x_stride];
+            std::uint32_t *y_node = &y_addr[node * y_stride];
+
+            for (index_t frame = 0; frame < frame_size; frame += 32) {
+                std::uint32_t word = 0;
+                for (int i = 0; i < 32 && frame + i < frame_size; i += 8) {
+                    __m256i f_v  = _mm256_add_epi32(lane, _mm256_set1_epi32((int)(frame + i)));
+                    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)frame_size), f_v);
+                    __m256i bit  = _mm256_add_epi32(lane_pos, _mm256_set1_epi32((int)((frame + i) * pos_size + pos)));
+                    __m256i v    = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), x_node, _mm256_srli_epi32(bit, 5), mask, 4);
+                    v = _mm256_sllv_epi32(v, _mm256_sub_epi32(bit_mask, _mm256_and_si256(bit, bit_mask)));
+                    word |= (std::uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(v, mask))) << i;
+                }
+                y_node[frame / 32] = word;
+            }
+        }
+    }
+
+    // Forward の逆転置 (FP32)
+    BB_TARGET_AVX2
+    void BackwardHostSimdFP32(FrameBuffer const &dy, FrameBuffer &dx)
+    {
+        auto dy_ptr = dy.LockMemoryConst();
+        auto dx_ptr = dx.LockMemory(true);
+        float const *dy_addr = (float const *)dy_ptr.GetAddr();
+        float       *dx_addr = (float       *)dx_ptr.GetAddr();
+
+        index_t const dy_stride   = dy.GetFrameStride() / sizeof(float);
+        index_t const dx_stride   = dx.GetFrameStride() / sizeof(float);
+        index_t const pos_size    = m_h_size * m_w_size;
+        index_t const pos_blocks  = (pos_size + 7) / 8;
+        index_t const frame_size  = dy.GetFrameSize();
+
+        #pragma omp parallel for
+        for (index_t blk = 0; blk < m_c_size * pos_blocks; ++blk) {
+            index_t c     = blk / pos_blocks;
+            index_t pos   = (blk % pos_blocks) * 8;
+            int     pos_n = (int)std::min((index_t)8, pos_size - pos);
+            __m256i pos_mask = _mm256_castps_si256(bb_mm256_mask_ps(pos_n));
+            float const *dy_node = &dy_addr[(c * pos_size + pos) * dy_stride];
+            float       *dx_node = &dx_addr[c * dx_stride];
+
+            for (index_t frame = 0; frame < frame_size; frame += 8) {
+                int    frame_n = (int)std::min((index_t)8, frame_size - frame);
+                __m256 r[8];
+                for (int j = 0; j < 8; ++j) {
+                    r[j] = (j < pos_n) ? _mm256_load_ps(&dy_node[j * dy_stride + frame]) : _mm256_setzero_ps();
+                }
+                bb_mm256_transpose8x8_ps(r);
+                for (int i = 0; i < frame_n; ++i) {
+                    float *dst = &dx_node[(frame + i) * pos_size + pos];
+                    if ( pos_n == 8 ) {
+                        _mm256_storeu_ps(dst, r[i]);
+                    }
+                    else {
+                        _mm256_maskstore_ps(dst, pos_mask, r[i]);
+                    }
+                }
+            }
+        }
+    }
+
+public:
+
     FrameBuffer Forward(FrameBuffer x, bool train=true)
  	{
         BB_ASSERT(x.GetType() == DataType<FT>::type);
 
+        // SetInputShpaeされていなければ初回に設定
+        if ( x.GetShape() != m_input_shape ) {
+            SetInputShape(x.GetShape());
+        }
+
        	index_t input_frame_size  = x.GetFrameSize();
         BB_ASSERT(input_frame_size % (m_h_size * m_w_size) == 0);
     	index_t output_frame_size = input_frame_size / (m_h_size * m_w_size);
@@ -175,24 +326,31 @@ public:
         }
 #endif
 
+        if ( m_host_simd && DataType<FT>::type == BB_TYPE_FP32 && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            ForwardHostSimdFP32(x, m_y);
+            return m_y;
+        }
+
+        if ( m_host_simd && DataType<FT>::type == BB_TYPE_BIT && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            ForwardHostSimdBit(x, m_y);
+            return m_y;
+        }
+
         {
-            // 汎用版
+            // 汎用版 (出力ノード毎に分配すれば書き込み先が重ならない)
             auto x_ptr = x.LockConst<FT>();
             auto y_ptr = m_y.Lock<FT>(true);
-		    index_t input_frame = 0;
-		    for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
-			    for (index_t y = 0; y < m_h_size; ++y) {
-				    for (index_t x = 0; x < m_w_size; ++x) {
-					    #pragma omp parallel for
-					    for (index_t c = 0; c < m_c_size; ++c) {
-						    index_t input_node = c;
-						    index_t output_node = (c*m_h_size + y)*m_w_size + x;
-						    y_ptr.Set(output_frame, output_node, x_ptr.Get(input_frame, input_node));
-					    }
-					    ++input_frame;
-				    }
-			    }
-		    }
+            index_t pos_size  = m_h_size * m_w_size;
+            index_t node_size = m_c_size * pos_size;
+
+            #pragma omp parallel for
+            for (index_t output_node = 0; output_node < node_size; ++output_node) {
+                index_t c   = output_node / pos_size;
+                index_t pos = output_node % pos_size;
+                for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
+                    y_ptr.Set(output_frame, output_node, x_ptr.Get(output_frame * pos_size + pos, c));
+                }
+            }
             return m_y;
         }
 	}
@@ -228,24 +386,25 @@ public:
         }
 #endif
 
+        if ( m_host_simd && DataType<BT>::type == BB_TYPE_FP32 && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            BackwardHostSimdFP32(dy, m_dx);
+            return m_dx;
+        }
+
         {
 		    auto dy_ptr = dy.LockConst<BT>();
 		    auto dx_ptr = m_dx.Lock<BT>(true);
-
-		    index_t input_frame = 0;
-		    for (index_t output_frame = 0; output_frame < output_frame_size; ++output_frame) {
-			    for (index_t y = 0; y < m_h_size; ++y) {
-				    for (index_t x = 0; x < m_w_size; ++x) {
-					    #pragma omp parallel for
-					    for (index_t c = 0; c < m_c_size; ++c) {
-						    index_t output_node = (c*m_h_size + y)*m_w_size + x;
-						    index_t input_node = c;
-						    dx_ptr.Set(input_frame, input_node, dy_ptr.Get(output_frame, output_node));
-					    }
-					    ++input_frame;
-				    }
-			    }
-		    }
+            index_t pos_size  = m_h_size * m_w_size;
+
+            // チャネル単位で分配すれば書き込み先が重ならない
+            #pragma omp parallel for
+            for (index_t c = 0; c < m_c_size; ++c) {
+                for (index_t input_frame = 0; input_frame < input_frame_size; ++input_frame) {
+                    index_t output_frame = input_frame / pos_size;
+                    index_t output_node  = c * pos_size + input_frame % pos_size;
+                    dx_ptr.Set(input_frame, c, dy_ptr.Get(output_frame, output_node));
+                }
+            }
             return m_dx;
         }
 	}
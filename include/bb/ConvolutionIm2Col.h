@@ -12,11 +12,14 @@
 
 #include <fstream>
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 #include <random>
 
 #include "bb/Manager.h"
 #include "bb/Model.h"
 #include "bb/FrameBuffer.h"
+#include "bb/SimdSupport.h"
 
 
 namespace bb {
@@ -27,6 +30,7 @@ class ConvolutionIm2Col : public Model
 {
 protected:
 	bool			m_host_only = false;
+    bool            m_host_simd = true;
     
     indices_t       m_input_shape;
     indices_t       m_output_shape;
@@ -39,6 +43,15 @@ protected:
 	index_t			m_filter_w_size;
 	index_t			m_output_h_size;
 	index_t			m_output_w_size;
+    index_t         m_h_stride   = 1;
+    index_t         m_w_stride   = 1;
+    index_t         m_h_padding  = 0;
+    index_t         m_w_padding  = 0;
+    index_t         m_h_dilation = 1;
+    index_t         m_w_dilation = 1;
+
+    // フィルタ位置毎の 出力座標 -> 入力座標(y*w+x) の変換テーブル (範囲外は -1)
+    std::vector<std::int32_t>   m_input_offset;
 
     // メモリの確保/開放を繰り返さないように演算後も確保
     FrameBuffer     m_y;
@@ -59,6 +72,12 @@ protected:
         {
             m_host_only = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
 	}
 
 public:
@@ -68,24 +87,61 @@ public:
     {
         index_t filter_h_size = 3;
         index_t filter_w_size = 3;
+        index_t h_stride      = 1;
+        index_t w_stride      = 1;
+        index_t h_padding     = 0;      // 上下に付加する 0 の幅
+        index_t w_padding     = 0;      // 左右に付加する 0 の幅
+        index_t h_dilation    = 1;
+        index_t w_dilation    = 1;
     };
 
 	static std::shared_ptr<ConvolutionIm2Col> Create(create_t const & create)
 	{
+        BB_ASSERT(create.h_stride >= 1 && create.w_stride >= 1);
+        BB_ASSERT(create.h_padding >= 0 && create.w_padding >= 0);
+        BB_ASSERT(create.h_dilation >= 1 && create.w_dilation >= 1);
+
         auto self = std::shared_ptr<ConvolutionIm2Col>(new ConvolutionIm2Col);
 		self->m_filter_h_size = create.filter_h_size;
         self->m_filter_w_size = create.filter_w_size;
+        self->m_h_stride      = create.h_stride;
+        self->m_w_stride      = create.w_stride;
+        self->m_h_padding     = create.h_padding;
+        self->m_w_padding     = create.w_padding;
+        self->m_h_dilation    = create.h_dilation;
+        self->m_w_dilation    = create.w_dilation;
         return self;
 	}
 
-	static std::shared_ptr<ConvolutionIm2Col> Create(size_t filter_h_size, size_t filter_w_size)
+	static std::shared_ptr<ConvolutionIm2Col> Create(size_t filter_h_size, size_t filter_w_size,
+                index_t h_stride = 1, index_t w_stride = 1, index_t h_padding = 0, index_t w_padding = 0,
+                index_t h_dilation = 1, index_t w_dilation = 1)
     {
-        auto self = std::shared_ptr<ConvolutionIm2Col>(new ConvolutionIm2Col);
-		self->m_filter_h_size = filter_h_size;
-        self->m_filter_w_size = filter_w_size;
-        return self;
+        create_t create;
+        create.filter_h_size = filter_h_size;
+        create.filter_w_size = filter_w_size;
+        create.h_stride      = h_stride;
+        create.w_stride      = w_stride;
+        create.h_padding     = h_padding;
+        create.w_padding     = w_padding;
+        create.h_dilation    = h_dilation;
+        create.w_dilation    = w_dilation;
+        return Create(create);
+    }
+
+    /**
+     * @brief  出力サイズ計算
+     * @detail 畳み込み後の画像サイズ(1次元分)を計算する
+     *         LoweringConvolution で Col2Im の形状を決める際にも利用する
+     */
+    static index_t CalcOutputSize(index_t input_size, index_t filter_size, index_t stride, index_t padding, index_t dilation)
+    {
+        return (input_size + 2 * padding - dilation * (filter_size - 1) - 1) / stride + 1;
     }
 
+    index_t GetOutputHeight(void) const { return m_output_h_size; }
+    index_t GetOutputWidth(void)  const { return m_output_w_size; }
+
 	std::string GetClassName(void) const { return "ConvolutionIm2Col"; }
 
 
@@ -104,8 +160,24 @@ public:
         m_input_w_size = m_input_shape[0];
         m_input_h_size = m_input_shape[1];
         m_input_c_size = m_input_shape[2];
-		m_output_h_size = m_input_h_size - m_filter_h_size + 1;
-		m_output_w_size = m_input_w_size - m_filter_w_size + 1;
+		m_output_h_size = CalcOutputSize(m_input_h_size, m_filter_h_size, m_h_stride, m_h_padding, m_h_dilation);
+		m_output_w_size = CalcOutputSize(m_input_w_size, m_filter_w_size, m_w_stride, m_w_padding, m_w_dilation);
+        BB_ASSERT(m_output_h_size > 0 && m_output_w_size > 0);
+
+        // 座標変換テーブル作成
+        index_t output_size = m_output_h_size * m_output_w_size;
+        m_input_offset.assign(m_filter_h_size * m_filter_w_size * output_size + 8, -1);     // SIMDで端数を読むので 8 要素余分に確保
+        for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
+            for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
+                std::int32_t *offset = &m_input_offset[(fy * m_filter_w_size + fx) * output_size];
+                for (index_t oy = 0; oy < m_output_h_size; ++oy) {
+                    for (index_t ox = 0; ox < m_output_w_size; ++ox) {
+                        index_t iy, ix;
+                        offset[oy * m_output_w_size + ox] = GetInputPosition(oy, ox, fy, fx, iy, ix) ? (std::int32_t)(iy * m_input_w_size + ix) : -1;
+                    }
+                }
+            }
+        }
 
         m_output_shape.resize(3);
         m_output_shape[0] = m_filter_w_size;
@@ -147,6 +219,165 @@ protected:
 		return (c*m_filter_h_size + y)*m_filter_w_size + x;
 	}
 
+    // 出力座標とフィルタ位置から入力座標を求める(パディング領域なら false)
+    inline bool GetInputPosition(index_t oy, index_t ox, index_t fy, index_t fx, index_t &iy, index_t &ix) const
+    {
+        iy = oy * m_h_stride - m_h_padding + fy * m_h_dilation;
+        ix = ox * m_w_stride - m_w_padding + fx * m_w_dilation;
+        return (iy >= 0 && iy < m_input_h_size && ix >= 0 && ix < m_input_w_size);
+    }
+
+    // stride/padding/dilation を使わない素の畳み込みか(CUDA版はこの場合のみ対応)
+    inline bool IsPlainConvolution(void) const
+    {
+        return m_h_stride == 1 && m_w_stride == 1 && m_h_padding == 0 && m_w_padding == 0 && m_h_dilation == 1 && m_w_dilation == 1;
+    }
+
+    // 出力ノード単位に連続フレームを生成 (FP32)
+    BB_TARGET_AVX2
+    void ForwardHostSimdFP32(FrameBuffer const &x, FrameBuffer &y)
+    {
+        auto x_ptr = x.LockMemoryConst();
+        auto y_ptr = y.LockMemory(true);
+        float const *x_addr = (float const *)x_ptr.GetAddr();
+        float       *y_addr = (float       *)y_ptr.GetAddr();
+
+        index_t const x_stride    = x.GetFrameStride() / sizeof(float);
+        index_t const y_stride    = y.GetFrameStride() / sizeof(float);
+        index_t const filter_size = m_filter_h_size * m_filter_w_size;
+        index_t const output_size = m_output_h_size * m_output_w_size;
+        index_t const node_size   = m_input_c_size * filter_size;
+        index_t const frame_size  = m_input_frame_size;
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < node_size; ++node) {
+            index_t c = node / filter_size;
+            index_t f = node % filter_size;
+            std::int32_t const *offset = &m_input_offset[f * output_size];
+            float const        *x_base = &x_addr[c * m_input_h_size * m_input_w_size * x_stride];
+            float              *y_node = &y_addr[node * y_stride];
+
+            // 8フレーム x 8座標 単位で読み出して転置し、出力の連続領域に書き込む
+            for (index_t frame = 0; frame < frame_size; frame += 8) {
+                int frame_n = (int)std::min((index_t)8, frame_size - frame);
+                for (index_t pos = 0; pos < output_size; pos += 8) {
+                    int    pos_n = (int)std::min((index_t)8, output_size - pos);
+                    __m256 r[8];
+                    for (int i = 0; i < 8; ++i) {
+                        r[i] = (i < pos_n && offset[pos + i] >= 0) ? _mm256_load_ps(&x_base[offset[pos + i] * x_stride + frame]) : _mm256_setzero_ps();
+                    }
+                    bb_mm256_transpose8x8_ps(r);
+                    if ( pos_n == 8 ) {
+                        for (int i = 0; i < frame_n; ++i) {
+                            _mm256_storeu_ps(&y_node[(frame + i) * output_size + pos], r[i]);
+                        }
+                    }
+                    else {
+                        __m256i mask = _mm256_castps_si256(bb_mm256_mask_ps(pos_n));
+                        for (int i = 0; i < frame_n; ++i) {
+                            _mm256_maskstore_ps(&y_node[(frame + i) * output_size + pos], mask, r[i]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 出力ノード単位に連続フレームを生成 (Bit)
+    BB_TARGET_AVX2
+    void ForwardHostSimdBit(FrameBuffer const &x, FrameBuffer &y)
+    {
+        auto x_ptr = x.LockMemoryConst();
+        auto y_ptr = y.LockMemory(true);
+        int const     *x_addr = (int const     *)x_ptr.GetAddr();
+        std::uint32_t *y_addr = (std::uint32_t *)y_ptr.GetAddr();
+
+        index_t const x_stride    = x.GetFrameStride() / sizeof(int);
+        index_t const y_stride    = y.GetFrameStride() / sizeof(std::uint32_t);
+        index_t const filter_size = m_filter_h_size * m_filter_w_size;
+        index_t const output_size = m_output_h_size * m_output_w_size;
+        index_t const node_size   = m_input_c_size * filter_size;
+        index_t const frame_size  = m_input_frame_size;
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < node_size; ++node) {
+            index_t c = node / filter_size;
+            index_t f = node % filter_size;
+            std::int32_t const *offset = &m_input_offset[f * output_size];
+            int const          *x_base = &x_addr[c * m_input_h_size * m_input_w_size * x_stride];
+            std::uint32_t      *y_word = &y_addr[node * y_stride];
+
+            // 出力フレームは連続するので 32bit 溜まる毎に書き出す
+            std::uint64_t acc      = 0;
+            int           acc_bits = 0;
+
+            __m256i stride_v = _mm256_set1_epi32((int)x_stride);
+            for (index_t frame = 0; frame < frame_size; ++frame) {
+                __m256i word_v  = _mm256_set1_epi32((int)(frame / 32));
+                __m128i shift_v = _mm_cvtsi32_si128((int)(31 - frame % 32));
+                for (index_t pos = 0; pos < output_size; pos += 8) {
+                    int     n    = (int)std::min((index_t)8, output_size - pos);
+                    __m256i off  = _mm256_loadu_si256((__m256i const *)&offset[pos]);
+                    __m256i mask = _mm256_cmpgt_epi32(off, _mm256_set1_epi32(-1));
+                    __m256i idx  = _mm256_add_epi32(_mm256_mullo_epi32(off, stride_v), word_v);
+                    __m256i v    = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), x_base, idx, mask, 4);
+                    v = _mm256_sll_epi32(v, shift_v);
+                    std::uint32_t bits = (std::uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(v)) & ((1u << n) - 1);
+
+                    acc      |= (std::uint64_t)bits << acc_bits;
+                    acc_bits += n;
+                    if ( acc_bits >= 32 ) {
+                        *y_word++ = (std::uint32_t)acc;
+                        acc      >>= 32;
+                        acc_bits -= 32;
+                    }
+                }
+            }
+            if ( acc_bits > 0 ) {
+                *y_word = (std::uint32_t)acc;
+            }
+        }
+    }
+
+    // 入力ノード単位に勾配を集約 (FP32)
+    BB_TARGET_AVX2
+    void BackwardHostSimdFP32(FrameBuffer const &dy, FrameBuffer &dx)
+    {
+        auto dy_ptr = dy.LockMemoryConst();
+        auto dx_ptr = dx.LockMemory();
+        float const *dy_addr = (float const *)dy_ptr.GetAddr();
+        float       *dx_addr = (float       *)dx_ptr.GetAddr();
+
+        index_t const dy_stride   = dy.GetFrameStride() / sizeof(float);
+        index_t const dx_stride   = dx.GetFrameStride() / sizeof(float);
+        index_t const filter_size = m_filter_h_size * m_filter_w_size;
+        index_t const output_size = m_output_h_size * m_output_w_size;
+        index_t const frame_size  = m_input_frame_size;
+
+        __m256i const lane_idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)output_size));
+
+        // チャネル単位で分配すれば書き込み先が重ならない
+        #pragma omp parallel for
+        for (index_t c = 0; c < m_input_c_size; ++c) {
+            for (index_t f = 0; f < filter_size; ++f) {
+                std::int32_t const *offset  = &m_input_offset[f * output_size];
+                float const        *dy_node = &dy_addr[(c * filter_size + f) * dy_stride];
+                for (index_t pos = 0; pos < output_size; ++pos) {
+                    if ( offset[pos] < 0 ) {
+                        continue;
+                    }
+                    float *dx_node = &dx_addr[(c * m_input_h_size * m_input_w_size + offset[pos]) * dx_stride];
+                    for (index_t frame = 0; frame < frame_size; frame += 8) {
+                        __m256i idx  = _mm256_add_epi32(lane_idx, _mm256_set1_epi32((int)(frame * output_size + pos)));
+                        __m256  mask = bb_mm256_mask_ps((int)std::min((index_t)8, frame_size - frame));
+                        __m256  grad = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), dy_node, idx, mask, 4);
+                        _mm256_store_ps(&dx_node[frame], _mm256_add_ps(_mm256_load_ps(&dx_node[frame]), grad));
+                    }
+                }
+            }
+        }
+    }
+
 public:
 
     FrameBuffer Forward(FrameBuffer x, bool train = true)
@@ -167,7 +398,7 @@ public:
         
 
 #ifdef BB_WITH_CUDA
-        if ( !m_host_only && x.GetType() == BB_TYPE_FP32 && x.IsDeviceAvailable() && m_y.IsDeviceAvailable() && Manager::IsDeviceAvailable())
+        if ( !m_host_only && IsPlainConvolution() && x.GetType() == BB_TYPE_FP32 && x.IsDeviceAvailable() && m_y.IsDeviceAvailable() && Manager::IsDeviceAvailable())
         {
             // FP32 CUDA
             auto ptr_x = x.LockDeviceMemoryConst();
@@ -188,7 +419,7 @@ public:
 #endif
 
 #ifdef BB_WITH_CUDA
-        if ( !m_host_only && x.GetType() == BB_TYPE_BIT && x.IsDeviceAvailable() && m_y.IsDeviceAvailable() && Manager::IsDeviceAvailable())
+        if ( !m_host_only && IsPlainConvolution() && x.GetType() == BB_TYPE_BIT && x.IsDeviceAvailable() && m_y.IsDeviceAvailable() && Manager::IsDeviceAvailable())
         {
             // bit CUDA
             auto ptr_x = x.LockDeviceMemoryConst();
@@ -208,6 +439,16 @@ public:
         }
 #endif
 
+        if ( m_host_simd && DataType<FT>::type == BB_TYPE_FP32 && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            ForwardHostSimdFP32(x, m_y);
+            return m_y;
+        }
+
+        if ( m_host_simd && DataType<FT>::type == BB_TYPE_BIT && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            ForwardHostSimdBit(x, m_y);
+            return m_y;
+        }
+
         {
             // 汎用版
    		    const index_t frame_size = m_y.GetFrameStride() * 8 / DataType<FT>::bit_size;
@@ -228,12 +469,14 @@ public:
 							    index_t output_frame = frame_base + frame_step;
 							    index_t input_frame = output_frame / (m_output_h_size * m_output_w_size);
 							    index_t f = output_frame % (m_output_h_size * m_output_w_size);
-							    index_t ix = f % m_output_w_size;
-							    index_t iy = f / m_output_w_size;
-							    ix += fx;
-							    iy += fy;
-    						    index_t input_node = GetInputNode(c, iy, ix);
-							    FT sig = x.template Get<FT, FT>(addr_x, input_frame, input_node);
+							    index_t ox = f % m_output_w_size;
+							    index_t oy = f / m_output_w_size;
+							    index_t ix, iy;
+							    FT sig = 0;
+							    if ( GetInputPosition(oy, ox, fy, fx, iy, ix) ) {
+    						        index_t input_node = GetInputNode(c, iy, ix);
+							        sig = x.template Get<FT, FT>(addr_x, input_frame, input_node);
+							    }
 							    m_y.template Set<FT, FT>(addr_y, output_frame, output_node, sig);
 						    }
 					    }
@@ -252,7 +495,7 @@ public:
         m_dx.Resize(DataType<BT>::type, m_input_frame_size, m_input_shape);
 
 #ifdef BB_WITH_CUDA
-        if ( !m_host_only && dy.GetType() == BB_TYPE_FP32 && dy.IsDeviceAvailable() && m_dx.IsDeviceAvailable() && Manager::IsDeviceAvailable())
+        if ( !m_host_only && IsPlainConvolution() && dy.GetType() == BB_TYPE_FP32 && dy.IsDeviceAvailable() && m_dx.IsDeviceAvailable() && Manager::IsDeviceAvailable())
         {
             auto ptr_dy = dy.LockDeviceMemoryConst();
             auto ptr_dx = m_dx.LockDeviceMemory();
@@ -272,6 +515,13 @@ public:
 #endif
 
 
+   		m_dx.FillZero();
+
+        if ( m_host_simd && DataType<BT>::type == BB_TYPE_FP32 && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            BackwardHostSimdFP32(dy, m_dx);
+            return m_dx;
+        }
+
 		const index_t frame_size = dy.GetFrameStride() * 8 / DataType<BT>::bit_size;
 		const index_t frame_unit = 256 / DataType<BT>::bit_size;
 
@@ -280,10 +530,9 @@ public:
         auto addr_dy = ptr_dy.GetAddr();
         auto addr_dx = ptr_dx.GetAddr();
 
-   		m_dx.FillZero();
-
-		for (index_t c = 0; c < m_input_c_size; ++c) {
+        // 同じ入力フレームへの加算が競合しないようチャネル単位で分配
 #pragma omp parallel for
+		for (index_t c = 0; c < m_input_c_size; ++c) {
 			for (index_t frame_base = 0; frame_base < frame_size; frame_base += frame_unit) {
 				for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
 					for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
@@ -291,11 +540,16 @@ public:
 						for (index_t frame_step = 0; frame_step < frame_unit; ++frame_step) {
 							index_t output_frame = frame_base + frame_step;
 							index_t input_frame = output_frame / (m_output_h_size * m_output_w_size);
+							if ( input_frame >= m_input_frame_size ) {
+								continue;
+							}
 							index_t f = output_frame % (m_output_h_size * m_output_w_size);
-							index_t ix = f % m_output_w_size;
-							index_t iy = f / m_output_w_size;
-							ix += fx;
-							iy += fy;
+							index_t ox = f % m_output_w_size;
+							index_t oy = f / m_output_w_size;
+							index_t ix, iy;
+							if ( !GetInputPosition(oy, ox, fy, fx, iy, ix) ) {
+								continue;
+							}
 							index_t input_node = GetInputNode(c, iy, ix);
 							BT grad = dy.template Get<BT, BT>(addr_dy, output_frame, output_node);
 							m_dx.template Add<BT, BT>(addr_dx, input_frame, input_node, grad);
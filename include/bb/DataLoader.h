@@ -0,0 +1,310 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "bb/DataType.h"
+#include "bb/FrameBuffer.h"
+#include "bb/DataSet.h"
+#include "bb/MemoryPlanner.h"
+
+
+namespace bb {
+
+
+//[DataLoader クラス]
+//  ・学習データ(vector of vector または DataArray)からミニバッチ単位の FrameBuffer をワーカースレッドで先行生成する
+//  ・キューの段数分(既定は2段のダブルバッファ)先のミニバッチまで用意しておき、
+//    Forward/Backward と並行してフレーム順への詰め替えやデータ拡張を行う
+//  ・ミニバッチは毎回新しい FrameBuffer として生成する(レイヤーが保持する入力を上書きしないため)
+//  ・複数スレッド時もミニバッチの順序は変わらない
+//  ・消費側が待たされた回数と時間(stall)を計測する
+
+template <typename T = float>
+class DataLoader
+{
+public:
+    // データ拡張 (seed はミニバッチ毎に決まるので、スレッド数によらず同じ結果になる)
+    using augmentation_proc_t = void (*)(FrameBuffer &x_buf, FrameBuffer &t_buf, std::uint64_t seed, void *user);
+
+    struct create_t
+    {
+        index_t                 queue_size        = 2;          //< 先行生成するミニバッチ数
+        index_t                 thread_size       = 1;          //< ワーカースレッド数
+        augmentation_proc_t     augmentation_proc = nullptr;    //< データ拡張関数
+        void                    *augmentation_user = nullptr;   //< データ拡張関数のユーザーパラメータ
+    };
+
+protected:
+    struct Slot
+    {
+        index_t     batch = -1;     // 格納済みのミニバッチ番号 (-1 なら空)
+        FrameBuffer x_buf;
+        FrameBuffer t_buf;
+    };
+
+    index_t                             m_queue_size  = 2;
+    index_t                             m_thread_size = 1;
+    augmentation_proc_t                 m_augmentation_proc = nullptr;
+    void                                *m_augmentation_user = nullptr;
+
+    // 現在のデータセット
+    SampleSource<T>                     m_x;
+    SampleSource<T>                     m_t;
+    indices_t                           m_x_shape;
+    indices_t                           m_t_shape;
+    index_t                             m_batch_size = 0;
+    index_t                             m_batch_num  = 0;
+    index_t                             m_frame_size = 0;
+    bool                                m_augmentation = false;
+    std::uint64_t                       m_seed = 0;
+
+    std::vector<std::thread>            m_threads;
+    std::mutex                          m_mtx;
+    std::condition_variable             m_cv_producer;
+    std::condition_variable             m_cv_consumer;
+    std::vector<Slot>                   m_slots;
+    index_t                             m_next_produce = 0;     // 次に生成するミニバッチ
+    index_t                             m_next_consume = 0;     // 次に取り出すミニバッチ
+    bool                                m_stop = false;
+
+    // 統計
+    index_t                             m_batch_count = 0;
+    index_t                             m_stall_count = 0;
+    double                              m_stall_time  = 0;
+    double                              m_work_time   = 0;
+
+protected:
+    DataLoader() {}
+
+public:
+    ~DataLoader()
+    {
+        Stop();
+    }
+
+    static std::shared_ptr<DataLoader> Create(create_t const &create)
+    {
+        auto self = std::shared_ptr<DataLoader>(new DataLoader);
+        self->m_queue_size        = std::max((index_t)1, create.queue_size);
+        self->m_thread_size       = std::max((index_t)1, create.thread_size);
+        self->m_augmentation_proc = create.augmentation_proc;
+        self->m_augmentation_user = create.augmentation_user;
+        return self;
+    }
+
+    static std::shared_ptr<DataLoader> Create(index_t queue_size = 2, index_t thread_size = 1)
+    {
+        create_t create;
+        create.queue_size  = queue_size;
+        create.thread_size = thread_size;
+        return Create(create);
+    }
+
+    index_t GetQueueSize(void) const  { return m_queue_size; }
+    index_t GetThreadSize(void) const { return m_thread_size; }
+
+    void SetAugmentation(augmentation_proc_t proc, void *user)
+    {
+        m_augmentation_proc = proc;
+        m_augmentation_user = user;
+    }
+
+
+    /**
+     * @brief  先行生成の開始
+     * @detail x, t の参照先は Stop() するまで変更しないこと
+     * @param  x               入力データ
+     * @param  x_shape         入力の形状
+     * @param  t               期待値データ
+     * @param  t_shape         期待値の形状
+     * @param  max_batch_size  ミニバッチサイズ
+     * @param  min_batch_size  最後のミニバッチがこれより小さければ生成しない
+     * @param  augmentation    データ拡張を行うか
+     * @param  seed            データ拡張の乱数初期値
+     */
+    void Start(
+                SampleSource<T>                     x,
+                indices_t                           x_shape,
+                SampleSource<T>                     t,
+                indices_t                           t_shape,
+                index_t                             max_batch_size,
+                index_t                             min_batch_size = 0,
+                bool                                augmentation = false,
+                std::uint64_t                       seed = 1
+            )
+    {
+        BB_ASSERT(x.GetSize() == t.GetSize());
+        BB_ASSERT(max_batch_size > 0);
+        Stop();
+
+        m_x            = x;
+        m_t            = t;
+        m_x_shape      = x_shape;
+        m_t_shape      = t_shape;
+        m_frame_size   = x.GetSize();
+        m_batch_size   = max_batch_size;
+        m_augmentation = augmentation && m_augmentation_proc != nullptr;
+        m_seed         = seed;
+
+        // 規定数に満たない最後のミニバッチは除く
+        m_batch_num = (m_frame_size + m_batch_size - 1) / m_batch_size;
+        if ( m_batch_num > 0 && m_frame_size - (m_batch_num - 1) * m_batch_size < min_batch_size ) {
+            --m_batch_num;
+        }
+
+        m_slots.clear();
+        m_slots.resize((size_t)m_queue_size);
+        m_next_produce = 0;
+        m_next_consume = 0;
+        m_stop         = false;
+
+        for ( index_t i = 0; i < m_thread_size; ++i ) {
+            m_threads.push_back(std::thread(&DataLoader::WorkerProc, this));
+        }
+    }
+
+    /**
+     * @brief  先行生成の停止
+     * @detail 生成済みのミニバッチは破棄する
+     */
+    void Stop(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_stop = true;
+        }
+        m_cv_producer.notify_all();
+        m_cv_consumer.notify_all();
+
+        for ( auto &th : m_threads ) {
+            th.join();
+        }
+        m_threads.clear();
+        m_slots.clear();
+    }
+
+    /**
+     * @brief  次のミニバッチの取り出し
+     * @param  x_buf  入力
+     * @param  t_buf  期待値
+     * @return 全ミニバッチを取り出し済みなら false
+     */
+    bool Pop(FrameBuffer &x_buf, FrameBuffer &t_buf)
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if ( m_threads.empty() || m_next_consume >= m_batch_num ) {
+            return false;
+        }
+
+        Slot &slot = m_slots[(size_t)(m_next_consume % m_queue_size)];
+        if ( slot.batch != m_next_consume ) {
+            auto start = std::chrono::steady_clock::now();
+            m_cv_consumer.wait(lock, [&] { return slot.batch == m_next_consume; });
+            m_stall_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ++m_stall_count;
+        }
+
+        x_buf = slot.x_buf;
+        t_buf = slot.t_buf;
+        slot.x_buf = FrameBuffer();
+        slot.t_buf = FrameBuffer();
+        slot.batch = -1;
+        ++m_next_consume;
+        ++m_batch_count;
+
+        lock.unlock();
+        m_cv_producer.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief  取り出したミニバッチの先頭フレーム位置
+     * @detail 直前に Pop したミニバッチについて返す
+     */
+    index_t GetFrameIndex(void) const
+    {
+        return (m_next_consume - 1) * m_batch_size;
+    }
+
+    // 統計
+    index_t GetBatchCount(void) const   { return m_batch_count; }   //< 取り出したミニバッチ数
+    index_t GetStallCount(void) const   { return m_stall_count; }   //< 取り出し時に生成を待った回数
+    double  GetStallTime(void) const    { return m_stall_time; }    //< 取り出し時に生成を待った時間[s]
+    double  GetWorkTime(void) const     { return m_work_time; }     //< ワーカーの生成時間の合計[s]
+
+    void ClearStatistics(void)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_batch_count = 0;
+        m_stall_count = 0;
+        m_stall_time  = 0;
+        m_work_time   = 0;
+    }
+
+protected:
+    void WorkerProc(void)
+    {
+        // 学習ステップのメモリ計画とは無関係に確保する
+        MemoryPlanner::SetThreadEnable(false);
+
+        for ( ; ; ) {
+            index_t batch;
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_cv_producer.wait(lock, [&] {
+                        return m_stop || m_next_produce >= m_batch_num || m_next_produce < m_next_consume + m_queue_size;
+                    });
+                if ( m_stop || m_next_produce >= m_batch_num ) {
+                    return;
+                }
+                batch = m_next_produce++;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            index_t     index      = batch * m_batch_size;
+            index_t     frame_size = std::min(m_batch_size, m_frame_size - index);
+            FrameBuffer x_buf(DataType<T>::type, frame_size, m_x_shape);
+            FrameBuffer t_buf(DataType<T>::type, frame_size, m_t_shape);
+            m_x.CopyTo(x_buf, index);
+            m_t.CopyTo(t_buf, index);
+            if ( m_augmentation ) {
+                m_augmentation_proc(x_buf, t_buf, m_seed + (std::uint64_t)batch, m_augmentation_user);
+            }
+
+            double work_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                Slot &slot = m_slots[(size_t)(batch % m_queue_size)];
+                slot.x_buf  = x_buf;
+                slot.t_buf  = t_buf;
+                slot.batch  = batch;
+                m_work_time += work_time;
+            }
+            m_cv_consumer.notify_all();
+        }
+    }
+};
+
+
+}
+
+
+// end of file
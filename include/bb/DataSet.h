@@ -0,0 +1,313 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <algorithm>
+
+#include "bb/DataType.h"
+#include "bb/FrameBuffer.h"
+#include "bb/MappedFile.h"
+
+
+namespace bb {
+
+
+//[DataArray クラス]
+//  ・サンプル数 × サンプルサイズ の連続配列で学習データを保持する
+//  ・自前のバッファを持つか、ファイルを読み出し専用でメモリマップして参照する
+//  ・vector of vector と異なりサンプル毎の確保が無く、サンプル i は GetSample(i) の先頭から連続して並ぶ
+//  ・マップ時のコピーはファイルを共有する
+
+template <typename T = float>
+class DataArray
+{
+protected:
+    index_t                         m_size        = 0;
+    index_t                         m_sample_size = 0;
+    std::vector<T>                  m_buf;
+    std::shared_ptr<MappedFile>     m_file;
+    size_t                          m_offset = 0;
+
+public:
+    DataArray() {}
+
+    DataArray(index_t size, index_t sample_size)
+    {
+        Resize(size, sample_size);
+    }
+
+    void clear(void)
+    {
+        m_size        = 0;
+        m_sample_size = 0;
+        m_buf.clear();
+        m_buf.shrink_to_fit();
+        m_file.reset();
+        m_offset = 0;
+    }
+
+    bool empty(void) const { return m_size == 0; }
+
+    /**
+     * @brief  自前のバッファの確保
+     * @detail マップ中であれば解除し、0 で初期化する
+     * @param  size         サンプル数
+     * @param  sample_size  1サンプルの要素数
+     */
+    void Resize(index_t size, index_t sample_size)
+    {
+        m_file.reset();
+        m_offset      = 0;
+        m_size        = size;
+        m_sample_size = sample_size;
+        m_buf.assign((size_t)(size * sample_size), (T)0);
+    }
+
+    /**
+     * @brief  ファイルのメモリマップ
+     * @detail T 型の配列がそのまま並んでいるファイルの一部を参照する
+     * @param  filename     ファイル名
+     * @param  offset       先頭のバイト位置(T のアライメントに合わせること)
+     * @param  size         サンプル数
+     * @param  sample_size  1サンプルの要素数
+     * @return 範囲外やマップ失敗時は false
+     */
+    bool Map(std::string filename, size_t offset, index_t size, index_t sample_size)
+    {
+        auto file = MappedFile::Open(filename);
+        if ( !file ) {
+            return false;
+        }
+        return Map(file, offset, size, sample_size);
+    }
+
+    bool Map(std::shared_ptr<MappedFile> file, size_t offset, index_t size, index_t sample_size)
+    {
+        if ( offset % alignof(T) != 0 ) {
+            return false;
+        }
+        if ( offset + (size_t)(size * sample_size) * sizeof(T) > file->GetSize() ) {
+            return false;
+        }
+
+        m_buf.clear();
+        m_buf.shrink_to_fit();
+        m_file        = file;
+        m_offset      = offset;
+        m_size        = size;
+        m_sample_size = sample_size;
+        return true;
+    }
+
+    bool IsMapped(void) const { return (bool)m_file; }
+
+    // vector of vector からの変換
+    void Assign(std::vector< std::vector<T> > const &data)
+    {
+        Resize((index_t)data.size(), data.empty() ? 0 : (index_t)data[0].size());
+        for ( index_t i = 0; i < m_size; ++i ) {
+            BB_ASSERT(data[i].size() == (size_t)m_sample_size);
+            std::copy(data[i].begin(), data[i].end(), GetWritableSample(i));
+        }
+    }
+
+    // vector of vector への変換
+    std::vector< std::vector<T> > ToVector(void) const
+    {
+        std::vector< std::vector<T> > data((size_t)m_size);
+        for ( index_t i = 0; i < m_size; ++i ) {
+            data[i].assign(GetSample(i), GetSample(i) + m_sample_size);
+        }
+        return data;
+    }
+
+    index_t GetSize(void) const       { return m_size; }
+    index_t GetSampleSize(void) const { return m_sample_size; }
+
+    T const *GetData(void) const
+    {
+        if ( m_file ) {
+            return (T const *)((std::uint8_t const *)m_file->GetAddr() + m_offset);
+        }
+        return m_buf.data();
+    }
+
+    // 書き込み用 (マップ中は書き込めない)
+    T *GetWritableData(void)
+    {
+        BB_ASSERT(!m_file);
+        return m_buf.data();
+    }
+
+    T const *GetSample(index_t index) const
+    {
+        BB_DEBUG_ASSERT(index >= 0 && index < m_size);
+        return GetData() + index * m_sample_size;
+    }
+
+    T *GetWritableSample(index_t index)
+    {
+        BB_DEBUG_ASSERT(index >= 0 && index < m_size);
+        return GetWritableData() + index * m_sample_size;
+    }
+};
+
+
+//[DataSet 構造体]
+//  ・TrainData の連続配列版
+//  ・学習データのシャッフルはデータを動かさず参照順(train_order)の並べ替えで行う
+//  ・並べ替えは ShuffleDataSet と同じ手順なので、同じ seed なら TrainData と同じ順序になる
+
+template <typename T = float>
+struct DataSet
+{
+    indices_t               x_shape;
+    indices_t               t_shape;
+    DataArray<T>            x_train;
+    DataArray<T>            t_train;
+    DataArray<T>            x_test;
+    DataArray<T>            t_test;
+    std::vector<index_t>    train_order;    // 学習データの参照順 (空なら格納順)
+
+    void clear(void) {
+        x_shape.clear();
+        t_shape.clear();
+        x_train.clear();
+        t_train.clear();
+        x_test.clear();
+        t_test.clear();
+        train_order.clear();
+    }
+
+    bool empty(void) const {
+        return x_train.empty() || t_train.empty() || x_test.empty() || t_test.empty();
+    }
+
+    //! 参照順を格納順に戻す
+    void ResetOrder(void)
+    {
+        train_order.resize((size_t)x_train.GetSize());
+        for ( size_t i = 0; i < train_order.size(); ++i ) {
+            train_order[i] = (index_t)i;
+        }
+    }
+
+    //! 学習データのシャッフル
+    void Shuffle(std::uint64_t seed)
+    {
+        BB_ASSERT(x_train.GetSize() == t_train.GetSize());
+        if ( train_order.size() != (size_t)x_train.GetSize() ) {
+            ResetOrder();
+        }
+        if ( train_order.empty() ) {
+            return;
+        }
+
+        std::mt19937_64                         mt(seed);
+        std::uniform_int_distribution<size_t>   rand_distribution(0, train_order.size() - 1);
+        for ( size_t i = 0; i < train_order.size(); ++i ) {
+            size_t j = rand_distribution(mt);
+            std::swap(train_order[i], train_order[j]);
+        }
+    }
+
+    //! TrainData への変換 (学習データは参照順に並べる)
+    TrainData<T> ToTrainData(void) const
+    {
+        TrainData<T> td;
+        td.x_shape = x_shape;
+        td.t_shape = t_shape;
+        td.x_train = x_train.ToVector();
+        td.t_train = t_train.ToVector();
+        td.x_test  = x_test.ToVector();
+        td.t_test  = t_test.ToVector();
+        if ( train_order.size() == td.x_train.size() ) {
+            auto x = td.x_train;
+            auto t = td.t_train;
+            for ( size_t i = 0; i < train_order.size(); ++i ) {
+                td.x_train[i] = x[(size_t)train_order[i]];
+                td.t_train[i] = t[(size_t)train_order[i]];
+            }
+        }
+        return td;
+    }
+};
+
+
+//[SampleSource クラス]
+//  ・vector of vector と DataArray(+参照順) を同じように読み出すための非所有のビュー
+//  ・参照先は SampleSource を使い終わるまで保持しておくこと
+
+template <typename T = float>
+class SampleSource
+{
+protected:
+    std::vector< std::vector<T> > const *m_vector = nullptr;
+    DataArray<T> const                  *m_array  = nullptr;
+    std::vector<index_t> const          *m_order  = nullptr;
+
+public:
+    SampleSource() {}
+
+    SampleSource(std::vector< std::vector<T> > const &data) : m_vector(&data) {}
+
+    SampleSource(DataArray<T> const &data, std::vector<index_t> const *order = nullptr) : m_array(&data)
+    {
+        if ( order != nullptr && !order->empty() ) {
+            BB_ASSERT(order->size() == (size_t)data.GetSize());
+            m_order = order;
+        }
+    }
+
+    index_t GetSize(void) const
+    {
+        if ( m_vector != nullptr ) { return (index_t)m_vector->size(); }
+        if ( m_array  != nullptr ) { return m_array->GetSize(); }
+        return 0;
+    }
+
+    T const *GetSample(index_t index) const
+    {
+        if ( m_vector != nullptr ) {
+            return (*m_vector)[(size_t)index].data();
+        }
+        if ( m_order != nullptr ) {
+            index = (*m_order)[(size_t)index];
+        }
+        return m_array->GetSample(index);
+    }
+
+    /**
+     * @brief  FrameBuffer への書き込み
+     * @detail offset 番目のサンプルから buf のフレーム数分を書き込む
+     */
+    void CopyTo(FrameBuffer &buf, index_t offset) const
+    {
+        BB_ASSERT(offset + buf.GetFrameSize() <= GetSize());
+
+        std::vector<T const *> samples((size_t)buf.GetFrameSize());
+        for ( index_t frame = 0; frame < buf.GetFrameSize(); ++frame ) {
+            samples[(size_t)frame] = GetSample(offset + frame);
+        }
+        buf.SetFrames(samples);
+    }
+};
+
+
+}
+
+
+// end of file
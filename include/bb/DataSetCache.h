@@ -0,0 +1,296 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <limits>
+
+#include "bb/DataType.h"
+#include "bb/FrameBuffer.h"
+#include "bb/DataSet.h"
+#include "bb/MappedFile.h"
+
+
+namespace bb {
+
+
+//[DataSetCache クラス]
+//  ・正規化済みの FP32 または二値化済みの Bit のデータを FrameBuffer のメモリ配置のまま保存したキャッシュファイル
+//  ・block_frames フレーム毎のブロックに分けて、各ブロックを FrameBuffer のメモリイメージとして並べる
+//  ・読み込みはファイルをメモリマップし、ブロックをコピー無しで FrameBuffer として参照する
+//    (書き込み用に Lock した時点で自前の領域にコピーされるので、ファイルは書き換わらない)
+//
+//  ファイル形式 (リトルエンディアン)
+//    0x0000 : Header
+//    data_offset から ブロック0, ブロック1, ... (最後のブロックのみフレーム数が端数になる)
+
+class DataSetCache
+{
+public:
+    static std::uint32_t const  VERSION = 1;
+
+protected:
+    static size_t const         DATA_ALIGN = 4096;
+    static int const            MAX_DIM    = 8;
+
+    struct Header
+    {
+        char            magic[8];           // "BBDSETC\0"
+        std::uint32_t   version;
+        std::int32_t    data_type;
+        std::int64_t    frame_size;
+        std::int64_t    block_frames;
+        std::int64_t    data_offset;
+        std::int32_t    shape_dim;
+        std::int32_t    reserved;
+        std::int64_t    shape[MAX_DIM];
+    };
+
+    static char const *Magic(void) { return "BBDSETC"; }
+
+    std::shared_ptr<MappedFile> m_file;
+    Header                      m_header;
+    indices_t                   m_shape;
+
+protected:
+    DataSetCache() {}
+
+public:
+    /**
+     * @brief  キャッシュファイルの作成
+     * @param  filename      ファイル名
+     * @param  src           サンプルの並び
+     * @param  shape         1サンプルの形状
+     * @param  data_type     BB_TYPE_FP32 または BB_TYPE_BIT
+     * @param  block_frames  1ブロックのフレーム数(ミニバッチサイズに合わせるとコピー無しで取り出せる)
+     * @param  threshold     Bit の場合の二値化の閾値 (threshold より大きければ 1)
+     * @return 書き込み失敗時は false
+     */
+    template <typename T>
+    static bool Write(std::string filename, SampleSource<T> const &src, indices_t shape, int data_type = BB_TYPE_FP32, index_t block_frames = 256, T threshold = (T)0.5)
+    {
+        BB_ASSERT(data_type == BB_TYPE_FP32 || data_type == BB_TYPE_BIT);
+        BB_ASSERT(block_frames > 0);
+        BB_ASSERT(shape.size() <= MAX_DIM);
+
+        std::ofstream ofs(filename, std::ios::binary);
+        if ( !ofs.is_open() ) {
+            return false;
+        }
+
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, Magic(), sizeof(header.magic));
+        header.version      = VERSION;
+        header.data_type    = data_type;
+        header.frame_size   = src.GetSize();
+        header.block_frames = block_frames;
+        header.data_offset  = DATA_ALIGN;
+        header.shape_dim    = (std::int32_t)shape.size();
+        for ( size_t i = 0; i < shape.size(); ++i ) {
+            header.shape[i] = shape[i];
+        }
+        ofs.write((char const *)&header, sizeof(header));
+
+        std::vector<char> pad(DATA_ALIGN - sizeof(header), 0);
+        ofs.write(pad.data(), pad.size());
+
+        for ( index_t index = 0; index < src.GetSize(); index += block_frames ) {
+            index_t     frame_size = std::min(block_frames, src.GetSize() - index);
+            FrameBuffer buf(DataType<T>::type, frame_size, shape, true);
+            src.CopyTo(buf, index);
+
+            if ( data_type == BB_TYPE_BIT ) {
+                FrameBuffer bit_buf(BB_TYPE_BIT, frame_size, shape, true);
+                auto src_ptr = buf.LockConst<T>();
+                auto dst_ptr = bit_buf.Lock<Bit>(true);
+                for ( index_t node = 0; node < buf.GetNodeSize(); ++node ) {
+                    for ( index_t frame = 0; frame < frame_size; ++frame ) {
+                        dst_ptr.Set(frame, node, src_ptr.Get(frame, node) > threshold);
+                    }
+                }
+                buf = bit_buf;
+            }
+
+            auto ptr = buf.LockMemoryConst();
+            ofs.write((char const *)ptr.GetAddr(), FrameBuffer::GetMemorySize(data_type, frame_size, shape));
+        }
+
+        return !ofs.fail();
+    }
+
+    template <typename T>
+    static bool Write(std::string filename, std::vector< std::vector<T> > const &src, indices_t shape, int data_type = BB_TYPE_FP32, index_t block_frames = 256, T threshold = (T)0.5)
+    {
+        return Write<T>(filename, SampleSource<T>(src), shape, data_type, block_frames, threshold);
+    }
+
+    template <typename T>
+    static bool Write(std::string filename, DataArray<T> const &src, indices_t shape, int data_type = BB_TYPE_FP32, index_t block_frames = 256, T threshold = (T)0.5)
+    {
+        return Write<T>(filename, SampleSource<T>(src), shape, data_type, block_frames, threshold);
+    }
+
+
+    /**
+     * @brief  キャッシュファイルを開く
+     * @detail 形式やバージョンが一致しない場合や、ヘッダの値が壊れている場合は失敗する
+     * @return 失敗時は nullptr
+     */
+    static std::shared_ptr<DataSetCache> Open(std::string filename)
+    {
+        auto file = MappedFile::Open(filename);
+        if ( !file || file->GetSize() < sizeof(Header) ) {
+            return nullptr;
+        }
+
+        auto self = std::shared_ptr<DataSetCache>(new DataSetCache);
+        memcpy(&self->m_header, file->GetAddr(), sizeof(Header));
+        auto const &header = self->m_header;
+        if ( memcmp(header.magic, Magic(), sizeof(header.magic)) != 0 || header.version != VERSION ) {
+            return nullptr;
+        }
+        if ( !(header.data_type == BB_TYPE_FP32 || header.data_type == BB_TYPE_BIT)
+                || header.shape_dim < 0 || header.shape_dim > MAX_DIM || header.block_frames <= 0 || header.frame_size < 0 ) {
+            return nullptr;
+        }
+
+        // ブロックを SIMD 用の境界で参照するので、データ位置は DATA_ALIGN 境界であること
+        if ( header.data_offset < (std::int64_t)sizeof(Header) || header.data_offset % DATA_ALIGN != 0 ) {
+            return nullptr;
+        }
+
+        // 全ブロック分のサイズが溢れないこと (以降の GetBlockOffset の計算はこの範囲に収まる)
+        std::int64_t node_size = 1;
+        for ( int i = 0; i < header.shape_dim; ++i ) {
+            if ( header.shape[i] <= 0 || !CheckedMul(node_size, header.shape[i], node_size) ) {
+                return nullptr;
+            }
+        }
+        std::int64_t block_size;
+        std::int64_t total_size;
+        std::int64_t block_num = (header.frame_size + header.block_frames - 1) / header.block_frames;
+        if ( header.block_frames > (std::numeric_limits<std::int64_t>::max() - 255) / 64
+                || !CheckedMul(CalcFrameStride(header.data_type, header.block_frames), node_size, block_size)
+                || !CheckedMul(block_size, block_num, total_size)
+                || total_size > std::numeric_limits<std::int64_t>::max() - header.data_offset ) {
+            return nullptr;
+        }
+
+        self->m_file = file;
+        for ( int i = 0; i < header.shape_dim; ++i ) {
+            self->m_shape.push_back((index_t)header.shape[i]);
+        }
+
+        // 全ブロックがファイルに収まっているか
+        if ( self->GetBlockOffset(self->GetBlockSize()) > file->GetSize() ) {
+            return nullptr;
+        }
+
+        return self;
+    }
+
+    int         GetType(void) const         { return m_header.data_type; }
+    index_t     GetFrameSize(void) const    { return (index_t)m_header.frame_size; }
+    index_t     GetBlockFrames(void) const  { return (index_t)m_header.block_frames; }
+    indices_t   GetShape(void) const        { return m_shape; }
+
+    //! ブロック数
+    index_t GetBlockSize(void) const
+    {
+        return (GetFrameSize() + GetBlockFrames() - 1) / GetBlockFrames();
+    }
+
+    /**
+     * @brief  ブロックの取り出し
+     * @detail ファイルを直接参照する FrameBuffer を返す(コピー無し)
+     */
+    FrameBuffer GetBlock(index_t block) const
+    {
+        BB_ASSERT(block >= 0 && block < GetBlockSize());
+
+        index_t frame_size = std::min(GetBlockFrames(), GetFrameSize() - block * GetBlockFrames());
+        size_t  offset     = GetBlockOffset(block);
+        size_t  size       = (size_t)FrameBuffer::GetMemorySize(GetType(), frame_size, m_shape);
+        auto    mem        = Memory::CreateExternal((std::uint8_t const *)m_file->GetAddr() + offset, size, m_file);
+        return FrameBuffer(GetType(), frame_size, m_shape, mem);
+    }
+
+    /**
+     * @brief  任意範囲の取り出し
+     * @detail ブロックと一致する範囲はコピー無し、それ以外はブロックを跨いでコピーする
+     */
+    FrameBuffer GetFrames(index_t index, index_t size) const
+    {
+        BB_ASSERT(index >= 0 && size > 0 && index + size <= GetFrameSize());
+
+        index_t block_frames = GetBlockFrames();
+        if ( index % block_frames == 0 ) {
+            index_t block = index / block_frames;
+            if ( size == std::min(block_frames, GetFrameSize() - index) ) {
+                return GetBlock(block);
+            }
+        }
+
+        FrameBuffer buf(GetType(), size, m_shape);
+        index_t pos = 0;
+        while ( pos < size ) {
+            index_t     block = (index + pos) / block_frames;
+            index_t     start = (index + pos) % block_frames;
+            FrameBuffer block_buf = GetBlock(block);
+            index_t     n = std::min(size - pos, block_buf.GetFrameSize() - start);
+            buf.SetRange(pos, block_buf.GetRange(start, n));
+            pos += n;
+        }
+        return buf;
+    }
+
+protected:
+    // FrameBuffer のフレーム方向のバイト数 (FrameBuffer::CalcFrameStride と同じ)
+    static std::int64_t CalcFrameStride(int data_type, std::int64_t frame_size)
+    {
+        return ((frame_size * DataType_GetBitSize(data_type) + 255) / 256) * (256 / 8);
+    }
+
+    // 溢れなければ a * b を返す (a, b >= 0)
+    static bool CheckedMul(std::int64_t a, std::int64_t b, std::int64_t &result)
+    {
+        if ( a != 0 && b > std::numeric_limits<std::int64_t>::max() / a ) {
+            return false;
+        }
+        result = a * b;
+        return true;
+    }
+
+    size_t GetBlockOffset(index_t block) const
+    {
+        size_t block_size = (size_t)FrameBuffer::GetMemorySize(GetType(), GetBlockFrames(), m_shape);
+        size_t offset     = (size_t)m_header.data_offset + block_size * (size_t)block;
+        if ( block == GetBlockSize() ) {
+            // 終端は最後のブロックの実サイズで計算する
+            index_t last = GetFrameSize() - (block - 1) * GetBlockFrames();
+            if ( block > 0 ) {
+                offset = offset - block_size + (size_t)FrameBuffer::GetMemorySize(GetType(), last, m_shape);
+            }
+        }
+        return offset;
+    }
+};
+
+
+}
+
+
+// end of file
@@ -14,6 +14,7 @@
 
 #include "bb/DataType.h"
 #include "bb/Model.h"
+#include "bb/HostGemm.h"
 
 #ifdef BB_WITH_CUDA
 #include "cuda_runtime.h"
@@ -35,6 +36,7 @@ class DenseAffine : public Model
 protected:
     bool	                	m_binary_mode = false;
     bool                        m_host_only = false;
+    bool                        m_host_simd = true;
 
     T                           m_initialize_std = (T)0.01;
     std::string                 m_initializer = "he";
@@ -86,6 +88,12 @@ protected:
         {
             m_host_only = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
 	}
 
 
@@ -294,6 +302,45 @@ public:
         }
 #endif
 
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd )
+        {
+            auto x_ptr = x.LockMemoryConst();
+            auto y_ptr = m_y.LockMemory(true);
+            auto W_ptr = m_W->LockMemoryConst();
+            auto b_ptr = lock_b_const();
+
+            index_t frame_size   = m_y.GetFrameSize();
+            index_t frame_stride = m_y.GetFrameStride() / sizeof(float);
+            auto    y_addr       = (float *)y_ptr.GetAddr();
+
+            #pragma omp parallel for
+            for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
+                float bias = b_ptr(output_node);
+                for (index_t frame = 0; frame < frame_size; ++frame) {
+                    y_addr[output_node * frame_stride + frame] = bias;
+                }
+            }
+
+            HostSgemm
+                (
+                    false,
+                    false,
+                    m_y.GetFrameSize(),
+                    m_y.GetNodeSize(),
+                    x.GetNodeSize(),
+                    1.0f,
+                    (float const *)x_ptr.GetAddr(),
+                    x.GetFrameStride() / sizeof(float),
+                    (float const *)W_ptr.GetAddr(),
+                    x.GetNodeSize(),
+                    1.0f,
+                    (float *)y_ptr.GetAddr(),
+                    m_y.GetFrameStride() / sizeof(float)
+                );
+
+            return m_y;
+        }
+
         {
             auto frame_size   = x.GetFrameSize();
 
@@ -389,28 +436,99 @@ public:
         }
 #endif
 
-        m_dx.FillZero();
-        m_dW->FillZero();
-        m_db->FillZero();
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd )
+        {
+            auto dy_ptr = dy.LockMemoryConst();
+            auto x_ptr  = m_x.LockMemoryConst();
+            auto dx_ptr = m_dx.LockMemory(true);
+            auto W_ptr  = m_W->LockMemoryConst();
+            auto dW_ptr = m_dW->LockMemory(true);
+            auto db_ptr = lock_db();
+
+            index_t frame_stride = dy.GetFrameStride() / sizeof(float);
+            auto    dy_addr      = (float const *)dy_ptr.GetAddr();
+
+            // db はノード単位で集計するので競合しない
+            #pragma omp parallel for
+            for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
+                float sum = 0;
+                for (index_t frame = 0; frame < frame_size; ++frame) {
+                    sum += dy_addr[output_node * frame_stride + frame];
+                }
+                db_ptr(output_node) = sum;
+            }
+
+            HostSgemm
+                (
+                    false,
+                    true,
+                    m_dx.GetFrameSize(),
+                    m_dx.GetNodeSize(),
+                    dy.GetNodeSize(),
+                    1.0f,
+                    (float const *)dy_ptr.GetAddr(),
+                    dy.GetFrameStride() / sizeof(float),
+                    (float const *)W_ptr.GetAddr(),
+                    m_dx.GetNodeSize(),
+                    0.0f,
+                    (float *)dx_ptr.GetAddr(),
+                    m_dx.GetFrameStride() / sizeof(float)
+                );
+
+            HostSgemm
+                (
+                    true,
+                    false,
+                    m_dx.GetNodeSize(),
+                    dy.GetNodeSize(),
+                    m_dx.GetFrameSize(),
+                    1.0f,
+                    (float const *)x_ptr.GetAddr(),
+                    m_x.GetFrameStride() / sizeof(float),
+                    (float const *)dy_ptr.GetAddr(),
+                    dy.GetFrameStride() / sizeof(float),
+                    0.0f,
+                    (float *)dW_ptr.GetAddr(),
+                    m_dx.GetNodeSize()
+                );
+
+            return m_dx;
+        }
 
         {
             auto x_ptr  = m_x.LockConst<T>();
             auto dy_ptr = dy.LockConst<T>();
             auto dx_ptr = m_dx.Lock<T>();
             auto W_ptr  = lock_W_const();
-            auto b_ptr  = lock_b_const();
             auto dW_ptr = lock_dW();
             auto db_ptr = lock_db();
 
+            // dx は frame 単位、dW/db は出力ノード単位で分配して書き込みが競合しないようにする
             #pragma omp parallel for
             for (index_t frame = 0; frame < frame_size; ++frame) {
-                for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
-                    auto grad = dy_ptr.Get(frame, output_node);
-                    db_ptr(output_node) += grad;
-                    for (index_t input_node = 0; input_node < m_input_node_size; ++input_node) {
-                        dx_ptr.Add(frame, input_node, grad * W_ptr(output_node, input_node));
-                        dW_ptr(output_node, input_node) += grad * x_ptr.Get(frame, input_node);
+                for (index_t input_node = 0; input_node < m_input_node_size; ++input_node) {
+                    T sum = 0;
+                    for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
+                        sum += dy_ptr.Get(frame, output_node) * W_ptr(output_node, input_node);
+                    }
+                    dx_ptr.Set(frame, input_node, sum);
+                }
+            }
+
+            #pragma omp parallel for
+            for (index_t output_node = 0; output_node < m_output_node_size; ++output_node) {
+                T db = 0;
+                for (index_t frame = 0; frame < frame_size; ++frame) {
+                    db += dy_ptr.Get(frame, output_node);
+                }
+                db_ptr(output_node) = db;
+
+                for (index_t input_node = 0; input_node < m_input_node_size; ++input_node) {
+                    T dW = 0;
+                    for (index_t frame = 0; frame < frame_size; ++frame) {
+                        dW += dy_ptr.Get(frame, output_node) * x_ptr.Get(frame, input_node);
                     }
+                    dW_ptr(output_node, input_node) = dW;
                 }
             }
 
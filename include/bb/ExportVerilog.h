@@ -281,8 +281,23 @@ void ExportVerilog_LutLayers(std::ostream& os, std::string module_name, std::sha
 
 
 // Convolutionモジュールの出力
-inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string module_name, std::string mlp_name, int in_c, int out_c, int n, int m)
+//   dilation は参照窓を BLK_N = (N-1)*Y_DILATION+1 x BLK_M = (M-1)*X_DILATION+1 に広げて間引き、
+//   stride は出力画素の de を落とすことで実現する
+//   padding は jelly_img_blk_buffer の窓の中心位置 (LINE_CENTER/PIXEL_CENTER) で表し、
+//   窓がはみ出した分は BORDER_MODE="CONSTANT" により 0 で埋まる
+//   (負の値を指定した場合は窓の中央 (BLK-1)/2)
+//   ハードウェアは入力画素と同じ数だけ出力するので、padding が (BLK-1)/2 より小さい場合は
+//   各ライン/画像の末尾 BLK-1-2*padding 画素分が学習時の出力に無い余分な出力になる
+//   (以前は PIXEL_CENTER が (M-1)/M (=0) でライン方向とずれていたのを padding に合わせた)
+inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string module_name, std::string mlp_name, int in_c, int out_c, int n, int m,
+            int y_stride = 1, int x_stride = 1, int y_padding = -1, int x_padding = -1, int y_dilation = 1, int x_dilation = 1)
 {
+	int blk_n = (n - 1) * y_dilation + 1;
+	int blk_m = (m - 1) * x_dilation + 1;
+	if ( y_padding < 0 ) { y_padding = (blk_n - 1) / 2; }
+	if ( x_padding < 0 ) { x_padding = (blk_m - 1) / 2; }
+	BB_ASSERT(y_padding <= blk_n - 1 && x_padding <= blk_m - 1);	// 窓の外を中心にはできない
+
 	os << "\n\n\n";
 	os << "module " << module_name << "\n";
 
@@ -297,6 +312,12 @@ inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string mod
 	os << "			parameter	M_C  = " << out_c << ",\n";
 	os << "			parameter	N  = " << n << ",\n";
 	os << "			parameter	M  = " << m << ",\n";
+	os << "			parameter	Y_STRIDE   = " << y_stride << ",\n";
+	os << "			parameter	X_STRIDE   = " << x_stride << ",\n";
+	os << "			parameter	Y_PADDING  = " << y_padding << ",\n";
+	os << "			parameter	X_PADDING  = " << x_padding << ",\n";
+	os << "			parameter	Y_DILATION = " << y_dilation << ",\n";
+	os << "			parameter	X_DILATION = " << x_dilation << ",\n";
 			
 	os << R"(
 			parameter	USER_BITS  = USER_WIDTH > 0 ? USER_WIDTH : 1
@@ -328,8 +349,10 @@ inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string mod
 
 	
 	os << R"(
-	localparam	NC = (N-1) / 2;
-	localparam	MC = (M-1) / M;
+	localparam	BLK_N = (N-1) * Y_DILATION + 1;
+	localparam	BLK_M = (M-1) * X_DILATION + 1;
+	localparam	NC = Y_PADDING;
+	localparam	MC = X_PADDING;
 	
 	
 	wire							img_blk_line_first;
@@ -338,21 +361,21 @@ inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string mod
 	wire							img_blk_pixel_last;
 	wire							img_blk_de;
 	wire	[USER_BITS-1:0]			img_blk_user;
-	wire	[N*M*S_C-1:0]			img_blk_data;
+	wire	[BLK_N*BLK_M*S_C-1:0]	img_blk_data;
 	wire							img_blk_valid;
 	
 	jelly_img_blk_buffer
 			#(
 				.USER_WIDTH			(USER_WIDTH),
 				.DATA_WIDTH			(S_C),
-				.LINE_NUM			(N),
-				.PIXEL_NUM			(M),
+				.LINE_NUM			(BLK_N),
+				.PIXEL_NUM			(BLK_M),
 				.LINE_CENTER		(NC),
 				.PIXEL_CENTER		(MC),
 				.MAX_X_NUM			(MAX_X_NUM),
 				.RAM_TYPE			(RAM_TYPE),
 				.BORDER_MODE		("CONSTANT"),
-				.BORDER_VALUE		({(N*M){1'b0}})
+				.BORDER_VALUE		({(BLK_N*BLK_M){1'b0}})
 			)
 		i_img_blk_buffer
 			(
@@ -385,11 +408,31 @@ inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string mod
 	for ( i = 0; i < S_C; i = i+1 ) begin : loop_i
 		for ( j = 0; j < N; j = j+1 ) begin : loop_j
 			for ( k = 0; k < M; k = k+1 ) begin : loop_j
-				assign img_blk_data_shuffle[i*(N*M) + j*M + k] = img_blk_data[(j*M + k)*S_C + i];
+				assign img_blk_data_shuffle[i*(N*M) + j*M + k] = img_blk_data[((j*Y_DILATION)*BLK_M + k*X_DILATION)*S_C + i];
 			end
 		end
 	end
 	endgenerate
+	
+	// stride 分の間引き (ライン/画素の位相が 0 のときのみ de を有効にする)
+	reg		[15:0]					reg_y_phase;
+	reg		[15:0]					reg_x_phase;
+	wire	[15:0]					y_phase = img_blk_line_first  ? 0 :
+											  img_blk_pixel_first ? ((reg_y_phase == Y_STRIDE-1) ? 0 : reg_y_phase + 1) :
+											  reg_y_phase;
+	wire	[15:0]					x_phase = img_blk_pixel_first ? 0 : ((reg_x_phase == X_STRIDE-1) ? 0 : reg_x_phase + 1);
+	always @(posedge clk) begin
+		if ( reset ) begin
+			reg_y_phase <= 0;
+			reg_x_phase <= 0;
+		end
+		else if ( cke && img_blk_valid ) begin
+			reg_y_phase <= y_phase;
+			reg_x_phase <= x_phase;
+		end
+	end
+	
+	wire							img_blk_de_stride = img_blk_de && (y_phase == 0) && (x_phase == 0);
 
 )";
 
@@ -412,7 +455,7 @@ inline void ExportVerilog_LutConvolutionModule(std::ostream& os, std::string mod
 								img_blk_line_last,
 								img_blk_pixel_first,
 								img_blk_pixel_last,
-								img_blk_de
+								img_blk_de_stride
 							}),
 				.in_data	(img_blk_data_shuffle),
 				.in_valid	(img_blk_valid),
@@ -460,7 +503,10 @@ void ExportVerilog_LutConvolutionLayer(std::ostream& os, std::string module_name
 	int n = (int)conv->GetFilterHeight();
 	int m = (int)conv->GetFilterWidth();
 
-	ExportVerilog_LutConvolutionModule(os, module_name, mlp_name, in_c, out_c, n, m);
+	ExportVerilog_LutConvolutionModule(os, module_name, mlp_name, in_c, out_c, n, m,
+			(int)conv->GetStrideHeight(),   (int)conv->GetStrideWidth(),
+			(int)conv->GetPaddingHeight(),  (int)conv->GetPaddingWidth(),
+			(int)conv->GetDilationHeight(), (int)conv->GetDilationWidth());
 	ExportVerilog_LutLayers<FT, BT>(os, mlp_name, net);
 }
 
@@ -19,6 +19,7 @@
 
 #include "bb/DataType.h"
 #include "bb/Tensor.h"
+#include "bb/SimdSupport.h"
 
 
 namespace bb {
@@ -309,6 +310,23 @@ public:
 		Resize(data_type, frame_size, shape);
 	}
 
+   	/**
+     * @brief  コンストラクタ
+     * @detail 確保済みのメモリを参照して構築する
+     *         mem は Resize と同じレイアウト(GetMemorySize 分)で格納済みであること
+     * @param data_type  1ノードのデータ型
+     * @param frame_size フレーム数
+     * @param shape      1フレームのノードを構成するshape
+     * @param mem        参照するメモリ
+     */
+	explicit FrameBuffer(int data_type, index_t frame_size, std::vector<index_t> shape, std::shared_ptr<Memory> mem)
+	{
+        int         tensor_type;
+        indices_t   tensor_shape;
+        SetLayout(data_type, frame_size, shape, tensor_type, tensor_shape);
+        m_tensor = Tensor(tensor_type, tensor_shape, mem);
+	}
+
    	/**
       * @brief  コピーコンストラクタ
       * @detail コピーコンストラクタ
@@ -380,14 +398,43 @@ public:
      */
     void Resize(int data_type, index_t frame_size, indices_t shape)
 	{
+        int         tensor_type;
+        indices_t   tensor_shape;
+        SetLayout(data_type, frame_size, shape, tensor_type, tensor_shape);
+
+		// メモリ確保
+		m_tensor.Resize(tensor_type, tensor_shape);
+	}
+
+    /**
+     * @brief  メモリサイズの計算
+     * @detail Resize した時に確保されるメモリのバイト数
+     */
+    static index_t GetMemorySize(int data_type, index_t frame_size, indices_t shape)
+    {
+        index_t node_size = 1;
+        for ( auto size : shape ) {
+            node_size *= size;
+        }
+        return CalcFrameStride(data_type, frame_size) * node_size;
+    }
+
+protected:
+    // frame軸は256bit境界にあわせる(SIMD命令用)
+    static index_t CalcFrameStride(int data_type, index_t frame_size)
+    {
+        return ((frame_size * DataType_GetBitSize(data_type) + 255) / 256) * (256 / 8);
+    }
+
+    void SetLayout(int data_type, index_t frame_size, indices_t const &shape, int &tensor_type, indices_t &tensor_shape)
+    {
         m_data_type    = data_type;
         m_frame_size   = frame_size;
-        m_frame_stride = ((frame_size * DataType_GetBitSize(data_type) + 255) / 256) * (256 / 8);        // frame軸は256bit境界にあわせる(SIMD命令用)
+        m_frame_stride = CalcFrameStride(data_type, frame_size);
         m_node_shape   = shape;
 
-
         // Bit型は内部 UINT8 で扱う
-        int tensor_type = data_type;
+        tensor_type = data_type;
         if ( data_type == BB_TYPE_BIT )
         {
             tensor_type = BB_TYPE_UINT8;
@@ -395,16 +442,15 @@ public:
 
         // サイズ計算
 		m_node_size = 1;
-        std::vector<index_t>    tensor_shape;
+        tensor_shape.clear();
         tensor_shape.push_back(m_frame_stride / DataType_GetByteSize(tensor_type));
         for ( auto size : shape ) {
             tensor_shape.push_back(size);
     		m_node_size *= size;
         }
+    }
 
-		// メモリ確保
-		m_tensor.Resize(tensor_type, tensor_shape);
-	}
+public:
 
 
   	/**
@@ -949,6 +995,12 @@ public:
     void SetVector(std::vector< std::vector<Tp> > const &data)
     {
         BB_ASSERT(data.size() == (size_t)m_frame_size);
+
+        if ( GetType() == DataType<Tp>::type ) {
+            SetVector(data, 0);
+            return;
+        }
+
         for (index_t frame = 0; frame < m_frame_size; ++frame) {
             BB_ASSERT(data[frame].size() == (size_t)m_node_size);
             for (index_t node = 0; node < m_node_size; ++node) {
@@ -961,13 +1013,326 @@ public:
     void SetVector(std::vector< std::vector<Tp> > const &data, index_t offset)
     {
         BB_ASSERT(GetType() == DataType<Tp>::type);
-        BB_ASSERT(offset + m_frame_size <= (index_t)data.size() );
+        BB_ASSERT(offset >= 0 && offset + m_frame_size <= (index_t)data.size() );
 
-        auto ptr = Lock<Tp>();
+        std::vector<Tp const *> frames(m_frame_size);
+        for (index_t frame = 0; frame < m_frame_size; ++frame) {
+            BB_ASSERT(data[frame + offset].size() == (size_t)m_node_size);
+            frames[frame] = data[frame + offset].data();
+        }
+        SetFrames(frames);
+    }
+
+    /**
+     * @brief  フレーム毎のデータの先頭アドレスを指定して一括設定
+     * @detail サンプル単位(フレーム毎にノードが連続)の並びを、ノード単位の配置に転置して書き込む
+     *         FP32 は 8x8 の AVX 転置、Bit は 8フレーム x 32ノード 単位でビットパッキングし、
+     *         ノードのブロック毎に OpenMP で並列化する
+     * @param  data  各フレームのデータ(ノード数分の連続領域)の先頭
+     */
+    template<typename Tp>
+    void SetFrames(std::vector<Tp const *> const &data)
+    {
+        BB_ASSERT(GetType() == DataType<Tp>::type);
+        BB_ASSERT(data.size() == (size_t)m_frame_size);
+
+        if ( m_frame_size <= 0 || m_node_size <= 0 ) {
+            return;
+        }
+
+        auto ptr  = LockMemory();
+        auto addr = (std::uint8_t *)ptr.GetAddr();
+
+        if ( DataType<Tp>::type == BB_TYPE_FP32 ) {
+            ImportFramesFp32(addr, reinterpret_cast<std::vector<float const *> const &>(data));
+        }
+        else if ( DataType<Tp>::type == BB_TYPE_BIT ) {
+            ImportFramesBit(addr, reinterpret_cast<std::vector<std::uint8_t const *> const &>(data));
+        }
+        else {
+            #pragma omp parallel for
+            for (index_t node = 0; node < m_node_size; ++node) {
+                auto dst = addr + m_frame_stride * node;
+                for (index_t frame = 0; frame < m_frame_size; ++frame) {
+                    DataType_Write<Tp>(dst, frame, data[frame][node]);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief  フレーム毎のデータの先頭アドレスを指定して一括取得
+     * @detail SetFrames の逆方向(ノード単位の配置からサンプル単位の並びへの転置)
+     * @param  data  各フレームの格納先(ノード数分の連続領域)の先頭
+     */
+    template<typename Tp>
+    void GetFrames(std::vector<Tp *> const &data) const
+    {
+        BB_ASSERT(GetType() == DataType<Tp>::type);
+        BB_ASSERT(data.size() == (size_t)m_frame_size);
+
+        if ( m_frame_size <= 0 || m_node_size <= 0 ) {
+            return;
+        }
+
+        auto ptr  = LockMemoryConst();
+        auto addr = (std::uint8_t const *)ptr.GetAddr();
+
+        if ( DataType<Tp>::type == BB_TYPE_FP32 ) {
+            ExportFramesFp32(addr, reinterpret_cast<std::vector<float *> const &>(data));
+        }
+        else if ( DataType<Tp>::type == BB_TYPE_BIT ) {
+            ExportFramesBit(addr, reinterpret_cast<std::vector<std::uint8_t *> const &>(data));
+        }
+        else {
+            #pragma omp parallel for
+            for (index_t node = 0; node < m_node_size; ++node) {
+                auto src = addr + m_frame_stride * node;
+                for (index_t frame = 0; frame < m_frame_size; ++frame) {
+                    data[frame][node] = DataType_Read<Tp>(src, frame);
+                }
+            }
+        }
+    }
+
+    template<typename Tp>
+    void GetVector(std::vector< std::vector<Tp> > &data, index_t offset) const
+    {
+        BB_ASSERT(offset >= 0 && offset + m_frame_size <= (index_t)data.size() );
+
+        std::vector<Tp *> frames(m_frame_size);
+        for (index_t frame = 0; frame < m_frame_size; ++frame) {
+            data[frame + offset].resize(m_node_size);
+            frames[frame] = data[frame + offset].data();
+        }
+        GetFrames(frames);
+    }
+
+    template<typename Tp>
+    std::vector< std::vector<Tp> > GetVector(void) const
+    {
+        std::vector< std::vector<Tp> > data(m_frame_size);
+        GetVector(data, 0);
+        return data;
+    }
+
+protected:
+    // 8x8 ビット行列の転置 (x の バイトi の ビットj を バイトj の ビットi へ)
+    static std::uint64_t TransposeBit8x8(std::uint64_t x)
+    {
+        std::uint64_t t;
+        t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAULL;  x = x ^ t ^ (t << 7);
+        t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;  x = x ^ t ^ (t << 14);
+        t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;  x = x ^ t ^ (t << 28);
+        return x;
+    }
+
+    void ImportFramesFp32(std::uint8_t *addr, std::vector<float const *> const &data)
+    {
+        if ( bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            ImportFramesFp32_Avx2(addr, data);
+            return;
+        }
+
+        index_t const stride = m_frame_stride / (index_t)sizeof(float);
+        float * const base   = (float *)addr;
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < m_node_size; ++node) {
+            for (index_t frame = 0; frame < m_frame_size; ++frame) {
+                base[node * stride + frame] = data[frame][node];
+            }
+        }
+    }
+
+    // 8ノード x 8フレーム 単位で転置しながら書き込む
+    BB_TARGET_AVX2
+    void ImportFramesFp32_Avx2(std::uint8_t *addr, std::vector<float const *> const &data)
+    {
+        index_t const stride = m_frame_stride / (index_t)sizeof(float);
+        index_t const frame8 = m_frame_size & ~(index_t)7;
+        index_t const block  = (m_node_size + 7) / 8;
+        float * const base   = (float *)addr;
+
+        #pragma omp parallel for
+        for (index_t b = 0; b < block; ++b) {
+            index_t node0 = b * 8;
+            index_t n     = std::min((index_t)8, m_node_size - node0);
+            if ( n == 8 ) {
+                for (index_t frame0 = 0; frame0 < frame8; frame0 += 8) {
+                    __m256  r[8];
+                    for (int i = 0; i < 8; ++i) {
+                        r[i] = _mm256_loadu_ps(data[frame0 + i] + node0);
+                    }
+                    bb_mm256_transpose8x8_ps(r);
+                    for (int i = 0; i < 8; ++i) {
+                        _mm256_storeu_ps(base + (node0 + i) * stride + frame0, r[i]);
+                    }
+                }
+            }
+            else {
+                for (index_t frame0 = 0; frame0 < frame8; ++frame0) {
+                    for (index_t i = 0; i < n; ++i) {
+                        base[(node0 + i) * stride + frame0] = data[frame0][node0 + i];
+                    }
+                }
+            }
+            for (index_t frame = frame8; frame < m_frame_size; ++frame) {
+                for (index_t i = 0; i < n; ++i) {
+                    base[(node0 + i) * stride + frame] = data[frame][node0 + i];
+                }
+            }
+        }
+    }
+
+    void ExportFramesFp32(std::uint8_t const *addr, std::vector<float *> const &data) const
+    {
+        if ( bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            ExportFramesFp32_Avx2(addr, data);
+            return;
+        }
+
+        index_t const stride = m_frame_stride / (index_t)sizeof(float);
+        float const * const base = (float const *)addr;
+
+        #pragma omp parallel for
         for (index_t frame = 0; frame < m_frame_size; ++frame) {
-            BB_ASSERT(data[frame].size() == (size_t)m_node_size);
             for (index_t node = 0; node < m_node_size; ++node) {
-                ptr.Set(frame, node, data[frame + offset][node]);
+                data[frame][node] = base[node * stride + frame];
+            }
+        }
+    }
+
+    BB_TARGET_AVX2
+    void ExportFramesFp32_Avx2(std::uint8_t const *addr, std::vector<float *> const &data) const
+    {
+        index_t const stride = m_frame_stride / (index_t)sizeof(float);
+        index_t const frame8 = m_frame_size & ~(index_t)7;
+        index_t const block  = (m_node_size + 7) / 8;
+        float const * const base = (float const *)addr;
+
+        #pragma omp parallel for
+        for (index_t b = 0; b < block; ++b) {
+            index_t node0 = b * 8;
+            index_t n     = std::min((index_t)8, m_node_size - node0);
+            if ( n == 8 ) {
+                for (index_t frame0 = 0; frame0 < frame8; frame0 += 8) {
+                    __m256  r[8];
+                    for (int i = 0; i < 8; ++i) {
+                        r[i] = _mm256_loadu_ps(base + (node0 + i) * stride + frame0);
+                    }
+                    bb_mm256_transpose8x8_ps(r);
+                    for (int i = 0; i < 8; ++i) {
+                        _mm256_storeu_ps(data[frame0 + i] + node0, r[i]);
+                    }
+                }
+            }
+            else {
+                for (index_t frame0 = 0; frame0 < frame8; ++frame0) {
+                    for (index_t i = 0; i < n; ++i) {
+                        data[frame0][node0 + i] = base[(node0 + i) * stride + frame0];
+                    }
+                }
+            }
+            for (index_t frame = frame8; frame < m_frame_size; ++frame) {
+                for (index_t i = 0; i < n; ++i) {
+                    data[frame][node0 + i] = base[(node0 + i) * stride + frame];
+                }
+            }
+        }
+    }
+
+    // 1フレーム分の最大32ノードの Bit を 32bit のマスクにする
+    static std::uint32_t PackBitMask32(std::uint8_t const *src, index_t n)
+    {
+        std::uint32_t mask = 0;
+        for (index_t i = 0; i < n; ++i) {
+            if ( src[i] != 0 ) { mask |= (1u << i); }
+        }
+        return mask;
+    }
+
+    BB_TARGET_AVX2
+    static std::uint32_t PackBitMask32_Avx2(std::uint8_t const *src, index_t n)
+    {
+        if ( n == 32 ) {
+            __m256i v  = _mm256_loadu_si256((__m256i const *)src);
+            __m256i z  = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+            return ~(std::uint32_t)_mm256_movemask_epi8(z);
+        }
+        return PackBitMask32(src, n);
+    }
+
+    void ImportFramesBit(std::uint8_t *addr, std::vector<std::uint8_t const *> const &data)
+    {
+        auto const pack = (bb_simd_get_level() >= BB_SIMD_AVX2) ? &PackBitMask32_Avx2 : &PackBitMask32;
+
+        index_t const frame8 = m_frame_size & ~(index_t)7;
+        index_t const block  = (m_node_size + 31) / 32;
+
+        #pragma omp parallel for
+        for (index_t b = 0; b < block; ++b) {
+            index_t node0 = b * 32;
+            index_t n     = std::min((index_t)32, m_node_size - node0);
+
+            // 8フレーム毎に 8x8 ビット転置して、ノード毎に 1byte ずつ書き込む
+            for (index_t frame0 = 0; frame0 < frame8; frame0 += 8) {
+                std::uint32_t mask[8];
+                for (int i = 0; i < 8; ++i) {
+                    mask[i] = pack(data[frame0 + i] + node0, n);
+                }
+                for (index_t g = 0; g * 8 < n; ++g) {
+                    std::uint64_t x = 0;
+                    for (int i = 0; i < 8; ++i) {
+                        x |= (std::uint64_t)((mask[i] >> (g * 8)) & 0xff) << (i * 8);
+                    }
+                    x = TransposeBit8x8(x);
+                    index_t gn = std::min((index_t)8, n - g * 8);
+                    for (index_t j = 0; j < gn; ++j) {
+                        addr[m_frame_stride * (node0 + g * 8 + j) + frame0 / 8] = (std::uint8_t)(x >> (j * 8));
+                    }
+                }
+            }
+
+            // 端数フレーム
+            for (index_t frame = frame8; frame < m_frame_size; ++frame) {
+                std::uint32_t mask = pack(data[frame] + node0, n);
+                for (index_t i = 0; i < n; ++i) {
+                    DataType_Write<Bit>(addr + m_frame_stride * (node0 + i), frame, Bit(((mask >> i) & 1) != 0));
+                }
+            }
+        }
+    }
+
+    void ExportFramesBit(std::uint8_t const *addr, std::vector<std::uint8_t *> const &data) const
+    {
+        index_t const frame8 = m_frame_size & ~(index_t)7;
+        index_t const block  = (m_node_size + 7) / 8;
+
+        #pragma omp parallel for
+        for (index_t b = 0; b < block; ++b) {
+            index_t node0 = b * 8;
+            index_t n     = std::min((index_t)8, m_node_size - node0);
+
+            for (index_t frame0 = 0; frame0 < frame8; frame0 += 8) {
+                std::uint64_t x = 0;
+                for (index_t j = 0; j < n; ++j) {
+                    x |= (std::uint64_t)addr[m_frame_stride * (node0 + j) + frame0 / 8] << (j * 8);
+                }
+                x = TransposeBit8x8(x);
+                for (int i = 0; i < 8; ++i) {
+                    std::uint8_t bits = (std::uint8_t)(x >> (i * 8));
+                    std::uint8_t *dst = data[frame0 + i] + node0;
+                    for (index_t j = 0; j < n; ++j) {
+                        dst[j] = (bits >> j) & 1;
+                    }
+                }
+            }
+
+            for (index_t frame = frame8; frame < m_frame_size; ++frame) {
+                for (index_t j = 0; j < n; ++j) {
+                    data[frame][node0 + j] = (bool)DataType_Read<Bit>(addr + m_frame_stride * (node0 + j), frame) ? 1 : 0;
+                }
             }
         }
     }
@@ -1006,7 +1371,7 @@ public:
     FrameBuffer GetRange(index_t start, index_t size)
     {
         BB_ASSERT(start >= 0 && start < m_frame_size);
-        BB_ASSERT(size >= 0 &&  size < m_frame_size - start);
+        BB_ASSERT(size >= 0 &&  size <= m_frame_size - start);
 
         FrameBuffer buf(m_data_type, size, m_node_shape);
 
@@ -1039,6 +1404,42 @@ public:
 
         return buf;
     }
+
+    // 部分書き込み (GetRange の逆)
+    void SetRange(index_t start, FrameBuffer const &buf)
+    {
+        index_t size = buf.m_frame_size;
+        BB_ASSERT(buf.m_data_type == m_data_type && buf.m_node_size == m_node_size);
+        BB_ASSERT(start >= 0 && start < m_frame_size);
+        BB_ASSERT(size >= 0 &&  size <= m_frame_size - start);
+
+        auto src_ptr = buf.m_tensor.LockMemoryConst();
+        auto dst_ptr = m_tensor.LockMemory();
+        auto src_addr = (std::int8_t const *)src_ptr.GetAddr();
+        auto dst_addr = (std::int8_t       *)dst_ptr.GetAddr();
+
+        if (m_data_type == BB_TYPE_BIT && ((start % 8) != 0 || (size % 8) != 0) ) {
+            #pragma omp parallel for
+            for (index_t node = 0; node < m_node_size; ++node)
+            {
+                for (index_t frame = 0; frame < size; ++frame) {
+                    auto val = DataType_Read<Bit>(src_addr + buf.m_frame_stride * node, frame);
+                    DataType_Write<Bit>(dst_addr + m_frame_stride * node, frame + start, val);
+                }
+            }           
+        }
+        else {
+            int     unit   = DataType_GetBitSize(m_data_type);
+            index_t byte_offset = (start * unit) / 8;
+            index_t byte_size   = (size * unit) / 8;
+
+            #pragma omp parallel for
+            for (index_t node = 0; node < m_node_size; ++node)
+            {
+                memcpy(dst_addr + m_frame_stride * node + byte_offset, src_addr + buf.m_frame_stride * node, byte_size);
+            }
+        }
+    }
     
 
 
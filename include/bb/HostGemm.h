@@ -0,0 +1,310 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <algorithm>
+
+#ifdef BB_WITH_BLAS
+#include <cblas.h>
+#endif
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+#include "bb/Utility.h"
+
+
+namespace bb {
+
+
+// -------------------------------------
+//  ホスト版 SGEMM
+// -------------------------------------
+
+// ブロックサイズ
+//   MR x NR がマイクロカーネル(レジスタブロック)のサイズ
+//   MC x KC の A パネルが L2 に、KC x NC の B パネルが L3 に載る程度を目安にしている
+#ifndef BB_HOST_SGEMM_MR
+#define BB_HOST_SGEMM_MR    16
+#endif
+#ifndef BB_HOST_SGEMM_NR
+#define BB_HOST_SGEMM_NR    6
+#endif
+#ifndef BB_HOST_SGEMM_MC
+#define BB_HOST_SGEMM_MC    128
+#endif
+#ifndef BB_HOST_SGEMM_KC
+#define BB_HOST_SGEMM_KC    256
+#endif
+#ifndef BB_HOST_SGEMM_NC
+#define BB_HOST_SGEMM_NC    3072
+#endif
+#ifndef BB_HOST_SGEMM_NB
+#define BB_HOST_SGEMM_NB    (BB_HOST_SGEMM_NR * 16)    // スレッドへの分配単位(n方向)
+#endif
+
+
+// op(A) の (mc x kc) を MR 行単位のパネルに詰め替える (端数行は 0 埋め)
+inline void HostSgemm_PackA(bool trans, index_t mc, index_t kc, float const *A, index_t lda, float *dst)
+{
+    index_t const MR = BB_HOST_SGEMM_MR;
+
+    for ( index_t ir = 0; ir < mc; ir += MR ) {
+        index_t mr = std::min(MR, mc - ir);
+        if ( !trans ) {
+            for ( index_t p = 0; p < kc; ++p ) {
+                float const *src = &A[ir + p * lda];
+                index_t ii = 0;
+                for ( ; ii < mr; ++ii ) { dst[p * MR + ii] = src[ii]; }
+                for ( ; ii < MR; ++ii ) { dst[p * MR + ii] = 0.0f; }
+            }
+        }
+        else {
+            for ( index_t ii = 0; ii < MR; ++ii ) {
+                if ( ii < mr ) {
+                    float const *src = &A[(ir + ii) * lda];
+                    for ( index_t p = 0; p < kc; ++p ) { dst[p * MR + ii] = src[p]; }
+                }
+                else {
+                    for ( index_t p = 0; p < kc; ++p ) { dst[p * MR + ii] = 0.0f; }
+                }
+            }
+        }
+        dst += MR * kc;
+    }
+}
+
+// op(B) の (kc x nc) を NR 列単位のパネルに詰め替える (端数列は 0 埋め)
+inline void HostSgemm_PackB(bool trans, index_t kc, index_t nc, float const *B, index_t ldb, float *dst)
+{
+    index_t const NR = BB_HOST_SGEMM_NR;
+    index_t const panel_num = (nc + NR - 1) / NR;
+
+    #pragma omp for
+    for ( index_t panel = 0; panel < panel_num; ++panel ) {
+        index_t jr  = panel * NR;
+        index_t nr  = std::min(NR, nc - jr);
+        float   *pd = &dst[jr * kc];
+        if ( !trans ) {
+            for ( index_t jj = 0; jj < NR; ++jj ) {
+                if ( jj < nr ) {
+                    float const *src = &B[(jr + jj) * ldb];
+                    for ( index_t p = 0; p < kc; ++p ) { pd[p * NR + jj] = src[p]; }
+                }
+                else {
+                    for ( index_t p = 0; p < kc; ++p ) { pd[p * NR + jj] = 0.0f; }
+                }
+            }
+        }
+        else {
+            for ( index_t p = 0; p < kc; ++p ) {
+                float const *src = &B[jr + p * ldb];
+                index_t jj = 0;
+                for ( ; jj < nr; ++jj ) { pd[p * NR + jj] = src[jj]; }
+                for ( ; jj < NR; ++jj ) { pd[p * NR + jj] = 0.0f; }
+            }
+        }
+    }
+}
+
+// マイクロカーネル スカラー版 (AVX2 の無い CPU 用)
+inline void HostSgemm_KernelScalar(index_t kc, float const *Ap, float const *Bp, float alpha, float beta, float *C, index_t ldc, index_t mr, index_t nr)
+{
+    index_t const MR = BB_HOST_SGEMM_MR;
+    index_t const NR = BB_HOST_SGEMM_NR;
+
+    float acc[BB_HOST_SGEMM_NR][BB_HOST_SGEMM_MR] = {};
+    for ( index_t p = 0; p < kc; ++p ) {
+        for ( index_t j = 0; j < NR; ++j ) {
+            float b = Bp[j];
+            for ( index_t i = 0; i < MR; ++i ) {
+                acc[j][i] += Ap[i] * b;
+            }
+        }
+        Ap += MR;
+        Bp += NR;
+    }
+
+    for ( index_t j = 0; j < nr; ++j ) {
+        float *c_addr = &C[j * ldc];
+        for ( index_t i = 0; i < mr; ++i ) {
+            c_addr[i] = (beta != 0.0f) ? alpha * acc[j][i] + beta * c_addr[i] : alpha * acc[j][i];
+        }
+    }
+}
+
+// マイクロカーネル (MR x NR = 16 x 6 を 12本の ymm に保持)
+BB_TARGET_AVX2
+inline void HostSgemm_KernelAvx2(index_t kc, float const *Ap, float const *Bp, float alpha, float beta, float *C, index_t ldc, index_t mr, index_t nr)
+{
+    index_t const MR = BB_HOST_SGEMM_MR;
+    index_t const NR = BB_HOST_SGEMM_NR;
+
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for ( index_t p = 0; p < kc; ++p ) {
+        __m256 a0 = _mm256_load_ps(&Ap[0]);
+        __m256 a1 = _mm256_load_ps(&Ap[8]);
+        __m256 b;
+        b = _mm256_broadcast_ss(&Bp[0]); c00 = _mm256_fmadd_ps(a0, b, c00); c01 = _mm256_fmadd_ps(a1, b, c01);
+        b = _mm256_broadcast_ss(&Bp[1]); c10 = _mm256_fmadd_ps(a0, b, c10); c11 = _mm256_fmadd_ps(a1, b, c11);
+        b = _mm256_broadcast_ss(&Bp[2]); c20 = _mm256_fmadd_ps(a0, b, c20); c21 = _mm256_fmadd_ps(a1, b, c21);
+        b = _mm256_broadcast_ss(&Bp[3]); c30 = _mm256_fmadd_ps(a0, b, c30); c31 = _mm256_fmadd_ps(a1, b, c31);
+        b = _mm256_broadcast_ss(&Bp[4]); c40 = _mm256_fmadd_ps(a0, b, c40); c41 = _mm256_fmadd_ps(a1, b, c41);
+        b = _mm256_broadcast_ss(&Bp[5]); c50 = _mm256_fmadd_ps(a0, b, c50); c51 = _mm256_fmadd_ps(a1, b, c51);
+        Ap += MR;
+        Bp += NR;
+    }
+
+    __m256 acc[NR][2] = { {c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51} };
+    __m256 alpha_v = _mm256_set1_ps(alpha);
+    __m256 beta_v  = _mm256_set1_ps(beta);
+
+    if ( mr == MR && nr == NR ) {
+        for ( index_t j = 0; j < NR; ++j ) {
+            float *c_addr = &C[j * ldc];
+            __m256 r0 = _mm256_mul_ps(alpha_v, acc[j][0]);
+            __m256 r1 = _mm256_mul_ps(alpha_v, acc[j][1]);
+            if ( beta != 0.0f ) {
+                r0 = _mm256_fmadd_ps(beta_v, _mm256_loadu_ps(&c_addr[0]), r0);
+                r1 = _mm256_fmadd_ps(beta_v, _mm256_loadu_ps(&c_addr[8]), r1);
+            }
+            _mm256_storeu_ps(&c_addr[0], r0);
+            _mm256_storeu_ps(&c_addr[8], r1);
+        }
+    }
+    else {
+        // 端数タイル
+        float tmp[BB_HOST_SGEMM_NR][BB_HOST_SGEMM_MR];
+        for ( index_t j = 0; j < NR; ++j ) {
+            _mm256_storeu_ps(&tmp[j][0], acc[j][0]);
+            _mm256_storeu_ps(&tmp[j][8], acc[j][1]);
+        }
+        for ( index_t j = 0; j < nr; ++j ) {
+            float *c_addr = &C[j * ldc];
+            for ( index_t i = 0; i < mr; ++i ) {
+                c_addr[i] = (beta != 0.0f) ? alpha * tmp[j][i] + beta * c_addr[i] : alpha * tmp[j][i];
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief  ホスト版 SGEMM
+ * @detail C = alpha * op(A) * op(B) + beta * C を計算する
+ *         引数は cuBLAS の cublasSgemm と同じく column-major で指定する
+ *         (FrameBuffer は frame 方向が連続なので、frame を行とした行列としてそのまま渡せる)
+ *         出力をタイル単位でスレッドに分配するので、各要素は単一スレッドのみが書き込む
+ *         BB_WITH_BLAS 定義時はシステムの CBLAS を利用する
+ */
+inline void HostSgemm
+(
+    bool            trans_a,
+    bool            trans_b,
+    index_t         m,
+    index_t         n,
+    index_t         k,
+    float           alpha,
+    float const     *A,
+    index_t         lda,
+    float const     *B,
+    index_t         ldb,
+    float           beta,
+    float           *C,
+    index_t         ldc
+)
+{
+    if ( m <= 0 || n <= 0 ) {
+        return;
+    }
+
+#ifdef BB_WITH_BLAS
+    cblas_sgemm(CblasColMajor,
+            trans_a ? CblasTrans : CblasNoTrans,
+            trans_b ? CblasTrans : CblasNoTrans,
+            (int)m, (int)n, (int)k,
+            alpha, A, (int)lda, B, (int)ldb,
+            beta, C, (int)ldc);
+#else
+    if ( k <= 0 || alpha == 0.0f ) {
+        #pragma omp parallel for
+        for ( index_t j = 0; j < n; ++j ) {
+            for ( index_t i = 0; i < m; ++i ) {
+                C[i + j * ldc] = (beta != 0.0f) ? beta * C[i + j * ldc] : 0.0f;
+            }
+        }
+        return;
+    }
+
+    index_t const MR = BB_HOST_SGEMM_MR;
+    index_t const NR = BB_HOST_SGEMM_NR;
+    index_t const MC = BB_HOST_SGEMM_MC;
+    index_t const KC = BB_HOST_SGEMM_KC;
+    index_t const NC = BB_HOST_SGEMM_NC;
+    index_t const NB = BB_HOST_SGEMM_NB;
+
+    auto const kernel = (bb_simd_get_level() >= BB_SIMD_AVX2) ? HostSgemm_KernelAvx2 : HostSgemm_KernelScalar;
+
+    float *b_buf = (float *)aligned_memory_alloc(KC * std::min(NC, (n + NR - 1) / NR * NR) * sizeof(float), 32);
+
+    #pragma omp parallel
+    {
+        float *a_buf = (float *)aligned_memory_alloc(MC * KC * sizeof(float), 32);
+
+        for ( index_t jc = 0; jc < n; jc += NC ) {
+            index_t nc = std::min(NC, n - jc);
+            for ( index_t pc = 0; pc < k; pc += KC ) {
+                index_t kc     = std::min(KC, k - pc);
+                float   beta_p = (pc == 0) ? beta : 1.0f;
+
+                // B パネルを全スレッドで詰め替え (omp for の暗黙バリアで完了を待つ)
+                HostSgemm_PackB(trans_b, kc, nc, trans_b ? &B[jc + pc * ldb] : &B[pc + jc * ldb], ldb, b_buf);
+
+                // C を (MC x NB) のタイルに分けて分配
+                index_t ic_num    = (m  + MC - 1) / MC;
+                index_t jb_num    = (nc + NB - 1) / NB;
+                index_t tile_num  = ic_num * jb_num;
+
+                #pragma omp for
+                for ( index_t tile = 0; tile < tile_num; ++tile ) {
+                    index_t ic = (tile % ic_num) * MC;
+                    index_t jb = (tile / ic_num) * NB;
+                    index_t mc = std::min(MC, m - ic);
+                    index_t nb = std::min(NB, nc - jb);
+
+                    HostSgemm_PackA(trans_a, mc, kc, trans_a ? &A[pc + ic * lda] : &A[ic + pc * lda], lda, a_buf);
+
+                    for ( index_t jr = jb; jr < jb + nb; jr += NR ) {
+                        index_t nr = std::min(NR, jb + nb - jr);
+                        for ( index_t ir = 0; ir < mc; ir += MR ) {
+                            index_t mr = std::min(MR, mc - ir);
+                            kernel(kc, &a_buf[ir * kc], &b_buf[jr * kc], alpha, beta_p,
+                                    &C[(ic + ir) + (jc + jr) * ldc], ldc, mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+
+        aligned_memory_free(a_buf);
+    }
+
+    aligned_memory_free(b_buf);
+#endif
+}
+
+
+}
@@ -0,0 +1,157 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+
+
+namespace bb {
+
+
+// -------------------------------------
+//  ホスト版 Optimizer の更新カーネル
+// -------------------------------------
+//  パラメータ1個(Tensor 1個)分を 1パスで更新する(一時領域を作らない)
+//  勾配は読み出し時に要素毎のクリッピング(clip > 0 の時のみ)と L2 正則化(decay * param の加算)を行う
+
+// これ以上の要素数の時に OpenMP で並列化する
+#ifndef BB_HOST_OPTIMIZER_PARALLEL_SIZE
+#define BB_HOST_OPTIMIZER_PARALLEL_SIZE     (16 * 1024)
+#endif
+
+
+// 勾配の前処理
+template<typename T>
+inline T HostOptimizer_Grad(T grad, T param, T clip, T decay)
+{
+    if ( clip > 0 ) {
+        grad = std::min(std::max(grad, -clip), clip);
+    }
+    return grad + decay * param;
+}
+
+
+// Adam (汎用版)
+template<typename T>
+inline void HostAdam_Update(index_t size, T *param, T const *grad, T *m, T *v, T lr_t, T beta1, T beta2, T clip = 0, T decay = 0)
+{
+    #pragma omp parallel for if(size >= BB_HOST_OPTIMIZER_PARALLEL_SIZE)
+    for ( index_t i = 0; i < size; ++i ) {
+        T g  = HostOptimizer_Grad<T>(grad[i], param[i], clip, decay);
+        m[i] += ((T)1.0 - beta1) * (g - m[i]);
+        v[i] += ((T)1.0 - beta2) * (g * g - v[i]);
+        param[i] -= lr_t * m[i] / (std::sqrt(v[i]) + (T)1e-7);
+    }
+}
+
+// Adam (FP32 AVX2版)
+BB_TARGET_AVX2
+inline void HostAdam_UpdateAvx2(index_t size, float *param, float const *grad, float *m, float *v, float lr_t, float beta1, float beta2, float clip, float decay)
+{
+    index_t const size8 = size & ~(index_t)7;
+
+    __m256 const  c1    = _mm256_set1_ps(1.0f - beta1);
+    __m256 const  c2    = _mm256_set1_ps(1.0f - beta2);
+    __m256 const  lr    = _mm256_set1_ps(lr_t);
+    __m256 const  eps   = _mm256_set1_ps(1e-7f);
+    __m256 const  hi    = _mm256_set1_ps(clip);
+    __m256 const  lo    = _mm256_set1_ps(-clip);
+    __m256 const  wd    = _mm256_set1_ps(decay);
+
+    #pragma omp parallel for if(size >= BB_HOST_OPTIMIZER_PARALLEL_SIZE)
+    for ( index_t i = 0; i < size8; i += 8 ) {
+        __m256 p  = _mm256_loadu_ps(&param[i]);
+        __m256 g  = _mm256_loadu_ps(&grad[i]);
+        if ( clip > 0 ) {
+            g = _mm256_min_ps(hi, _mm256_max_ps(lo, g));    // NaN は汎用版と同じくそのまま通す
+        }
+        g = bb_mm256_fmadd_ps(wd, p, g);
+
+        __m256 mm = _mm256_loadu_ps(&m[i]);
+        __m256 vv = _mm256_loadu_ps(&v[i]);
+        mm = bb_mm256_fmadd_ps(c1, _mm256_sub_ps(g, mm), mm);
+        vv = bb_mm256_fmadd_ps(c2, _mm256_sub_ps(_mm256_mul_ps(g, g), vv), vv);
+        p  = _mm256_sub_ps(p, _mm256_div_ps(_mm256_mul_ps(lr, mm), _mm256_add_ps(_mm256_sqrt_ps(vv), eps)));
+
+        _mm256_storeu_ps(&m[i], mm);
+        _mm256_storeu_ps(&v[i], vv);
+        _mm256_storeu_ps(&param[i], p);
+    }
+
+    HostAdam_Update<float>(size - size8, param + size8, grad + size8, m + size8, v + size8, lr_t, beta1, beta2, clip, decay);
+}
+
+// Adam (FP32 版、実行時に命令セットを選択)
+inline void HostAdam_Update(index_t size, float *param, float const *grad, float *m, float *v, float lr_t, float beta1, float beta2, float clip = 0, float decay = 0)
+{
+    if ( bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+        HostAdam_UpdateAvx2(size, param, grad, m, v, lr_t, beta1, beta2, clip, decay);
+        return;
+    }
+    HostAdam_Update<float>(size, param, grad, m, v, lr_t, beta1, beta2, clip, decay);
+}
+
+
+// SGD (汎用版)
+template<typename T>
+inline void HostSgd_Update(index_t size, T *param, T const *grad, T lr, T clip = 0, T decay = 0)
+{
+    #pragma omp parallel for if(size >= BB_HOST_OPTIMIZER_PARALLEL_SIZE)
+    for ( index_t i = 0; i < size; ++i ) {
+        param[i] -= lr * HostOptimizer_Grad<T>(grad[i], param[i], clip, decay);
+    }
+}
+
+// SGD (FP32 AVX2版)
+BB_TARGET_AVX2
+inline void HostSgd_UpdateAvx2(index_t size, float *param, float const *grad, float lr, float clip, float decay)
+{
+    index_t const size8 = size & ~(index_t)7;
+
+    __m256 const  rate  = _mm256_set1_ps(lr);
+    __m256 const  hi    = _mm256_set1_ps(clip);
+    __m256 const  lo    = _mm256_set1_ps(-clip);
+    __m256 const  wd    = _mm256_set1_ps(decay);
+
+    #pragma omp parallel for if(size >= BB_HOST_OPTIMIZER_PARALLEL_SIZE)
+    for ( index_t i = 0; i < size8; i += 8 ) {
+        __m256 p = _mm256_loadu_ps(&param[i]);
+        __m256 g = _mm256_loadu_ps(&grad[i]);
+        if ( clip > 0 ) {
+            g = _mm256_min_ps(hi, _mm256_max_ps(lo, g));     // NaN は汎用版と同じくそのまま通す
+        }
+        g = bb_mm256_fmadd_ps(wd, p, g);
+        _mm256_storeu_ps(&param[i], bb_mm256_fnmadd_ps(rate, g, p));
+    }
+
+    HostSgd_Update<float>(size - size8, param + size8, grad + size8, lr, clip, decay);
+}
+
+// SGD (FP32 版、実行時に命令セットを選択)
+inline void HostSgd_Update(index_t size, float *param, float const *grad, float lr, float clip = 0, float decay = 0)
+{
+    if ( bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+        HostSgd_UpdateAvx2(size, param, grad, lr, clip, decay);
+        return;
+    }
+    HostSgd_Update<float>(size, param, grad, lr, clip, decay);
+}
+
+
+}
+
+
+// end of file
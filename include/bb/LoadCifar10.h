@@ -17,6 +17,7 @@
 #include <array>
 
 #include "bb/DataType.h"
+#include "bb/DataSet.h"
 
 
 namespace bb {
@@ -61,6 +62,40 @@ public:
 		return ReadFile(ifs, x, y);
 	}
 
+	// 連続配列へ直接読み込む (files のレコードを順に連結する)
+	static bool ReadFiles(std::vector<std::string> const &files, DataArray<T>& x, DataArray<T>& y)
+	{
+		int const record_size = 1 + 32 * 32 * 3;
+
+		// 先にサンプル数を数えて一度だけ確保する
+		index_t num = 0;
+		for (auto const &filename : files) {
+			std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+			if (!ifs.is_open()) { return false; }
+			num += (index_t)ifs.tellg() / record_size;
+		}
+		x.Resize(num, 32 * 32 * 3);
+		y.Resize(num, 10);
+
+		std::vector<std::uint8_t> record(record_size);
+		index_t index = 0;
+		for (auto const &filename : files) {
+			std::ifstream ifs(filename, std::ios::binary);
+			if (!ifs.is_open()) { return false; }
+			while (index < num && ifs.read((char*)&record[0], record_size)) {
+				if (record[0] >= 10) { return false; }
+				y.GetWritableSample(index)[record[0]] = (T)1.0;
+				T *dst = x.GetWritableSample(index);
+				for (int i = 0; i < 32 * 32 * 3; ++i) {
+					dst[i] = (T)record[1 + i] / (T)255.0;
+				}
+				++index;
+			}
+		}
+
+		return index == num;
+	}
+
 	static bool Load(std::vector< std::vector<T> >& x_train, std::vector< std::vector<T> >& y_train,
 		std::vector< std::vector<T> >& x_test, std::vector< std::vector<T> >& y_test, int num = 5)
 	{
@@ -83,6 +118,24 @@ public:
 		}
 		return td;
 	}
+
+	// 連続配列のデータセットとして読み込む
+	static DataSet<T> LoadDataSet(int num = 5)
+	{
+		DataSet<T>	ds;
+        ds.x_shape = indices_t({32, 32, 3});
+        ds.t_shape = indices_t({10});
+
+		std::vector<std::string> train_files;
+		for (int i = 1; i <= num && i <= 5; ++i) {
+			train_files.push_back("cifar-10-batches-bin/data_batch_" + std::to_string(i) + ".bin");
+		}
+		if (   !ReadFiles({"cifar-10-batches-bin/test_batch.bin"}, ds.x_test, ds.t_test)
+			|| !ReadFiles(train_files, ds.x_train, ds.t_train) ) {
+			ds.clear();
+		}
+		return ds;
+	}
 };
 
 }
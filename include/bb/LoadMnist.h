@@ -18,6 +18,7 @@
 #include <array>
 
 #include "bb/DataType.h"
+#include "bb/DataSet.h"
 
 
 namespace bb {
@@ -90,6 +91,44 @@ public:
 	}
 
 
+	// 連続配列へ直接読み込む
+	static bool ReadImageFile(std::istream& is, DataArray<T>& image, int max_size = -1)
+	{
+		std::uint8_t header[16];
+		is.read((char*)&header[0], 16);
+
+		int num   = ReadWord(&header[4]);
+		int rows  = ReadWord(&header[8]);
+		int cols  = ReadWord(&header[12]);
+
+		if (max_size > 0 && num > max_size) {
+			num = max_size;
+		}
+
+		image.Resize(num, rows*cols);
+		std::vector<std::uint8_t> image_u8(rows*cols);
+		for (int i = 0; i < num; ++i) {
+			is.read((char*)&image_u8[0], rows*cols);
+			T *dst = image.GetWritableSample(i);
+			for (int j = 0; j < rows*cols; ++j) {
+				dst[j] = (T)image_u8[j] / (T)255.0;
+			}
+		}
+
+		return !is.fail();
+	}
+
+	static bool ReadImageFile(std::string filename, DataArray<T>& image, int max_size = -1)
+	{
+		std::ifstream ifs(filename, std::ios::binary);
+		if (!ifs.is_open()) {
+			std::cerr << "open error : " << filename << std::endl;
+			return false;
+		}
+		return ReadImageFile(ifs, image, max_size);
+	}
+
+
 	static bool ReadLabelFile(std::istream& is, std::vector<uint8_t>& label, int max_size = -1)
 	{
 		std::uint8_t header[8];
@@ -135,6 +174,31 @@ public:
 	}
 
 
+	static bool ReadLabelFile(std::istream& is, DataArray<T>& label, int num_class = 10, int max_size = -1)
+	{
+		std::vector<uint8_t> label_u8;
+		if (!ReadLabelFile(is, label_u8, max_size)) { return false;  }
+
+		label.Resize((index_t)label_u8.size(), num_class);
+		for (size_t i = 0; i < label_u8.size(); ++i) {
+			if (!(label_u8[i] >= 0 && label_u8[i] < num_class)) { return false; }
+			label.GetWritableSample((index_t)i)[label_u8[i]] = (T)1.0;
+		}
+
+		return true;
+	}
+
+	static bool ReadLabelFile(std::string filename, DataArray<T>& label, int num_class = 10, int max_size = -1)
+	{
+		std::ifstream ifs(filename, std::ios::binary);
+		if (!ifs.is_open()) { 
+			std::cerr << "open error : " << filename << std::endl;
+			return false;
+		}
+		return ReadLabelFile(ifs, label, num_class, max_size);
+	}
+
+
 	static bool Load(std::vector< std::vector<T> >& x_train, std::vector< std::vector<T> >& y_train,
 		std::vector< std::vector<T> >& x_test, std::vector< std::vector<T> >& y_test,
 		int num_class = 10, int max_train=-1, int max_test = -1)
@@ -156,6 +220,21 @@ public:
 		}
 		return td;
 	}
+
+	// 連続配列のデータセットとして読み込む
+	static DataSet<T> LoadDataSet(int num_class = 10, int max_train = -1, int max_test = -1)
+	{
+		DataSet<T>	ds;
+        ds.x_shape = indices_t({28, 28, 1});
+        ds.t_shape = indices_t({10});
+		if (   !ReadImageFile("train-images-idx3-ubyte", ds.x_train, max_train)
+			|| !ReadLabelFile("train-labels-idx1-ubyte", ds.t_train, 10, max_train)
+			|| !ReadImageFile("t10k-images-idx3-ubyte",  ds.x_test,  max_test)
+			|| !ReadLabelFile("t10k-labels-idx1-ubyte",  ds.t_test,  10, max_test) ) {
+			ds.clear();
+		}
+		return ds;
+	}
 };
 
 
@@ -14,6 +14,7 @@
 #include <valarray>
 
 #include "bb/LossFunction.h"
+#include "bb/SimdSupport.h"
 
 
 namespace bb {
@@ -54,6 +55,85 @@ public:
         return (double)loss_ptr[0] / (double)m_frames;
     }
 
+protected:
+    // FP32 の AVX2 版 (フレーム方向に 8 フレームずつ SIMD 化)
+    BB_TARGET_AVX2
+    void CalculateLossAvx2(FrameBuffer const &y, FrameBuffer const &t)
+    {
+        index_t frame_size  = y.GetFrameSize();
+        index_t node_size   = y.GetNodeSize();
+        index_t y_stride    = y.GetFrameStride() / sizeof(float);
+        index_t t_stride    = t.GetFrameStride() / sizeof(float);
+        index_t dy_stride   = m_dy.GetFrameStride() / sizeof(float);
+
+        auto y_ptr        = y.LockMemoryConst();
+        auto t_ptr        = t.LockMemoryConst();
+        auto dy_ptr       = m_dy.LockMemory(true);
+        auto loss_buf_ptr = m_loss_buf.Lock(true);
+        auto loss_ptr     = m_loss.Lock();
+
+        auto y_addr  = (float const *)y_ptr.GetAddr();
+        auto t_addr  = (float const *)t_ptr.GetAddr();
+        auto dy_addr = (float       *)dy_ptr.GetAddr();
+        auto loss_buf_addr = (float *)&loss_buf_ptr[0];
+
+        // フレーム方向に 8 フレームずつ SIMD 化 (端数フレームはマスクして捨てる)
+        index_t block_size = (frame_size + 7) / 8;
+        int     nan_flag   = 0;
+        double  loss_sum   = 0;
+
+        #pragma omp parallel for reduction(+:loss_sum) reduction(|:nan_flag)
+        for (index_t block = 0; block < block_size; ++block) {
+            index_t frame = block * 8;
+
+            // max
+            __m256 c = _mm256_loadu_ps(&y_addr[frame]);
+            for (index_t node = 1; node < node_size; ++node) {
+                c = _mm256_max_ps(c, _mm256_loadu_ps(&y_addr[node * y_stride + frame]));
+            }
+
+            // exp(y - c) を dy に仮置きしつつ合計
+            __m256 sum = _mm256_setzero_ps();
+            for (index_t node = 0; node < node_size; ++node) {
+                __m256 e = bb_mm256_exp_ps(_mm256_sub_ps(_mm256_loadu_ps(&y_addr[node * y_stride + frame]), c));
+                _mm256_storeu_ps(&dy_addr[node * dy_stride + frame], e);
+                sum = _mm256_add_ps(sum, e);
+            }
+
+            __m256 rcp_sum = _mm256_div_ps(_mm256_set1_ps(1.0f), sum);
+            __m256 rcp_fs  = _mm256_set1_ps(1.0f / (float)frame_size);
+            __m256 sel     = _mm256_set1_ps(1.0f);
+            __m256 nan     = _mm256_cmp_ps(c, c, _CMP_UNORD_Q);
+            for (index_t node = 0; node < node_size; ++node) {
+                __m256 softmax = _mm256_mul_ps(_mm256_loadu_ps(&dy_addr[node * dy_stride + frame]), rcp_sum);
+                __m256 target  = _mm256_loadu_ps(&t_addr[node * t_stride + frame]);
+                sel = _mm256_blendv_ps(sel, softmax, _mm256_cmp_ps(target, _mm256_setzero_ps(), _CMP_GT_OQ));
+                __m256 dy = _mm256_mul_ps(_mm256_sub_ps(softmax, target), rcp_fs);
+                nan = _mm256_or_ps(nan, _mm256_cmp_ps(dy, dy, _CMP_UNORD_Q));
+                _mm256_storeu_ps(&dy_addr[node * dy_stride + frame], dy);
+            }
+
+            // log は正解ノードの 8 要素分のみなのでスカラーで計算
+            float   sel_buf[8];
+            _mm256_storeu_ps(sel_buf, sel);
+            int     n = (int)std::min((index_t)8, frame_size - frame);
+            for (int i = 0; i < n; ++i) {
+                float loss = std::log(sel_buf[i] + 1.0e-7f);
+                loss_buf_addr[frame + i] = loss;
+                loss_sum += loss;
+            }
+            nan_flag |= (_mm256_movemask_ps(_mm256_and_ps(nan, bb_mm256_mask_ps(n))) != 0);
+        }
+
+        if ( nan_flag ) {
+            std::cout << "loss : nan" << std::endl;
+        }
+
+        loss_ptr[0] += (T)(-loss_sum);
+        m_frames    += frame_size;
+    }
+
+public:
     FrameBuffer CalculateLoss(FrameBuffer y, FrameBuffer t)
     {
         m_dy.Resize(y.GetType(), y.GetFrameSize(), y.GetShape());
@@ -86,10 +166,14 @@ public:
         }
 #endif
 
+        if ( DataType<T>::type == BB_TYPE_FP32 && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            CalculateLossAvx2(y, t);
+            return m_dy;
+        }
+
         {
             index_t frame_size = y.GetFrameSize();
             index_t node_size = y.GetNodeSize();
-            index_t stride_size = y.GetFrameStride() / sizeof(T);
 
             auto y_ptr = y.LockConst<T>();
             auto t_ptr = t.LockConst<T>();
@@ -97,7 +181,9 @@ public:
             auto loss_buf_ptr = m_loss_buf.Lock(true);
             auto loss_ptr = m_loss.Lock();
 
-//#pragma omp parallel for
+            T loss_sum = 0;
+
+            #pragma omp parallel for reduction(+:loss_sum)
             for (index_t frame = 0; frame < frame_size; ++frame) {
                 // max
                 auto c = y_ptr.Get(frame, 0);
@@ -106,33 +192,31 @@ public:
                 }
                 if (!Real_IsValid(c)) {
                     std::cout << "loss c : nan" << std::endl;
- //                 getchar();
                 }
 
-                // sum(exp(y - c))
+                // exp(y - c) を dy に仮置きしつつ合計
                 T sum = 0;
                 for (index_t node = 0; node < node_size; ++node) {
-                    sum += std::exp(y_ptr.Get(frame, node) - c);
+                    T e = std::exp(y_ptr.Get(frame, node) - c);
+                    dy_ptr.Set(frame, node, e);
+                    sum += e;
                 }
 
+                T loss = std::log((T)1.0 + (T)1.0e-7);
                 for (index_t node = 0; node < node_size; ++node) {
-                    T softmax = std::exp(y_ptr.Get(frame, node) - c) / sum;
+                    T softmax = dy_ptr.Get(frame, node) / sum;
                     if (t_ptr.Get(frame, node) > 0) {
-                        loss_buf_ptr[frame] = std::log(softmax + (T)1.0e-7);
+                        loss = std::log(softmax + (T)1.0e-7);
                     }
                     T dy = (softmax - t_ptr.Get(frame, node)) / (T)frame_size;
                     if (!Real_IsValid(dy)) {
                         std::cout << "loss dy : nan" << std::endl;
- //                     getchar();
                     }
 
                     dy_ptr.Set(frame, node, dy);
                 }
-            }
-
-            T loss_sum = 0;
-            for ( index_t frame = 0; frame < frame_size; ++frame ) {
-                loss_sum += loss_buf_ptr[frame];
+                loss_buf_ptr[frame] = loss;
+                loss_sum += loss;
             }
 
             loss_ptr[0] += -loss_sum;
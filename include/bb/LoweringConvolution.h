@@ -11,6 +11,7 @@
 #pragma once
 
 #include <cstdint>
+#include <algorithm>
 
 #include "bb/Filter2d.h"
 #include "bb/ConvolutionIm2Col.h"
@@ -29,6 +30,19 @@ class LoweringConvolution : public Filter2d<FT, BT>
 protected:
     index_t m_filter_h_size = 1;
     index_t m_filter_w_size = 1;
+    index_t m_h_stride      = 1;
+    index_t m_w_stride      = 1;
+    index_t m_h_padding     = 0;
+    index_t m_w_padding     = 0;
+    index_t m_h_dilation    = 1;
+    index_t m_w_dilation    = 1;
+
+    // fused モード(入力フレームをタイルに分けて内部層に流す)の1タイルの最大画素数 (0 なら一括処理)
+    index_t m_fused_tile_size = 0;
+    bool    m_fused_forward   = false;
+    FrameBuffer m_x;
+    FrameBuffer m_y;
+    FrameBuffer m_dx;
 
     // 3層で構成
 	std::shared_ptr< ConvolutionIm2Col<FT, BT> >	m_im2col;
@@ -38,6 +52,22 @@ protected:
 protected:
 	LoweringConvolution() {}
 
+    /**
+     * @brief  コマンド処理
+     * @detail コマンド処理
+     * @param  args   コマンド
+     */
+	void CommandProc(std::vector<std::string> args)
+	{
+        // fusedモードのタイルサイズ設定 (im2col 後の1タイルの最大画素数、0 で一括処理)
+        //   分割は入力フレーム単位で行うので、1フレームの出力画素数が指定より大きい場合は
+        //   1フレームずつ処理し、タイルはその1フレーム分になる
+        if (args.size() == 2 && args[0] == "fused_tile_size")
+        {
+            m_fused_tile_size = (index_t)std::stoll(args[1]);
+        }
+	}
+
 public:
 	~LoweringConvolution() {}
 
@@ -46,6 +76,13 @@ public:
         std::shared_ptr<Model>  layer;
         index_t                 filter_h_size = 1;
         index_t                 filter_w_size = 1;
+        index_t                 h_stride      = 1;
+        index_t                 w_stride      = 1;
+        index_t                 h_padding     = 0;
+        index_t                 w_padding     = 0;
+        index_t                 h_dilation    = 1;
+        index_t                 w_dilation    = 1;
+        index_t                 fused_tile_size = 0;    // 0 以外で fused モード (im2col 後の1タイルの最大画素数、入力フレーム単位で分割)
     };
 
     static std::shared_ptr<LoweringConvolution> Create(create_t const & create)
@@ -54,26 +91,45 @@ public:
         
         self->m_filter_w_size = create.filter_w_size;
         self->m_filter_h_size = create.filter_h_size;
-
-  		self->m_im2col = ConvolutionIm2Col<FT, BT>::Create(self->m_filter_h_size, self->m_filter_w_size);
+        self->m_h_stride      = create.h_stride;
+        self->m_w_stride      = create.w_stride;
+        self->m_h_padding     = create.h_padding;
+        self->m_w_padding     = create.w_padding;
+        self->m_h_dilation    = create.h_dilation;
+        self->m_w_dilation    = create.w_dilation;
+        self->m_fused_tile_size = create.fused_tile_size;
+
+        typename ConvolutionIm2Col<FT, BT>::create_t im2col_create;
+        im2col_create.filter_h_size = create.filter_h_size;
+        im2col_create.filter_w_size = create.filter_w_size;
+        im2col_create.h_stride      = create.h_stride;
+        im2col_create.w_stride      = create.w_stride;
+        im2col_create.h_padding     = create.h_padding;
+        im2col_create.w_padding     = create.w_padding;
+        im2col_create.h_dilation    = create.h_dilation;
+        im2col_create.w_dilation    = create.w_dilation;
+  		self->m_im2col = ConvolutionIm2Col<FT, BT>::Create(im2col_create);
         self->m_layer  = create.layer;
         // col2im の形状は入力形状確定時に決まる
 
         return self;
 	}
 
-    static std::shared_ptr<LoweringConvolution> Create(std::shared_ptr<Model> layer, index_t filter_h_size, index_t filter_w_size)
+    static std::shared_ptr<LoweringConvolution> Create(std::shared_ptr<Model> layer, index_t filter_h_size, index_t filter_w_size,
+                index_t h_stride = 1, index_t w_stride = 1, index_t h_padding = 0, index_t w_padding = 0,
+                index_t h_dilation = 1, index_t w_dilation = 1)
 	{
-        auto self = std::shared_ptr<LoweringConvolution>(new LoweringConvolution);
-        
-        self->m_filter_w_size = filter_w_size;
-        self->m_filter_h_size = filter_h_size;
-
-  		self->m_im2col = ConvolutionIm2Col<FT, BT>::Create(filter_h_size, filter_w_size);
-        self->m_layer  = layer;
-        // col2im の形状は入力形状確定時に決まる
-
-        return self;
+        create_t create;
+        create.layer         = layer;
+        create.filter_h_size = filter_h_size;
+        create.filter_w_size = filter_w_size;
+        create.h_stride      = h_stride;
+        create.w_stride      = w_stride;
+        create.h_padding     = h_padding;
+        create.w_padding     = w_padding;
+        create.h_dilation    = h_dilation;
+        create.w_dilation    = w_dilation;
+        return Create(create);
 	}
 
 	std::string GetClassName(void) const { return "LoweringConvolution"; }
@@ -87,6 +143,13 @@ public:
 
     index_t GetFilterHeight(void) { return m_filter_h_size; }
     index_t GetFilterWidth(void)  { return m_filter_w_size; }
+    index_t GetStrideHeight(void)   const { return m_h_stride; }
+    index_t GetStrideWidth(void)    const { return m_w_stride; }
+    index_t GetPaddingHeight(void)  const { return m_h_padding; }
+    index_t GetPaddingWidth(void)   const { return m_w_padding; }
+    index_t GetDilationHeight(void) const { return m_h_dilation; }
+    index_t GetDilationWidth(void)  const { return m_w_dilation; }
+    index_t GetFusedTileSize(void)  const { return m_fused_tile_size; }
 
 
     /**
@@ -95,9 +158,12 @@ public:
      */   
     void SendCommand(std::string command, std::string send_to = "all")
     {
+        super::SendCommand(command, send_to);
 	    m_im2col->SendCommand(command, send_to);
 	    m_layer->SendCommand(command, send_to);
-	    m_col2im->SendCommand(command, send_to);
+        if ( m_col2im ) {   // col2im は入力形状確定時に生成
+	        m_col2im->SendCommand(command, send_to);
+        }
     }
     
     /**
@@ -142,15 +208,11 @@ public:
     {
         BB_ASSERT(shape.size() == 3);
 
-        index_t input_w_size = shape[0];
-        index_t input_h_size = shape[1];
-        index_t input_c_size = shape[2];
-		index_t output_w_size = input_w_size - m_filter_w_size + 1;
-		index_t output_h_size = input_h_size - m_filter_h_size + 1;
+        shape = m_im2col->SetInputShape(shape);
 
-		m_col2im = ConvolutionCol2Im<FT, BT>::Create(output_h_size, output_w_size);
+        // 出力サイズは stride/padding/dilation を反映して im2col が計算する
+		m_col2im = ConvolutionCol2Im<FT, BT>::Create(m_im2col->GetOutputHeight(), m_im2col->GetOutputWidth());
 
-        shape = m_im2col->SetInputShape(shape);
         shape = m_layer->SetInputShape(shape);
         shape = m_col2im->SetInputShape(shape);
 
@@ -179,33 +241,125 @@ public:
     }
     
 
+protected:
+    // fused モードで1タイルに入れる入力フレーム数 (一括処理なら 0)
+    index_t GetFusedTileFrames(index_t frame_size) const
+    {
+        if ( m_fused_tile_size <= 0 ) {
+            return 0;
+        }
+
+        // 指定画素数を超えないフレーム数 (1フレームで超える場合は1フレーム)
+        index_t pixel_size  = m_im2col->GetOutputHeight() * m_im2col->GetOutputWidth();
+        index_t tile_frames = std::max((index_t)1, m_fused_tile_size / pixel_size);
+
+        // Bit型は8フレーム以上ならバイト単位で切り出せるよう切り下げる
+        if ( DataType<FT>::type == BB_TYPE_BIT && tile_frames >= 8 ) {
+            tile_frames = tile_frames / 8 * 8;
+        }
+        return (tile_frames < frame_size) ? tile_frames : 0;
+    }
+
+    FrameBuffer ForwardTile(FrameBuffer x, bool train)
+    {
+	    x = m_im2col->Forward(x, train);
+	    x = m_layer->Forward(x, train);
+	    x = m_col2im->Forward(x, train);
+        return x;
+    }
+
+public:
    /**
      * @brief  forward演算
      * @detail forward演算を行う
+     *         fused モードでは入力フレームをタイルに分けて内部層に流し、
+     *         im2col 後のバッファをタイルサイズに抑える
      * @param  x     入力データ
      * @param  train 学習時にtrueを指定
      * @return forward演算結果
      */
     FrameBuffer Forward(FrameBuffer x, bool train = true)
     {
-	    x = m_im2col->Forward(x, train);
-	    x = m_layer->Forward(x, train);
-	    x = m_col2im->Forward(x, train);
-        return x;
+        // SetInputShpaeされていなければ初回に設定
+        if ( !m_col2im || x.GetShape() != m_im2col->GetInputShape() ) {
+            SetInputShape(x.GetShape());
+        }
+
+        index_t frame_size  = x.GetFrameSize();
+        index_t tile_frames = GetFusedTileFrames(frame_size);
+        m_fused_forward = (tile_frames > 0);
+        if ( !m_fused_forward ) {
+            return ForwardTile(x, train);
+        }
+
+        m_y.Resize(DataType<FT>::type, frame_size, GetOutputShape());
+        for (index_t start = 0; start < frame_size; start += tile_frames) {
+            index_t size = std::min(tile_frames, frame_size - start);
+            m_y.SetRange(start, ForwardTile(x.GetRange(start, size), train));
+        }
+
+        // backward 時にタイル毎に forward を再計算する
+        if ( train ) {
+            m_x = x;
+        }
+
+        return m_y;
     }
 
    /**
      * @brief  backward演算
      * @detail backward演算を行う
-     *         
+     *         fused モードではタイル毎に forward を再計算してから逆伝播し、
+     *         内部層の勾配はタイル分を合算する
+     *         (BatchNormalization 等の統計量はタイル単位になる)
+     *         再計算中は内部層に running_stat_lock を送り BatchNormalization の
+     *         running_mean/var の二重更新を防ぐ
+     *         学習時 forward で乱数を引く層 (RealToBinary 等) は再計算で
+     *         別の乱数を引くため forward と一致しない。fused モードの内部層には含めないこと
      * @return backward演算結果
      */
     FrameBuffer Backward(FrameBuffer dy)
     {
-	    dy = m_col2im->Backward(dy);
-	    dy = m_layer->Backward(dy);
-	    dy = m_im2col->Backward(dy);
-        return dy; 
+        if ( !m_fused_forward ) {
+	        dy = m_col2im->Backward(dy);
+	        dy = m_layer->Backward(dy);
+	        dy = m_im2col->Backward(dy);
+            return dy;
+        }
+
+        index_t frame_size  = dy.GetFrameSize();
+        index_t tile_frames = GetFusedTileFrames(frame_size);
+        BB_ASSERT(frame_size == m_x.GetFrameSize() && tile_frames > 0);
+
+        m_dx.Resize(DataType<BT>::type, frame_size, GetInputShape());
+
+        Variables gradients = m_layer->GetGradients();
+        Variables acc_gradients(gradients.GetTypes(), gradients.GetShapes());
+        acc_gradients = 0;
+
+        // 最後のタイルは forward の内部状態が残っているので逆順に処理する
+        index_t last_start = (frame_size - 1) / tile_frames * tile_frames;
+        for (index_t start = last_start; start >= 0; start -= tile_frames) {
+            index_t size = std::min(tile_frames, frame_size - start);
+            if ( start != last_start ) {
+                m_layer->SendCommand("running_stat_lock true");
+                ForwardTile(m_x.GetRange(start, size), true);
+                m_layer->SendCommand("running_stat_lock false");
+            }
+
+            FrameBuffer dx = dy.GetRange(start, size);
+	        dx = m_col2im->Backward(dx);
+	        dx = m_layer->Backward(dx);
+	        dx = m_im2col->Backward(dx);
+            m_dx.SetRange(start, dx);
+
+            if ( start > 0 ) {
+                acc_gradients += gradients;
+            }
+        }
+        gradients += acc_gradients;
+
+        return m_dx;
     }
 	
 protected:
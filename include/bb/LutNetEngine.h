@@ -0,0 +1,858 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <utility>
+#include <fstream>
+
+#include "bb/DataType.h"
+#include "bb/Utility.h"
+#include "bb/SimdSupport.h"
+#include "bb/SimdKernel.h"
+#include "bb/FrameBuffer.h"
+#include "bb/Sequential.h"
+#include "bb/BinaryLutN.h"
+#include "bb/MaxPooling.h"
+#include "bb/LoweringConvolution.h"
+
+
+namespace bb {
+
+
+/**
+ * @brief  学習済みLUTネットの推論専用エンジン
+ * @detail Sequential / BinaryLutN / MaxPooling / LoweringConvolution で構成された
+ *         Bit入力のネットを、ビットスライス演算の段(stage)の列に平坦化して実行する
+ *         LUT の評価は BinaryLutN の host_simd と同じカーネル(BinaryLutN_ForwardBit)を使い、
+ *         同じテーブルのノードはテーブルを共有する
+ *         中間結果は事前確保した2面のバッファを交互に使う
+ */
+class LutNetEngine
+{
+public:
+    enum {
+        STAGE_LUT,      // LUT の評価
+        STAGE_OR,       // 入力の論理和(Bit版MaxPooling)
+        STAGE_IM2COL,   // 畳み込みの展開 (フレーム数が pixel_size 倍になる)
+        STAGE_COL2IM,   // 展開の復元 (フレーム数が 1/pixel_size になる)
+    };
+
+    struct Stage
+    {
+        std::int32_t    type;
+        std::int32_t    op_begin;           // STAGE_LUT/OR: m_ops 上の範囲, STAGE_IM2COL: m_inputs 上の座標変換テーブル
+        std::int32_t    op_end;
+        std::int32_t    node_size;          // 出力ノード数
+        std::int32_t    frame_mul;          // 入力フレーム数の倍率
+        std::int32_t    c_size;             // STAGE_IM2COL/COL2IM
+        std::int32_t    tap_size;           // STAGE_IM2COL: フィルタサイズ
+        std::int32_t    pixel_size;         // 出力画素数
+        std::int32_t    input_pixel_size;   // STAGE_IM2COL: 入力画素数
+    };
+
+    struct Op
+    {
+        std::int32_t    table;          // STAGE_LUT のみ
+        std::int32_t    input_begin;    // m_inputs 上の位置
+        std::int32_t    input_size;
+    };
+
+    static int const MAX_LUT_INPUT = 6;
+    static int const MAX_OR_INPUT  = 64;
+
+protected:
+    // ファイル形式 (先頭に MAGIC と VERSION を置く)
+    static char const *Magic(void) { return "BBLUTNET"; }
+    static int const            VERSION = 1;
+
+    index_t                     m_input_node_size  = 0;
+    index_t                     m_output_node_size = 0;
+    indices_t                   m_input_shape;
+    indices_t                   m_output_shape;
+
+    std::vector<Stage>          m_stages;
+    std::vector<Op>             m_ops;
+    std::vector<std::int32_t>   m_inputs;       // 前段の入力ノード番号 (-1 は定数0)
+
+    std::vector<std::int32_t>   m_table_input_size;
+    std::vector<std::uint64_t>  m_table;
+
+    // 実行用バッファ (ノード毎に 256 フレーム単位で切り上げた 32bit ワード列)
+    index_t                     m_max_frame_size = 0;
+    index_t                     m_buf_size       = 0;   // 中間バッファのワード数
+    std::int32_t                *m_buf[3] = {nullptr, nullptr, nullptr};    // [0]:入力, [1][2]:中間
+    std::int32_t                *m_zero   = nullptr;
+
+public:
+    LutNetEngine() {}
+    LutNetEngine(LutNetEngine const &) = delete;
+    LutNetEngine &operator=(LutNetEngine const &) = delete;
+
+    ~LutNetEngine()
+    {
+        FreeBuffer();
+    }
+
+    index_t   GetInputNodeSize(void)  const { return m_input_node_size; }
+    index_t   GetOutputNodeSize(void) const { return m_output_node_size; }
+    indices_t GetInputShape(void)     const { return m_input_shape; }
+    indices_t GetOutputShape(void)    const { return m_output_shape; }
+    index_t   GetStageSize(void)      const { return (index_t)m_stages.size(); }
+    index_t   GetOpSize(void)         const { return (index_t)m_ops.size(); }
+    index_t   GetTableSize(void)      const { return (index_t)m_table.size(); }
+    index_t   GetMaxFrameSize(void)   const { return m_max_frame_size; }
+    index_t   GetBufferSize(void)     const { return (2 * m_buf_size + m_input_node_size * WordSize(m_max_frame_size)) * sizeof(std::int32_t); }
+
+
+    /**
+     * @brief  ネットのコンパイル
+     * @detail 入力形状が設定済み(SetInputShape済み)のネットを平坦化する
+     * @param  model          変換するネット
+     * @param  max_frame_size 1回に処理するフレーム数(中間バッファの大きさ)
+     * @return 未対応の層を含む場合は false
+     */
+    bool Compile(std::shared_ptr<Model> model, index_t max_frame_size = 256)
+    {
+        Clear();
+
+        m_input_shape      = model->GetInputShape();
+        m_output_shape     = model->GetOutputShape();
+        m_input_node_size  = GetShapeSize(m_input_shape);
+        m_output_node_size = GetShapeSize(m_output_shape);
+
+        std::map< std::pair<int, std::uint64_t>, int > table_map;
+        index_t node_size = m_input_node_size;
+        index_t frame_mul = 1;
+        if ( !CompileLayer(model, node_size, frame_mul, table_map) ) {
+            Clear();
+            return false;
+        }
+        BB_ASSERT(node_size == m_output_node_size && frame_mul == 1);
+
+        SetMaxFrameSize(max_frame_size);
+        return true;
+    }
+
+    /**
+     * @brief  1回に処理する最大フレーム数の設定
+     * @detail 中間バッファを確保し直す(256 フレーム単位に切り上げ)
+     */
+    void SetMaxFrameSize(index_t max_frame_size)
+    {
+        FreeBuffer();
+        m_max_frame_size = std::max((index_t)1, (max_frame_size + 255) / 256) * 256;
+
+        index_t max_words = WordSize(m_max_frame_size);
+        m_buf_size = 8;
+        for (auto const &stage : m_stages) {
+            index_t frame_size = m_max_frame_size * stage.frame_mul;
+            if ( stage.type == STAGE_IM2COL ) { frame_size *= stage.pixel_size; }
+            if ( stage.type == STAGE_COL2IM ) { frame_size /= stage.pixel_size; }
+            m_buf_size  = std::max(m_buf_size, stage.node_size * WordSize(frame_size));
+            max_words   = std::max(max_words, WordSize(m_max_frame_size * stage.frame_mul));
+        }
+
+        // Col2Im は 32bit をまたいで読むので末尾に 1 ワードの余白を付ける
+        m_buf[0] = (std::int32_t *)aligned_memory_alloc((std::max((index_t)8, m_input_node_size * WordSize(m_max_frame_size)) + 1) * sizeof(std::int32_t), 64);
+        m_buf[1] = (std::int32_t *)aligned_memory_alloc((m_buf_size + 1) * sizeof(std::int32_t), 64);
+        m_buf[2] = (std::int32_t *)aligned_memory_alloc((m_buf_size + 1) * sizeof(std::int32_t), 64);
+        m_zero   = (std::int32_t *)aligned_memory_alloc(max_words * sizeof(std::int32_t), 64);
+        memset(m_zero, 0, max_words * sizeof(std::int32_t));
+    }
+
+
+    /**
+     * @brief  推論 (Bit型 FrameBuffer)
+     * @param  x  入力 (Bit型)
+     * @return 出力 (Bit型)
+     */
+    FrameBuffer Forward(FrameBuffer x)
+    {
+        BB_ASSERT(x.GetType() == BB_TYPE_BIT);
+        BB_ASSERT(x.GetNodeSize() == m_input_node_size);
+
+        index_t    frame_size = x.GetFrameSize();
+        FrameBuffer y(BB_TYPE_BIT, frame_size, m_output_shape);
+
+        auto x_ptr = x.LockMemoryConst();
+        auto y_ptr = y.LockMemory(true);
+        auto x_addr = (std::uint8_t const *)x_ptr.GetAddr();
+        auto y_addr = (std::uint8_t       *)y_ptr.GetAddr();
+        index_t x_stride = x.GetFrameStride();
+        index_t y_stride = y.GetFrameStride();
+
+        for (index_t frame = 0; frame < frame_size; frame += m_max_frame_size) {
+            index_t size       = std::min(m_max_frame_size, frame_size - frame);
+            index_t words      = WordSize(size);
+            index_t byte_begin = frame / 8;
+            index_t byte_size  = words * sizeof(std::int32_t);
+
+            for (index_t node = 0; node < m_input_node_size; ++node) {
+                memcpy(&m_buf[0][node * words], &x_addr[node * x_stride + byte_begin], byte_size);
+            }
+
+            std::int32_t const *out = Execute(size);
+
+            for (index_t node = 0; node < m_output_node_size; ++node) {
+                memcpy(&y_addr[node * y_stride + byte_begin], &out[node * words], byte_size);
+            }
+        }
+
+        return y;
+    }
+
+    /**
+     * @brief  推論 (フレーム毎に並んだ 0/1 のバイト列)
+     * @param  x           入力 x[frame * 入力ノード数 + node]
+     * @param  y           出力 y[frame * 出力ノード数 + node]
+     * @param  frame_size  フレーム数
+     */
+    void Forward(std::uint8_t const *x, std::uint8_t *y, index_t frame_size)
+    {
+        for (index_t frame = 0; frame < frame_size; frame += m_max_frame_size) {
+            index_t size  = std::min(m_max_frame_size, frame_size - frame);
+            index_t words = WordSize(size);
+
+            // フレーム方向にビットを詰める
+            #pragma omp parallel for
+            for (index_t node = 0; node < m_input_node_size; ++node) {
+                std::uint32_t *row = (std::uint32_t *)&m_buf[0][node * words];
+                memset(row, 0, words * sizeof(std::int32_t));
+                for (index_t i = 0; i < size; ++i) {
+                    if ( x[(frame + i) * m_input_node_size + node] ) {
+                        row[i / 32] |= (1u << (i % 32));
+                    }
+                }
+            }
+
+            std::int32_t const *out = Execute(size);
+
+            #pragma omp parallel for
+            for (index_t i = 0; i < size; ++i) {
+                std::uint8_t *y_frame = &y[(frame + i) * m_output_node_size];
+                for (index_t node = 0; node < m_output_node_size; ++node) {
+                    std::uint32_t const *row = (std::uint32_t const *)&out[node * words];
+                    y_frame[node] = (std::uint8_t)((row[i / 32] >> (i % 32)) & 1);
+                }
+            }
+        }
+    }
+
+
+    // Serialize
+    void Save(std::ostream &os) const
+    {
+        os.write(Magic(), 8);
+        SaveValue(os, (std::int32_t)VERSION);
+        SaveValue(os, m_input_shape);
+        SaveValue(os, m_output_shape);
+        SaveValue(os, m_stages);
+        SaveValue(os, m_ops);
+        SaveValue(os, m_inputs);
+        SaveValue(os, m_table_input_size);
+        SaveValue(os, m_table);
+    }
+
+    /**
+     * @brief  読み込み
+     * @detail ヘッダ・各サイズ・段の構成を検査し、壊れたデータや別形式のデータは読み込まない
+     * @return 失敗時は false (エンジンは空になる)
+     */
+    bool Load(std::istream &is, index_t max_frame_size = 256)
+    {
+        Clear();
+
+        char          magic[8];
+        std::int32_t  version = 0;
+        is.read(magic, 8);
+        if ( !is || memcmp(magic, Magic(), 8) != 0 ) { return false; }
+        LoadValue(is, version);
+        if ( !is || version != VERSION )             { return false; }
+
+        if ( !LoadVector(is, m_input_shape,      16)
+                || !LoadVector(is, m_output_shape,     16)
+                || !LoadVector(is, m_stages,           1 << 16)
+                || !LoadVector(is, m_ops,              1 << 24)
+                || !LoadVector(is, m_inputs,           1 << 28)
+                || !LoadVector(is, m_table_input_size, 1 << 24)
+                || !LoadVector(is, m_table,            1 << 24) ) {
+            Clear();
+            return false;
+        }
+
+        if ( !Validate() ) {
+            Clear();
+            return false;
+        }
+        m_input_node_size  = GetShapeSize(m_input_shape);
+        m_output_node_size = GetShapeSize(m_output_shape);
+
+        SetMaxFrameSize(max_frame_size);
+        return true;
+    }
+
+    bool SaveBinary(std::string filename) const
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        if ( !ofs.is_open() ) {
+            return false;
+        }
+        Save(ofs);
+        return (bool)ofs;
+    }
+
+    bool LoadBinary(std::string filename, index_t max_frame_size = 256)
+    {
+        std::ifstream ifs(filename, std::ios::binary);
+        if ( !ifs.is_open() ) {
+            return false;
+        }
+        return Load(ifs, max_frame_size);
+    }
+
+
+protected:
+    // ノード1つ分のワード数 (AVX-512 でも端数なく読めるよう 256 フレーム単位に切り上げ)
+    static index_t WordSize(index_t frame_size)
+    {
+        return (frame_size + 255) / 256 * 8;
+    }
+
+    void FreeBuffer(void)
+    {
+        for (int i = 0; i < 3; ++i) {
+            if ( m_buf[i] != nullptr ) { aligned_memory_free(m_buf[i]); m_buf[i] = nullptr; }
+        }
+        if ( m_zero != nullptr ) { aligned_memory_free(m_zero); m_zero = nullptr; }
+    }
+
+    void Clear(void)
+    {
+        FreeBuffer();
+        m_input_node_size  = 0;
+        m_output_node_size = 0;
+        m_input_shape.clear();
+        m_output_shape.clear();
+        m_stages.clear();
+        m_ops.clear();
+        m_inputs.clear();
+        m_table_input_size.clear();
+        m_table.clear();
+        m_max_frame_size = 0;
+        m_buf_size       = 0;
+    }
+
+    // サイズ上限付きの配列読み込み (読み込み失敗・上限超過は false)
+    template<typename T>
+    static bool LoadVector(std::istream &is, std::vector<T> &vec, std::uint64_t max_size)
+    {
+        std::uint64_t size = 0;
+        is.read((char *)&size, sizeof(size));
+        if ( !is || size > max_size ) {
+            return false;
+        }
+        vec.resize((size_t)size);
+        if ( size > 0 ) {
+            is.read((char *)&vec[0], (std::streamsize)(size * sizeof(T)));
+        }
+        return (bool)is;
+    }
+
+    static bool ValidShape(indices_t const &shape)
+    {
+        if ( shape.empty() ) {
+            return false;
+        }
+        index_t size = 1;
+        for (auto len : shape) {
+            if ( len <= 0 || len > (1 << 24) ) {
+                return false;
+            }
+            size *= len;
+            if ( size > (1 << 24) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 読み込んだ段の構成の検査 (ノード番号・範囲・フレーム倍率を前段から順に確認する)
+    bool Validate(void) const
+    {
+        if ( !ValidShape(m_input_shape) || !ValidShape(m_output_shape) ) {
+            return false;
+        }
+        if ( m_table_input_size.size() != m_table.size() ) {
+            return false;
+        }
+        for (auto n : m_table_input_size) {
+            if ( n < 1 || n > MAX_LUT_INPUT ) {
+                return false;
+            }
+        }
+
+        index_t const op_size    = (index_t)m_ops.size();
+        index_t const input_size = (index_t)m_inputs.size();
+        index_t node_size = GetShapeSize(m_input_shape);
+        index_t frame_mul = 1;
+        for (auto const &stage : m_stages) {
+            if ( stage.node_size <= 0 || stage.node_size > (1 << 24) || stage.frame_mul != frame_mul ) {
+                return false;
+            }
+
+            switch ( stage.type ) {
+            case STAGE_LUT:
+            case STAGE_OR:
+                if ( stage.op_begin < 0 || stage.op_end > op_size || stage.op_end - stage.op_begin != stage.node_size ) {
+                    return false;
+                }
+                for (index_t op_index = stage.op_begin; op_index < stage.op_end; ++op_index) {
+                    Op const &op = m_ops[op_index];
+                    if ( op.input_size < 1 || op.input_begin < 0 || (index_t)op.input_begin + op.input_size > input_size ) {
+                        return false;
+                    }
+                    if ( stage.type == STAGE_LUT ) {
+                        if ( op.table < 0 || op.table >= (index_t)m_table.size() || op.input_size != m_table_input_size[op.table] ) {
+                            return false;
+                        }
+                    }
+                    else if ( op.input_size > MAX_OR_INPUT ) {
+                        return false;
+                    }
+                    for (int i = 0; i < op.input_size; ++i) {
+                        std::int32_t node = m_inputs[op.input_begin + i];
+                        if ( node < -1 || node >= node_size ) {
+                            return false;
+                        }
+                    }
+                }
+                break;
+
+            case STAGE_IM2COL:
+                {
+                    if ( stage.c_size <= 0 || stage.tap_size <= 0 || stage.pixel_size <= 0 || stage.input_pixel_size <= 0
+                            || stage.tap_size > (1 << 16) || stage.pixel_size > (1 << 24) ) {
+                        return false;
+                    }
+                    if ( (index_t)stage.c_size * stage.input_pixel_size != node_size
+                            || (index_t)stage.c_size * stage.tap_size != stage.node_size ) {
+                        return false;
+                    }
+                    index_t table_size = (index_t)stage.tap_size * stage.pixel_size;
+                    if ( stage.op_begin < 0 || stage.op_end > input_size || stage.op_end - stage.op_begin != table_size ) {
+                        return false;
+                    }
+                    for (index_t i = stage.op_begin; i < stage.op_end; ++i) {
+                        if ( m_inputs[i] < -1 || m_inputs[i] >= stage.input_pixel_size ) {
+                            return false;
+                        }
+                    }
+                    frame_mul *= stage.pixel_size;
+                    if ( frame_mul > (1 << 24) ) {
+                        return false;
+                    }
+                }
+                break;
+
+            case STAGE_COL2IM:
+                if ( stage.pixel_size <= 0 || frame_mul % stage.pixel_size != 0
+                        || stage.c_size != node_size || (index_t)stage.c_size * stage.pixel_size != stage.node_size ) {
+                    return false;
+                }
+                frame_mul /= stage.pixel_size;
+                break;
+
+            default:
+                return false;
+            }
+
+            node_size = stage.node_size;
+        }
+
+        return node_size == GetShapeSize(m_output_shape) && frame_mul == 1;
+    }
+
+    // 段を実行して最終段のバッファを返す
+    std::int32_t const *Execute(index_t frame_size)
+    {
+        int src = 0;
+        for (auto const &stage : m_stages) {
+            int dst = (src == 1) ? 2 : 1;
+            index_t in_frames = frame_size * stage.frame_mul;
+            switch ( stage.type ) {
+            case STAGE_LUT:    ExecuteLut(stage, m_buf[src], m_buf[dst], WordSize(in_frames));  break;
+            case STAGE_OR:     ExecuteOr(stage, m_buf[src], m_buf[dst], WordSize(in_frames));   break;
+            case STAGE_IM2COL: ExecuteIm2Col(stage, m_buf[src], m_buf[dst], in_frames);          break;
+            case STAGE_COL2IM: ExecuteCol2Im(stage, m_buf[src], m_buf[dst], in_frames);          break;
+            }
+            src = dst;
+        }
+
+        return m_buf[src];
+    }
+
+    void ExecuteLut(Stage const &stage, std::int32_t const *src_buf, std::int32_t *dst_buf, index_t words)
+    {
+        using LutKernel = void (*)(std::int32_t *, std::int32_t const * const [], std::uint32_t const [], index_t);
+        LutKernel const kernel[MAX_LUT_INPUT + 1] = {
+                nullptr,
+                BB_SIMD_KERNEL(BinaryLutN_ForwardBit<1>),
+                BB_SIMD_KERNEL(BinaryLutN_ForwardBit<2>),
+                BB_SIMD_KERNEL(BinaryLutN_ForwardBit<3>),
+                BB_SIMD_KERNEL(BinaryLutN_ForwardBit<4>),
+                BB_SIMD_KERNEL(BinaryLutN_ForwardBit<5>),
+                BB_SIMD_KERNEL(BinaryLutN_ForwardBit<6>),
+            };
+
+        #pragma omp parallel for
+        for (index_t op_index = stage.op_begin; op_index < stage.op_end; ++op_index) {
+            Op const &op = m_ops[op_index];
+
+            std::int32_t const *x_addr[MAX_LUT_INPUT];
+            for (int i = 0; i < op.input_size; ++i) {
+                std::int32_t node = m_inputs[op.input_begin + i];
+                x_addr[i] = (node < 0) ? m_zero : &src_buf[node * words];
+            }
+
+            std::uint64_t table = m_table[op.table];
+            std::uint32_t table_word[2] = { (std::uint32_t)table, (std::uint32_t)(table >> 32) };
+            kernel[op.input_size](&dst_buf[(op_index - stage.op_begin) * words], x_addr, table_word, words);
+        }
+    }
+
+    void ExecuteOr(Stage const &stage, std::int32_t const *src_buf, std::int32_t *dst_buf, index_t words)
+    {
+        auto kernel = BB_SIMD_KERNEL(MaxPooling_ForwardBit);
+
+        #pragma omp parallel for
+        for (index_t op_index = stage.op_begin; op_index < stage.op_end; ++op_index) {
+            Op const &op = m_ops[op_index];
+
+            std::int32_t const *x_addr[MAX_OR_INPUT];
+            for (int i = 0; i < op.input_size; ++i) {
+                std::int32_t node = m_inputs[op.input_begin + i];
+                x_addr[i] = (node < 0) ? m_zero : &src_buf[node * words];
+            }
+
+            kernel(&dst_buf[(op_index - stage.op_begin) * words], x_addr, op.input_size, words);
+        }
+    }
+
+    // 32x32 のビット行列の転置 (a[i] の bit j と a[j] の bit i を入れ替える)
+    //   入力は先頭 in_n 行(残りは 0)、出力は先頭 out_n 行だけを使う
+    //   小さい行列(フレーム数が少ない時)はビット単位で並べ替えた方が速い
+    static void BitTranspose32(std::uint32_t a[32], int in_n, int out_n)
+    {
+        if ( in_n * out_n <= 256 ) {
+            std::uint32_t b[32];
+            for (int i = 0; i < out_n; ++i) {
+                std::uint32_t v = 0;
+                for (int j = 0; j < in_n; ++j) {
+                    v |= ((a[j] >> i) & 1) << j;
+                }
+                b[i] = v;
+            }
+            for (int i = 0; i < out_n; ++i) {
+                a[i] = b[i];
+            }
+            return;
+        }
+
+        std::uint32_t m = 0x0000ffff;
+        for (int j = 16; j != 0; j >>= 1, m ^= (m << j)) {
+            for (int k = 0; k < 32; k = ((k | j) + 1) & ~j) {
+                std::uint32_t t = ((a[k] >> j) ^ a[k | j]) & m;
+                a[k]     ^= (t << j);
+                a[k | j] ^= t;
+            }
+        }
+    }
+
+    // ビット位置 bit から 32bit を取り出す (バッファ末尾には 1 ワードの余白がある)
+    static std::uint32_t LoadBits32(std::uint32_t const *addr, index_t bit)
+    {
+        index_t word  = bit / 32;
+        int     shift = (int)(bit % 32);
+        if ( shift == 0 ) {
+            return addr[word];
+        }
+        return (std::uint32_t)((((std::uint64_t)addr[word + 1] << 32) | addr[word]) >> shift);
+    }
+
+    // ビット位置 bit に 32bit を OR で書き込む (v に入れる範囲外のビットは 0 とする)
+    static void OrBits32(std::uint32_t *addr, index_t bit, std::uint32_t v)
+    {
+        std::uint64_t w = (std::uint64_t)v << (bit % 32);
+        addr[bit / 32] |= (std::uint32_t)w;
+        if ( (w >> 32) != 0 ) {
+            addr[bit / 32 + 1] |= (std::uint32_t)(w >> 32);
+        }
+    }
+
+    // 出力ノード(チャネル,フィルタ位置)毎に、フレーム×出力画素のビットを集める
+    // 32画素×32フレームのブロック単位で入力を読み、ビット行列の転置で並べ替える
+    void ExecuteIm2Col(Stage const &stage, std::int32_t const *src_buf, std::int32_t *dst_buf, index_t frame_size)
+    {
+        index_t const src_words  = WordSize(frame_size);
+        index_t const dst_words  = WordSize(frame_size * stage.pixel_size);
+        index_t const pixel_size = stage.pixel_size;
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < (index_t)stage.node_size; ++node) {
+            index_t c   = node / stage.tap_size;
+            index_t tap = node % stage.tap_size;
+            std::int32_t const  *offset = &m_inputs[stage.op_begin + tap * pixel_size];
+            std::uint32_t const *x_base = (std::uint32_t const *)&src_buf[c * stage.input_pixel_size * src_words];
+            std::uint32_t       *y_node = (std::uint32_t *)&dst_buf[node * dst_words];
+
+            memset(y_node, 0, dst_words * sizeof(std::uint32_t));
+            for (index_t pixel = 0; pixel < pixel_size; pixel += 32) {
+                int pixel_n = (int)std::min((index_t)32, pixel_size - pixel);
+                for (index_t frame = 0; frame < frame_size; frame += 32) {
+                    int frame_n = (int)std::min((index_t)32, frame_size - frame);
+
+                    std::uint32_t a[32];
+                    for (int i = 0; i < 32; ++i) {
+                        std::int32_t off = (i < pixel_n) ? offset[pixel + i] : -1;
+                        a[i] = (off >= 0) ? x_base[off * src_words + frame / 32] : 0;
+                    }
+                    BitTranspose32(a, pixel_n, frame_n);
+                    for (int i = 0; i < frame_n; ++i) {
+                        OrBits32(y_node, (frame + i) * pixel_size + pixel, a[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    // 出力ノード(チャネル,画素)毎に、入力の frame * pixel_size + pixel のビットを集める
+    // Im2Col と逆向きに、32フレーム×32画素のブロックを転置して書き出す
+    void ExecuteCol2Im(Stage const &stage, std::int32_t const *src_buf, std::int32_t *dst_buf, index_t frame_size)
+    {
+        index_t const out_frames  = frame_size / stage.pixel_size;
+        index_t const src_words   = WordSize(frame_size);
+        index_t const dst_words   = WordSize(out_frames);
+        index_t const pixel_size  = stage.pixel_size;
+        index_t const pixel_block = (pixel_size + 31) / 32;
+
+        #pragma omp parallel for
+        for (index_t block = 0; block < stage.c_size * pixel_block; ++block) {
+            index_t c     = block / pixel_block;
+            index_t pixel = block % pixel_block * 32;
+            int     pixel_n = (int)std::min((index_t)32, pixel_size - pixel);
+            std::uint32_t const *x_node = (std::uint32_t const *)&src_buf[c * src_words];
+            std::uint32_t       *y_base = (std::uint32_t *)&dst_buf[(c * pixel_size + pixel) * dst_words];
+
+            for (index_t frame = 0; frame < out_frames; frame += 32) {
+                int frame_n = (int)std::min((index_t)32, out_frames - frame);
+
+                std::uint32_t a[32];
+                for (int i = 0; i < 32; ++i) {
+                    a[i] = (i < frame_n) ? LoadBits32(x_node, (frame + i) * pixel_size + pixel) : 0;
+                }
+                BitTranspose32(a, frame_n, pixel_n);
+                for (int i = 0; i < pixel_n; ++i) {
+                    y_base[i * dst_words + frame / 32] = a[i];
+                }
+            }
+        }
+    }
+
+    Stage NewStage(int type, index_t node_size, index_t frame_mul)
+    {
+        Stage stage = {};
+        stage.type      = type;
+        stage.op_begin  = (std::int32_t)m_ops.size();
+        stage.op_end    = stage.op_begin;
+        stage.node_size = (std::int32_t)node_size;
+        stage.frame_mul = (std::int32_t)frame_mul;
+        return stage;
+    }
+
+    /**
+     * @brief  層の変換
+     * @param  node_size  入力ノード数 (変換後は出力ノード数)
+     * @param  frame_mul  入力フレーム数の倍率 (畳み込みの内部では出力画素数倍)
+     */
+    bool CompileLayer(std::shared_ptr<Model> model, index_t &node_size, index_t &frame_mul,
+                        std::map< std::pair<int, std::uint64_t>, int > &table_map)
+    {
+        if ( auto seq = std::dynamic_pointer_cast<Sequential>(model) ) {
+            for (int i = 0; i < seq->GetSize(); ++i) {
+                if ( !CompileLayer(seq->Get(i), node_size, frame_mul, table_map) ) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        if ( CompileLut<6>(model, node_size, frame_mul, table_map) ) { return true; }
+        if ( CompileLut<5>(model, node_size, frame_mul, table_map) ) { return true; }
+        if ( CompileLut<4>(model, node_size, frame_mul, table_map) ) { return true; }
+        if ( CompileLut<3>(model, node_size, frame_mul, table_map) ) { return true; }
+        if ( CompileLut<2>(model, node_size, frame_mul, table_map) ) { return true; }
+        if ( CompileLut<1>(model, node_size, frame_mul, table_map) ) { return true; }
+
+        if ( auto pool = std::dynamic_pointer_cast< MaxPooling<Bit, float> >(model) ) {
+            CompileMaxPooling(pool, node_size, frame_mul);
+            return true;
+        }
+
+        if ( auto cnv = std::dynamic_pointer_cast< LoweringConvolution<Bit, float> >(model) ) {
+            return CompileConvolution(cnv, node_size, frame_mul, table_map);
+        }
+
+        return false;   // 未対応の層
+    }
+
+    template <int N>
+    bool CompileLut(std::shared_ptr<Model> model, index_t &node_size, index_t &frame_mul,
+                        std::map< std::pair<int, std::uint64_t>, int > &table_map)
+    {
+        auto lut = std::dynamic_pointer_cast< BinaryLutN<N, Bit, float> >(model);
+        if ( !lut ) {
+            return false;
+        }
+
+        BB_ASSERT(GetShapeSize(lut->GetInputShape()) == node_size);
+        index_t output_node_size = GetShapeSize(lut->GetOutputShape());
+
+        Stage stage = NewStage(STAGE_LUT, output_node_size, frame_mul);
+        for (index_t node = 0; node < output_node_size; ++node) {
+            // 同じテーブルのノードはテーブルを共有する
+            std::uint64_t table = 0;
+            for (int i = 0; i < (1 << N); ++i) {
+                table |= (std::uint64_t)(lut->GetLutTable(node, i) ? 1 : 0) << i;
+            }
+            auto key = std::make_pair(N, table);
+            auto it  = table_map.find(key);
+            if ( it == table_map.end() ) {
+                it = table_map.insert(std::make_pair(key, (int)m_table.size())).first;
+                m_table_input_size.push_back(N);
+                m_table.push_back(table);
+            }
+
+            Op op;
+            op.table       = it->second;
+            op.input_begin = (std::int32_t)m_inputs.size();
+            op.input_size  = N;
+            for (int i = 0; i < N; ++i) {
+                m_inputs.push_back((std::int32_t)lut->GetNodeInput(node, i));
+            }
+            m_ops.push_back(op);
+        }
+        stage.op_end = (std::int32_t)m_ops.size();
+        m_stages.push_back(stage);
+
+        node_size = output_node_size;
+        return true;
+    }
+
+    void CompileMaxPooling(std::shared_ptr< MaxPooling<Bit, float> > pool, index_t &node_size, index_t &frame_mul)
+    {
+        indices_t in_shape  = pool->GetInputShape();
+        indices_t out_shape = pool->GetOutputShape();
+        index_t   in_w  = in_shape[0],  in_h  = in_shape[1],  c_size = in_shape[2];
+        index_t   out_w = out_shape[0], out_h = out_shape[1];
+        index_t   filter_h = pool->GetFilterHeight();
+        index_t   filter_w = pool->GetFilterWidth();
+        BB_ASSERT(GetShapeSize(in_shape) == node_size);
+        BB_ASSERT(filter_h * filter_w <= MAX_OR_INPUT);
+
+        Stage stage = NewStage(STAGE_OR, GetShapeSize(out_shape), frame_mul);
+        for (index_t c = 0; c < c_size; ++c) {
+            for (index_t y = 0; y < out_h; ++y) {
+                for (index_t x = 0; x < out_w; ++x) {
+                    Op op;
+                    op.table       = -1;
+                    op.input_begin = (std::int32_t)m_inputs.size();
+                    for (index_t fy = 0; fy < filter_h; ++fy) {
+                        for (index_t fx = 0; fx < filter_w; ++fx) {
+                            index_t iy = y * filter_h + fy;
+                            index_t ix = x * filter_w + fx;
+                            if ( iy < in_h && ix < in_w ) {
+                                m_inputs.push_back((std::int32_t)((c * in_h + iy) * in_w + ix));
+                            }
+                        }
+                    }
+                    op.input_size = (std::int32_t)(m_inputs.size() - op.input_begin);
+                    m_ops.push_back(op);
+                }
+            }
+        }
+        stage.op_end = (std::int32_t)m_ops.size();
+        m_stages.push_back(stage);
+
+        node_size = GetShapeSize(out_shape);
+    }
+
+    bool CompileConvolution(std::shared_ptr< LoweringConvolution<Bit, float> > cnv, index_t &node_size, index_t &frame_mul,
+                        std::map< std::pair<int, std::uint64_t>, int > &table_map)
+    {
+        indices_t in_shape  = cnv->GetInputShape();
+        indices_t out_shape = cnv->GetOutputShape();
+        index_t   in_w  = in_shape[0],  in_h  = in_shape[1],  in_c  = in_shape[2];
+        index_t   out_w = out_shape[0], out_h = out_shape[1], out_c = out_shape[2];
+        index_t   filter_h   = cnv->GetFilterHeight();
+        index_t   filter_w   = cnv->GetFilterWidth();
+        index_t   tap_size   = filter_h * filter_w;
+        index_t   pixel_size = out_h * out_w;
+        BB_ASSERT(GetShapeSize(in_shape) == node_size);
+
+        // im2col: フィルタ位置毎の 出力画素 -> 入力画素 の変換テーブル (範囲外は -1)
+        Stage im2col = NewStage(STAGE_IM2COL, in_c * tap_size, frame_mul);
+        im2col.op_begin         = (std::int32_t)m_inputs.size();
+        im2col.c_size           = (std::int32_t)in_c;
+        im2col.tap_size         = (std::int32_t)tap_size;
+        im2col.pixel_size       = (std::int32_t)pixel_size;
+        im2col.input_pixel_size = (std::int32_t)(in_h * in_w);
+        for (index_t fy = 0; fy < filter_h; ++fy) {
+            for (index_t fx = 0; fx < filter_w; ++fx) {
+                for (index_t oy = 0; oy < out_h; ++oy) {
+                    for (index_t ox = 0; ox < out_w; ++ox) {
+                        index_t iy = oy * cnv->GetStrideHeight() - cnv->GetPaddingHeight() + fy * cnv->GetDilationHeight();
+                        index_t ix = ox * cnv->GetStrideWidth()  - cnv->GetPaddingWidth()  + fx * cnv->GetDilationWidth();
+                        bool    valid = (iy >= 0 && iy < in_h && ix >= 0 && ix < in_w);
+                        m_inputs.push_back(valid ? (std::int32_t)(iy * in_w + ix) : -1);
+                    }
+                }
+            }
+        }
+        im2col.op_end = (std::int32_t)m_inputs.size();
+        m_stages.push_back(im2col);
+
+        node_size  = in_c * tap_size;
+        frame_mul *= pixel_size;
+        if ( !CompileLayer(cnv->GetLayer(), node_size, frame_mul, table_map) ) {
+            return false;
+        }
+        BB_ASSERT(node_size == out_c);
+
+        Stage col2im = NewStage(STAGE_COL2IM, out_c * pixel_size, frame_mul);
+        col2im.c_size     = (std::int32_t)out_c;
+        col2im.pixel_size = (std::int32_t)pixel_size;
+        m_stages.push_back(col2im);
+
+        node_size  = out_c * pixel_size;
+        frame_mul /= pixel_size;
+        return true;
+    }
+};
+
+}
+
+
+// end of file
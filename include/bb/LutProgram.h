@@ -0,0 +1,483 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <utility>
+#include <limits>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+
+
+namespace bb {
+
+
+/**
+ * @brief  LUTのビットスライス演算プログラム(推論用)
+ * @detail 6入力以下のLUTの真理値表を、bit-packed なフレームデータに対する
+ *         論理演算列に変換して評価する
+ *         Shannon展開(共有付きのマルチプレクサ木)と、積和形(Quine-McCluskey)の
+ *         両方を生成し、実行するISAでの演算数が少ない方をノード毎に採用する
+ *         AVX2 では BinaryLutN_ForwardBit (mux木) より遅いことが多いので、
+ *         BinaryLutN の host_program は既定で無効にしている
+ */
+class LutProgram
+{
+public:
+    enum {
+        OP_ZERO,        // d = 0
+        OP_ONE,         // d = ~0
+        OP_NOT,         // d = ~a
+        OP_AND,         // d = a & b
+        OP_ANDN,        // d = ~a & b
+        OP_OR,          // d = a | b
+        OP_ORN,         // d = ~a | b
+        OP_MUX,         // d = a ? c : b
+    };
+
+    struct Code
+    {
+        std::uint8_t    op;
+        std::uint8_t    dst;
+        std::uint8_t    a;
+        std::uint8_t    b;
+        std::uint8_t    c;
+    };
+
+    static int const    MAX_INPUT = 6;
+    static int const    MAX_REGS  = 128;
+    static int const    BLOCK     = 16;     // 1命令あたりに処理するSIMDレジスタ数
+
+protected:
+    int                 m_input_size = 0;
+    int                 m_reg_size   = 0;
+    int                 m_out        = 0;
+    bool                m_overflow   = false;   // レジスタ不足(この形式では生成できない)
+    std::vector<Code>   m_code;
+
+public:
+    LutProgram() {}
+
+    int  GetInputSize(void) const { return m_input_size; }
+    int  GetCodeSize(void)  const { return (int)m_code.size(); }
+    int  GetRegSize(void)   const { return m_reg_size; }
+    bool IsValid(void)      const { return !m_overflow; }
+
+    // 実行コスト(SIMD命令数)の見積り
+    int GetCost(bool ternlog) const
+    {
+        if ( m_overflow ) {
+            return std::numeric_limits<int>::max();
+        }
+
+        int cost = 0;
+        for ( auto const &code : m_code ) {
+            cost += OpCost(code.op, ternlog);
+        }
+        return cost;
+    }
+
+    static int OpCost(int op, bool ternlog)
+    {
+        switch ( op ) {
+        case OP_ORN:  return ternlog ? 1 : 2;
+        case OP_MUX:  return ternlog ? 1 : 3;
+        default:      return 1;
+        }
+    }
+
+
+    /**
+     * @brief  真理値表からプログラム生成
+     * @detail Shannon展開と積和形のうち ternlog(AVX-512 VPTERNLOG) 有無で
+     *         見積ったコストの小さい方を返す
+     * @param  input_size 入力数(6以下)
+     * @param  table      真理値表(bit i が入力パターン i の出力)
+     * @param  ternlog    VPTERNLOG を使う前提でコストを見積るか
+     */
+    static LutProgram Compile(int input_size, std::uint64_t table, bool ternlog)
+    {
+        auto prog_mux = CompileShannon(input_size, table);
+        auto prog_sop = CompileSop(input_size, table);
+        return (prog_sop.GetCost(ternlog) < prog_mux.GetCost(ternlog)) ? prog_sop : prog_mux;
+    }
+
+    // Shannon展開によるマルチプレクサ木(同一部分関数は共有)
+    static LutProgram CompileShannon(int input_size, std::uint64_t table)
+    {
+        BB_ASSERT(input_size >= 0 && input_size <= MAX_INPUT);
+
+        LutProgram prog;
+        prog.Init(input_size);
+
+        std::map< std::pair<std::uint64_t, int>, int > memo;
+        prog.m_out = prog.BuildShannon(table & TableMask(input_size), input_size, memo);
+        return prog;
+    }
+
+    // 積和形(f と ~f の両方を簡単化して小さい方)
+    static LutProgram CompileSop(int input_size, std::uint64_t table)
+    {
+        BB_ASSERT(input_size >= 0 && input_size <= MAX_INPUT);
+
+        std::uint64_t mask = TableMask(input_size);
+
+        LutProgram prog_pos;
+        prog_pos.Init(input_size);
+        prog_pos.m_out = prog_pos.BuildSop(table & mask);
+
+        LutProgram prog_neg;
+        prog_neg.Init(input_size);
+        prog_neg.m_out = prog_neg.Emit(OP_NOT, prog_neg.BuildSop(~table & mask));
+
+        return (prog_neg.GetCost(false) < prog_pos.GetCost(false)) ? prog_neg : prog_pos;
+    }
+
+
+    // スカラ評価(検証用)
+    bool Evaluate(int index) const
+    {
+        std::uint64_t reg[MAX_REGS];
+        for ( int i = 0; i < m_input_size; ++i ) {
+            reg[i] = ((index >> i) & 1) ? ~(std::uint64_t)0 : 0;
+        }
+        for ( auto const &code : m_code ) {
+            reg[code.dst] = ScalarOp(code, reg);
+        }
+        return (reg[m_out] & 1) != 0;
+    }
+
+
+    /**
+     * @brief  AVX2 での実行
+     * @param  x_addr     入力 i の先頭アドレス
+     * @param  y_addr     出力の先頭アドレス
+     * @param  unit_size  __m256i 単位のサイズ
+     */
+    BB_TARGET_AVX2
+    void ExecuteAvx2(__m256i const * const x_addr[], __m256i *y_addr, index_t unit_size) const
+    {
+        __m256i reg[MAX_REGS][BLOCK];
+        __m256i const ones = _mm256_set1_epi8(-1);
+
+        for ( index_t base = 0; base < unit_size; base += BLOCK ) {
+            int n = (int)std::min((index_t)BLOCK, unit_size - base);
+
+            for ( int i = 0; i < m_input_size; ++i ) {
+                for ( int j = 0; j < n; ++j ) {
+                    reg[i][j] = _mm256_load_si256(&x_addr[i][base + j]);
+                }
+            }
+
+            for ( auto const &code : m_code ) {
+                __m256i *d = reg[code.dst];
+                __m256i *a = reg[code.a];
+                __m256i *b = reg[code.b];
+                __m256i *c = reg[code.c];
+                switch ( code.op ) {
+                case OP_ZERO: for ( int j = 0; j < n; ++j ) { d[j] = _mm256_setzero_si256(); }                                   break;
+                case OP_ONE:  for ( int j = 0; j < n; ++j ) { d[j] = ones; }                                                     break;
+                case OP_NOT:  for ( int j = 0; j < n; ++j ) { d[j] = _mm256_xor_si256(a[j], ones); }                             break;
+                case OP_AND:  for ( int j = 0; j < n; ++j ) { d[j] = _mm256_and_si256(a[j], b[j]); }                             break;
+                case OP_ANDN: for ( int j = 0; j < n; ++j ) { d[j] = _mm256_andnot_si256(a[j], b[j]); }                          break;
+                case OP_OR:   for ( int j = 0; j < n; ++j ) { d[j] = _mm256_or_si256(a[j], b[j]); }                              break;
+                case OP_ORN:  for ( int j = 0; j < n; ++j ) { d[j] = _mm256_or_si256(_mm256_xor_si256(a[j], ones), b[j]); }      break;
+                case OP_MUX:  for ( int j = 0; j < n; ++j ) { d[j] = _mm256_xor_si256(b[j], _mm256_and_si256(a[j], _mm256_xor_si256(b[j], c[j]))); } break;
+                }
+            }
+
+            for ( int j = 0; j < n; ++j ) {
+                _mm256_store_si256(&y_addr[base + j], reg[m_out][j]);
+            }
+        }
+    }
+
+    /**
+     * @brief  AVX-512 での実行 (OP_ORN, OP_NOT, OP_MUX は VPTERNLOG 1命令)
+     * @param  x_addr     入力 i の先頭アドレス
+     * @param  y_addr     出力の先頭アドレス
+     * @param  unit_size  __m256i 単位のサイズ(端数は 256bit マスクで処理)
+     */
+    BB_TARGET_AVX512F
+    void ExecuteAvx512(__m256i const * const x_addr[], __m256i *y_addr, index_t unit_size) const
+    {
+        __m512i reg[MAX_REGS][BLOCK];
+
+        index_t unit512_size = (unit_size + 1) / 2;
+        for ( index_t base = 0; base < unit512_size; base += BLOCK ) {
+            int n = (int)std::min((index_t)BLOCK, unit512_size - base);
+
+            for ( int i = 0; i < m_input_size; ++i ) {
+                for ( int j = 0; j < n; ++j ) {
+                    index_t   unit = (base + j) * 2;
+                    __mmask8  mask = (unit + 1 < unit_size) ? (__mmask8)0xff : (__mmask8)0x0f;
+                    reg[i][j] = _mm512_maskz_loadu_epi64(mask, &x_addr[i][unit]);
+                }
+            }
+
+            for ( auto const &code : m_code ) {
+                __m512i *d = reg[code.dst];
+                __m512i *a = reg[code.a];
+                __m512i *b = reg[code.b];
+                __m512i *c = reg[code.c];
+                switch ( code.op ) {
+                case OP_ZERO: for ( int j = 0; j < n; ++j ) { d[j] = _mm512_setzero_si512(); }                              break;
+                case OP_ONE:  for ( int j = 0; j < n; ++j ) { d[j] = _mm512_set1_epi64(-1); }                                break;
+                case OP_NOT:  for ( int j = 0; j < n; ++j ) { d[j] = _mm512_ternarylogic_epi64(a[j], a[j], a[j], 0x0f); }    break;
+                case OP_AND:  for ( int j = 0; j < n; ++j ) { d[j] = _mm512_and_si512(a[j], b[j]); }                         break;
+                case OP_ANDN: for ( int j = 0; j < n; ++j ) { d[j] = _mm512_andnot_si512(a[j], b[j]); }                      break;
+                case OP_OR:   for ( int j = 0; j < n; ++j ) { d[j] = _mm512_or_si512(a[j], b[j]); }                          break;
+                case OP_ORN:  for ( int j = 0; j < n; ++j ) { d[j] = _mm512_ternarylogic_epi64(a[j], b[j], b[j], 0xcf); }    break;
+                case OP_MUX:  for ( int j = 0; j < n; ++j ) { d[j] = _mm512_ternarylogic_epi64(a[j], b[j], c[j], 0xac); }    break;
+                }
+            }
+
+            for ( int j = 0; j < n; ++j ) {
+                index_t   unit = (base + j) * 2;
+                __mmask8  mask = (unit + 1 < unit_size) ? (__mmask8)0xff : (__mmask8)0x0f;
+                _mm512_mask_storeu_epi64(&y_addr[unit], mask, reg[m_out][j]);
+            }
+        }
+    }
+
+
+protected:
+    static std::uint64_t TableMask(int input_size)
+    {
+        return (input_size >= 6) ? ~(std::uint64_t)0 : (((std::uint64_t)1 << (1 << input_size)) - 1);
+    }
+
+    static std::uint64_t ScalarOp(Code const &code, std::uint64_t const reg[])
+    {
+        std::uint64_t a = reg[code.a];
+        std::uint64_t b = reg[code.b];
+        std::uint64_t c = reg[code.c];
+        switch ( code.op ) {
+        case OP_ZERO: return 0;
+        case OP_ONE:  return ~(std::uint64_t)0;
+        case OP_NOT:  return ~a;
+        case OP_AND:  return a & b;
+        case OP_ANDN: return ~a & b;
+        case OP_OR:   return a | b;
+        case OP_ORN:  return ~a | b;
+        case OP_MUX:  return (a & c) | (~a & b);
+        }
+        return 0;
+    }
+
+    void Init(int input_size)
+    {
+        m_input_size = input_size;
+        m_reg_size   = input_size;
+        m_out        = 0;
+        m_code.clear();
+    }
+
+    int Emit(int op, int a = 0, int b = 0, int c = 0)
+    {
+        // パリティ関数の積和形などはレジスタに収まらないので不採用とする
+        if ( m_overflow || m_reg_size >= MAX_REGS ) {
+            m_overflow = true;
+            return 0;
+        }
+
+        Code code;
+        code.op  = (std::uint8_t)op;
+        code.dst = (std::uint8_t)m_reg_size;
+        code.a   = (std::uint8_t)a;
+        code.b   = (std::uint8_t)b;
+        code.c   = (std::uint8_t)c;
+        m_code.push_back(code);
+        return m_reg_size++;
+    }
+
+    // table は下位 (1 << k) bit が有効な k 入力関数
+    int BuildShannon(std::uint64_t table, int k, std::map< std::pair<std::uint64_t, int>, int > &memo)
+    {
+        // 最上位の入力に依存しない間は次数を落とす
+        while ( k > 0 ) {
+            int           half = 1 << (k - 1);
+            std::uint64_t lo   = table & TableMask(k - 1);
+            std::uint64_t hi   = (table >> half) & TableMask(k - 1);
+            if ( lo != hi ) {
+                break;
+            }
+            table = lo;
+            --k;
+        }
+
+        auto key = std::make_pair(table, k);
+        auto it  = memo.find(key);
+        if ( it != memo.end() ) {
+            return it->second;
+        }
+
+        int reg;
+        if ( k == 0 ) {
+            reg = Emit((table & 1) ? OP_ONE : OP_ZERO);
+        }
+        else {
+            int           half = 1 << (k - 1);
+            std::uint64_t full = TableMask(k - 1);
+            std::uint64_t lo   = table & full;
+            std::uint64_t hi   = (table >> half) & full;
+            int           x    = k - 1;
+
+            if ( lo == 0 && hi == full ) {
+                reg = x;
+            }
+            else if ( lo == full && hi == 0 ) {
+                reg = Emit(OP_NOT, x);
+            }
+            else if ( lo == 0 ) {
+                reg = Emit(OP_AND, x, BuildShannon(hi, k - 1, memo));
+            }
+            else if ( hi == 0 ) {
+                reg = Emit(OP_ANDN, x, BuildShannon(lo, k - 1, memo));
+            }
+            else if ( hi == full ) {
+                reg = Emit(OP_OR, x, BuildShannon(lo, k - 1, memo));
+            }
+            else if ( lo == full ) {
+                reg = Emit(OP_ORN, x, BuildShannon(hi, k - 1, memo));
+            }
+            else {
+                int f0 = BuildShannon(lo, k - 1, memo);
+                int f1 = BuildShannon(hi, k - 1, memo);
+                reg = Emit(OP_MUX, x, f0, f1);
+            }
+        }
+
+        memo[key] = reg;
+        return reg;
+    }
+
+    // Quine-McCluskey で主項を求め、貪欲法で被覆して積和形を生成
+    int BuildSop(std::uint64_t table)
+    {
+        int const     n    = m_input_size;
+        int const     size = 1 << n;
+        std::uint64_t full = TableMask(n);
+
+        if ( table == 0 )    { return Emit(OP_ZERO); }
+        if ( table == full ) { return Emit(OP_ONE); }
+
+        // 項は (value, dont_care) で表現
+        typedef std::pair<int, int> term_t;
+
+        std::vector<term_t> primes;
+        std::vector<term_t> current;
+        for ( int i = 0; i < size; ++i ) {
+            if ( (table >> i) & 1 ) {
+                current.push_back(term_t(i, 0));
+            }
+        }
+
+        while ( !current.empty() ) {
+            std::vector<term_t> next;
+            std::vector<bool>   used(current.size(), false);
+            for ( size_t i = 0; i < current.size(); ++i ) {
+                for ( size_t j = i + 1; j < current.size(); ++j ) {
+                    if ( current[i].second != current[j].second ) { continue; }
+                    int diff = current[i].first ^ current[j].first;
+                    if ( diff == 0 || (diff & (diff - 1)) != 0 ) { continue; }
+                    term_t t(current[i].first & ~diff, current[i].second | diff);
+                    if ( std::find(next.begin(), next.end(), t) == next.end() ) {
+                        next.push_back(t);
+                    }
+                    used[i] = true;
+                    used[j] = true;
+                }
+            }
+            for ( size_t i = 0; i < current.size(); ++i ) {
+                if ( !used[i] ) {
+                    primes.push_back(current[i]);
+                }
+            }
+            current.swap(next);
+        }
+
+        // 被覆
+        std::vector<std::uint64_t> cover(primes.size(), 0);
+        for ( size_t p = 0; p < primes.size(); ++p ) {
+            for ( int i = 0; i < size; ++i ) {
+                if ( (i & ~primes[p].second) == primes[p].first ) {
+                    cover[p] |= ((std::uint64_t)1 << i);
+                }
+            }
+        }
+
+        std::vector<term_t> terms;
+        std::uint64_t       remain = table;
+        while ( remain != 0 ) {
+            int best       = -1;
+            int best_count = 0;
+            int best_dc    = -1;
+            for ( size_t p = 0; p < primes.size(); ++p ) {
+                int count = PopCount(cover[p] & remain);
+                int dc    = PopCount((std::uint64_t)primes[p].second);
+                if ( count > best_count || (count == best_count && count > 0 && dc > best_dc) ) {
+                    best       = (int)p;
+                    best_count = count;
+                    best_dc    = dc;
+                }
+            }
+            BB_ASSERT(best >= 0);
+            terms.push_back(primes[best]);
+            remain &= ~cover[best];
+        }
+
+        // 命令生成 (否定リテラルは ANDN で取り込む)
+        std::vector<int> not_reg(n, -1);
+        int sum = -1;
+        for ( auto const &t : terms ) {
+            int prod = -1;
+            for ( int i = 0; i < n; ++i ) {
+                if ( ((t.second >> i) & 1) == 0 && ((t.first >> i) & 1) != 0 ) {
+                    prod = (prod < 0) ? i : Emit(OP_AND, prod, i);
+                }
+            }
+            for ( int i = 0; i < n; ++i ) {
+                if ( ((t.second >> i) & 1) == 0 && ((t.first >> i) & 1) == 0 ) {
+                    if ( prod < 0 ) {
+                        if ( not_reg[i] < 0 ) {
+                            not_reg[i] = Emit(OP_NOT, i);
+                        }
+                        prod = not_reg[i];
+                    }
+                    else {
+                        prod = Emit(OP_ANDN, i, prod);
+                    }
+                }
+            }
+            sum = (sum < 0) ? prod : Emit(OP_OR, sum, prod);
+        }
+
+        return sum;
+    }
+
+    static int PopCount(std::uint64_t x)
+    {
+        int count = 0;
+        while ( x ) {
+            x &= x - 1;
+            ++count;
+        }
+        return count;
+    }
+};
+
+
+}
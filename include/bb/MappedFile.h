@@ -0,0 +1,149 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <string>
+#include <memory>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace bb {
+
+
+// 読み出し専用のメモリマップドファイル
+class MappedFile
+{
+protected:
+    void const  *m_addr = nullptr;
+    size_t      m_size  = 0;
+
+#ifdef _WIN32
+    HANDLE      m_file    = INVALID_HANDLE_VALUE;
+    HANDLE      m_mapping = NULL;
+#endif
+
+protected:
+    MappedFile() {}
+
+public:
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    /**
+     * @brief  ファイルをマップする
+     * @param  filename  ファイル名
+     * @return 失敗時は nullptr
+     */
+    static std::shared_ptr<MappedFile> Open(std::string filename)
+    {
+        auto self = std::shared_ptr<MappedFile>(new MappedFile);
+        if ( !self->Map(filename) ) {
+            return nullptr;
+        }
+        return self;
+    }
+
+    void const *GetAddr(void) const { return m_addr; }
+    size_t      GetSize(void) const { return m_size; }
+
+protected:
+#ifdef _WIN32
+    bool Map(std::string filename)
+    {
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if ( m_file == INVALID_HANDLE_VALUE ) {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if ( !GetFileSizeEx(m_file, &size) ) {
+            return false;
+        }
+        m_size = (size_t)size.QuadPart;
+        if ( m_size == 0 ) {
+            return true;
+        }
+
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if ( m_mapping == NULL ) {
+            return false;
+        }
+
+        m_addr = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        return (m_addr != nullptr);
+    }
+
+    void Close(void)
+    {
+        if ( m_addr != nullptr )                { UnmapViewOfFile(m_addr); m_addr = nullptr; }
+        if ( m_mapping != NULL )                { CloseHandle(m_mapping);  m_mapping = NULL; }
+        if ( m_file != INVALID_HANDLE_VALUE )   { CloseHandle(m_file);     m_file = INVALID_HANDLE_VALUE; }
+    }
+#else
+    bool Map(std::string filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if ( fd < 0 ) {
+            return false;
+        }
+
+        struct stat st;
+        if ( fstat(fd, &st) != 0 ) {
+            close(fd);
+            return false;
+        }
+        m_size = (size_t)st.st_size;
+        if ( m_size == 0 ) {
+            close(fd);
+            return true;
+        }
+
+        void *addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);  // マップ後はディスクリプタ不要
+        if ( addr == MAP_FAILED ) {
+            return false;
+        }
+        m_addr = addr;
+        return true;
+    }
+
+    void Close(void)
+    {
+        if ( m_addr != nullptr ) {
+            munmap(const_cast<void *>(m_addr), m_size);
+            m_addr = nullptr;
+        }
+    }
+#endif
+};
+
+
+}
+
+
+// end of file
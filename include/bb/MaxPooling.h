@@ -15,6 +15,7 @@
 #include <random>
 
 #include "bb/Filter2d.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
@@ -195,31 +196,28 @@ public:
             auto x_ptr = m_x.LockConst<FT>();
             auto y_ptr = m_y.Lock<FT>(true);
 
-			index_t  m256_frame_size = (int)m_y.GetFrameStride() / 32;
+			index_t  word_size = m_y.GetFrameStride() / sizeof(std::int32_t);
+
+            auto kernel = BB_SIMD_KERNEL(MaxPooling_ForwardBit);
 
     		#pragma omp parallel for
 			for (index_t c = 0; c < m_input_c_size; ++c) {
+                std::vector<std::int32_t const *> x_addr((size_t)(m_filter_h_size * m_filter_w_size));
 				for (index_t y = 0; y < m_output_h_size; ++y) {
 					for (index_t x = 0; x < m_output_w_size; ++x) {
-						__m256i *y_addr = (__m256i *)y_ptr.GetAddr(GetOutputNode(c, y, x));
-
-						for (index_t frame = 0; frame < m256_frame_size; ++frame) {
-							__m256i	max_val = _mm256_set1_epi8(0);
-                            for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
-								index_t iy = y*m_filter_h_size + fy;
-                                if ( iy < m_input_h_size ) {
-								    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
-									    index_t ix = x*m_filter_w_size + fx;
-                                        if ( ix < m_input_w_size ) {
-									        __m256i const *x_addr = (__m256i const *)x_ptr.GetAddr(GetInputNode(c, iy, ix));
-									        __m256i in_sig = _mm256_load_si256(&x_addr[frame]);
-									        max_val = _mm256_or_si256(max_val, in_sig);
-                                        }
-								    }
-                                }
-							}
-							_mm256_store_si256(&y_addr[frame], max_val);
+                        int n = 0;
+                        for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
+							index_t iy = y*m_filter_h_size + fy;
+                            if ( iy < m_input_h_size ) {
+							    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
+								    index_t ix = x*m_filter_w_size + fx;
+                                    if ( ix < m_input_w_size ) {
+								        x_addr[n++] = (std::int32_t const *)x_ptr.GetAddr(GetInputNode(c, iy, ix));
+                                    }
+							    }
+                            }
 						}
+						kernel((std::int32_t *)y_ptr.GetAddr(GetOutputNode(c, y, x)), x_addr.data(), n, word_size);
 					}
 				}
 			}
@@ -232,31 +230,28 @@ public:
             auto x_ptr = m_x.LockConst<FT>();
             auto y_ptr = m_y.Lock<FT>(true);
 
-			index_t  m256_frame_size = (int)m_y.GetFrameStride() / sizeof(float);
+			index_t  frame_stride = m_y.GetFrameStride() / sizeof(float);
+
+            auto kernel = BB_SIMD_KERNEL(MaxPooling_ForwardFp32);
 
     		#pragma omp parallel for
 			for (index_t c = 0; c < m_input_c_size; ++c) {
+                std::vector<float const *> x_addr((size_t)(m_filter_h_size * m_filter_w_size));
 				for (index_t y = 0; y < m_output_h_size; ++y) {
 					for (index_t x = 0; x < m_output_w_size; ++x) {
-						float *y_addr = (float *)y_ptr.GetAddr(GetOutputNode(c, y, x));
-
-						for (index_t frame = 0; frame < m256_frame_size; frame += 8) {
-							__m256	max_val = _mm256_set1_ps(-1.0e7f);	// 前段に活性化入れるから0がminだよね？
-							for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
-								index_t iy = y*m_filter_h_size + fy;
-                                if ( iy < m_input_h_size ) {
-								    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
-									    index_t ix = x*m_filter_w_size + fx;
-                                        if ( ix < m_input_w_size ) {
-									        float const *x_addr = (float const *)x_ptr.GetAddr(GetInputNode(c, iy, ix));
-									        __m256 in_sig = _mm256_load_ps(&x_addr[frame]);
-									        max_val = _mm256_max_ps(max_val, in_sig);
-                                        }
-								    }
-                                }
-							}
-							_mm256_store_ps(&y_addr[frame], max_val);
+                        int n = 0;
+						for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
+							index_t iy = y*m_filter_h_size + fy;
+                            if ( iy < m_input_h_size ) {
+							    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
+								    index_t ix = x*m_filter_w_size + fx;
+                                    if ( ix < m_input_w_size ) {
+								        x_addr[n++] = (float const *)x_ptr.GetAddr(GetInputNode(c, iy, ix));
+                                    }
+							    }
+                            }
 						}
+						kernel((float *)y_ptr.GetAddr(GetOutputNode(c, y, x)), x_addr.data(), n, frame_stride);
 					}
 				}
 			}
@@ -336,40 +331,39 @@ public:
 
 		if ( DataType<BT>::type == BB_TYPE_FP32 && DataType<FT>::type == BB_TYPE_FP32 ) {
 			// float用実装
-			index_t  m256_frame_size = m_dx.GetFrameStride() / sizeof(float);
+			index_t  frame_stride = m_dx.GetFrameStride() / sizeof(float);
 
             auto x_ptr  = m_x.LockConst<FT>();
             auto y_ptr  = m_y.LockConst<FT>();
             auto dy_ptr = dy.LockConst<BT>();
             auto dx_ptr = m_dx.Lock<BT>(true);
 
+            auto kernel = BB_SIMD_KERNEL(MaxPooling_BackwardFp32);
+
 	#pragma omp parallel for
 			for (index_t n = 0; n < m_input_c_size; ++n) {
+                std::vector<float const *> x_addr((size_t)(m_filter_h_size * m_filter_w_size));
+                std::vector<float       *> dx_addr((size_t)(m_filter_h_size * m_filter_w_size));
 				for (index_t y = 0; y < m_output_h_size; ++y) {
 					for (index_t x = 0; x < m_output_w_size; ++x) {
 						float const * y_addr  = (float const *)y_ptr.GetAddr(GetOutputNode(n, y, x));
 						float const * dy_addr = (float const *)dy_ptr.GetAddr(GetOutputNode(n, y, x));
 
-						for (index_t frame = 0; frame < m256_frame_size; frame += 8) {
-							__m256 out_sig  = _mm256_load_ps(&y_addr[frame]);
-							__m256 out_grad = _mm256_load_ps(&dy_addr[frame]);
-							for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
-								index_t iy = y*m_filter_h_size + fy;
-                                if ( iy < m_input_h_size ) {
-								    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
-									    index_t ix = x*m_filter_w_size + fx;
-                                        if ( ix < m_input_w_size ) {
-									        float const *x_addr  = (float const *)x_ptr.GetAddr(GetInputNode(n, iy, ix));
-									        float       *dx_addr = (float       *)dx_ptr.GetAddr(GetInputNode(n, iy, ix));
-									        __m256 in_sig  = _mm256_load_ps(&x_addr[frame]);
-									        __m256 mask    = _mm256_cmp_ps(in_sig, out_sig, _CMP_EQ_OQ);
-									        __m256 in_grad = _mm256_and_ps(mask, out_grad);
-									        _mm256_store_ps(&dx_addr[frame], in_grad);
-                                        }
-								    }
+                        int k = 0;
+						for (index_t fy = 0; fy < m_filter_h_size; ++fy) {
+							index_t iy = y*m_filter_h_size + fy;
+                            if ( iy < m_input_h_size ) {
+							    for (index_t fx = 0; fx < m_filter_w_size; ++fx) {
+								    index_t ix = x*m_filter_w_size + fx;
+                                    if ( ix < m_input_w_size ) {
+								        x_addr[k]  = (float const *)x_ptr.GetAddr(GetInputNode(n, iy, ix));
+								        dx_addr[k] = (float       *)dx_ptr.GetAddr(GetInputNode(n, iy, ix));
+                                        ++k;
+                                    }
 							    }
-                            }
-						}
+						    }
+                        }
+                        kernel(dx_addr.data(), x_addr.data(), k, y_addr, dy_addr, frame_stride);
 					}
 				}
 			}
@@ -23,6 +23,9 @@
 #include "bb/DataType.h"
 #include "bb/Utility.h"
 #include "bb/CudaUtility.h"
+#include "bb/MemoryPool.h"
+#include "bb/MemoryPlanner.h"
+#include "bb/Profiler.h"
 
 
 namespace bb {
@@ -219,14 +222,22 @@ protected:
 	std::atomic<int>  	m_devRefCnt;
 #endif
 
+    // MemoryPlanner による割り当て情報
+    index_t                 m_plan_serial = -1;
+    index_t                 m_plan_index  = -1;
+    std::shared_ptr<void>   m_plan_arena;       // アリーナ上に割り当てられている間はアリーナを参照
+
+    // 外部メモリ(メモリマップしたファイルなど)を参照している間は所有者を保持する
+    std::shared_ptr<void>   m_external;
+
 #ifdef BB_WITH_CUDA
-    static void GetRef(Memory *self)       { BB_ASSERT(self->m_devRefCnt == 0);  self->m_hostRefCnt++; }
-    static void RelRef(Memory *self)       { BB_ASSERT(self->m_devRefCnt == 0);  self->m_hostRefCnt--; }
+    static void GetRef(Memory *self)       { BB_ASSERT(self->m_devRefCnt == 0);  self->m_hostRefCnt++; MemoryPlanner::Touch(self->m_plan_serial, self->m_plan_index); }
+    static void RelRef(Memory *self)       { BB_ASSERT(self->m_devRefCnt == 0);  self->m_hostRefCnt--; MemoryPlanner::Touch(self->m_plan_serial, self->m_plan_index); }
     static void GetRefDevice(Memory *self) { BB_ASSERT(self->m_hostRefCnt == 0); self->m_devRefCnt++; }
     static void RelRefDevice(Memory *self) { BB_ASSERT(self->m_hostRefCnt == 0); self->m_devRefCnt--; }
 #else
-    static void GetRef(Memory *self)       { self->m_hostRefCnt++; }
-    static void RelRef(Memory *self)       { self->m_hostRefCnt--; }
+    static void GetRef(Memory *self)       { self->m_hostRefCnt++; MemoryPlanner::Touch(self->m_plan_serial, self->m_plan_index); }
+    static void RelRef(Memory *self)       { self->m_hostRefCnt--; MemoryPlanner::Touch(self->m_plan_serial, self->m_plan_index); }
     static void GetRefDevice(Memory *self) {}
     static void RelRefDevice(Memory *self) {}
 #endif
@@ -259,6 +270,32 @@ public:
         return std::shared_ptr<Memory>(new Memory(size, hostOnly));
     }
 
+	/**
+     * @brief  外部メモリを参照するメモリオブジェクトの生成
+     * @detail 読み出しはコピー無しで addr を直接参照する(ホスト専用)
+     *         外部メモリは読み出し専用として扱い、書き込み用に Lock した時点で
+     *         自前の領域にコピーしてから書き込む
+     * @param addr  外部メモリのアドレス
+     * @param size  サイズ(バイト単位)
+     * @param owner 参照中に保持しておく外部メモリの所有者
+     * @return メモリオブジェクトへのshared_ptr
+     */
+	static std::shared_ptr<Memory> CreateExternal(void const *addr, size_t size, std::shared_ptr<void> owner)
+    {
+        auto self = std::shared_ptr<Memory>(new Memory(0, true));
+        self->ReleaseHost();
+        self->m_addr     = const_cast<void *>(addr);
+        self->m_size     = size;
+        self->m_external = owner;
+        return self;
+    }
+
+    //! 外部メモリを参照中か
+    bool IsExternal(void) const
+    {
+        return (bool)m_external;
+    }
+
 protected:
 	/**
      * @brief  コンストラクタ
@@ -296,14 +333,40 @@ protected:
 
 		// デバイスが使えなければここでホストメモリ確保
 		if ( !m_devAvailable ) {
-			m_addr = aligned_memory_alloc(m_size, 32);
+			m_addr = AllocateHost(m_size);
 		}
 #else
 		// メモリ確保
-		m_addr = aligned_memory_alloc(m_size, 32);
+		m_addr = AllocateHost(m_size);
 #endif
 	}
 
+    // ホストメモリの確保 (MemoryPlanner の区間内であれば計画に従い、それ以外は MemoryPool から確保)
+    void *AllocateHost(size_t size)
+    {
+        Profiler::CountAlloc(size);
+        void *addr = MemoryPlanner::Allocate(size, m_plan_serial, m_plan_index, m_plan_arena);
+        if ( addr != nullptr ) {
+            return addr;
+        }
+        return MemoryPool::Allocate(size);
+    }
+
+    // ホストメモリの開放 (アリーナ上や外部メモリであれば参照を外すだけ)
+    void ReleaseHost(void)
+    {
+        if ( m_external ) {
+            m_external.reset();
+        }
+        else if ( m_plan_arena ) {
+            m_plan_arena.reset();
+        }
+        else {
+            MemoryPool::Free(m_addr);
+        }
+        m_addr = nullptr;
+    }
+
 public:
 	/**
      * @brief  デストラクタ
@@ -331,16 +394,12 @@ public:
 		}
         else {
 			// メモリ開放
-			if (m_addr != nullptr) {
-				aligned_memory_free(m_addr);
-			}
+            ReleaseHost();
         }
 
 #else
 		// メモリ開放
-		if (m_addr != nullptr) {
-			aligned_memory_free(m_addr);
-		}
+        ReleaseHost();
 #endif
 	}
 
@@ -418,13 +477,13 @@ public:
         }
         else {
             // ホストメモリ再確保
-            aligned_memory_free(m_addr);
-            m_addr = aligned_memory_alloc(size, 32);
+            ReleaseHost();
+            m_addr = AllocateHost(size);
             m_hostModified = false;
         }
 #else
-        aligned_memory_free(m_addr);
-        m_addr = aligned_memory_alloc(size, 32);
+        ReleaseHost();
+        m_addr = AllocateHost(size);
         m_size = size;
         m_hostModified = false;
 #endif
@@ -526,6 +585,19 @@ public:
      */
 	Ptr Lock(bool new_buffer=false)
 	{
+        Profiler::CountHostLock();
+
+        // 外部メモリには書き込まず、自前の領域にコピーしてから書き込む
+        if ( m_external ) {
+            BB_DEBUG_ASSERT(m_hostRefCnt == 0);
+            void *addr = AllocateHost(m_size);
+            if ( !new_buffer ) {
+                memcpy(addr, m_addr, m_size);
+            }
+            m_external.reset();
+            m_addr = addr;
+        }
+
 #ifdef BB_WITH_CUDA
 		if ( m_devAvailable ) {
 			// 新規であれば過去の更新情報は破棄
@@ -538,12 +610,14 @@ public:
 				// ホスト側メモリ未確保ならここで確保
 				CudaDevicePush dev_push(m_device);
 				bbcu::MallocHost(&m_addr, m_mem_size);
+				Profiler::CountAlloc(m_mem_size);
 			}
 
 			if ( m_devModified ) {
 				// デバイス側メモリが最新ならコピー取得
 				CudaDevicePush dev_push(m_device);
 				bbcu::Memcpy(m_addr, m_devAddr, m_size, cudaMemcpyDeviceToHost);
+				Profiler::CountMemcpy(false, m_size);
 				m_devModified =false;
 			}
 		}
@@ -566,6 +640,7 @@ public:
 	ConstPtr LockConst(void) const
 	{
         auto self = const_cast<Memory *>(this);
+        Profiler::CountHostLock();
 
 #ifdef BB_WITH_CUDA
 		if ( m_devAvailable ) {
@@ -573,12 +648,14 @@ public:
 				// ホスト側メモリ未確保ならここで確保
 				CudaDevicePush dev_push(m_device);
 				bbcu::MallocHost(&self->m_addr, m_mem_size);
+				Profiler::CountAlloc(m_mem_size);
 			}
 
 			if ( m_devModified ) {
 				// デバイス側メモリが最新ならコピー取得
 				CudaDevicePush dev_push(m_device);
 				bbcu::Memcpy(m_addr, m_devAddr, m_size, cudaMemcpyDeviceToHost);
+				Profiler::CountMemcpy(false, m_size);
 				self->m_devModified = false;
 			}
 		}
@@ -597,6 +674,8 @@ public:
      */
 	DevPtr LockDevice(bool new_buffer=false)
 	{
+        Profiler::CountDeviceLock();
+
 	#ifdef BB_WITH_CUDA
 		if ( m_devAvailable ) {
 			// 新規であれば過去の更新情報は破棄
@@ -609,12 +688,14 @@ public:
 				// デバイス側メモリ未確保ならここで確保
 				CudaDevicePush dev_push(m_device);
 				bbcu::Malloc(&m_devAddr, m_size);
+				Profiler::CountAlloc(m_size);
 			}
 
 			if (m_hostModified) {
 				// ホスト側メモリが最新ならコピー取得
 				CudaDevicePush dev_push(m_device);
 				bbcu::Memcpy(m_devAddr, m_addr, m_size, cudaMemcpyHostToDevice);
+				Profiler::CountMemcpy(true, m_size);
 				m_hostModified =false;
 			}
 
@@ -640,6 +721,7 @@ public:
 	{
         // 便宜上constをはずす
         auto self = const_cast<Memory *>(this);
+        Profiler::CountDeviceLock();
 
 #ifdef BB_WITH_CUDA
 		if ( m_devAvailable ) {
@@ -647,12 +729,14 @@ public:
 				// デバイス側メモリ未確保ならここで確保
 				CudaDevicePush dev_push(m_device);
 				bbcu::Malloc(&self->m_devAddr, m_size);
+				Profiler::CountAlloc(m_size);
 			}
 
 			if (m_hostModified) {
 				// ホスト側メモリが最新ならコピー取得
 				CudaDevicePush dev_push(m_device);
 				bbcu::Memcpy(m_devAddr, m_addr, m_size, cudaMemcpyHostToDevice);
+				Profiler::CountMemcpy(true, m_size);
 				self->m_hostModified =false;
 			}
 
@@ -684,7 +768,7 @@ public:
 
         if (hostOnly) {
 		    // メモリ確保
-		    auto newAddr = aligned_memory_alloc(m_size, 32);
+		    auto newAddr = MemoryPool::Allocate(m_size);
             BB_ASSERT(m_addr != nullptr);
 
             // データがあればコピー
@@ -711,7 +795,17 @@ public:
             m_addr = newAddr;
         }
         else {
-		    if ( m_hostModified ) {
+            if ( m_external ) {
+                // 外部メモリは自前の領域にコピーしておく
+                void *newAddr;
+                bbcu::MallocHost(&newAddr, m_size);
+                m_mem_size = m_size;
+                memcpy(newAddr, m_addr, m_size);
+                ReleaseHost();
+                m_hostModified = true;
+                m_addr = newAddr;
+            }
+		    else if ( m_hostModified ) {
                 // メモリ確保
                 void *newAddr;
                 bbcu::MallocHost(&newAddr, m_size);
@@ -721,9 +815,7 @@ public:
                 memcpy(newAddr, m_addr, m_size);
 
                 // メモリ開放
-                if ( m_addr != nullptr ) {
-        		    aligned_memory_free(m_addr);
-                }
+                ReleaseHost();
 
                 m_hostModified = false;
 
@@ -0,0 +1,318 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "bb/DataType.h"
+#include "bb/Utility.h"
+
+
+namespace bb {
+
+
+//[MemoryPlanner クラス]
+//  ・学習1ステップ(Forward(train) ～ Backward) を1つの区間(window)として扱う
+//  ・区間内での Memory の確保を発生順の通し番号で識別する
+//  ・記録した区間で各確保の生存期間(確保 ～ 最後のLock/Unlock)を求め、
+//    生存期間の重ならない確保同士が同じ領域を使うよう1つのアリーナ上にオフセットを割り付ける
+//  ・以降の区間では確保要求を通し番号で照合し、一致すればアリーナ上の領域を返す
+//  ・確保の順番やサイズが記録と食い違った場合は通常確保に戻し、次の区間で記録しなおす
+//  ・ホストメモリのみが対象 (CUDAデバイスメモリは対象外)
+//
+// 区間は入れ子にならず、同時に有効な MemoryPlanner は1つだけとする
+// データの先行読み込みなど、区間と無関係に確保を行うスレッドは SetThreadEnable(false) で対象から外す
+
+class MemoryPlanner
+{
+protected:
+    enum {
+        STATE_WARMUP,   // 初回(遅延確保を済ませる)
+        STATE_RECORD,   // 生存期間の記録
+        STATE_REPLAY,   // 計画に従ってアリーナ上に割り当て
+    };
+
+    static index_t const ALIGN = 256;
+
+    struct Block
+    {
+        size_t  size   = 0;
+        index_t begin  = 0;         // 確保した時刻
+        index_t end    = 0;         // 最後に参照した時刻
+        bool    pinned = false;     // 次の区間にまたがって参照されるので計画から外す
+        size_t  offset = 0;
+    };
+
+    int                     m_state      = STATE_WARMUP;
+    bool                    m_active     = false;
+    bool                    m_mismatch   = false;
+    index_t                 m_serial     = -1;
+    index_t                 m_time       = 0;
+    index_t                 m_count      = 0;
+    std::vector<Block>      m_blocks;
+    std::shared_ptr<void>   m_arena;
+    size_t                  m_arena_size = 0;
+
+    static MemoryPlanner *&Current(void)
+    {
+        static MemoryPlanner *current = nullptr;
+        return current;
+    }
+
+    static index_t &Serial(void)
+    {
+        static index_t serial = 0;
+        return serial;
+    }
+
+    static bool &ThreadEnable(void)
+    {
+        static thread_local bool enable = true;
+        return enable;
+    }
+
+public:
+    MemoryPlanner() {}
+    MemoryPlanner(MemoryPlanner const &) = delete;
+    MemoryPlanner &operator=(MemoryPlanner const &) = delete;
+
+    ~MemoryPlanner()
+    {
+        End();
+    }
+
+    /**
+     * @brief  区間の開始
+     * @detail 他の区間が有効な間(入れ子のSequentialなど)は何もしない
+     */
+    void Begin(void)
+    {
+        if ( Current() != nullptr ) {
+            return;
+        }
+
+        Current()  = this;
+        m_active   = true;
+        m_mismatch = false;
+        m_serial   = ++Serial();
+        m_time     = 0;
+        m_count    = 0;
+    }
+
+    /**
+     * @brief  区間の終了
+     * @detail 記録中であれば計画を作成する
+     */
+    void End(void)
+    {
+        if ( !m_active ) {
+            return;
+        }
+        Current() = nullptr;
+        m_active  = false;
+
+        switch ( m_state ) {
+        case STATE_WARMUP:
+            m_state = STATE_RECORD;
+            break;
+
+        case STATE_RECORD:
+            m_blocks.resize((size_t)m_count);
+            Plan();
+            m_state = STATE_REPLAY;
+            break;
+
+        case STATE_REPLAY:
+            if ( m_mismatch || m_count != (index_t)m_blocks.size() ) {
+                m_state = STATE_RECORD;     // 次の区間で記録しなおす
+            }
+            break;
+        }
+    }
+
+    bool IsActive(void) const { return m_active; }
+    bool IsPlanned(void) const { return m_state == STATE_REPLAY; }
+
+    //! 計画したアリーナのサイズ(再利用後のピーク)
+    size_t GetPeakSize(void) const { return m_arena_size; }
+
+    //! 計画対象の確保サイズの合計(再利用しない場合の必要量)
+    size_t GetTotalSize(void) const
+    {
+        size_t total = 0;
+        for ( auto const &block : m_blocks ) {
+            total += block.size;
+        }
+        return total;
+    }
+
+    //! 呼び出したスレッドでの確保を計画の対象とするか
+    static void SetThreadEnable(bool enable)
+    {
+        ThreadEnable() = enable;
+    }
+
+    //! 計画対象の確保数
+    index_t GetBlockSize(void) const { return (index_t)m_blocks.size(); }
+
+
+    /**
+     * @brief  確保要求 (Memory クラスから呼ばれる)
+     * @param  size    確保サイズ
+     * @param  serial  確保した区間の識別子を返す (区間外なら -1)
+     * @param  index   区間内の通し番号を返す
+     * @param  arena   アリーナ上に割り当てた場合は参照を返す
+     * @return アリーナ上のアドレス。通常確保すべきときは nullptr
+     */
+    static void *Allocate(size_t size, index_t &serial, index_t &index, std::shared_ptr<void> &arena)
+    {
+        auto self = Current();
+        if ( self == nullptr || !ThreadEnable() ) {
+            serial = -1;
+            index  = -1;
+            return nullptr;
+        }
+        return self->AllocateBlock(size, serial, index, arena);
+    }
+
+    /**
+     * @brief  参照の通知 (Memory のロック/アンロック時に呼ばれる)
+     */
+    static void Touch(index_t serial, index_t index)
+    {
+        auto self = Current();
+        if ( self == nullptr || serial < 0 || !ThreadEnable() ) {
+            return;
+        }
+        self->TouchBlock(serial, index);
+    }
+
+protected:
+    void *AllocateBlock(size_t size, index_t &serial, index_t &index, std::shared_ptr<void> &arena)
+    {
+        serial = m_serial;
+        index  = m_count++;
+        ++m_time;
+
+        if ( m_state == STATE_RECORD ) {
+            if ( index >= (index_t)m_blocks.size() ) {
+                m_blocks.resize((size_t)index + 1);
+            }
+            Block &block = m_blocks[(size_t)index];
+            block.size   = std::max(block.size, size);     // 記録しなおしの際は大きい方を残す
+            block.begin  = m_time;
+            block.end    = m_time;
+            return nullptr;
+        }
+
+        if ( m_state == STATE_REPLAY && !m_mismatch ) {
+            if ( index < (index_t)m_blocks.size() && size <= m_blocks[(size_t)index].size ) {
+                Block const &block = m_blocks[(size_t)index];
+                if ( block.pinned || size == 0 ) {
+                    return nullptr;
+                }
+                arena = m_arena;
+                return (std::uint8_t *)m_arena.get() + block.offset;
+            }
+            m_mismatch = true;  // 以降はこの区間では通常確保
+        }
+
+        return nullptr;
+    }
+
+    void TouchBlock(index_t serial, index_t index)
+    {
+        if ( m_state != STATE_RECORD ) {
+            return;
+        }
+
+        #pragma omp critical
+        {
+            ++m_time;
+            if ( serial == m_serial ) {
+                if ( index < (index_t)m_blocks.size() ) {
+                    m_blocks[(size_t)index].end = m_time;
+                }
+            }
+            else if ( serial == m_serial - 1 ) {
+                // 前の区間の確保を、再確保する前に参照している
+                if ( index >= (index_t)m_blocks.size() ) {
+                    m_blocks.resize((size_t)index + 1);
+                }
+                m_blocks[(size_t)index].pinned = true;
+            }
+        }
+    }
+
+    // 生存期間の重なる確保同士が重ならないようにオフセットを割り付ける (サイズの大きい順に first-fit)
+    void Plan(void)
+    {
+        std::vector<index_t> order;
+        for ( index_t i = 0; i < (index_t)m_blocks.size(); ++i ) {
+            if ( !m_blocks[(size_t)i].pinned && m_blocks[(size_t)i].size > 0 ) {
+                order.push_back(i);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(),
+                [&](index_t a, index_t b) { return m_blocks[(size_t)a].size > m_blocks[(size_t)b].size; });
+
+        size_t arena_size = 0;
+        std::vector<index_t> placed;
+        for ( auto i : order ) {
+            Block &block = m_blocks[(size_t)i];
+            size_t size  = AlignSize(block.size);
+
+            // 生存期間の重なる配置済みブロックをアドレス順に並べ、最初に収まる隙間を探す
+            std::vector< std::pair<size_t, size_t> > used;
+            for ( auto j : placed ) {
+                Block const &other = m_blocks[(size_t)j];
+                if ( block.begin <= other.end && other.begin <= block.end ) {
+                    used.push_back(std::make_pair(other.offset, other.offset + AlignSize(other.size)));
+                }
+            }
+            std::sort(used.begin(), used.end());
+
+            size_t offset = 0;
+            for ( auto const &range : used ) {
+                if ( offset + size <= range.first ) {
+                    break;
+                }
+                offset = std::max(offset, range.second);
+            }
+
+            block.offset = offset;
+            arena_size   = std::max(arena_size, offset + size);
+            placed.push_back(i);
+        }
+
+        m_arena_size = arena_size;
+        if ( arena_size > 0 ) {
+            m_arena = std::shared_ptr<void>(aligned_memory_alloc(arena_size, ALIGN), aligned_memory_free);
+        }
+        else {
+            m_arena.reset();
+        }
+    }
+
+    static size_t AlignSize(size_t size)
+    {
+        return (size + ALIGN - 1) / ALIGN * ALIGN;
+    }
+};
+
+
+}
+
+
+// end of file
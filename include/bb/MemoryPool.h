@@ -0,0 +1,369 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+
+#include "bb/DataType.h"
+#include "bb/Utility.h"
+
+
+namespace bb {
+
+
+//[MemoryPool クラス]
+//  ・Memory クラスのホストメモリ確保を受け持つサイズクラス別のキャッシュ
+//  ・サイズは2のべき乗区間を4分割したクラスに切り上げ、開放されたブロックはクラス毎のフリーリストに戻す
+//  ・1MB以下のブロックはスレッド毎のフリーリスト、それ以上は共有のフリーリストで管理する
+//  ・キャッシュ量(スレッド毎のキャッシュを含む)が上限を超える分はOSに返す
+//  ・スレッド毎のキャッシュは共有の一覧に登録し、Trim() は全スレッドのキャッシュを直ちにOSに返す
+//  ・ブロックの先頭にクラス番号を持つヘッダを置くので、開放時にサイズは不要
+//
+// 最終ミニバッチのフレーム数変化などで同じサイズの確保/開放が繰り返される場合に再利用が効く
+
+class MemoryPool
+{
+public:
+    struct Statistics
+    {
+        size_t          bytes_in_use      = 0;  // 使用中のブロックのバイト数(クラスサイズ)
+        size_t          peak_bytes_in_use = 0;  // bytes_in_use の最大値
+        size_t          bytes_held        = 0;  // キャッシュに保持しているバイト数
+        size_t          peak_bytes_held   = 0;  // bytes_held の最大値
+        std::uint64_t   alloc_count       = 0;  // 確保回数
+        std::uint64_t   hit_count         = 0;  // キャッシュから確保できた回数
+
+        double GetHitRate(void) const
+        {
+            return alloc_count > 0 ? (double)hit_count / (double)alloc_count : 0.0;
+        }
+    };
+
+protected:
+    static size_t const HEADER_SIZE       = 64;                 // アライメントを兼ねる
+    static size_t const MIN_SIZE          = 256;
+    static int    const CLASS_DIVISION    = 4;                  // 2のべき乗区間の分割数
+    static int    const CLASS_NUM         = 48 * CLASS_DIVISION;
+    static size_t const THREAD_CACHE_SIZE = 1024 * 1024;        // スレッド毎に扱う最大ブロック
+    static int    const THREAD_CACHE_NUM  = 8;                  // スレッド毎・クラス毎の最大保持数
+
+    struct Header
+    {
+        std::int32_t    class_index;
+    };
+
+    // 持ち主のスレッドと Trim() の両方から触るので mtx で保護する (通常は競合しない)
+    struct ThreadCache
+    {
+        std::mutex                  mtx;
+        std::vector<void *>         free_list[CLASS_NUM];
+
+        ThreadCache()
+        {
+            auto &global = GetGlobal();
+            std::lock_guard<std::mutex> lock(global.mtx);
+            global.thread_caches.push_back(this);
+        }
+
+        ~ThreadCache()
+        {
+            ThreadState() = 2;
+            Flush(*this);
+        }
+    };
+
+    struct Global
+    {
+        std::mutex                  mtx;
+        std::vector<void *>         free_list[CLASS_NUM];
+        std::atomic<size_t>         cache_limit;
+        std::atomic<bool>           enable;
+        std::vector<ThreadCache *>  thread_caches;  // 生存中のスレッドのキャッシュ (mtx で保護)
+
+        std::atomic<size_t>         bytes_in_use;
+        std::atomic<size_t>         peak_bytes_in_use;
+        std::atomic<size_t>         bytes_held;
+        std::atomic<size_t>         peak_bytes_held;
+        std::atomic<std::uint64_t>  alloc_count;
+        std::atomic<std::uint64_t>  hit_count;
+
+        Global()
+        {
+            cache_limit = (size_t)1024 * 1024 * 1024;
+            enable      = true;
+            bytes_in_use      = 0;
+            peak_bytes_in_use = 0;
+            bytes_held        = 0;
+            peak_bytes_held   = 0;
+            alloc_count       = 0;
+            hit_count         = 0;
+        }
+    };
+
+    // 終了処理中の開放でも使えるよう開放しない
+    static Global &GetGlobal(void)
+    {
+        static Global *global = new Global;
+        return *global;
+    }
+
+    // 0:未生成 1:有効 2:破棄済み
+    static int &ThreadState(void)
+    {
+        static thread_local int state = 0;
+        return state;
+    }
+
+    static ThreadCache *GetThreadCache(void)
+    {
+        if ( ThreadState() == 2 ) {
+            return nullptr;
+        }
+        static thread_local ThreadCache cache;
+        ThreadState() = 1;
+        return &cache;
+    }
+
+public:
+    /**
+     * @brief  メモリ確保
+     * @param  size  確保サイズ(バイト単位)
+     * @return 64バイト境界のアドレス
+     */
+    static void *Allocate(size_t size)
+    {
+        auto &global = GetGlobal();
+        int  index   = GetClassIndex(size);
+        global.alloc_count++;
+
+        void *block = nullptr;
+        if ( global.enable ) {
+            block = Pop(index);
+        }
+
+        if ( block != nullptr ) {
+            global.hit_count++;
+        }
+        else {
+            block = aligned_memory_alloc(HEADER_SIZE + GetClassSize(index), HEADER_SIZE);
+            BB_ASSERT(block != nullptr);
+            ((Header *)block)->class_index = index;
+        }
+
+        UpdatePeak(global.peak_bytes_in_use, global.bytes_in_use += GetClassSize(index));
+        return (std::uint8_t *)block + HEADER_SIZE;
+    }
+
+    /**
+     * @brief  メモリ開放
+     * @param  addr  Allocate で確保したアドレス (nullptr 可)
+     */
+    static void Free(void *addr)
+    {
+        if ( addr == nullptr ) {
+            return;
+        }
+
+        auto &global = GetGlobal();
+        void *block  = (std::uint8_t *)addr - HEADER_SIZE;
+        int   index  = ((Header *)block)->class_index;
+        global.bytes_in_use -= GetClassSize(index);
+
+        if ( !global.enable || !Push(index, block) ) {
+            aligned_memory_free(block);
+        }
+    }
+
+    /**
+     * @brief  キャッシュの開放
+     * @detail 共有のキャッシュと、全スレッドのキャッシュをOSに返す
+     */
+    static void Trim(void)
+    {
+        auto &global = GetGlobal();
+        std::lock_guard<std::mutex> lock(global.mtx);
+        for ( auto tc : global.thread_caches ) {
+            std::lock_guard<std::mutex> tc_lock(tc->mtx);
+            for ( int index = 0; index < CLASS_NUM; ++index ) {
+                for ( auto block : tc->free_list[index] ) {
+                    aligned_memory_free(block);
+                    global.bytes_held -= GetClassSize(index);
+                }
+                tc->free_list[index].clear();
+            }
+        }
+
+        for ( int index = 0; index < CLASS_NUM; ++index ) {
+            for ( auto block : global.free_list[index] ) {
+                aligned_memory_free(block);
+                global.bytes_held -= GetClassSize(index);
+            }
+            global.free_list[index].clear();
+        }
+    }
+
+    //! キャッシュの保持上限(スレッド毎のキャッシュを含む、バイト単位)
+    static void SetCacheLimit(size_t limit)
+    {
+        GetGlobal().cache_limit = limit;
+    }
+
+    //! キャッシュの有効/無効 (無効時は都度OSから確保する)
+    static void SetEnable(bool enable)
+    {
+        GetGlobal().enable = enable;
+        if ( !enable ) {
+            Trim();
+        }
+    }
+
+    static Statistics GetStatistics(void)
+    {
+        auto &global = GetGlobal();
+        Statistics stat;
+        stat.bytes_in_use      = global.bytes_in_use;
+        stat.peak_bytes_in_use = global.peak_bytes_in_use;
+        stat.bytes_held        = global.bytes_held;
+        stat.peak_bytes_held   = global.peak_bytes_held;
+        stat.alloc_count       = global.alloc_count;
+        stat.hit_count         = global.hit_count;
+        return stat;
+    }
+
+    //! 統計の最大値と回数をリセット
+    static void ResetStatistics(void)
+    {
+        auto &global = GetGlobal();
+        global.peak_bytes_in_use = (size_t)global.bytes_in_use;
+        global.peak_bytes_held   = (size_t)global.bytes_held;
+        global.alloc_count       = 0;
+        global.hit_count         = 0;
+    }
+
+    //! 実際に確保されるサイズ
+    static size_t GetAllocationSize(size_t size)
+    {
+        return GetClassSize(GetClassIndex(size));
+    }
+
+protected:
+    static size_t GetClassSize(int index)
+    {
+        int    exp  = index / CLASS_DIVISION;
+        size_t base = MIN_SIZE << exp;
+        return base + (base / CLASS_DIVISION) * (index % CLASS_DIVISION);
+    }
+
+    static int GetClassIndex(size_t size)
+    {
+        if ( size <= MIN_SIZE ) {
+            return 0;
+        }
+
+        int exp = 0;
+        while ( (MIN_SIZE << (exp + 1)) <= size ) {
+            ++exp;
+        }
+        size_t base = MIN_SIZE << exp;
+        size_t step = base / CLASS_DIVISION;
+        int    sub  = (int)((size - base + step - 1) / step);
+        int    index = exp * CLASS_DIVISION + sub;    // sub == CLASS_DIVISION なら次の区間の先頭
+        BB_ASSERT(index < CLASS_NUM);
+        return index;
+    }
+
+    static void UpdatePeak(std::atomic<size_t> &peak, size_t value)
+    {
+        size_t prev = peak;
+        while ( prev < value && !peak.compare_exchange_weak(prev, value) ) {
+        }
+    }
+
+    static void *Pop(int index)
+    {
+        size_t size = GetClassSize(index);
+        auto  &global = GetGlobal();
+
+        if ( size <= THREAD_CACHE_SIZE ) {
+            auto tc = GetThreadCache();
+            if ( tc != nullptr ) {
+                std::lock_guard<std::mutex> tc_lock(tc->mtx);
+                if ( !tc->free_list[index].empty() ) {
+                    void *block = tc->free_list[index].back();
+                    tc->free_list[index].pop_back();
+                    global.bytes_held -= size;
+                    return block;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(global.mtx);
+        if ( global.free_list[index].empty() ) {
+            return nullptr;
+        }
+        void *block = global.free_list[index].back();
+        global.free_list[index].pop_back();
+        global.bytes_held -= size;
+        return block;
+    }
+
+    static bool Push(int index, void *block)
+    {
+        size_t size = GetClassSize(index);
+        auto  &global = GetGlobal();
+
+        if ( size <= THREAD_CACHE_SIZE ) {
+            auto tc = GetThreadCache();
+            if ( tc != nullptr ) {
+                std::lock_guard<std::mutex> tc_lock(tc->mtx);
+                if ( (int)tc->free_list[index].size() < THREAD_CACHE_NUM && global.bytes_held + size <= global.cache_limit ) {
+                    tc->free_list[index].push_back(block);
+                    UpdatePeak(global.peak_bytes_held, global.bytes_held += size);
+                    return true;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(global.mtx);
+        if ( global.bytes_held + size > global.cache_limit ) {
+            return false;
+        }
+        global.free_list[index].push_back(block);
+        UpdatePeak(global.peak_bytes_held, global.bytes_held += size);
+        return true;
+    }
+
+    // スレッドのキャッシュを共有のキャッシュに移して一覧から外す
+    static void Flush(ThreadCache &tc)
+    {
+        auto &global = GetGlobal();
+        std::lock_guard<std::mutex> lock(global.mtx);
+        global.thread_caches.erase(std::find(global.thread_caches.begin(), global.thread_caches.end(), &tc));
+
+        std::lock_guard<std::mutex> tc_lock(tc.mtx);
+        for ( int index = 0; index < CLASS_NUM; ++index ) {
+            for ( auto block : tc.free_list[index] ) {
+                global.free_list[index].push_back(block);
+            }
+            tc.free_list[index].clear();
+        }
+    }
+};
+
+
+}
+
+
+// end of file
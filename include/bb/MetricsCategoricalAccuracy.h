@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "bb/MetricsFunction.h"
+#include "bb/SimdSupport.h"
 
 
 namespace bb {
@@ -54,6 +55,55 @@ public:
         return (double)acc / (double)m_frames;
     }
 
+protected:
+    // FP32 の AVX2 版 (フレーム方向に 8 フレームずつ argmax を取る)
+    BB_TARGET_AVX2
+    void CalculateMetricsAvx2(FrameBuffer const &y, FrameBuffer const &t)
+    {
+	    index_t frame_size = y.GetFrameSize();
+	    index_t node_size  = y.GetNodeSize();
+        index_t y_stride   = y.GetFrameStride() / sizeof(float);
+        index_t t_stride   = t.GetFrameStride() / sizeof(float);
+
+        auto y_ptr   = y.LockMemoryConst();
+        auto t_ptr   = t.LockMemoryConst();
+        auto acc_ptr = m_accuracy.Lock();
+
+        auto y_addr = (float const *)y_ptr.GetAddr();
+        auto t_addr = (float const *)t_ptr.GetAddr();
+
+        // フレーム方向に 8 フレームずつ argmax を取る
+        index_t block_size = (frame_size + 7) / 8;
+        int     acc        = 0;
+
+        #pragma omp parallel for reduction(+:acc)
+        for (index_t block = 0; block < block_size; ++block) {
+            index_t frame = block * 8;
+
+            __m256  max_signal = _mm256_loadu_ps(&y_addr[frame]);
+            __m256  max_node   = _mm256_setzero_ps();
+            for (index_t node = 1; node < node_size; ++node) {
+                __m256  sig  = _mm256_loadu_ps(&y_addr[node * y_stride + frame]);
+                __m256  mask = _mm256_cmp_ps(sig, max_signal, _CMP_GT_OQ);
+                max_signal = _mm256_blendv_ps(max_signal, sig, mask);
+                max_node   = _mm256_blendv_ps(max_node, _mm256_set1_ps((float)node), mask);
+            }
+
+            float   node_buf[8];
+            _mm256_storeu_ps(node_buf, max_node);
+            int     n = (int)std::min((index_t)8, frame_size - frame);
+            for (int i = 0; i < n; ++i) {
+                if ( t_addr[(index_t)node_buf[i] * t_stride + frame + i] > 0 ) {
+                    acc += 1;
+                }
+            }
+        }
+
+        acc_ptr[0] += acc;
+        m_frames   += frame_size;
+    }
+
+public:
 	void CalculateMetrics(FrameBuffer y, FrameBuffer t)
 	{
         BB_ASSERT(y.GetType() == DataType<T>::type);
@@ -81,6 +131,11 @@ public:
         }
 #endif
 
+        if ( DataType<T>::type == BB_TYPE_FP32 && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            CalculateMetricsAvx2(y, t);
+            return;
+        }
+
         {
 		    index_t frame_size = y.GetFrameSize();
 		    index_t node_size = y.GetNodeSize();
@@ -88,23 +143,34 @@ public:
 
             m_frames += frame_size;
 
-            auto y_ptr  = y.LockConst<T>();
+            // サンプル単位の並びに一括転置してから argmax を取る
+            std::vector<T>      y_buf((size_t)frame_size * node_size);
+            std::vector<T *>    y_frames(frame_size);
+            for (index_t frame = 0; frame < frame_size; ++frame) {
+                y_frames[frame] = &y_buf[(size_t)frame * node_size];
+            }
+            y.GetFrames(y_frames);
+
             auto t_ptr  = t.LockConst<T>();
- 
+
+            int acc = 0;
+            #pragma omp parallel for reduction(+:acc)
 		    for (index_t frame = 0; frame < frame_size; ++frame) {
+                T const *y_vec = y_frames[frame];
 			    index_t	max_node   = 0;
-			    T		max_signal = y_ptr.Get(frame, 0);
+			    T		max_signal = y_vec[0];
 			    for (index_t node = 1; node < node_size; ++node) {
-				    T	sig = y_ptr.Get(frame, node);
+				    T	sig = y_vec[node];
 				    if (sig > max_signal) {
 					    max_node   = node;
 					    max_signal = sig;
 				    }
 			    }
 			    if ( t_ptr.Get(frame, max_node) > 0) {
-				    acc_ptr[0] += 1;
+				    acc += 1;
 			    }
 		    }
+            acc_ptr[0] += acc;
 	    }
     }
 };
@@ -12,17 +12,26 @@
 
 #include <cstdint>
 #include <random>
+#include <type_traits>
+#include <typeinfo>
 
 #include "bb/Model.h"
+#include "bb/Sequential.h"
 #include "bb/MicroMlpAffine.h"
 #include "bb/BatchNormalization.h"
+#include "bb/Binarize.h"
 #include "bb/ReLU.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
 
 
 // Sparce Mini-MLP(Multilayer perceptron) Layer [Affine-ReLU-Affine-BatchNorm-Binarize]
+//   "fusion true" で3層を融合したホスト演算を行う(FP32 かつ活性化が ReLU/Binarize の時)
+//     推論時 : BatchNormalization を出力段の重みに畳み込み、ノード毎に affine と活性化を1パスで計算
+//     学習時 : affine 出力を1度だけ読んで正規化と活性化を行い、backward も活性化と正規化を1パスで行う
+//   融合しない場合と同じパラメータ・勾配を使うので、途中で切り替えても学習を継続できる
 template <int N = 6, int M = 16, typename T = float, class Activation = ReLU<T> >
 class MicroMlp : public SparseLayer<T, T>
 {
@@ -34,9 +43,45 @@ protected:
 	std::shared_ptr< BatchNormalization<T>   >  m_batch_norm;
 	std::shared_ptr< Activation              >  m_activation;
 
+    // 融合演算
+    // Sigmoid 等も Binarize の派生なので型は完全一致で判定する
+    static bool const   m_fusable = std::is_same<T, float>::value
+                                        && (std::is_same<ReLU<T>, Activation>::value || std::is_same<Binarize<T>, Activation>::value);
+
+    bool                m_fusion    = false;
+    bool                m_host_only = false;
+    bool                m_fused     = false;    // 直前の Forward を融合演算で行ったか
+
+    FrameBuffer         m_z;                    // affine 出力(backward 用)
+    FrameBuffer         m_y;
+    FrameBuffer         m_dz;
+
+    Tensor_<T>          m_mean;                 // 正規化に使った平均値
+    Tensor_<T>          m_rstd;                 // 正規化に使った標準偏差の逆数
+
 protected:
 	MicroMlp() {}
 
+    /**
+     * @brief  コマンド処理
+     * @detail コマンド処理
+     * @param  args   コマンド
+     */
+	void CommandProc(std::vector<std::string> args)
+	{
+        // 融合演算の有効化
+        if (args.size() == 2 && args[0] == "fusion")
+        {
+            m_fusion = EvalBool(args[1]);
+        }
+
+        // HostOnlyモード設定
+        if (args.size() == 2 && args[0] == "host_only")
+        {
+            m_host_only = EvalBool(args[1]);
+        }
+	}
+
 public:
 	~MicroMlp() {}
 
@@ -73,6 +118,18 @@ public:
         return self;
     }
 
+    // 既存の3層からの作成(パラメータを共有する)
+    static std::shared_ptr< MicroMlp > Create(std::shared_ptr< MicroMlpAffine<N, M, T> > affine,
+                                              std::shared_ptr< BatchNormalization<T> > batch_norm,
+                                              std::shared_ptr< Activation > activation)
+    {
+        auto self = std::shared_ptr<MicroMlp>(new MicroMlp);
+        self->m_affine     = affine;
+        self->m_batch_norm = batch_norm;
+        self->m_activation = activation;
+        return self;
+    }
+
 	std::string GetClassName(void) const { return "MicroMlp"; }
 
     /**
@@ -81,6 +138,7 @@ public:
      */   
     void SendCommand(std::string command, std::string send_to = "all")
     {
+        Model::SendCommand(command, send_to);
 	    m_affine    ->SendCommand(command, send_to);
 	    m_batch_norm->SendCommand(command, send_to);
 	    m_activation->SendCommand(command, send_to);
@@ -186,6 +244,12 @@ public:
      */
     FrameBuffer Forward(FrameBuffer x, bool train = true)
     {
+        // 融合版
+        m_fused = IsFusionAvailable(x);
+        if ( m_fused ) {
+            return train ? ForwardFusedTraining(x) : ForwardFusedInference(x);
+        }
+
 	    x = m_affine    ->Forward(x, train);
 	    x = m_batch_norm->Forward(x, train);
 	    x = m_activation->Forward(x, train);
@@ -200,6 +264,11 @@ public:
      */
     FrameBuffer Backward(FrameBuffer dy)
     {
+        // 融合版
+        if ( m_fused ) {
+            return BackwardFused(dy);
+        }
+
 	    dy = m_activation->Backward(dy);
 	    dy = m_batch_norm->Backward(dy);
 	    dy = m_affine    ->Backward(dy);
@@ -207,6 +276,199 @@ public:
     }
 
 protected:
+    bool IsFusionAvailable(FrameBuffer const &x) const
+    {
+        if ( !m_fusable || !m_fusion || x.GetType() != BB_TYPE_FP32 ) {
+            return false;
+        }
+
+        // 派生クラスのインスタンスが渡された場合は融合しない
+        if ( typeid(*m_activation) != typeid(ReLU<T>) && typeid(*m_activation) != typeid(Binarize<T>) ) {
+            return false;
+        }
+
+#ifdef BB_WITH_CUDA
+        // CUDA が使える場合は各層の CUDA版を使う
+        if ( !m_host_only && x.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
+            return false;
+        }
+#endif
+
+        return true;
+    }
+
+    // 活性化が Binarize として動作するか(ReLU のバイナリモードを含む)
+    bool IsBinaryActivation(void) const
+    {
+        auto relu = std::dynamic_pointer_cast< ReLU<T> >(m_activation);
+        return !relu || relu->GetBinaryMode();
+    }
+
+    // 融合版 forward (推論)
+    FrameBuffer ForwardFusedInference(FrameBuffer x)
+    {
+        // SetInputShpaeされていなければ初回に設定
+        if ( x.GetNodeSize() != GetShapeSize(m_affine->GetInputShape()) ) {
+            m_affine->SetInputShape(x.GetShape());
+        }
+        m_affine->ClipParameters();
+
+        index_t node_size  = GetShapeSize(m_affine->GetOutputShape());
+        index_t frame_size = x.GetFrameSize();
+
+        m_y.Resize(BB_TYPE_FP32, frame_size, m_affine->GetOutputShape());
+
+        auto x_ptr           = x.LockConst<float>();
+        auto y_ptr           = m_y.Lock<float>(true);
+        auto input_index_ptr = m_affine->lock_InputIndex_const();
+        auto W0_ptr          = m_affine->lock_W0_const();
+        auto b0_ptr          = m_affine->lock_b0_const();
+        auto W1_ptr          = m_affine->lock_W1_const();
+        auto b1_ptr          = m_affine->lock_b1_const();
+        auto gamma_ptr       = m_batch_norm->lock_gamma_const();
+        auto beta_ptr        = m_batch_norm->lock_beta_const();
+        auto mean_ptr        = m_batch_norm->lock_mean_const();
+        auto var_ptr         = m_batch_norm->lock_var_const();
+
+        auto affine_kernel = BB_SIMD_KERNEL(MicroMlpAffine_Forward<N, M>);
+        auto act_kernel    = IsBinaryActivation() ? BB_SIMD_KERNEL(Binarize_Forward) : BB_SIMD_KERNEL(ReLU_Forward);
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < node_size; ++node) {
+            // 正規化を出力段の重みに畳み込む (BatchNormalization の推論と同じ式)
+            float scale = (float)gamma_ptr(node) / ((float)std::sqrt(var_ptr(node)) + 10e-7f);
+
+            float	W0[M][N];
+            float	b0[M];
+            float	W1[M];
+            for (int i = 0; i < M; ++i) {
+                for (int j = 0; j < N; ++j) {
+                    W0[i][j] = W0_ptr(node, i, j);
+                }
+                b0[i] = b0_ptr(node, i);
+                W1[i] = W1_ptr(node, i) * scale;
+            }
+            float b1 = ((float)b1_ptr(node) - (float)mean_ptr(node)) * scale + (float)beta_ptr(node);
+
+            float const *x_addr[N];
+            for (int i = 0; i < N; ++i) {
+                x_addr[i] = x_ptr.GetAddr(input_index_ptr(node, i));
+            }
+
+            // 出力行がキャッシュにある間に活性化まで行う
+            float *y_addr = y_ptr.GetAddr(node);
+            affine_kernel(y_addr, x_addr, W0, b0, W1, b1, frame_size);
+            act_kernel(y_addr, y_addr, frame_size);
+        }
+
+        return m_y;
+    }
+
+    // 融合版 forward (学習)
+    FrameBuffer ForwardFusedTraining(FrameBuffer x)
+    {
+        // affine は backward の為に通常通り計算して出力を保持
+        m_z = m_affine->Forward(x, true);
+
+        index_t node_size  = m_z.GetNodeSize();
+        index_t frame_size = m_z.GetFrameSize();
+
+        m_y.Resize(BB_TYPE_FP32, frame_size, m_z.GetShape());
+        m_mean.Resize(node_size);
+        m_rstd.Resize(node_size);
+
+        float momentum = (float)m_batch_norm->GetRunningStatMomentum();
+
+        auto z_ptr            = m_z.LockConst<float>();
+        auto y_ptr            = m_y.Lock<float>(true);
+        auto gamma_ptr        = m_batch_norm->lock_gamma_const();
+        auto beta_ptr         = m_batch_norm->lock_beta_const();
+        auto running_mean_ptr = m_batch_norm->lock_mean();
+        auto running_var_ptr  = m_batch_norm->lock_var();
+        auto mean_ptr         = m_mean.Lock();
+        auto rstd_ptr         = m_rstd.Lock();
+
+        auto bn_kernel  = BB_SIMD_KERNEL(BatchNormalization_ForwardTraining);
+        auto act_kernel = IsBinaryActivation() ? BB_SIMD_KERNEL(Binarize_Forward) : BB_SIMD_KERNEL(ReLU_Forward);
+
+        #pragma omp parallel for
+        for (index_t node = 0; node < node_size; ++node) {
+            float *y_addr = y_ptr.GetAddr(node);
+
+            float mean, var, rstd;
+            bn_kernel(y_addr, z_ptr.GetAddr(node), frame_size, gamma_ptr(node), beta_ptr(node), mean, var, rstd);
+            act_kernel(y_addr, y_addr, frame_size);
+
+            // 実行時の mean と var 保存
+            running_mean_ptr[node] = running_mean_ptr[node] * momentum + mean * (1 - momentum);
+            running_var_ptr[node]  = running_var_ptr[node] * momentum + var * (1 - momentum);
+
+            mean_ptr[node] = mean;
+            rstd_ptr[node] = rstd;
+        }
+
+        return m_y;
+    }
+
+    // 融合版 backward
+    FrameBuffer BackwardFused(FrameBuffer dy)
+    {
+        BB_ASSERT(dy.GetType() == BB_TYPE_FP32);
+
+        index_t node_size  = dy.GetNodeSize();
+        index_t frame_size = dy.GetFrameSize();
+        bool    binary     = IsBinaryActivation();
+
+        m_dz.Resize(BB_TYPE_FP32, frame_size, dy.GetShape());
+
+        {
+            auto z_ptr      = m_z.LockConst<float>();
+            auto y_ptr      = m_y.LockConst<float>();
+            auto dy_ptr     = dy.LockConst<float>();
+            auto dz_ptr     = m_dz.Lock<float>(true);
+            auto gamma_ptr  = m_batch_norm->lock_gamma_const();
+            auto beta_ptr   = m_batch_norm->lock_beta_const();
+            auto dgamma_ptr = m_batch_norm->lock_dgamma();
+            auto dbeta_ptr  = m_batch_norm->lock_dbeta();
+            auto mean_ptr   = m_mean.LockConst();
+            auto rstd_ptr   = m_rstd.LockConst();
+
+            auto relu_kernel     = BB_SIMD_KERNEL(ReLU_Backward);
+            auto binarize_kernel = BB_SIMD_KERNEL(Binarize_Backward);
+            auto norm_kernel     = BB_SIMD_KERNEL(BatchNormalization_ForwardInference);
+            auto bn_kernel       = BB_SIMD_KERNEL(BatchNormalization_Backward);
+
+            #pragma omp parallel
+            {
+                // Binarize の backward は正規化後の値を使うので、保存せずに行単位で再計算する
+                std::vector<float> norm_buf(binary ? frame_size : 0);
+
+                #pragma omp for
+                for (index_t node = 0; node < node_size; ++node) {
+                    float const *z_addr  = z_ptr.GetAddr(node);
+                    float const *dy_addr = dy_ptr.GetAddr(node);
+                    float       *dz_addr = dz_ptr.GetAddr(node);
+
+                    if ( binary ) {
+                        norm_kernel(norm_buf.data(), z_addr, frame_size, mean_ptr[node], rstd_ptr[node], gamma_ptr(node), beta_ptr(node));
+                        binarize_kernel(dz_addr, norm_buf.data(), dy_addr, frame_size);
+                    }
+                    else {
+                        relu_kernel(dz_addr, y_ptr.GetAddr(node), dy_addr, frame_size);
+                    }
+
+                    // 活性化の誤差をその場で正規化の誤差に置き換える
+                    float dgamma, dbeta;
+                    bn_kernel(dz_addr, z_addr, dz_addr, frame_size, mean_ptr[node], rstd_ptr[node], gamma_ptr(node), dgamma, dbeta);
+                    dgamma_ptr(node) = dgamma;
+                    dbeta_ptr(node)  = dbeta;
+                }
+            }
+        }
+
+        return m_affine->Backward(m_dz);
+    }
+
     /**
      * @brief  モデルの情報を表示
      * @detail モデルの情報を表示する
@@ -277,4 +539,58 @@ public:
 };
 
 
+/**
+ * @brief  MicroMlp の融合パス
+ * @detail Sequential(ネストしたものを含む)の中の MicroMlpAffine → BatchNormalization → ReLU/Binarize の並びを
+ *         同じレイヤーを共有する MicroMlp に置き換え、全ての MicroMlp の融合演算を有効にする
+ *         書き換えは N, M, T が一致する並びのみが対象
+ * @param  net    対象のネット
+ * @return 置き換えた並びの数
+ */
+template <int N = 6, int M = 16, typename T = float>
+int FuseMicroMlp(std::shared_ptr<Sequential> net)
+{
+    int count = 0;
+    for (int i = 0; i < net->GetSize(); ++i) {
+        auto seq = std::dynamic_pointer_cast<Sequential>(net->Get(i));
+        if ( seq ) {
+            count += FuseMicroMlp<N, M, T>(seq);
+            continue;
+        }
+
+        if ( i + 2 >= net->GetSize() ) {
+            continue;
+        }
+
+        auto affine     = std::dynamic_pointer_cast< MicroMlpAffine<N, M, T> >(net->Get(i));
+        auto batch_norm = std::dynamic_pointer_cast< BatchNormalization<T> >(net->Get(i+1));
+        if ( !affine || !batch_norm ) {
+            continue;
+        }
+
+        // ReLU や Sigmoid は Binarize の派生なので型は完全一致で判定する
+        auto &activation = *net->Get(i+2);
+        std::shared_ptr<Model> layer;
+        if ( typeid(activation) == typeid(ReLU<T>) ) {
+            layer = MicroMlp<N, M, T, ReLU<T> >::Create(affine, batch_norm, std::static_pointer_cast< ReLU<T> >(net->Get(i+2)));
+        }
+        else if ( typeid(activation) == typeid(Binarize<T>) ) {
+            layer = MicroMlp<N, M, T, Binarize<T> >::Create(affine, batch_norm, std::static_pointer_cast< Binarize<T> >(net->Get(i+2)));
+        }
+        else {
+            continue;
+        }
+
+        net->Set(i, layer);
+        net->Remove(i+1);
+        net->Remove(i+1);
+        ++count;
+    }
+
+    net->SendCommand("fusion true");
+
+    return count;
+}
+
+
 }
\ No newline at end of file
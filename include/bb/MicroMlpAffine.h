@@ -16,6 +16,7 @@
 #include "bb/Manager.h"
 #include "bb/SparseLayer.h"
 #include "bb/ShuffleSet.h"
+#include "bb/SimdKernel.h"
 
 namespace bb {
 
@@ -415,6 +416,21 @@ public:
 	}
 
 
+    /**
+     * @brief  バイナリモード時のパラメータクリップ
+     * @detail Forward の先頭で行う処理
+     *         Forward を経由せずにパラメータを使う場合(MicroMlp の融合演算など)にも呼び出す
+     */
+    void ClipParameters(void)
+    {
+        if (m_binary_mode) {
+            m_W0->Clamp(-1.0, +1.0);
+            m_b0->Clamp(-1.0, +1.0);
+            m_W1->Clamp(-1.0, +1.0);
+            m_b1->Clamp(-1.0, +1.0);
+        }
+    }
+
     FrameBuffer Forward(FrameBuffer x, bool train = true)
     {
         BB_ASSERT(x.GetType() == DataType<T>::type);
@@ -431,12 +447,7 @@ public:
         m_y.Resize(DataType<T>::type, m_x.GetFrameSize(), m_output_shape);
 
         // バイナリモードならパラメータクリップ
-        if (m_binary_mode) {
-            m_W0->Clamp(-1.0, +1.0);
-            m_b0->Clamp(-1.0, +1.0);
-            m_W1->Clamp(-1.0, +1.0);
-            m_b1->Clamp(-1.0, +1.0);
-        }
+        ClipParameters();
 
         // CUDA版
 #ifdef BB_WITH_CUDA
@@ -539,8 +550,8 @@ protected:
     
     void ForwardHostSimdFP32(void)
 	{
-		const index_t   frame_size = m_x.GetFrameStride() / sizeof(float);
-		const __m256	zero = _mm256_set1_ps(0);
+		const index_t   frame_size   = m_x.GetFrameSize();
+		const index_t   frame_stride = m_x.GetFrameStride() / sizeof(float);
 
         auto x_ptr = m_x.LockMemoryConst();
         auto y_ptr = m_y.LockMemory();
@@ -553,51 +564,27 @@ protected:
 		auto in_sig_buf  = (float const *)x_ptr.GetAddr();
 		auto out_sig_buf = (float       *)y_ptr.GetAddr();
 
+        auto kernel = BB_SIMD_KERNEL(MicroMlpAffine_Forward<N, M>);
+
 #pragma omp parallel for
 		for (index_t node = 0; node < m_output_node_size; ++node) {
-			__m256	W0[M][N];
-			__m256	b0[M];
-			__m256	W1[M];
-			__m256	b1;
+			float	W0[M][N];
+			float	b0[M];
+			float	W1[M];
 			for (int i = 0; i < M; ++i) {
 				for (int j = 0; j < N; ++j) {
-					W0[i][j] = _mm256_set1_ps(W0_ptr(node, i, j));
+					W0[i][j] = W0_ptr(node, i, j);
 				}
-				b0[i] = _mm256_set1_ps(b0_ptr(node, i));
-				W1[i] = _mm256_set1_ps(W1_ptr(node, i));
+				b0[i] = b0_ptr(node, i);
+				W1[i] = W1_ptr(node, i);
 			}
-			b1 = _mm256_set1_ps(b1_ptr(node));
 
 			float const *in_sig_ptr[N];
-			float       *out_sig_ptr;
 			for (int i = 0; i < N; ++i) {
-				in_sig_ptr[i] = &in_sig_buf[input_index_ptr(node, i) * frame_size];
+				in_sig_ptr[i] = &in_sig_buf[input_index_ptr(node, i) * frame_stride];
 			}
-			out_sig_ptr = &out_sig_buf[node * frame_size];
-
-			for (index_t frame = 0; frame < frame_size; frame += 8) {
-				__m256	in_sig[N];
-				for (int i = 0; i < N; ++i) {
-					in_sig[i] = _mm256_load_ps(&in_sig_ptr[i][frame]);
-				}
-
-				__m256	sum1 = b1;
-				for (int i = 0; i < M; ++i) {
-					// sub-layer0
-					__m256	sum0 = b0[i];
-					for (int j = 0; j < N; ++j) {
-						sum0 = _mm256_fmadd_ps(in_sig[j], W0[i][j], sum0);
-					}
-
-					// ReLU
-					sum0 = _mm256_max_ps(sum0, zero);
-
-					// sub-layer1
-					sum1 = _mm256_fmadd_ps(sum0, W1[i], sum1);
-				}
 
-				_mm256_store_ps(&out_sig_ptr[frame], sum1);
-			}
+			kernel(&out_sig_buf[node * frame_stride], in_sig_ptr, W0, b0, W1, b1_ptr(node), frame_size);
         }
 	}
     
@@ -637,8 +624,9 @@ protected:
     // Backward
     void BackwardHostSimdFP32(FrameBuffer const &dy)
 	{
-		index_t frame_size = dy.GetFrameStride() / sizeof(float);
-		index_t node_size  = m_output_node_size;
+		index_t frame_size   = dy.GetFrameSize();
+		index_t frame_stride = dy.GetFrameStride() / sizeof(float);
+		index_t node_size    = m_output_node_size;
 
    		m_dx.FillZero();
 
@@ -660,115 +648,62 @@ protected:
 		auto dx_buf = (float       *)dx_ptr.GetAddr();
 		auto x_buf  = (float const *)x_ptr.GetAddr();
 
-		const __m256	zero = _mm256_set1_ps(0);
+		float* tmp_err_buf = (float *)aligned_memory_alloc(node_size*N*frame_stride*sizeof(float), 32);
 
-		float* tmp_err_buf = (float *)aligned_memory_alloc(node_size*N*frame_size*sizeof(float), 32);
+        auto kernel = BB_SIMD_KERNEL(MicroMlpAffine_Backward<N, M>);
 		
 #pragma omp parallel for
 		for (int node = 0; node < (int)node_size; ++node) {
-			__m256	W0[M][N];
-			__m256	b0[M];
-			__m256	dW0[M][N];
-			__m256	db0[M];
-			__m256	W1[M];
-			__m256	dW1[M];
-			__m256	db1;
+			float	W0[M][N];
+			float	b0[M];
+			float	dW0[M][N];
+			float	db0[M];
+			float	W1[M];
+			float	dW1[M];
+			float	db1;
 			for (int i = 0; i < M; ++i) {
 				for (int j = 0; j < N; ++j) {
-					W0[i][j]  = _mm256_set1_ps(W0_ptr (node, i, j));
-					dW0[i][j] = _mm256_set1_ps(dW0_ptr(node, i, j));
+					W0[i][j]  = W0_ptr (node, i, j);
+					dW0[i][j] = dW0_ptr(node, i, j);
 				}
-				b0[i]  = _mm256_set1_ps(b0_ptr(node, i));
-				db0[i] = _mm256_set1_ps(db0_ptr(node, i));
-				W1[i]  = _mm256_set1_ps(W1_ptr(node, i));
-				dW1[i] = _mm256_set1_ps(dW1_ptr(node, i));
+				b0[i]  = b0_ptr(node, i);
+				db0[i] = db0_ptr(node, i);
+				W1[i]  = W1_ptr(node, i);
+				dW1[i] = dW1_ptr(node, i);
 			}
-			db1 = _mm256_set1_ps(db1_ptr(node));
+			db1 = db1_ptr(node);
 
-			float const *out_err_ptr;
 			float const *in_sig_ptr[N];
-
-			float*	tmp_err_ptr = &tmp_err_buf[node * N*frame_size];
-
-
-			out_err_ptr = &dy_buf[frame_size * node];
+			float       *tmp_err_ptr[N];
 			for (int i = 0; i < N; ++i) {
-				in_sig_ptr[i] = &x_buf[frame_size * input_index_ptr(node, i)];
+				in_sig_ptr[i]  = &x_buf[frame_stride * input_index_ptr(node, i)];
+				tmp_err_ptr[i] = &tmp_err_buf[(node * N + i) * frame_stride];
 			}
 
-			for (int frame = 0; frame < frame_size; frame += 8) {
-				__m256	in_sig[N];
-				for (int i = 0; i < N; ++i) {
-					in_sig[i] = _mm256_load_ps(&in_sig_ptr[i][frame]);
-				}
-
-				// 一層目の信号を再構成
-				__m256	sig0[M];
-				for (int i = 0; i < M; ++i) {
-					// sub-layer0
-					__m256	sum0 = b0[i];
-					for (int j = 0; j < N; ++j) {
-						sum0 = _mm256_fmadd_ps(in_sig[j], W0[i][j], sum0);
-					}
-
-					// ReLU
-					sum0 = _mm256_max_ps(sum0, zero);
-
-					sig0[i] = sum0;
-				}
-
-				// 逆伝播
-				__m256	in_err[N];
-				for (int i = 0; i < N; ++i) {
-					in_err[i] = zero;
-				}
-
-				__m256 out_err = _mm256_load_ps(&out_err_ptr[frame]);
-				db1 = _mm256_add_ps(db1, out_err);
-				for (int i = 0; i < M; ++i) {
-					__m256 err0 = _mm256_mul_ps(W1[i], out_err);
-					__m256 mask = _mm256_cmp_ps(sig0[i], zero, _CMP_GT_OS);
-					dW1[i] = _mm256_fmadd_ps(sig0[i], out_err, dW1[i]);
-
-					err0 = _mm256_and_ps(err0, mask);		// ReLU
-
-					db0[i] = _mm256_add_ps(db0[i], err0);
-					for (int j = 0; j < N; ++j) {
-						in_err[j] = _mm256_fmadd_ps(err0, W0[i][j], in_err[j]);
-						dW0[i][j] = _mm256_fmadd_ps(err0, in_sig[j], dW0[i][j]);
-					}
-				}
-
-				for (int i = 0; i < N; ++i) {
-					_mm256_store_ps(&tmp_err_ptr[i*frame_size + frame], in_err[i]);
-				}
-			}
+			kernel(tmp_err_ptr, in_sig_ptr, &dy_buf[frame_stride * node], W0, b0, W1, dW0, db0, dW1, db1, frame_size);
 
 			for (int i = 0; i < M; ++i) {
 				for (int j = 0; j < N; ++j) {
-					dW0_ptr(node, i, j) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(dW0[i][j]));
+					dW0_ptr(node, i, j) = dW0[i][j];
 				}
-				db0_ptr(node, i) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(db0[i]));
-				dW1_ptr(node, i) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(dW1[i]));
+				db0_ptr(node, i) = db0[i];
+				dW1_ptr(node, i) = dW1[i];
 			}
-			db1_ptr(node) += bb_mm256_cvtss_f32(bb_mm256_hsum_ps(db1));
+			db1_ptr(node) = db1;
 		}
 
 		// 足しこみ
 		for (int node = 0; node < (int)node_size; ++node) {
 			float*	in_err_ptr[N];
 			for (int i = 0; i < N; ++i) {
-				in_err_ptr[i] = &dx_buf[frame_size * input_index_ptr(node, i)];
+				in_err_ptr[i] = &dx_buf[frame_stride * input_index_ptr(node, i)];
 			}
-			float*	tmp_err_ptr = &tmp_err_buf[node * N*frame_size];
+			float*	tmp_err_ptr = &tmp_err_buf[node * N*frame_stride];
 
 #pragma omp parallel for
-			for (int frame = 0; frame < frame_size; frame += 8) {
+			for (int frame = 0; frame < frame_size; ++frame) {
 				for (int i = 0; i < N; ++i) {
-					__m256 in_err = _mm256_load_ps(&in_err_ptr[i][frame]);
-					__m256 tmp_err = _mm256_load_ps(&tmp_err_ptr[i*frame_size + frame]);
-					in_err = _mm256_add_ps(in_err, tmp_err);
-					_mm256_store_ps(&in_err_ptr[i][frame], in_err);
+					in_err_ptr[i][frame] += tmp_err_ptr[i*frame_stride + frame];
 				}
 			}
 
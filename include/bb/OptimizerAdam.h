@@ -12,6 +12,7 @@
 
 #include "bb/Optimizer.h"
 #include "bb/Variables.h"
+#include "bb/HostOptimizer.h"
 
 
 namespace bb {
@@ -27,6 +28,8 @@ protected:
 	int				m_iter;
 	T				m_b1;
 	T				m_b2;
+	T				m_weight_decay  = 0;
+	T				m_gradient_clip = 0;
 
     Variables       m_m;
     Variables       m_v;
@@ -45,6 +48,8 @@ public:
         T learning_rate = (T)0.001;
         T beta1         = (T)0.9;
         T beta2         = (T)0.999;
+        T weight_decay  = (T)0.0;     // L2 正則化の係数
+        T gradient_clip = (T)0.0;     // 勾配の要素毎のクリッピング値 (0 以下で無効)
     };
 
    	static std::shared_ptr<OptimizerAdam> Create(create_t const &create) 
@@ -54,6 +59,8 @@ public:
 		self->m_learning_rate = create.learning_rate;
 		self->m_beta1         = create.beta1;
 		self->m_beta2         = create.beta2;
+		self->m_weight_decay  = create.weight_decay;
+		self->m_gradient_clip = create.gradient_clip;
 		self->m_iter          = 0;
 
         self->m_b1            = self->m_beta1;
@@ -90,6 +97,8 @@ public:
 		m_learning_rate = create.learning_rate;
 		m_beta1         = create.beta1;
 		m_beta2         = create.beta2;
+		m_weight_decay  = create.weight_decay;
+		m_gradient_clip = create.gradient_clip;
 		m_iter          = 0;
 
         m_b1            = m_beta1;
@@ -113,7 +122,8 @@ public:
 	{
 
 #ifdef BB_WITH_CUDA
-        if ( m_params.IsDeviceAvailable() && m_grads.IsDeviceAvailable() && m_m.IsDeviceAvailable() && m_v.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
+        if ( m_weight_decay == 0 && m_gradient_clip <= 0
+                && m_params.IsDeviceAvailable() && m_grads.IsDeviceAvailable() && m_m.IsDeviceAvailable() && m_v.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
             // CUDA版
             auto lr_t = m_learning_rate * std::sqrt((T)1.0 - m_b2) / ((T)1.0 - m_b1 );
             bbcu_fp32_Adam
@@ -136,12 +146,34 @@ public:
 #endif
         
         {
-            // 汎用版
+            // 汎用版 (Tensor 毎に1パスで更新)
             auto lr_t = m_learning_rate * std::sqrt((T)1.0 - m_b2) / ((T)1.0 - m_b1 );
 
-            m_m += ((T)1.0 - m_beta1) * (m_grads - m_m);
-            m_v += ((T)1.0 - m_beta2) * (m_grads * m_grads - m_v);
-            m_params -= lr_t * m_m / (Sqrt(m_v) + (T)1e-7);
+            for ( index_t i = 0; i < m_params.GetSize(); ++i ) {
+                auto param_ptr = m_params[i].LockMemory();
+                auto grad_ptr  = m_grads[i].LockMemoryConst();
+                auto m_ptr     = m_m[i].LockMemory();
+                auto v_ptr     = m_v[i].LockMemory();
+                index_t size   = m_params[i].GetSize();
+
+                switch ( m_params[i].GetType() ) {
+                case BB_TYPE_FP32:
+                    HostAdam_Update(size, (float *)param_ptr.GetAddr(), (float const *)grad_ptr.GetAddr(),
+                            (float *)m_ptr.GetAddr(), (float *)v_ptr.GetAddr(),
+                            (float)lr_t, (float)m_beta1, (float)m_beta2, (float)m_gradient_clip, (float)m_weight_decay);
+                    break;
+
+                case BB_TYPE_FP64:
+                    HostAdam_Update<double>(size, (double *)param_ptr.GetAddr(), (double const *)grad_ptr.GetAddr(),
+                            (double *)m_ptr.GetAddr(), (double *)v_ptr.GetAddr(),
+                            (double)lr_t, (double)m_beta1, (double)m_beta2, (double)m_gradient_clip, (double)m_weight_decay);
+                    break;
+
+                default:
+                    BB_ASSERT(0);
+                    break;
+                }
+            }
 
             m_b1 *= m_beta1;
             m_b2 *= m_beta2;
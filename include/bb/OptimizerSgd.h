@@ -11,6 +11,7 @@
 
 
 #include "bb/Optimizer.h"
+#include "bb/HostOptimizer.h"
 
 
 namespace bb {
@@ -21,6 +22,8 @@ class OptimizerSgd : public Optimizer
 {
 protected:
 	T	            m_learning_rate;
+	T	            m_weight_decay  = 0;
+	T	            m_gradient_clip = 0;
     Variables       m_params;
     Variables       m_grads;
 
@@ -33,6 +36,8 @@ public:
     struct create_t
     {
         T learning_rate = (T)0.01;
+        T weight_decay  = (T)0.0;     // L2 正則化の係数
+        T gradient_clip = (T)0.0;     // 勾配の要素毎のクリッピング値 (0 以下で無効)
     };
 
    	static std::shared_ptr<OptimizerSgd> Create(create_t const &create) 
@@ -40,6 +45,8 @@ public:
         auto self = std::shared_ptr<OptimizerSgd>(new OptimizerSgd);
 
 		self->m_learning_rate = create.learning_rate;
+		self->m_weight_decay  = create.weight_decay;
+		self->m_gradient_clip = create.gradient_clip;
 
         return self;
 	}
@@ -62,7 +69,37 @@ public:
     
 	void Update(void)
 	{
-   		m_params -= m_learning_rate * m_grads;
+#ifdef BB_WITH_CUDA
+        if ( m_weight_decay == 0 && m_gradient_clip <= 0
+                && m_params.IsDeviceAvailable() && m_grads.IsDeviceAvailable() && Manager::IsDeviceAvailable() ) {
+            // CUDA版 (デバイス上の Tensor 演算で更新)
+       		m_params -= m_learning_rate * m_grads;
+            return;
+        }
+#endif
+
+        // 汎用版 (Tensor 毎に1パスで更新)
+        for ( index_t i = 0; i < m_params.GetSize(); ++i ) {
+            auto param_ptr = m_params[i].LockMemory();
+            auto grad_ptr  = m_grads[i].LockMemoryConst();
+            index_t size   = m_params[i].GetSize();
+
+            switch ( m_params[i].GetType() ) {
+            case BB_TYPE_FP32:
+                HostSgd_Update(size, (float *)param_ptr.GetAddr(), (float const *)grad_ptr.GetAddr(),
+                        (float)m_learning_rate, (float)m_gradient_clip, (float)m_weight_decay);
+                break;
+
+            case BB_TYPE_FP64:
+                HostSgd_Update<double>(size, (double *)param_ptr.GetAddr(), (double const *)grad_ptr.GetAddr(),
+                        (double)m_learning_rate, (double)m_gradient_clip, (double)m_weight_decay);
+                break;
+
+            default:
+                BB_ASSERT(0);
+                break;
+            }
+        }
     }
 };
 
@@ -0,0 +1,138 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                 Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                 https://github.com/ryuz
+//                                 ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "bb/DataType.h"
+#include "bb/ValueGenerator.h"
+
+namespace bb {
+
+
+// Philox4x32-10 (カウンタ方式の乱数)
+//   (counter, key) から 4個の 32bit 乱数を求める純粋関数なので、任意の位置の乱数を状態無しで並列に生成できる
+inline void Philox4x32_10(std::uint32_t ctr[4], std::uint32_t key0, std::uint32_t key1)
+{
+    for ( int round = 0; round < 10; ++round ) {
+        std::uint64_t p0 = (std::uint64_t)0xD2511F53 * ctr[0];
+        std::uint64_t p1 = (std::uint64_t)0xCD9E8D57 * ctr[2];
+        std::uint32_t c0 = (std::uint32_t)(p1 >> 32) ^ ctr[1] ^ key0;
+        std::uint32_t c2 = (std::uint32_t)(p0 >> 32) ^ ctr[3] ^ key1;
+        ctr[0] = c0;
+        ctr[1] = (std::uint32_t)p1;
+        ctr[2] = c2;
+        ctr[3] = (std::uint32_t)p0;
+        key0 += 0x9E3779B9;
+        key1 += 0xBB67AE85;
+    }
+}
+
+
+// カウンタ方式の一様乱数
+//   index 番目の値は (seed, index) だけで決まる
+//   Generate() は状態を変えないので、スレッド毎に担当範囲を生成してもスレッド数によらず同じ結果になる
+template <typename T>
+class PhiloxGenerator : public ValueGenerator<T>
+{
+protected:
+    T               m_a;
+    T               m_b;
+    std::uint64_t   m_seed;
+    std::uint64_t   m_counter = 0;
+
+protected:
+    PhiloxGenerator(T a = (T)0.0, T b = (T)1.0, std::uint64_t seed = 1)
+        : m_a(a), m_b(b), m_seed(seed)
+    {
+    }
+
+public:
+    static std::shared_ptr<PhiloxGenerator> Create(T a = (T)0.0, T b = (T)1.0, std::uint64_t seed = 1)
+    {
+        return std::shared_ptr<PhiloxGenerator>(new PhiloxGenerator(a, b, seed));
+    }
+
+    void Seed(std::uint64_t seed)
+    {
+        m_seed    = seed;
+        m_counter = 0;
+    }
+
+    void Reset(void)
+    {
+        m_counter = 0;
+    }
+
+    //! 次に生成する位置
+    std::uint64_t GetCounter(void) const { return m_counter; }
+
+    /**
+     * @brief  生成位置を size 分進める
+     * @detail 並列に Generate() する範囲の確保に使う
+     * @return 進める前の位置
+     */
+    std::uint64_t Advance(std::uint64_t size)
+    {
+        std::uint64_t counter = m_counter;
+        m_counter += size;
+        return counter;
+    }
+
+    T GetValue(void)
+    {
+        return GetValueAt(m_counter++);
+    }
+
+    //! 位置を指定して1個生成
+    T GetValueAt(std::uint64_t index) const
+    {
+        T value;
+        Generate(index, &value, 1);
+        return value;
+    }
+
+    void GetValues(T *values, index_t size)
+    {
+        Generate(Advance((std::uint64_t)size), values, size);
+    }
+
+    /**
+     * @brief  位置を指定して生成
+     * @detail index 番目から size 個を生成する(内部の位置は変えない)
+     */
+    void Generate(std::uint64_t index, T *values, index_t size) const
+    {
+        std::uint32_t key0  = (std::uint32_t)m_seed;
+        std::uint32_t key1  = (std::uint32_t)(m_seed >> 32);
+        T             scale = (m_b - m_a) / (T)16777216.0;   // 上位24bit を [a, b) に割り当てる
+
+        index_t i = 0;
+        while ( i < size ) {
+            std::uint64_t pos   = index + (std::uint64_t)i;
+            std::uint64_t block = pos / 4;
+            int           lane  = (int)(pos % 4);
+
+            std::uint32_t ctr[4] = {(std::uint32_t)block, (std::uint32_t)(block >> 32), 0, 0};
+            Philox4x32_10(ctr, key0, key1);
+
+            for ( ; lane < 4 && i < size; ++lane, ++i ) {
+                values[i] = m_a + (T)(ctr[lane] >> 8) * scale;
+            }
+        }
+    }
+};
+
+
+}
+
+
+// end of file
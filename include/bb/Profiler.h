@@ -0,0 +1,545 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "bb/DataType.h"
+
+
+namespace bb {
+
+
+//[Profiler クラス]
+//  ・層毎の Forward/Backward の処理時間やメモリの動きを記録するプロファイラ
+//  ・Profiler::Enable() で有効化し、PrintSummary() で集計表、WriteChromeTrace() で
+//    chrome://tracing (Perfetto) で読める JSON を出力する
+//  ・記録するのは区間毎の経過時間、確保したメモリ量、出力 FrameBuffer のサイズ、
+//    Memory の Lock/LockDevice 回数とホスト⇔デバイス間のコピー量、スレッド使用率
+//  ・スレッド使用率は プロセスのCPU時間 / (経過時間 × OpenMP の最大スレッド数)
+//  ・無効時の計測箇所のコストはフラグ判定1回のみ (BB_NO_PROFILER を定義すれば判定ごと消える)
+//  ・区間が記録されるのは Sequential の子の層と Runner の各処理のみ。
+//    LoweringConvolution の内部層や MicroMlp の affine/BN/活性化など複合層の中で
+//    呼ばれる層は個別には記録されず、外側の層の区間に含めて計上される。
+//    また Sequential や Runner を介さず直接 Forward/Backward を呼んだモデルは記録されない
+//    (必要なら呼び出し側で Profiler::Scope を置く)
+
+class Profiler
+{
+public:
+    struct Counter
+    {
+        std::uint64_t   alloc_count  = 0;   // メモリ確保回数
+        std::uint64_t   alloc_bytes  = 0;   // 確保バイト数
+        std::uint64_t   host_lock    = 0;   // Lock/LockConst 回数
+        std::uint64_t   device_lock  = 0;   // LockDevice/LockDeviceConst 回数
+        std::uint64_t   h2d_count    = 0;   // ホスト→デバイスのコピー回数
+        std::uint64_t   h2d_bytes    = 0;
+        std::uint64_t   d2h_count    = 0;   // デバイス→ホストのコピー回数
+        std::uint64_t   d2h_bytes    = 0;
+
+        Counter &operator+=(Counter const &c)
+        {
+            alloc_count += c.alloc_count;
+            alloc_bytes += c.alloc_bytes;
+            host_lock   += c.host_lock;
+            device_lock += c.device_lock;
+            h2d_count   += c.h2d_count;
+            h2d_bytes   += c.h2d_bytes;
+            d2h_count   += c.d2h_count;
+            d2h_bytes   += c.d2h_bytes;
+            return *this;
+        }
+    };
+
+    struct Event
+    {
+        std::string     name;
+        std::string     category;           // "forward", "backward" など
+        void const      *id         = nullptr;
+        int             depth       = 0;    // 区間の入れ子の深さ
+        int             tid         = 0;
+        double          start_us    = 0;    // Enable/Clear からの経過時間
+        double          time_us     = 0;
+        double          cpu_us      = 0;    // プロセスのCPU時間
+        int             threads     = 1;    // OpenMP の最大スレッド数
+        index_t         frame_size  = 0;    // 出力 FrameBuffer
+        index_t         node_size   = 0;
+        std::uint64_t   buffer_bytes = 0;
+        Counter         counter;
+
+        double GetThreadUtilization(void) const
+        {
+            return (time_us > 0) ? cpu_us / (time_us * threads) : 0.0;
+        }
+    };
+
+protected:
+    struct Global
+    {
+        std::mutex                                  mtx;
+        std::atomic<bool>                           enable;
+        std::chrono::steady_clock::time_point       origin;
+        std::vector<Event>                          events;
+        std::atomic<int>                            thread_count;
+
+        std::atomic<std::uint64_t>  alloc_count;
+        std::atomic<std::uint64_t>  alloc_bytes;
+        std::atomic<std::uint64_t>  host_lock;
+        std::atomic<std::uint64_t>  device_lock;
+        std::atomic<std::uint64_t>  h2d_count;
+        std::atomic<std::uint64_t>  h2d_bytes;
+        std::atomic<std::uint64_t>  d2h_count;
+        std::atomic<std::uint64_t>  d2h_bytes;
+
+        Global()
+        {
+            enable       = false;
+            origin       = std::chrono::steady_clock::now();
+            thread_count = 0;
+            alloc_count  = 0;
+            alloc_bytes  = 0;
+            host_lock    = 0;
+            device_lock  = 0;
+            h2d_count    = 0;
+            h2d_bytes    = 0;
+            d2h_count    = 0;
+            d2h_bytes    = 0;
+        }
+    };
+
+    // 終了処理中の Memory 開放からも参照されるので開放しない
+    static Global &GetGlobal(void)
+    {
+        static Global *global = new Global;
+        return *global;
+    }
+
+    static int &ThreadDepth(void)
+    {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    static int ThreadId(void)
+    {
+        static thread_local int tid = GetGlobal().thread_count++;
+        return tid;
+    }
+
+    static Counter GetCounter(void)
+    {
+        auto &global = GetGlobal();
+        Counter c;
+        c.alloc_count = global.alloc_count;
+        c.alloc_bytes = global.alloc_bytes;
+        c.host_lock   = global.host_lock;
+        c.device_lock = global.device_lock;
+        c.h2d_count   = global.h2d_count;
+        c.h2d_bytes   = global.h2d_bytes;
+        c.d2h_count   = global.d2h_count;
+        c.d2h_bytes   = global.d2h_bytes;
+        return c;
+    }
+
+    static double GetTimeUs(void)
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - GetGlobal().origin).count();
+    }
+
+    // プロセス全体のCPU時間 [us]
+    static double GetCpuTimeUs(void)
+    {
+#ifdef _WIN32
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+        if ( !GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time) ) {
+            return 0;
+        }
+        ULARGE_INTEGER k, u;
+        k.LowPart = kernel_time.dwLowDateTime;  k.HighPart = kernel_time.dwHighDateTime;
+        u.LowPart = user_time.dwLowDateTime;    u.HighPart = user_time.dwHighDateTime;
+        return (double)(k.QuadPart + u.QuadPart) / 10.0;
+#else
+        return (double)std::clock() * (1000000.0 / (double)CLOCKS_PER_SEC);
+#endif
+    }
+
+    static int GetMaxThreads(void)
+    {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+public:
+    /**
+     * @brief  有効/無効の設定
+     * @detail 有効化した時点で記録済みのイベントはクリアする
+     */
+    static void Enable(bool enable = true)
+    {
+        if ( enable && !IsEnabled() ) {
+            Clear();
+        }
+        GetGlobal().enable = enable;
+    }
+
+    static void Disable(void)
+    {
+        Enable(false);
+    }
+
+    static bool IsEnabled(void)
+    {
+#ifdef BB_NO_PROFILER
+        return false;
+#else
+        return GetGlobal().enable.load(std::memory_order_relaxed);
+#endif
+    }
+
+    //! 記録のクリア
+    static void Clear(void)
+    {
+        auto &global = GetGlobal();
+        std::lock_guard<std::mutex> lock(global.mtx);
+        global.events.clear();
+        global.origin = std::chrono::steady_clock::now();
+    }
+
+    //! 記録したイベントの取得(終了順)
+    static std::vector<Event> GetEvents(void)
+    {
+        auto &global = GetGlobal();
+        std::lock_guard<std::mutex> lock(global.mtx);
+        return global.events;
+    }
+
+
+    // Memory からの通知
+    static void CountAlloc(size_t size)
+    {
+        if ( !IsEnabled() ) { return; }
+        auto &global = GetGlobal();
+        global.alloc_count++;
+        global.alloc_bytes += size;
+    }
+
+    static void CountHostLock(void)
+    {
+        if ( !IsEnabled() ) { return; }
+        GetGlobal().host_lock++;
+    }
+
+    static void CountDeviceLock(void)
+    {
+        if ( !IsEnabled() ) { return; }
+        GetGlobal().device_lock++;
+    }
+
+    static void CountMemcpy(bool to_device, size_t size)
+    {
+        if ( !IsEnabled() ) { return; }
+        auto &global = GetGlobal();
+        if ( to_device ) {
+            global.h2d_count++;
+            global.h2d_bytes += size;
+        }
+        else {
+            global.d2h_count++;
+            global.d2h_bytes += size;
+        }
+    }
+
+
+    //[Scope クラス]
+    //  生存期間を1区間として記録する
+    class Scope
+    {
+    protected:
+        bool        m_active = false;
+        Event       m_event;
+        Counter     m_counter;
+
+    public:
+        /**
+         * @brief  名前を指定して区間を開始
+         * @param  name      区間名
+         * @param  category  分類("forward", "backward" など)
+         * @param  id        集計の単位 (nullptr なら名前で集計)
+         */
+        Scope(char const *name, char const *category, void const *id = nullptr)
+        {
+            if ( IsEnabled() ) {
+                Start(name, category, id);
+            }
+        }
+
+        /**
+         * @brief  モデルの区間を開始
+         * @detail 名前は model->GetName() で、集計はインスタンス単位
+         */
+        template <class ModelTp>
+        Scope(std::shared_ptr<ModelTp> const &model, char const *category)
+        {
+            if ( IsEnabled() ) {
+                Start(model->GetName(), category, model.get());
+            }
+        }
+
+        ~Scope()
+        {
+            if ( m_active ) {
+                End();
+            }
+        }
+
+        //! 区間の出力(FrameBuffer)のサイズを記録
+        template <class FrameBufferTp>
+        void SetOutput(FrameBufferTp const &buf)
+        {
+            if ( m_active ) {
+                m_event.frame_size   = buf.GetFrameSize();
+                m_event.node_size    = buf.GetNodeSize();
+                m_event.buffer_bytes = (std::uint64_t)FrameBufferTp::GetMemorySize(buf.GetType(), buf.GetFrameSize(), buf.GetShape());
+            }
+        }
+
+    protected:
+        void Start(std::string name, char const *category, void const *id)
+        {
+            m_active          = true;
+            m_event.name      = name;
+            m_event.category  = category;
+            m_event.id        = id;
+            m_event.depth     = ThreadDepth()++;
+            m_event.tid       = ThreadId();
+            m_event.threads   = GetMaxThreads();
+            m_counter         = GetCounter();
+            m_event.cpu_us    = GetCpuTimeUs();
+            m_event.start_us  = GetTimeUs();
+        }
+
+        void End(void)
+        {
+            m_event.time_us = GetTimeUs() - m_event.start_us;
+            m_event.cpu_us  = GetCpuTimeUs() - m_event.cpu_us;
+
+            Counter c = GetCounter();
+            m_event.counter.alloc_count = c.alloc_count - m_counter.alloc_count;
+            m_event.counter.alloc_bytes = c.alloc_bytes - m_counter.alloc_bytes;
+            m_event.counter.host_lock   = c.host_lock   - m_counter.host_lock;
+            m_event.counter.device_lock = c.device_lock - m_counter.device_lock;
+            m_event.counter.h2d_count   = c.h2d_count   - m_counter.h2d_count;
+            m_event.counter.h2d_bytes   = c.h2d_bytes   - m_counter.h2d_bytes;
+            m_event.counter.d2h_count   = c.d2h_count   - m_counter.d2h_count;
+            m_event.counter.d2h_bytes   = c.d2h_bytes   - m_counter.d2h_bytes;
+
+            ThreadDepth()--;
+
+            auto &global = GetGlobal();
+            std::lock_guard<std::mutex> lock(global.mtx);
+            global.events.push_back(m_event);
+        }
+    };
+
+
+    /**
+     * @brief  集計表の表示
+     * @detail 区間(モデルのインスタンスと分類)毎に、最初に開始した順で表示する
+     *         時間・メモリ・コピー量は子の区間を含む
+     */
+    static void PrintSummary(std::ostream &os = std::cout)
+    {
+        struct Row
+        {
+            Event           first;
+            int             calls   = 0;
+            double          time_us = 0;
+            double          cpu_us  = 0;
+            double          thread_us = 0;
+            Counter         counter;
+        };
+
+        auto events = GetEvents();
+
+        // 開始順に並べて集計
+        std::stable_sort(events.begin(), events.end(), [](Event const &a, Event const &b) { return a.start_us < b.start_us; });
+        std::vector<Row>                                            rows;
+        std::map<std::pair<std::string, std::string>, size_t>       index;
+        for ( auto const &ev : events ) {
+            std::ostringstream key;
+            key << ev.id << ":" << (ev.id == nullptr ? ev.name : "");
+            auto k = std::make_pair(key.str(), ev.category);
+            if ( index.find(k) == index.end() ) {
+                index[k] = rows.size();
+                rows.push_back(Row());
+                rows.back().first = ev;
+            }
+            auto &row = rows[index[k]];
+            row.calls     += 1;
+            row.time_us   += ev.time_us;
+            row.cpu_us    += ev.cpu_us;
+            row.thread_us += ev.time_us * ev.threads;
+            row.counter   += ev.counter;
+            row.first.frame_size   = ev.frame_size;     // サイズは最後の値
+            row.first.node_size    = ev.node_size;
+            row.first.buffer_bytes = ev.buffer_bytes;
+        }
+
+        os << std::left  << std::setw(32) << "name"
+           << std::setw(10) << "phase"
+           << std::right << std::setw(7)  << "calls"
+           << std::setw(12) << "total[ms]"
+           << std::setw(10) << "avg[ms]"
+           << std::setw(12) << "alloc[KB]"
+           << std::setw(16) << "output"
+           << std::setw(10) << "out[KB]"
+           << std::setw(14) << "lock(h/d)"
+           << std::setw(18) << "copy h2d/d2h[KB]"
+           << std::setw(8)  << "util"
+           << std::endl;
+        os << std::string(149, '-') << std::endl;
+
+        for ( auto const &row : rows ) {
+            std::string name = std::string(row.first.depth * 2, ' ') + row.first.name;
+            std::ostringstream output, lock, copy;
+            if ( row.first.frame_size > 0 ) {
+                output << row.first.frame_size << "x" << row.first.node_size;
+            }
+            else {
+                output << "-";
+            }
+            lock   << row.counter.host_lock << "/" << row.counter.device_lock;
+            copy   << row.counter.h2d_bytes / 1024 << "/" << row.counter.d2h_bytes / 1024;
+
+            os << std::left  << std::setw(32) << name
+               << std::setw(10) << row.first.category
+               << std::right << std::setw(7)  << row.calls
+               << std::fixed << std::setprecision(3)
+               << std::setw(12) << row.time_us / 1000.0
+               << std::setw(10) << row.time_us / 1000.0 / row.calls
+               << std::setw(12) << row.counter.alloc_bytes / 1024
+               << std::setw(16) << output.str()
+               << std::setw(10) << row.first.buffer_bytes / 1024
+               << std::setw(14) << lock.str()
+               << std::setw(18) << copy.str()
+               << std::setprecision(1)
+               << std::setw(7)  << (row.thread_us > 0 ? 100.0 * row.cpu_us / row.thread_us : 0.0) << "%"
+               << std::endl;
+        }
+        os << std::defaultfloat;
+    }
+
+
+    /**
+     * @brief  Chrome trace 形式(JSON)の出力
+     * @detail chrome://tracing や Perfetto で読み込める
+     */
+    static void WriteChromeTrace(std::ostream &os)
+    {
+        auto events = GetEvents();
+
+        os << "{\"traceEvents\":[";
+        for ( size_t i = 0; i < events.size(); ++i ) {
+            auto const &ev = events[i];
+            os << (i == 0 ? "\n" : ",\n");
+            os << std::fixed << std::setprecision(3);
+            os << "{\"name\":\"" << EscapeJson(ev.name) << "\",\"cat\":\"" << EscapeJson(ev.category) << "\",\"ph\":\"X\""
+               << ",\"ts\":" << ev.start_us << ",\"dur\":" << ev.time_us
+               << ",\"pid\":0,\"tid\":" << ev.tid
+               << ",\"args\":{"
+               << "\"frame_size\":" << ev.frame_size
+               << ",\"node_size\":" << ev.node_size
+               << ",\"buffer_bytes\":" << ev.buffer_bytes
+               << ",\"alloc_count\":" << ev.counter.alloc_count
+               << ",\"alloc_bytes\":" << ev.counter.alloc_bytes
+               << ",\"host_lock\":" << ev.counter.host_lock
+               << ",\"device_lock\":" << ev.counter.device_lock
+               << ",\"h2d_bytes\":" << ev.counter.h2d_bytes
+               << ",\"d2h_bytes\":" << ev.counter.d2h_bytes
+               << ",\"threads\":" << ev.threads
+               << ",\"thread_utilization\":" << ev.GetThreadUtilization()
+               << "}}";
+        }
+        os << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+        os << std::defaultfloat;
+    }
+
+    static bool WriteChromeTrace(std::string filename)
+    {
+        std::ofstream ofs(filename);
+        if ( !ofs.is_open() ) {
+            return false;
+        }
+        WriteChromeTrace(ofs);
+        return !ofs.fail();
+    }
+
+protected:
+    static std::string EscapeJson(std::string const &str)
+    {
+        std::string s;
+        for ( auto c : str ) {
+            switch ( c ) {
+            case '"':   s += "\\\"";  break;
+            case '\\':  s += "\\\\";  break;
+            case '\n':  s += "\\n";   break;
+            case '\t':  s += "\\t";   break;
+            default:
+                if ( (unsigned char)c < 0x20 ) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", (int)c);
+                    s += buf;
+                }
+                else {
+                    s += c;
+                }
+                break;
+            }
+        }
+        return s;
+    }
+};
+
+
+}
+
+
+// end of file
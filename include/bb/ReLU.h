@@ -13,6 +13,7 @@
 
 #include "bb/Manager.h"
 #include "bb/Binarize.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
@@ -65,6 +66,9 @@ public:
 
 	std::string GetClassName(void) const { return "ReLU"; }
 
+    //! バイナリモード(Binarize として動作)か
+    bool GetBinaryMode(void) const { return m_binary_mode; }
+
 
     // 1ノードのみForward計算
     std::vector<T> ForwardNode(index_t node, std::vector<T> x_vec) const
@@ -202,23 +206,18 @@ inline FrameBuffer ReLU<float>::Forward(FrameBuffer x, bool train)
 #endif
 
     {
-        // AVX版
-        index_t frame_size = m_x.GetFrameSize();
-        index_t node_size = m_x.GetNodeSize();
+        // SIMD版(実行時に命令セットを選択)
+        index_t node_size    = m_x.GetNodeSize();
+        index_t frame_stride = m_x.GetFrameStride() / sizeof(float);
 
         auto x_ptr = m_x.LockConst<float>();
 	    auto y_ptr = m_y.Lock<float>(true);
 
-		index_t  m256_frame_size = (int)(((frame_size + 7) / 8) * 8);
-		__m256 zero = _mm256_set1_ps(0);
+        auto kernel = BB_SIMD_KERNEL(ReLU_Forward);
+
+        #pragma omp parallel for
 		for (index_t node = 0; node < node_size; ++node) {
-		    auto x_addr = (float const *)x_ptr.GetAddr(node);
-		    auto y_addr = (float *)y_ptr.GetAddr(node);
-		    for (index_t frame = 0; frame < m256_frame_size; frame += 8) {
-			    __m256 in_sig = _mm256_load_ps(&x_addr[frame]);
-			    in_sig = _mm256_max_ps(in_sig, zero);
-			    _mm256_store_ps(&y_addr[frame], in_sig);
-		    }
+            kernel(y_ptr.GetAddr(node), x_ptr.GetAddr(node), frame_stride);
 		}
         return m_y;
     }
@@ -263,29 +262,19 @@ inline FrameBuffer ReLU<float>::Backward(FrameBuffer dy)
 #endif
 
     {
-        // AVX
-        index_t frame_size = m_dx.GetFrameSize();
-        index_t node_size = m_dx.GetNodeSize();
+        // SIMD版(実行時に命令セットを選択)
+        index_t node_size    = m_dx.GetNodeSize();
+        index_t frame_stride = m_dx.GetFrameStride() / sizeof(float);
 
-        auto x_ptr  = m_x.LockConst<float>();
 	    auto y_ptr  = m_y.LockConst<float>();
 	    auto dy_ptr = dy.LockConst<float>();
 	    auto dx_ptr = m_dx.Lock<float>(true);
 
-        index_t  m256_frame_size = (int)(((frame_size + 7) / 8) * 8);
+        auto kernel = BB_SIMD_KERNEL(ReLU_Backward);
 
-		__m256 zero = _mm256_set1_ps(0);
+        #pragma omp parallel for
 		for (index_t node = 0; node < node_size; ++node) {
-			auto y_addr  = (float *)y_ptr.GetAddr(node);
-			auto dy_addr = (float *)dy_ptr.GetAddr(node);
-			auto dx_addr = (float *)dx_ptr.GetAddr(node);
-			for (index_t frame = 0; frame < m256_frame_size; frame += 8) {
-				__m256 y    = _mm256_load_ps(&y_addr[frame]);
-				__m256 dy   = _mm256_load_ps(&dy_addr[frame]);
-				__m256 mask = _mm256_cmp_ps(y, zero, _CMP_GT_OS);
-				__m256 dx   = _mm256_and_ps(dy, mask);
-				_mm256_store_ps(&dx_addr[frame], dx);
-			}
+            kernel(dx_ptr.GetAddr(node), y_ptr.GetAddr(node), dy_ptr.GetAddr(node), frame_stride);
 		}
         return m_dx;
     }
@@ -11,9 +11,13 @@
 #pragma once
 
 #include <random>
+#include <vector>
+#include <type_traits>
 
 #include "bb/Model.h"
 #include "bb/ValueGenerator.h"
+#include "bb/PhiloxGenerator.h"
+#include "bb/SimdKernel.h"
 
 
 namespace bb {
@@ -26,6 +30,8 @@ namespace bb {
  *          入力に対して出力は frame_mux_size 倍のフレーム数となる
  *          入力値に応じて 0と1 を確率的に発生させることを目的としている
  *          RealToBinary と組み合わせて使う想定
+ *          FP32入力で、閾値が固定ステップか PhiloxGenerator の場合は、ノード並列の SIMD版で処理する
+ *          (PhiloxGenerator の乱数は (フレーム, ノード) の位置で決まるのでスレッド数によらず同じ結果になる)
  * 
  * @tparam FXT  foward入力型 (x)
  * @tparam FXT  foward出力型 (y)
@@ -137,6 +143,15 @@ public:
         // 戻り値の型を設定
         m_y.Resize(DataType<FYT>::type, x.GetFrameSize() * m_frame_mux_size, m_node_shape);
 
+        // SIMD版
+        if ( std::is_same<FXT, float>::value && (DataType<FYT>::type == BB_TYPE_FP32 || DataType<FYT>::type == BB_TYPE_BIT) ) {
+            auto philox = std::dynamic_pointer_cast< PhiloxGenerator<FXT> >(m_value_generator);
+            if ( m_value_generator == nullptr || philox ) {
+                ForwardSimd(x, philox);
+                return m_y;
+            }
+        }
+
 		index_t node_size        = x.GetNodeSize();
 		index_t input_frame_size = x.GetFrameSize();
 
@@ -181,6 +196,75 @@ public:
 	}
 
 
+protected:
+    void ForwardSimd(FrameBuffer const &x, std::shared_ptr< PhiloxGenerator<FXT> > philox)
+    {
+		index_t node_size         = x.GetNodeSize();
+		index_t input_frame_size  = x.GetFrameSize();
+		index_t output_frame_size = input_frame_size * m_frame_mux_size;
+        if ( output_frame_size <= 0 ) {
+            return;
+        }
+
+        // フレーム毎の閾値は全ノード共通なので先に作る
+        std::vector<float> th_frame;
+        std::uint64_t      th_index = 0;
+        if ( philox == nullptr ) {
+            FXT th_step = (m_input_range_hi - m_input_range_lo) / (FXT)(m_frame_mux_size + 1);
+            th_frame.resize(output_frame_size);
+            for ( index_t frame = 0; frame < output_frame_size; ++frame ) {
+                th_frame[frame] = (float)(m_input_range_lo + (th_step * (FXT)(frame % m_frame_mux_size + 1)));
+            }
+        }
+        else if ( m_framewise ) {
+            th_frame.resize(output_frame_size);
+            philox->GetValues((FXT *)&th_frame[0], output_frame_size);
+        }
+        else {
+            // データ毎の乱数は ノード番号 * 出力フレーム数 + 出力フレーム番号 の位置を使う
+            th_index = philox->Advance((std::uint64_t)node_size * (std::uint64_t)output_frame_size);
+        }
+
+        auto x_ptr = x.LockConst<float>();
+        auto y_ptr = m_y.Lock<FYT>(true);
+
+        bool bit_output = (DataType<FYT>::type == BB_TYPE_BIT);
+        auto fp32_kernel = BB_SIMD_KERNEL(RealToBinary_ForwardFp32);
+        auto bit_kernel  = BB_SIMD_KERNEL(RealToBinary_ForwardBit);
+
+        #pragma omp parallel
+        {
+            std::vector<float> x_buf(m_frame_mux_size > 1 ? output_frame_size : 0);
+            std::vector<float> th_buf(th_frame.empty() ? output_frame_size : 0);
+
+            #pragma omp for
+            for ( index_t node = 0; node < node_size; ++node ) {
+                // 出力フレームの並びに展開
+                float const *x_addr = x_ptr.GetAddr(node);
+                if ( m_frame_mux_size > 1 ) {
+                    for ( index_t frame = 0; frame < output_frame_size; ++frame ) {
+                        x_buf[frame] = x_addr[frame / m_frame_mux_size];
+                    }
+                    x_addr = &x_buf[0];
+                }
+
+                float const *th_addr = th_frame.empty() ? nullptr : &th_frame[0];
+                if ( th_addr == nullptr ) {
+                    philox->Generate(th_index + (std::uint64_t)node * (std::uint64_t)output_frame_size, (FXT *)&th_buf[0], output_frame_size);
+                    th_addr = &th_buf[0];
+                }
+
+                if ( bit_output ) {
+                    bit_kernel((std::int32_t *)y_ptr.GetAddr(node), x_addr, th_addr, output_frame_size);
+                }
+                else {
+                    fp32_kernel((float *)y_ptr.GetAddr(node), x_addr, th_addr, output_frame_size);
+                }
+            }
+        }
+    }
+
+public:
 	FrameBuffer Backward(FrameBuffer dy)
 	{
         BB_ASSERT(dy.GetType() == DataType<BT>::type);
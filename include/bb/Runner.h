@@ -21,6 +21,9 @@
 #include "bb/MetricsFunction.h"
 #include "bb/Optimizer.h"
 #include "bb/Utility.h"
+#include "bb/Profiler.h"
+#include "bb/DataSet.h"
+#include "bb/DataLoader.h"
 
 
 namespace bb {
@@ -31,7 +34,8 @@ template <typename T>
 class Runner
 {
 protected:
-    using callback_proc_t = void (*)(std::shared_ptr< Model >, void*);
+    using callback_proc_t     = void (*)(std::shared_ptr< Model >, void*);
+    using augmentation_proc_t = typename DataLoader<T>::augmentation_proc_t;
 
     std::string                         m_name;
     std::shared_ptr<Model>              m_net;
@@ -55,6 +59,10 @@ protected:
 	
     callback_proc_t                     m_callback_proc = nullptr;
 	void                                *m_callback_user = 0;
+
+    augmentation_proc_t                 m_augmentation_proc = nullptr;
+    void                                *m_augmentation_user = nullptr;
+    std::shared_ptr< DataLoader<T> >    m_loader;
     
 protected:
     // コンストラクタ
@@ -79,6 +87,10 @@ public:
         std::int64_t                        seed = 1;                           //< 乱数初期値
 	    callback_proc_t                     callback_proc = nullptr;            //< コールバック関数
 	    void*                               callback_user = 0;                  //< コールバック関数のユーザーパラメータ
+        index_t                             prefetch_size = 2;                  //< 先行生成するミニバッチ数(0で先行生成しない)
+        index_t                             prefetch_thread_size = 1;           //< 先行生成のスレッド数
+        augmentation_proc_t                 augmentation_proc = nullptr;        //< 学習時のデータ拡張関数
+        void*                               augmentation_user = nullptr;        //< データ拡張関数のユーザーパラメータ
     };
 
     static std::shared_ptr<Runner> Create(create_t const &create)
@@ -101,6 +113,17 @@ public:
 	    self->m_initial_evaluation      = create.initial_evaluation;
 	    self->m_callback_proc           = create.callback_proc;
 	    self->m_callback_user           = create.callback_user;
+        self->m_augmentation_proc       = create.augmentation_proc;
+        self->m_augmentation_user       = create.augmentation_user;
+
+        if ( create.prefetch_size > 0 ) {
+            typename DataLoader<T>::create_t loader_create;
+            loader_create.queue_size        = create.prefetch_size;
+            loader_create.thread_size       = create.prefetch_thread_size;
+            loader_create.augmentation_proc = create.augmentation_proc;
+            loader_create.augmentation_user = create.augmentation_user;
+            self->m_loader = DataLoader<T>::Create(loader_create);
+        }
         
         self->m_mt.seed(create.seed);
 
@@ -174,6 +197,18 @@ public:
         m_callback_proc = callback_proc;
 	    m_callback_user = user;
     }
+
+    void SetAugmentation(augmentation_proc_t augmentation_proc, void *user)
+    {
+        m_augmentation_proc = augmentation_proc;
+        m_augmentation_user = user;
+        if ( m_loader ) {
+            m_loader->SetAugmentation(augmentation_proc, user);
+        }
+    }
+
+    // 先行生成の統計(キュー段数, 待ち回数/時間)の参照用 (先行生成しない場合は nullptr)
+    std::shared_ptr< DataLoader<T> > GetDataLoader(void) const { return m_loader; }
     
 
     // Serialize
@@ -254,6 +289,52 @@ public:
 		    index_t      epoch_size,
 		    index_t      batch_size
         )
+    {
+        FittingProc(td, epoch_size, batch_size);
+    }
+
+	void Fitting(
+            DataSet<T>   &td,
+		    index_t      epoch_size,
+		    index_t      batch_size
+        )
+    {
+        FittingProc(td, epoch_size, batch_size);
+    }
+
+	double Evaluation(
+            TrainData<T> &td,
+		    index_t      batch_size
+        )
+    {
+        return Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
+    }
+
+	double Evaluation(
+            DataSet<T>   &td,
+		    index_t      batch_size
+        )
+    {
+        return Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
+    }
+
+    
+protected:
+    // 学習データの参照 (DataSet は参照順を通して読み出す)
+    static SampleSource<T> TrainX(TrainData<T> const &td) { return SampleSource<T>(td.x_train); }
+    static SampleSource<T> TrainT(TrainData<T> const &td) { return SampleSource<T>(td.t_train); }
+    static SampleSource<T> TrainX(DataSet<T> const &td)   { return SampleSource<T>(td.x_train, &td.train_order); }
+    static SampleSource<T> TrainT(DataSet<T> const &td)   { return SampleSource<T>(td.t_train, &td.train_order); }
+
+    static void Shuffle(TrainData<T> &td, std::uint64_t seed) { ShuffleDataSet(seed, td.x_train, td.t_train); }
+    static void Shuffle(DataSet<T> &td, std::uint64_t seed)   { td.Shuffle(seed); }
+
+    template <class DataSetTp>
+	void FittingProc(
+            DataSetTp    &td,
+		    index_t      epoch_size,
+		    index_t      batch_size
+        )
     {
 		std::string csv_file_name = m_name + "_metrics.txt";
 		std::string log_file_name = m_name + "_log.txt";
@@ -304,7 +385,7 @@ public:
 			// 初期評価
 			if (m_initial_evaluation) {
 				auto test_metrics  = Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
-				auto train_metrics = Calculation(td.x_train, td.x_shape, td.t_train, td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
+				auto train_metrics = Calculation(TrainX(td), td.x_shape, TrainT(td), td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
 				log_stream << "[initial] "
 					<< "test " << m_metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << test_metrics  << " "
 					<< "train " << m_metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << train_metrics << std::endl;
@@ -315,7 +396,7 @@ public:
 
 			for (int epoch = 0; epoch < epoch_size; ++epoch) {
 				// 学習実施
-				auto train_accuracy = Calculation(td.x_train, td.x_shape, td.t_train, td.t_shape, batch_size, batch_size,
+				auto train_accuracy = Calculation(TrainX(td), td.x_shape, TrainT(td), td.t_shape, batch_size, batch_size,
                                         m_metricsFunc, m_lossFunc, m_optimizer, true, m_print_progress, m_print_progress_loss, m_print_progress_accuracy);
 
 				// ネット保存
@@ -355,7 +436,7 @@ public:
                 {
 				    double now_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start_time).count() / 1000.0;
 				    auto test_metrics  = Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
-				    auto train_metrics = Calculation(td.x_train, td.x_shape, td.t_train, td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
+				    auto train_metrics = Calculation(TrainX(td), td.x_shape, TrainT(td), td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
 				    log_stream	<< std::setw(10) << std::fixed << std::setprecision(2) << now_time << "s "
 							    << "epoch[" << std::setw(3) << epoch + 1 + prev_epoch << "] "
 							    << "test "  << m_metricsFunc->GetMetricsString() << " : " << std::setw(6) << std::fixed << std::setprecision(4) << test_metrics  << " "
@@ -368,7 +449,7 @@ public:
 				}
 
 				// Shuffle
-				ShuffleDataSet(m_mt(), td.x_train, td.t_train);
+				Shuffle(td, m_mt());
 			}
 
 			// 終了メッセージ
@@ -377,20 +458,10 @@ public:
 	}
 
 
-	double Evaluation(
-            TrainData<T> &td,
-		    index_t      batch_size
-        )
-    {
-        return Calculation(td.x_test,  td.x_shape, td.t_test,  td.t_shape, batch_size, 0, m_metricsFunc, nullptr, nullptr, false, m_print_progress);
-    }
-
-    
-protected:
     double Calculation(
-                std::vector< std::vector<T> > const &x,
+                SampleSource<T> x,
                 indices_t x_shape,
-                std::vector< std::vector<T> > const &t,
+                SampleSource<T> t,
                 indices_t t_shape,
 		        index_t max_batch_size,
 		        index_t min_batch_size,
@@ -404,7 +475,7 @@ protected:
             )
 
     {
-        BB_ASSERT(x.size() == t.size());
+        BB_ASSERT(x.GetSize() == t.GetSize());
 
         if ( metricsFunc  != nullptr ) {
             metricsFunc->Clear();
@@ -413,11 +484,20 @@ protected:
             lossFunc->Clear();
         }
         
-        index_t frame_size = (index_t)x.size();
+        index_t frame_size = x.GetSize();
         
         FrameBuffer x_buf;
         FrameBuffer t_buf;
 
+        // データ拡張は学習時のみ
+        bool          augmentation = (train && m_augmentation_proc != nullptr);
+        std::uint64_t seed         = augmentation ? m_mt() : 0;
+
+        // 次のミニバッチを先行生成させる
+        if ( m_loader ) {
+            m_loader->Start(x, x_shape, t, t_shape, max_batch_size, min_batch_size, augmentation, seed);
+        }
+
         bb::index_t index = 0;
         while ( index < frame_size )
         {
@@ -429,16 +509,27 @@ protected:
                 break;
             }
 
-            // 学習データセット
-            x_buf.Resize(DataType<T>::type, mini_batch_size, x_shape);
-            x_buf.SetVector(x, index);
+            // 学習データと期待値データセット
+            if ( m_loader ) {
+                m_loader->Pop(x_buf, t_buf);
+            }
+            else {
+                x_buf.Resize(DataType<T>::type, mini_batch_size, x_shape);
+                x.CopyTo(x_buf, index);
+                t_buf.Resize(DataType<T>::type, mini_batch_size, t_shape);
+                t.CopyTo(t_buf, index);
+                if ( augmentation ) {
+                    m_augmentation_proc(x_buf, t_buf, seed + (std::uint64_t)(index / max_batch_size), m_augmentation_user);
+                }
+            }
 
             // Forward
-            auto y_buf = m_net->Forward(x_buf, train);
-
-            // 期待値データセット
-            t_buf.Resize(DataType<T>::type, mini_batch_size, t_shape);
-            t_buf.SetVector(t, index);
+            FrameBuffer y_buf;
+            {
+                Profiler::Scope prof(m_net, "forward");
+                y_buf = m_net->Forward(x_buf, train);
+                prof.SetOutput(y_buf);
+            }
 
 			// 進捗表示
 			if ( print_progress ) {
@@ -449,17 +540,25 @@ protected:
             
             FrameBuffer dy_buf;
             if ( lossFunc != nullptr ) {
+                Profiler::Scope prof("loss", "loss", lossFunc.get());
                 dy_buf = lossFunc->CalculateLoss(y_buf, t_buf);
+                prof.SetOutput(dy_buf);
             }
 
             if ( metricsFunc != nullptr ) {
+                Profiler::Scope prof("metrics", "metrics", metricsFunc.get());
                 metricsFunc->CalculateMetrics(y_buf, t_buf);
             }
 
             if ( train && lossFunc != nullptr ) {
-                auto dx = m_net->Backward(dy_buf);
+                {
+                    Profiler::Scope prof(m_net, "backward");
+                    auto dx = m_net->Backward(dy_buf);
+                    prof.SetOutput(dx);
+                }
                 
                 if ( optimizer != nullptr ) {
+                    Profiler::Scope prof("optimizer", "optimizer", optimizer.get());
                     optimizer->Update();
                 }
             }
@@ -481,6 +580,10 @@ protected:
             index += mini_batch_size;
         }
 
+        if ( m_loader ) {
+            m_loader->Stop();
+        }
+
         std::cout << "\r                                                                               \r" << std::flush;
 
         return metricsFunc->GetMetrics();
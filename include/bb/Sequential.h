@@ -13,6 +13,8 @@
 
 
 #include "bb/Model.h"
+#include "bb/MemoryPlanner.h"
+#include "bb/Profiler.h"
 
 
 namespace bb {
@@ -24,9 +26,32 @@ class Sequential : public Model
 protected:
 	std::vector< std::shared_ptr<Model> > m_layers;
 
+    bool                                    m_memory_plan = false;
+    std::shared_ptr<MemoryPlanner>          m_memory_planner;
+
 protected:
     Sequential() {}
 
+    /**
+     * @brief  コマンド処理
+     * @detail コマンド処理
+     * @param  args   コマンド
+     */
+	void CommandProc(std::vector<std::string> args)
+	{
+        // 学習時のメモリ計画の有効化 (Forward(train) ～ Backward のバッファをアリーナ上で再利用する)
+        if (args.size() == 2 && args[0] == "memory_plan")
+        {
+            m_memory_plan = EvalBool(args[1]);
+            if ( m_memory_plan && !m_memory_planner ) {
+                m_memory_planner = std::make_shared<MemoryPlanner>();
+            }
+            if ( !m_memory_plan ) {
+                m_memory_planner.reset();
+            }
+        }
+	}
+
 public:
     /**
      * @brief  デストラクタ(仮想関数)
@@ -65,6 +90,18 @@ public:
     {
         return m_layers[index];
     }
+
+    //! レイヤーの差し替え(融合パスなどのグラフ書き換え用)
+    void Set(int index, std::shared_ptr<Model> layer)
+    {
+        m_layers[index] = layer;
+    }
+
+    //! レイヤーの削除
+    void Remove(int index)
+    {
+        m_layers.erase(m_layers.begin() + index);
+    }
 	
     /**
      * @brief  コマンドを送る
@@ -72,6 +109,7 @@ public:
      */   
     void SendCommand(std::string command, std::string send_to = "all")
     {
+        Model::SendCommand(command, send_to);
         for (auto layer : m_layers) {
             layer->SendCommand(command, send_to);
         }
@@ -142,7 +180,7 @@ public:
     indices_t GetOutputShape(void) const
     {
         if ( m_layers.empty() ) { return indices_t(); }
-        return m_layers.back()->GetInputShape();
+        return m_layers.back()->GetOutputShape();
     }
     
 
@@ -155,8 +193,18 @@ public:
      */
     FrameBuffer Forward(FrameBuffer x, bool train = true)
     {
+        if ( m_memory_planner ) {
+            // 前回の区間を閉じて、学習時のみ新しい区間を開始
+            m_memory_planner->End();
+            if ( train ) {
+                m_memory_planner->Begin();
+            }
+        }
+
         for (auto layer : m_layers) {
+            Profiler::Scope prof(layer, "forward");
             x = layer->Forward(x, train);
+            prof.SetOutput(x);
         }
         return x;
     }
@@ -170,10 +218,42 @@ public:
     FrameBuffer Backward(FrameBuffer dy)
     {
         for (auto it = m_layers.rbegin(); it != m_layers.rend(); ++it) {
+            Profiler::Scope prof(*it, "backward");
             dy = (*it)->Backward(dy);
+            prof.SetOutput(dy);
+        }
+
+        if ( m_memory_planner ) {
+            // 戻り値は区間の終わりまで生存しているものとして扱う
+            if ( m_memory_planner->IsActive() && !dy.IsDeviceAvailable() ) {
+                dy.LockMemoryConst();
+            }
+            m_memory_planner->End();
         }
+
         return dy; 
     }
+
+    /**
+     * @brief  メモリ計画のピークサイズ取得
+     * @detail memory_plan 有効時に、計画したアリーナのサイズ(バイト単位)を返す
+     *         計画前は 0 を返す
+     */
+    size_t GetMemoryPlanPeakSize(void) const
+    {
+        if ( !m_memory_planner || !m_memory_planner->IsPlanned() ) { return 0; }
+        return m_memory_planner->GetPeakSize();
+    }
+
+    /**
+     * @brief  メモリ計画対象の総サイズ取得
+     * @detail memory_plan 有効時に、計画対象となった確保の合計サイズ(再利用しない場合の必要量)を返す
+     */
+    size_t GetMemoryPlanTotalSize(void) const
+    {
+        if ( !m_memory_planner || !m_memory_planner->IsPlanned() ) { return 0; }
+        return m_memory_planner->GetTotalSize();
+    }
 	
 protected:
     /**
@@ -0,0 +1,395 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+
+
+// -------------------------------------
+//  実行時に命令セットを切り替える層の演算カーネル
+// -------------------------------------
+//  カーネル本体(bb/SimdKernelBody.h)は命令セット毎のベクトル型 Simd を使って1度だけ書き、
+//  このファイルで scalar / SSE4.2 / AVX2 / AVX-512 の名前空間に1回ずつ展開する。
+//  AVX2 等は #pragma で関数単位の target を指定して展開するので、-mavx2 無しでも全レベルを持てる。
+//  呼び出し側は BB_SIMD_KERNEL(名前) で bb_simd_get_level() に応じた関数を得る。
+//
+//  Simd の共通インターフェース
+//    N                             float の要素数
+//    NW                            32bit ワードの要素数 (Bit データ用)
+//    Load / Store                  N 要素の読み書き
+//    LoadN / StoreN                先頭 n 要素のみの読み書き(読み出しの残りは 0)
+//    SelectGt(a, b, v)             a > b  なら v, それ以外 0
+//    SelectEq(a, b, v)             a == b なら v, それ以外 0
+//    MaskGt(a, b)                  a > b の要素をビットで返す (要素 i が bit i)
+//    Popcnt(w)                     32bit ワードの 1 のビット数
+//    IBits(w)                      w の下位 N ビットを要素毎の 0/1 の整数にする (要素 i が bit i)
+//    ICvt(a)                       整数から float への変換
+//    LutIndex(index, x, bit)       x != 0 なら index の bit ビット目を立てる
+//    LutLookup(table, index)       256bit テーブルの index ビット目が 1 なら 1.0f, それ以外 0
+
+
+
+namespace bb {
+namespace simd_scalar {
+
+struct Simd
+{
+    static int const N  = 1;
+    static int const NW = 1;
+    typedef float           vec;
+    typedef std::int32_t    ivec;
+
+    static vec   Zero(void)                         { return 0.0f; }
+    static vec   Set1(float a)                      { return a; }
+    static vec   Load(float const *p)               { return *p; }
+    static void  Store(float *p, vec a)             { *p = a; }
+    static vec   LoadN(float const *p, int n)       { return (n > 0) ? *p : 0.0f; }
+    static void  StoreN(float *p, vec a, int n)     { if ( n > 0 ) { *p = a; } }
+    static vec   Add(vec a, vec b)                  { return a + b; }
+    static vec   Sub(vec a, vec b)                  { return a - b; }
+    static vec   Mul(vec a, vec b)                  { return a * b; }
+    static vec   Max(vec a, vec b)                  { return (a > b) ? a : b; }
+    static vec   FMAdd(vec a, vec b, vec c)         { return a * b + c; }
+    static vec   FMSub(vec a, vec b, vec c)         { return a * b - c; }
+    static vec   FNMAdd(vec a, vec b, vec c)        { return c - a * b; }
+    static vec   SelectGt(vec a, vec b, vec v)      { return (a > b)  ? v : 0.0f; }
+    static vec   SelectEq(vec a, vec b, vec v)      { return (a == b) ? v : 0.0f; }
+    static int   MaskGt(vec a, vec b)               { return (a > b) ? 1 : 0; }
+    static int   Popcnt(std::uint32_t w)
+    {
+        w = w - ((w >> 1) & 0x55555555);
+        w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+        w = (w + (w >> 4)) & 0x0f0f0f0f;
+        return (int)((w * 0x01010101) >> 24);
+    }
+    static float Hsum(vec a)                        { return a; }
+
+    static ivec  ISet1(std::int32_t a)                          { return a; }
+    static ivec  ILoad(std::int32_t const *p)                   { return *p; }
+    static void  IStore(std::int32_t *p, ivec a)                { *p = a; }
+    static ivec  ILoadN(std::int32_t const *p, int n)           { return (n > 0) ? *p : 0; }
+    static void  IStoreN(std::int32_t *p, ivec a, int n)        { if ( n > 0 ) { *p = a; } }
+    static ivec  IAnd(ivec a, ivec b)                           { return a & b; }
+    static ivec  IOr(ivec a, ivec b)                            { return a | b; }
+    static ivec  IXor(ivec a, ivec b)                           { return a ^ b; }
+    static ivec  IAdd(ivec a, ivec b)                           { return a + b; }
+    static ivec  IBits(std::uint32_t w)                         { return (ivec)(w & 1); }
+    static vec   ICvt(ivec a)                                   { return (float)a; }
+
+    static ivec  LutIndex(ivec index, vec x, int bit)           { return (x != 0.0f) ? (index | (1 << bit)) : index; }
+    static vec   LutLookup(std::int32_t const table[8], ivec index)
+    {
+        return (((std::uint32_t)table[index >> 5] >> (index & 31)) & 1) ? 1.0f : 0.0f;
+    }
+};
+
+#include "bb/SimdKernelBody.h"
+
+}
+}
+
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse4.2,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#endif
+
+namespace bb {
+namespace simd_sse42 {
+
+struct Simd
+{
+    static int const N  = 4;
+    static int const NW = 4;
+    typedef __m128  vec;
+    typedef __m128i ivec;
+
+    static vec   Zero(void)                         { return _mm_setzero_ps(); }
+    static vec   Set1(float a)                      { return _mm_set1_ps(a); }
+    static vec   Load(float const *p)               { return _mm_loadu_ps(p); }
+    static void  Store(float *p, vec a)             { _mm_storeu_ps(p, a); }
+    static vec   LoadN(float const *p, int n)
+    {
+        float tmp[4] = {0, 0, 0, 0};
+        for ( int i = 0; i < n; ++i ) { tmp[i] = p[i]; }
+        return _mm_loadu_ps(tmp);
+    }
+    static void  StoreN(float *p, vec a, int n)
+    {
+        float tmp[4];
+        _mm_storeu_ps(tmp, a);
+        for ( int i = 0; i < n; ++i ) { p[i] = tmp[i]; }
+    }
+    static vec   Add(vec a, vec b)                  { return _mm_add_ps(a, b); }
+    static vec   Sub(vec a, vec b)                  { return _mm_sub_ps(a, b); }
+    static vec   Mul(vec a, vec b)                  { return _mm_mul_ps(a, b); }
+    static vec   Max(vec a, vec b)                  { return _mm_max_ps(a, b); }
+    static vec   FMAdd(vec a, vec b, vec c)         { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static vec   FMSub(vec a, vec b, vec c)         { return _mm_sub_ps(_mm_mul_ps(a, b), c); }
+    static vec   FNMAdd(vec a, vec b, vec c)        { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+    static vec   SelectGt(vec a, vec b, vec v)      { return _mm_and_ps(_mm_cmpgt_ps(a, b), v); }
+    static int   MaskGt(vec a, vec b)               { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+    static int   Popcnt(std::uint32_t w)            { return (int)_mm_popcnt_u32(w); }
+    static vec   SelectEq(vec a, vec b, vec v)      { return _mm_and_ps(_mm_cmpeq_ps(a, b), v); }
+    static float Hsum(vec a)
+    {
+        a = _mm_hadd_ps(a, a);
+        a = _mm_hadd_ps(a, a);
+        return _mm_cvtss_f32(a);
+    }
+
+    static ivec  ISet1(std::int32_t a)                          { return _mm_set1_epi32(a); }
+    static ivec  ILoad(std::int32_t const *p)                   { return _mm_loadu_si128((__m128i const *)p); }
+    static void  IStore(std::int32_t *p, ivec a)                { _mm_storeu_si128((__m128i *)p, a); }
+    static ivec  ILoadN(std::int32_t const *p, int n)
+    {
+        std::int32_t tmp[4] = {0, 0, 0, 0};
+        for ( int i = 0; i < n; ++i ) { tmp[i] = p[i]; }
+        return _mm_loadu_si128((__m128i const *)tmp);
+    }
+    static void  IStoreN(std::int32_t *p, ivec a, int n)
+    {
+        std::int32_t tmp[4];
+        _mm_storeu_si128((__m128i *)tmp, a);
+        for ( int i = 0; i < n; ++i ) { p[i] = tmp[i]; }
+    }
+    static ivec  IAnd(ivec a, ivec b)                           { return _mm_and_si128(a, b); }
+    static ivec  IOr(ivec a, ivec b)                            { return _mm_or_si128(a, b); }
+    static ivec  IXor(ivec a, ivec b)                           { return _mm_xor_si128(a, b); }
+    static ivec  IAdd(ivec a, ivec b)                           { return _mm_add_epi32(a, b); }
+    static ivec  IBits(std::uint32_t w)
+    {
+        __m128i bit = _mm_and_si128(_mm_set1_epi32((int)w), _mm_setr_epi32(1, 2, 4, 8));
+        return _mm_min_epu32(bit, _mm_set1_epi32(1));
+    }
+    static vec   ICvt(ivec a)                                   { return _mm_cvtepi32_ps(a); }
+
+    static ivec  LutIndex(ivec index, vec x, int bit)
+    {
+        __m128i m = _mm_castps_si128(_mm_cmpneq_ps(x, _mm_setzero_ps()));
+        return _mm_or_si128(index, _mm_and_si128(m, _mm_set1_epi32(1 << bit)));
+    }
+    static vec   LutLookup(std::int32_t const table[8], ivec index)
+    {
+        // 可変シフトが無いので要素毎に引く
+        std::int32_t idx[4];
+        float        y[4];
+        _mm_storeu_si128((__m128i *)idx, index);
+        for ( int i = 0; i < 4; ++i ) {
+            y[i] = (((std::uint32_t)table[idx[i] >> 5] >> (idx[i] & 31)) & 1) ? 1.0f : 0.0f;
+        }
+        return _mm_loadu_ps(y);
+    }
+};
+
+#include "bb/SimdKernelBody.h"
+
+}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,popcnt")
+#endif
+
+namespace bb {
+namespace simd_avx2 {
+
+struct Simd
+{
+    static int const N  = 8;
+    static int const NW = 8;
+    typedef __m256  vec;
+    typedef __m256i ivec;
+
+    static __m256i Mask(int n)                      { return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)); }
+
+    static vec   Zero(void)                         { return _mm256_setzero_ps(); }
+    static vec   Set1(float a)                      { return _mm256_set1_ps(a); }
+    static vec   Load(float const *p)               { return _mm256_loadu_ps(p); }
+    static void  Store(float *p, vec a)             { _mm256_storeu_ps(p, a); }
+    static vec   LoadN(float const *p, int n)       { return _mm256_maskload_ps(p, Mask(n)); }
+    static void  StoreN(float *p, vec a, int n)     { _mm256_maskstore_ps(p, Mask(n), a); }
+    static vec   Add(vec a, vec b)                  { return _mm256_add_ps(a, b); }
+    static vec   Sub(vec a, vec b)                  { return _mm256_sub_ps(a, b); }
+    static vec   Mul(vec a, vec b)                  { return _mm256_mul_ps(a, b); }
+    static vec   Max(vec a, vec b)                  { return _mm256_max_ps(a, b); }
+    static vec   FMAdd(vec a, vec b, vec c)         { return _mm256_fmadd_ps(a, b, c); }
+    static vec   FMSub(vec a, vec b, vec c)         { return _mm256_fmsub_ps(a, b, c); }
+    static vec   FNMAdd(vec a, vec b, vec c)        { return _mm256_fnmadd_ps(a, b, c); }
+    static vec   SelectGt(vec a, vec b, vec v)      { return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_GT_OS), v); }
+    static int   MaskGt(vec a, vec b)               { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OS)); }
+    static int   Popcnt(std::uint32_t w)            { return (int)_mm_popcnt_u32(w); }
+    static vec   SelectEq(vec a, vec b, vec v)      { return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ), v); }
+    static float Hsum(vec a)
+    {
+        __m128 r = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        r = _mm_hadd_ps(r, r);
+        r = _mm_hadd_ps(r, r);
+        return _mm_cvtss_f32(r);
+    }
+
+    static ivec  ISet1(std::int32_t a)                          { return _mm256_set1_epi32(a); }
+    static ivec  ILoad(std::int32_t const *p)                   { return _mm256_loadu_si256((__m256i const *)p); }
+    static void  IStore(std::int32_t *p, ivec a)                { _mm256_storeu_si256((__m256i *)p, a); }
+    static ivec  ILoadN(std::int32_t const *p, int n)           { return _mm256_maskload_epi32((int const *)p, Mask(n)); }
+    static void  IStoreN(std::int32_t *p, ivec a, int n)        { _mm256_maskstore_epi32((int *)p, Mask(n), a); }
+    static ivec  IAnd(ivec a, ivec b)                           { return _mm256_and_si256(a, b); }
+    static ivec  IOr(ivec a, ivec b)                            { return _mm256_or_si256(a, b); }
+    static ivec  IXor(ivec a, ivec b)                           { return _mm256_xor_si256(a, b); }
+    static ivec  IAdd(ivec a, ivec b)                           { return _mm256_add_epi32(a, b); }
+    static ivec  IBits(std::uint32_t w)
+    {
+        __m256i bit = _mm256_srlv_epi32(_mm256_set1_epi32((int)w), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        return _mm256_and_si256(bit, _mm256_set1_epi32(1));
+    }
+    static vec   ICvt(ivec a)                                   { return _mm256_cvtepi32_ps(a); }
+
+    static ivec  LutIndex(ivec index, vec x, int bit)
+    {
+        __m256i m = _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+        return _mm256_or_si256(index, _mm256_and_si256(m, _mm256_set1_epi32(1 << bit)));
+    }
+    static vec   LutLookup(std::int32_t const table[8], ivec index)
+    {
+        __m256i table_v = _mm256_loadu_si256((__m256i const *)table);
+        __m256i word    = _mm256_permutevar8x32_epi32(table_v, _mm256_srli_epi32(index, 5));
+        __m256i bit     = _mm256_srlv_epi32(word, _mm256_and_si256(index, _mm256_set1_epi32(31)));
+        __m256  y       = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(bit, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+        return _mm256_and_ps(y, _mm256_set1_ps(1.0f));
+    }
+};
+
+#include "bb/SimdKernelBody.h"
+
+}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx2,fma,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma,popcnt")
+#endif
+
+namespace bb {
+namespace simd_avx512 {
+
+struct Simd
+{
+    static int const N  = 16;
+    static int const NW = 16;
+    typedef __m512  vec;
+    typedef __m512i ivec;
+
+    static __mmask16 Mask(int n)                    { return (__mmask16)((n >= 16) ? 0xffff : ((1u << n) - 1)); }
+
+    static vec   Zero(void)                         { return _mm512_setzero_ps(); }
+    static vec   Set1(float a)                      { return _mm512_set1_ps(a); }
+    static vec   Load(float const *p)               { return _mm512_loadu_ps(p); }
+    static void  Store(float *p, vec a)             { _mm512_storeu_ps(p, a); }
+    static vec   LoadN(float const *p, int n)       { return _mm512_maskz_loadu_ps(Mask(n), p); }
+    static void  StoreN(float *p, vec a, int n)     { _mm512_mask_storeu_ps(p, Mask(n), a); }
+    static vec   Add(vec a, vec b)                  { return _mm512_add_ps(a, b); }
+    static vec   Sub(vec a, vec b)                  { return _mm512_sub_ps(a, b); }
+    static vec   Mul(vec a, vec b)                  { return _mm512_mul_ps(a, b); }
+    static vec   Max(vec a, vec b)                  { return _mm512_max_ps(a, b); }
+    static vec   FMAdd(vec a, vec b, vec c)         { return _mm512_fmadd_ps(a, b, c); }
+    static vec   FMSub(vec a, vec b, vec c)         { return _mm512_fmsub_ps(a, b, c); }
+    static vec   FNMAdd(vec a, vec b, vec c)        { return _mm512_fnmadd_ps(a, b, c); }
+    static vec   SelectGt(vec a, vec b, vec v)      { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OS), v); }
+    static int   MaskGt(vec a, vec b)               { return (int)_mm512_cmp_ps_mask(a, b, _CMP_GT_OS); }
+    static int   Popcnt(std::uint32_t w)            { return (int)_mm_popcnt_u32(w); }
+    static vec   SelectEq(vec a, vec b, vec v)      { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ), v); }
+    static float Hsum(vec a)                        { return _mm512_reduce_add_ps(a); }
+
+    static ivec  ISet1(std::int32_t a)                          { return _mm512_set1_epi32(a); }
+    static ivec  ILoad(std::int32_t const *p)                   { return _mm512_loadu_si512(p); }
+    static void  IStore(std::int32_t *p, ivec a)                { _mm512_storeu_si512(p, a); }
+    static ivec  ILoadN(std::int32_t const *p, int n)           { return _mm512_maskz_loadu_epi32(Mask(n), p); }
+    static void  IStoreN(std::int32_t *p, ivec a, int n)        { _mm512_mask_storeu_epi32(p, Mask(n), a); }
+    static ivec  IAnd(ivec a, ivec b)                           { return _mm512_and_si512(a, b); }
+    static ivec  IOr(ivec a, ivec b)                            { return _mm512_or_si512(a, b); }
+    static ivec  IXor(ivec a, ivec b)                           { return _mm512_xor_si512(a, b); }
+    static ivec  IAdd(ivec a, ivec b)                           { return _mm512_add_epi32(a, b); }
+    static ivec  IBits(std::uint32_t w)                         { return _mm512_maskz_set1_epi32((__mmask16)w, 1); }
+    static vec   ICvt(ivec a)                                   { return _mm512_cvtepi32_ps(a); }
+
+    static ivec  LutIndex(ivec index, vec x, int bit)
+    {
+        __mmask16 m = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_NEQ_UQ);
+        return _mm512_mask_or_epi32(index, m, index, _mm512_set1_epi32(1 << bit));
+    }
+    static vec   LutLookup(std::int32_t const table[8], ivec index)
+    {
+        __m512i table_v = _mm512_inserti64x4(_mm512_setzero_si512(), _mm256_loadu_si256((__m256i const *)table), 0);
+        __m512i word    = _mm512_permutexvar_epi32(_mm512_srli_epi32(index, 5), table_v);
+        __m512i bit     = _mm512_srlv_epi32(word, _mm512_and_si512(index, _mm512_set1_epi32(31)));
+        return _mm512_maskz_mov_ps(_mm512_test_epi32_mask(bit, _mm512_set1_epi32(1)), _mm512_set1_ps(1.0f));
+    }
+};
+
+#include "bb/SimdKernelBody.h"
+
+}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+
+namespace bb {
+
+// 命令セット毎の実装から現在のレベルのものを選ぶ
+template <typename F>
+inline F SimdKernel_Select(F scalar, F sse42, F avx2, F avx512, int level = bb_simd_get_level())
+{
+    switch ( level ) {
+    case BB_SIMD_AVX512F:   return avx512;
+    case BB_SIMD_AVX2:      return avx2;
+    case BB_SIMD_SSE42:     return sse42;
+    default:                return scalar;
+    }
+}
+
+}
+
+// 例) auto forward = BB_SIMD_KERNEL(ReLU_Forward);
+#define BB_SIMD_KERNEL(...)     bb::SimdKernel_Select(&bb::simd_scalar::__VA_ARGS__, &bb::simd_sse42::__VA_ARGS__, &bb::simd_avx2::__VA_ARGS__, &bb::simd_avx512::__VA_ARGS__)
+
+
+// end of file
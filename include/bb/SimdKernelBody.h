@@ -0,0 +1,626 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+//                                https://github.com/ryuz
+//                                ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+// 層の演算カーネル本体
+//   bb/SimdKernel.h から命令セット毎の名前空間の中で複数回 include される(#pragma once は付けない)
+//   ベクトル演算はその名前空間の Simd を通して行う
+//   いずれも1ノード(1行)分の処理で、並列化は呼び出し側で行う
+
+
+// ReLU forward (y = max(x, 0))
+inline void ReLU_Forward(float *y, float const *x, index_t size)
+{
+    Simd::vec zero = Simd::Zero();
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::Store(&y[i], Simd::Max(Simd::Load(&x[i]), zero));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::StoreN(&y[i], Simd::Max(Simd::LoadN(&x[i], n), zero), n);
+    }
+}
+
+// ReLU backward (dx = y > 0 ? dy : 0)
+inline void ReLU_Backward(float *dx, float const *y, float const *dy, index_t size)
+{
+    Simd::vec zero = Simd::Zero();
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::Store(&dx[i], Simd::SelectGt(Simd::Load(&y[i]), zero, Simd::Load(&dy[i])));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::StoreN(&dx[i], Simd::SelectGt(Simd::LoadN(&y[i], n), zero, Simd::LoadN(&dy[i], n)), n);
+    }
+}
+
+
+// Binarize forward (y = x > 0 ? 1 : 0)
+inline void Binarize_Forward(float *y, float const *x, index_t size)
+{
+    Simd::vec zero = Simd::Zero();
+    Simd::vec one  = Simd::Set1(1.0f);
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::Store(&y[i], Simd::SelectGt(Simd::Load(&x[i]), zero, one));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::StoreN(&y[i], Simd::SelectGt(Simd::LoadN(&x[i], n), zero, one), n);
+    }
+}
+
+// Binarize backward (hard-tanh : dx = -1 <= x <= 1 ? dy : 0)
+//   x > 1 と -1 > x の時の dy を差し引くことで範囲外を 0 にする
+inline void Binarize_Backward(float *dx, float const *x, float const *dy, index_t size)
+{
+    Simd::vec pos = Simd::Set1(+1.0f);
+    Simd::vec neg = Simd::Set1(-1.0f);
+    for ( index_t i = 0; i < size; i += Simd::N ) {
+        int       n    = (int)std::min((index_t)Simd::N, size - i);
+        Simd::vec x_v  = (n == Simd::N) ? Simd::Load(&x[i])  : Simd::LoadN(&x[i], n);
+        Simd::vec dy_v = (n == Simd::N) ? Simd::Load(&dy[i]) : Simd::LoadN(&dy[i], n);
+        Simd::vec dx_v = Simd::Sub(Simd::Sub(dy_v, Simd::SelectGt(x_v, pos, dy_v)), Simd::SelectGt(neg, x_v, dy_v));
+        if ( n == Simd::N ) {
+            Simd::Store(&dx[i], dx_v);
+        }
+        else {
+            Simd::StoreN(&dx[i], dx_v, n);
+        }
+    }
+}
+
+// RealToBinary FP32出力 (y = x > th ? 1 : 0)
+inline void RealToBinary_ForwardFp32(float *y, float const *x, float const *th, index_t size)
+{
+    Simd::vec one = Simd::Set1(1.0f);
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::Store(&y[i], Simd::SelectGt(Simd::Load(&x[i]), Simd::Load(&th[i]), one));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::StoreN(&y[i], Simd::SelectGt(Simd::LoadN(&x[i], n), Simd::LoadN(&th[i], n), one), n);
+    }
+}
+
+// RealToBinary Bit出力 (x > th を32フレーム毎のワードに詰める、端数ビットは 0)
+inline void RealToBinary_ForwardBit(std::int32_t *y, float const *x, float const *th, index_t size)
+{
+    for ( index_t i = 0; i < size; i += 32 ) {
+        int           n    = (int)std::min((index_t)32, size - i);
+        std::uint32_t word = 0;
+        for ( int j = 0; j < n; j += Simd::N ) {
+            int m = std::min(Simd::N, n - j);
+            Simd::vec x_v  = (m == Simd::N) ? Simd::Load(&x[i + j])  : Simd::LoadN(&x[i + j], m);
+            Simd::vec th_v = (m == Simd::N) ? Simd::Load(&th[i + j]) : Simd::LoadN(&th[i + j], m);
+            word |= (std::uint32_t)Simd::MaskGt(x_v, th_v) << j;   // 範囲外は 0 > 0 なので立たない
+        }
+        y[i / 32] = (std::int32_t)word;
+    }
+}
+
+// BinaryToReal Bit入力 (n 本の入力行について mux フレーム毎の 1 の数を数え gain 倍する、size は出力フレーム数)
+inline void BinaryToReal_ForwardBit(float *y, std::int32_t const * const x[], int n, index_t mux, float gain, index_t size)
+{
+    // mux == 1 は出力フレームをレーンに割り当て、ワード内のビットを N 個ずつ加算する
+    if ( mux == 1 ) {
+        Simd::vec gain_v = Simd::Set1(gain);
+        for ( index_t base = 0; base < size; base += 32 ) {
+            Simd::ivec cnt[32 / Simd::N];
+            for ( int g = 0; g < 32 / Simd::N; ++g ) {
+                cnt[g] = Simd::ISet1(0);
+            }
+            for ( int k = 0; k < n; ++k ) {
+                std::uint32_t word = (std::uint32_t)x[k][base / 32];
+                for ( int g = 0; g < 32 / Simd::N; ++g ) {
+                    cnt[g] = Simd::IAdd(cnt[g], Simd::IBits(word >> (g * Simd::N)));
+                }
+            }
+
+            int m = (int)std::min((index_t)32, size - base);
+            for ( int j = 0; j < m; j += Simd::N ) {
+                Simd::vec y_v = Simd::Mul(Simd::ICvt(cnt[j / Simd::N]), gain_v);
+                if ( m - j >= Simd::N ) {
+                    Simd::Store(&y[base + j], y_v);
+                }
+                else {
+                    Simd::StoreN(&y[base + j], y_v, m - j);
+                }
+            }
+        }
+        return;
+    }
+
+    // mux > 1 は1出力フレームが複数ビットになるので、範囲をワード単位に popcount で数える
+    std::int32_t cnt[256];
+    for ( index_t base = 0; base < size; base += 256 ) {
+        int m = (int)std::min((index_t)256, size - base);
+        for ( int j = 0; j < m; ++j ) {
+            cnt[j] = 0;
+        }
+        for ( int k = 0; k < n; ++k ) {
+            std::uint32_t const *x_ptr = (std::uint32_t const *)x[k];
+            index_t bit = base * mux;
+            for ( int j = 0; j < m; ++j ) {
+                // [bit, bit + mux) の範囲をワード単位で数える
+                index_t end = bit + mux;
+                int     c   = 0;
+                while ( bit < end ) {
+                    int           shift = (int)(bit & 31);
+                    int           len   = (int)std::min((index_t)(32 - shift), end - bit);
+                    std::uint32_t word  = x_ptr[bit >> 5] >> shift;
+                    if ( len < 32 ) {
+                        word &= (1u << len) - 1;
+                    }
+                    c   += Simd::Popcnt(word);
+                    bit += len;
+                }
+                cnt[j] += c;
+            }
+        }
+        for ( int j = 0; j < m; ++j ) {
+            y[base + j] = (float)cnt[j] * gain;
+        }
+    }
+}
+
+// BinaryToReal FP32入力 (n 本の入力行について mux フレーム毎の和を gain 倍する、size は出力フレーム数)
+inline void BinaryToReal_ForwardFp32(float *y, float const * const x[], int n, index_t mux, float gain, index_t size)
+{
+    if ( mux == 1 ) {
+        Simd::vec gain_v = Simd::Set1(gain);
+        index_t i = 0;
+        for ( ; i + Simd::N <= size; i += Simd::N ) {
+            Simd::vec sum = Simd::Zero();
+            for ( int k = 0; k < n; ++k ) {
+                sum = Simd::Add(sum, Simd::Load(&x[k][i]));
+            }
+            Simd::Store(&y[i], Simd::Mul(sum, gain_v));
+        }
+        if ( i < size ) {
+            int m = (int)(size - i);
+            Simd::vec sum = Simd::Zero();
+            for ( int k = 0; k < n; ++k ) {
+                sum = Simd::Add(sum, Simd::LoadN(&x[k][i], m));
+            }
+            Simd::StoreN(&y[i], Simd::Mul(sum, gain_v), m);
+        }
+        return;
+    }
+
+    for ( index_t i = 0; i < size; ++i ) {
+        float sum = 0;
+        for ( int k = 0; k < n; ++k ) {
+            float const *x_ptr = &x[k][i * mux];
+            for ( index_t j = 0; j < mux; ++j ) {
+                sum += x_ptr[j];
+            }
+        }
+        y[i] = sum * gain;
+    }
+}
+
+// BinaryToReal backward (dy を gain 倍して mux フレームに複製する、size は出力側のフレーム数)
+inline void BinaryToReal_Backward(float *dx, float const *dy, index_t mux, float gain, index_t size)
+{
+    Simd::vec gain_v = Simd::Set1(gain);
+    if ( mux == 1 ) {
+        index_t i = 0;
+        for ( ; i + Simd::N <= size; i += Simd::N ) {
+            Simd::Store(&dx[i], Simd::Mul(Simd::Load(&dy[i]), gain_v));
+        }
+        if ( i < size ) {
+            int m = (int)(size - i);
+            Simd::StoreN(&dx[i], Simd::Mul(Simd::LoadN(&dy[i], m), gain_v), m);
+        }
+        return;
+    }
+
+    for ( index_t i = 0; i < size; ++i ) {
+        Simd::vec grad  = Simd::Set1(dy[i] * gain);
+        float    *dx_ptr = &dx[i * mux];
+        index_t   j = 0;
+        for ( ; j + Simd::N <= mux; j += Simd::N ) {
+            Simd::Store(&dx_ptr[j], grad);
+        }
+        if ( j < mux ) {
+            Simd::StoreN(&dx_ptr[j], grad, (int)(mux - j));
+        }
+    }
+}
+
+// MaxPooling forward (窓内の x[0..n-1] の最大値)
+inline void MaxPooling_ForwardFp32(float *y, float const * const x[], int n, index_t size)
+{
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::vec max_val = Simd::Set1(-1.0e7f);
+        for ( int k = 0; k < n; ++k ) {
+            max_val = Simd::Max(max_val, Simd::Load(&x[k][i]));
+        }
+        Simd::Store(&y[i], max_val);
+    }
+    if ( i < size ) {
+        int m = (int)(size - i);
+        Simd::vec max_val = Simd::Set1(-1.0e7f);
+        for ( int k = 0; k < n; ++k ) {
+            max_val = Simd::Max(max_val, Simd::LoadN(&x[k][i], m));
+        }
+        Simd::StoreN(&y[i], max_val, m);
+    }
+}
+
+// MaxPooling forward Bit版 (窓内の OR、size は 32bit ワード数)
+inline void MaxPooling_ForwardBit(std::int32_t *y, std::int32_t const * const x[], int n, index_t size)
+{
+    index_t i = 0;
+    for ( ; i + Simd::NW <= size; i += Simd::NW ) {
+        Simd::ivec max_val = Simd::ISet1(0);
+        for ( int k = 0; k < n; ++k ) {
+            max_val = Simd::IOr(max_val, Simd::ILoad(&x[k][i]));
+        }
+        Simd::IStore(&y[i], max_val);
+    }
+    if ( i < size ) {
+        int m = (int)(size - i);
+        Simd::ivec max_val = Simd::ISet1(0);
+        for ( int k = 0; k < n; ++k ) {
+            max_val = Simd::IOr(max_val, Simd::ILoadN(&x[k][i], m));
+        }
+        Simd::IStoreN(&y[i], max_val, m);
+    }
+}
+
+// MaxPooling backward (最大値と一致した入力に勾配を流す)
+inline void MaxPooling_BackwardFp32(float * const dx[], float const * const x[], int n, float const *y, float const *dy, index_t size)
+{
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::vec out_sig  = Simd::Load(&y[i]);
+        Simd::vec out_grad = Simd::Load(&dy[i]);
+        for ( int k = 0; k < n; ++k ) {
+            Simd::Store(&dx[k][i], Simd::SelectEq(Simd::Load(&x[k][i]), out_sig, out_grad));
+        }
+    }
+    if ( i < size ) {
+        int m = (int)(size - i);
+        Simd::vec out_sig  = Simd::LoadN(&y[i], m);
+        Simd::vec out_grad = Simd::LoadN(&dy[i], m);
+        for ( int k = 0; k < n; ++k ) {
+            Simd::StoreN(&dx[k][i], Simd::SelectEq(Simd::LoadN(&x[k][i], m), out_sig, out_grad), m);
+        }
+    }
+}
+
+
+// BatchNormalization forward 学習時 (平均と分散を求めて正規化)
+inline void BatchNormalization_ForwardTraining(float *y, float const *x, index_t size, float gamma, float beta, float &mean_out, float &var_out, float &rstd_out)
+{
+    // 平均と二乗平均(Kahan の加算)
+    Simd::vec mean_sum = Simd::Zero();
+    Simd::vec mean_c   = Simd::Zero();
+    Simd::vec var_sum  = Simd::Zero();
+    Simd::vec var_c    = Simd::Zero();
+    for ( index_t i = 0; i < size; i += Simd::N ) {
+        Simd::vec x_v    = (i + Simd::N <= size) ? Simd::Load(&x[i]) : Simd::LoadN(&x[i], (int)(size - i));
+        Simd::vec mean_y = Simd::Sub(x_v, mean_c);
+        Simd::vec mean_t = Simd::Add(mean_sum, mean_y);
+        mean_c   = Simd::Sub(Simd::Sub(mean_t, mean_sum), mean_y);
+        mean_sum = mean_t;
+
+        Simd::vec var_y = Simd::FMSub(x_v, x_v, var_c);
+        Simd::vec var_t = Simd::Add(var_sum, var_y);
+        var_c   = Simd::Sub(Simd::Sub(var_t, var_sum), var_y);
+        var_sum = var_t;
+    }
+
+    float reciprocal_size = 1.0f / (float)size;
+    float mean = Simd::Hsum(mean_sum) * reciprocal_size;
+    float var  = Simd::Hsum(var_sum) * reciprocal_size - mean * mean;
+    var = std::max(var, 0.0f);  // 誤差対策(負にならないようにクリップ)
+    float rstd = 1.0f / std::sqrt(std::max(var, 10e-7f));
+
+    mean_out = mean;
+    var_out  = var;
+    rstd_out = rstd;
+
+    // 正規化 と gamma/beta 処理
+    Simd::vec mean_v  = Simd::Set1(mean);
+    Simd::vec rstd_v  = Simd::Set1(rstd);
+    Simd::vec gamma_v = Simd::Set1(gamma);
+    Simd::vec beta_v  = Simd::Set1(beta);
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::vec xn = Simd::Mul(Simd::Sub(Simd::Load(&x[i]), mean_v), rstd_v);
+        Simd::Store(&y[i], Simd::FMAdd(xn, gamma_v, beta_v));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::vec xn = Simd::Mul(Simd::Sub(Simd::LoadN(&x[i], n), mean_v), rstd_v);
+        Simd::StoreN(&y[i], Simd::FMAdd(xn, gamma_v, beta_v), n);
+    }
+}
+
+// BatchNormalization forward 推論時 (y = (x - mean) * rstd * gamma + beta)
+inline void BatchNormalization_ForwardInference(float *y, float const *x, index_t size, float mean, float rstd, float gamma, float beta)
+{
+    Simd::vec mean_v  = Simd::Set1(mean);
+    Simd::vec rstd_v  = Simd::Set1(rstd);
+    Simd::vec gamma_v = Simd::Set1(gamma);
+    Simd::vec beta_v  = Simd::Set1(beta);
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::vec xn = Simd::Mul(Simd::Sub(Simd::Load(&x[i]), mean_v), rstd_v);
+        Simd::Store(&y[i], Simd::FMAdd(xn, gamma_v, beta_v));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::vec xn = Simd::Mul(Simd::Sub(Simd::LoadN(&x[i], n), mean_v), rstd_v);
+        Simd::StoreN(&y[i], Simd::FMAdd(xn, gamma_v, beta_v), n);
+    }
+}
+
+// BatchNormalization backward
+inline void BatchNormalization_Backward(float *dx, float const *x, float const *dy, index_t size, float mean, float rstd, float gamma, float &dgamma_out, float &dbeta_out)
+{
+    Simd::vec mean_v  = Simd::Set1(mean);
+    Simd::vec rstd_v  = Simd::Set1(rstd);
+    Simd::vec gamma_v = Simd::Set1(gamma);
+    Simd::vec rstd2_v = Simd::Mul(rstd_v, rstd_v);
+    Simd::vec dbeta   = Simd::Zero();
+    Simd::vec dgamma  = Simd::Zero();
+    Simd::vec dstd    = Simd::Zero();
+    Simd::vec dmeanx  = Simd::Zero();
+
+    // 範囲外は 0 として読むので寄与しない
+    for ( index_t i = 0; i < size; i += Simd::N ) {
+        int       n    = (int)std::min((index_t)Simd::N, size - i);
+        Simd::vec x_v  = Simd::LoadN(&x[i], n);
+        Simd::vec dy_v = Simd::LoadN(&dy[i], n);
+        Simd::vec xc   = Simd::Sub(x_v, mean_v);
+        Simd::vec xn   = Simd::Mul(xc, rstd_v);
+        dbeta  = Simd::Add(dy_v, dbeta);
+        dgamma = Simd::FMAdd(xn, dy_v, dgamma);
+
+        Simd::vec dxn = Simd::Mul(dy_v, gamma_v);
+        dstd   = Simd::FNMAdd(Simd::Mul(dxn, xc), rstd2_v, dstd);
+        dmeanx = Simd::FNMAdd(dxn, rstd_v, dmeanx);
+    }
+    dgamma_out = Simd::Hsum(dgamma);
+    dbeta_out  = Simd::Hsum(dbeta);
+
+    float reciprocal_size = 1.0f / (float)size;
+    float dvar  = Simd::Hsum(dstd) * rstd;
+    float dmean = (Simd::Hsum(dmeanx) - mean * dvar) * reciprocal_size;
+
+    Simd::vec dvar_v  = Simd::Set1(dvar * reciprocal_size);
+    Simd::vec dmean_v = Simd::Set1(dmean);
+    index_t i = 0;
+    for ( ; i + Simd::N <= size; i += Simd::N ) {
+        Simd::vec dxc = Simd::FMAdd(Simd::Mul(Simd::Load(&dy[i]), gamma_v), rstd_v, dmean_v);
+        Simd::Store(&dx[i], Simd::FMAdd(Simd::Load(&x[i]), dvar_v, dxc));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        Simd::vec dxc = Simd::FMAdd(Simd::Mul(Simd::LoadN(&dy[i], n), gamma_v), rstd_v, dmean_v);
+        Simd::StoreN(&dx[i], Simd::FMAdd(Simd::LoadN(&x[i], n), dvar_v, dxc), n);
+    }
+}
+
+
+// MicroMlpAffine forward (N入力 -> M隠れ層(ReLU) -> 1出力)
+template <int N, int M>
+inline void MicroMlpAffine_Forward(float *y, float const * const x[], float const W0[M][N], float const b0[M], float const W1[M], float b1, index_t size)
+{
+    Simd::vec W0_v[M][N];
+    Simd::vec b0_v[M];
+    Simd::vec W1_v[M];
+    for ( int i = 0; i < M; ++i ) {
+        for ( int j = 0; j < N; ++j ) {
+            W0_v[i][j] = Simd::Set1(W0[i][j]);
+        }
+        b0_v[i] = Simd::Set1(b0[i]);
+        W1_v[i] = Simd::Set1(W1[i]);
+    }
+    Simd::vec b1_v = Simd::Set1(b1);
+    Simd::vec zero = Simd::Zero();
+
+    for ( index_t frame = 0; frame < size; frame += Simd::N ) {
+        int n = (int)std::min((index_t)Simd::N, size - frame);
+
+        Simd::vec in_sig[N];
+        for ( int j = 0; j < N; ++j ) {
+            in_sig[j] = (n == Simd::N) ? Simd::Load(&x[j][frame]) : Simd::LoadN(&x[j][frame], n);
+        }
+
+        Simd::vec sum1 = b1_v;
+        for ( int i = 0; i < M; ++i ) {
+            // sub-layer0
+            Simd::vec sum0 = b0_v[i];
+            for ( int j = 0; j < N; ++j ) {
+                sum0 = Simd::FMAdd(in_sig[j], W0_v[i][j], sum0);
+            }
+
+            // ReLU
+            sum0 = Simd::Max(sum0, zero);
+
+            // sub-layer1
+            sum1 = Simd::FMAdd(sum0, W1_v[i], sum1);
+        }
+
+        if ( n == Simd::N ) {
+            Simd::Store(&y[frame], sum1);
+        }
+        else {
+            Simd::StoreN(&y[frame], sum1, n);
+        }
+    }
+}
+
+// MicroMlpAffine backward
+//   入力側の誤差は dx_tmp[j] に書き出し、パラメータの勾配は dW0 等に加算する
+template <int N, int M>
+inline void MicroMlpAffine_Backward(float * const dx_tmp[], float const * const x[], float const *dy,
+            float const W0[M][N], float const b0[M], float const W1[M],
+            float dW0[M][N], float db0[M], float dW1[M], float &db1, index_t size)
+{
+    Simd::vec W0_v[M][N];
+    Simd::vec b0_v[M];
+    Simd::vec W1_v[M];
+    Simd::vec dW0_v[M][N];
+    Simd::vec db0_v[M];
+    Simd::vec dW1_v[M];
+    for ( int i = 0; i < M; ++i ) {
+        for ( int j = 0; j < N; ++j ) {
+            W0_v[i][j]  = Simd::Set1(W0[i][j]);
+            dW0_v[i][j] = Simd::Zero();
+        }
+        b0_v[i]  = Simd::Set1(b0[i]);
+        W1_v[i]  = Simd::Set1(W1[i]);
+        db0_v[i] = Simd::Zero();
+        dW1_v[i] = Simd::Zero();
+    }
+    Simd::vec db1_v = Simd::Zero();
+    Simd::vec zero  = Simd::Zero();
+
+    for ( index_t frame = 0; frame < size; frame += Simd::N ) {
+        int n = (int)std::min((index_t)Simd::N, size - frame);
+
+        Simd::vec in_sig[N];
+        for ( int j = 0; j < N; ++j ) {
+            in_sig[j] = (n == Simd::N) ? Simd::Load(&x[j][frame]) : Simd::LoadN(&x[j][frame], n);
+        }
+
+        // 一層目の信号を再構成
+        Simd::vec sig0[M];
+        for ( int i = 0; i < M; ++i ) {
+            Simd::vec sum0 = b0_v[i];
+            for ( int j = 0; j < N; ++j ) {
+                sum0 = Simd::FMAdd(in_sig[j], W0_v[i][j], sum0);
+            }
+            sig0[i] = Simd::Max(sum0, zero);
+        }
+
+        // 逆伝播
+        Simd::vec in_err[N];
+        for ( int j = 0; j < N; ++j ) {
+            in_err[j] = zero;
+        }
+
+        Simd::vec out_err = (n == Simd::N) ? Simd::Load(&dy[frame]) : Simd::LoadN(&dy[frame], n);
+        db1_v = Simd::Add(db1_v, out_err);
+        for ( int i = 0; i < M; ++i ) {
+            dW1_v[i] = Simd::FMAdd(sig0[i], out_err, dW1_v[i]);
+
+            Simd::vec err0 = Simd::SelectGt(sig0[i], zero, Simd::Mul(W1_v[i], out_err));     // ReLU
+            db0_v[i] = Simd::Add(db0_v[i], err0);
+            for ( int j = 0; j < N; ++j ) {
+                in_err[j]   = Simd::FMAdd(err0, W0_v[i][j], in_err[j]);
+                dW0_v[i][j] = Simd::FMAdd(err0, in_sig[j], dW0_v[i][j]);
+            }
+        }
+
+        for ( int j = 0; j < N; ++j ) {
+            if ( n == Simd::N ) {
+                Simd::Store(&dx_tmp[j][frame], in_err[j]);
+            }
+            else {
+                Simd::StoreN(&dx_tmp[j][frame], in_err[j], n);
+            }
+        }
+    }
+
+    for ( int i = 0; i < M; ++i ) {
+        for ( int j = 0; j < N; ++j ) {
+            dW0[i][j] += Simd::Hsum(dW0_v[i][j]);
+        }
+        db0[i] += Simd::Hsum(db0_v[i]);
+        dW1[i] += Simd::Hsum(dW1_v[i]);
+    }
+    db1 += Simd::Hsum(db1_v);
+}
+
+
+// ビットスライスしたLUTの評価(Shannon展開によるmux木をテンプレートで展開)
+//   LEVEL 段目(x[LEVEL-1] で選択)の BASE 番目の部分木を評価する
+//   最下段は t0 = table[2k], td = table[2k] ^ table[2k+1] を全ビットに展開した定数を使う
+template <int LEVEL, int BASE>
+struct BinaryLutN_MuxTree
+{
+    static Simd::ivec Eval(Simd::ivec const x[], Simd::ivec const t0[], Simd::ivec const td[])
+    {
+        Simd::ivec lo = BinaryLutN_MuxTree<LEVEL-1, BASE*2  >::Eval(x, t0, td);
+        Simd::ivec hi = BinaryLutN_MuxTree<LEVEL-1, BASE*2+1>::Eval(x, t0, td);
+        return Simd::IXor(lo, Simd::IAnd(x[LEVEL-1], Simd::IXor(lo, hi)));
+    }
+};
+
+template <int BASE>
+struct BinaryLutN_MuxTree<1, BASE>
+{
+    static Simd::ivec Eval(Simd::ivec const x[], Simd::ivec const t0[], Simd::ivec const td[])
+    {
+        return Simd::IXor(t0[BASE], Simd::IAnd(x[0], td[BASE]));
+    }
+};
+
+// BinaryLutN forward Bit版 (size は 32bit ワード数、table は 2^N ビット)
+template <int N>
+inline void BinaryLutN_ForwardBit(std::int32_t *y, std::int32_t const * const x[], std::uint32_t const table[], index_t size)
+{
+    // テーブルを全ビットに展開した定数を作成
+    Simd::ivec t0[(1 << N) / 2];
+    Simd::ivec td[(1 << N) / 2];
+    for ( int k = 0; k < (1 << N) / 2; ++k ) {
+        std::uint32_t b = table[(2*k) / 32] >> ((2*k) % 32);
+        t0[k] = Simd::ISet1(-(std::int32_t)(b & 1));
+        td[k] = Simd::ISet1(-(std::int32_t)((b ^ (b >> 1)) & 1));
+    }
+
+    Simd::ivec x_v[N];
+    index_t i = 0;
+    for ( ; i + Simd::NW <= size; i += Simd::NW ) {
+        for ( int j = 0; j < N; ++j ) {
+            x_v[j] = Simd::ILoad(&x[j][i]);
+        }
+        Simd::IStore(&y[i], BinaryLutN_MuxTree<N, 0>::Eval(x_v, t0, td));
+    }
+    if ( i < size ) {
+        int n = (int)(size - i);
+        for ( int j = 0; j < N; ++j ) {
+            x_v[j] = Simd::ILoadN(&x[j][i], n);
+        }
+        Simd::IStoreN(&y[i], BinaryLutN_MuxTree<N, 0>::Eval(x_v, t0, td), n);
+    }
+}
+
+// BinaryLutN forward FP32版 (0 以外を 1 とみなしてテーブルを引く、N <= 8)
+template <int N>
+inline void BinaryLutN_ForwardFp32(float *y, float const * const x[], std::int32_t const table[8], index_t size)
+{
+    for ( index_t i = 0; i < size; i += Simd::N ) {
+        int n = (int)std::min((index_t)Simd::N, size - i);
+        Simd::ivec index = Simd::ISet1(0);
+        for ( int j = 0; j < N; ++j ) {
+            index = Simd::LutIndex(index, (n == Simd::N) ? Simd::Load(&x[j][i]) : Simd::LoadN(&x[j][i], n), j);
+        }
+        Simd::vec y_v = Simd::LutLookup(table, index);
+        if ( n == Simd::N ) {
+            Simd::Store(&y[i], y_v);
+        }
+        else {
+            Simd::StoreN(&y[i], y_v, n);
+        }
+    }
+}
+
+
+// end of file
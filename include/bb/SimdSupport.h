@@ -10,6 +10,9 @@
 #pragma once
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 
 #ifdef _MSC_VER
@@ -19,9 +22,21 @@
 #endif
 
 
+// 拡張命令はコンパイルオプションに依らず関数単位で有効化し、実行時判定で切り替える
+#if defined(__GNUC__)
+#define BB_TARGET_SSE42		__attribute__((target("sse4.2")))
+#define BB_TARGET_AVX2		__attribute__((target("avx2,fma")))
+#define BB_TARGET_AVX512F	__attribute__((target("avx512f")))
+#else
+#define BB_TARGET_SSE42
+#define BB_TARGET_AVX2
+#define BB_TARGET_AVX512F
+#endif
+
 
 namespace bb {
 
+BB_TARGET_AVX2
 inline float bb_mm256_cvtss_f32(__m256 a)
 {
 #ifdef _MSC_VER
@@ -32,65 +47,45 @@ inline float bb_mm256_cvtss_f32(__m256 a)
 #endif
 }
 
+BB_TARGET_AVX2
 inline __m256 bb_mm256_fmadd_ps(__m256 a, __m256 b, __m256 c)
 {
-#ifdef __AVX2__
 	return _mm256_fmadd_ps(a, b, c);
-#else
-	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256 bb_mm256_fmsub_ps(__m256 a, __m256 b, __m256 c)
 {
-#ifdef __AVX2__
 	return _mm256_fmsub_ps(a, b, c);
-#else
-	return _mm256_sub_ps(_mm256_mul_ps(a, b), c);
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256 bb_mm256_fnmadd_ps(__m256 a, __m256 b, __m256 c)
 {
-#ifdef __AVX2__
 	return _mm256_fnmadd_ps(a, b, c);
-#else
-	return _mm256_sub_ps(c, _mm256_mul_ps(a, b));
-#endif
 }
 
 
+BB_TARGET_AVX2
 inline __m256i bb_mm256_andnot_si256(__m256i a, __m256i b)
 {
-#ifdef __AVX2__
 	return _mm256_andnot_si256(a, b);
-#else
-	__m256 res = _mm256_andnot_ps(*(__m256 *)&a, *(__m256 *)&b);
-	return *(__m256i *)&res;
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256i bb_mm256_and_si256(__m256i a, __m256i b)
 {
-#ifdef __AVX2__
 	return _mm256_and_si256(a, b);
-#else
-	__m256 res = _mm256_and_ps(*(__m256 *)&a, *(__m256 *)&b);
-	return *(__m256i *)&res;
-#endif
 }
 
+BB_TARGET_AVX2
 inline __m256i bb_mm256_or_si256(__m256i a, __m256i b)
 {
-#ifdef __AVX2__
 	return _mm256_or_si256(a, b);
-#else
-	__m256 res = _mm256_or_ps(*(__m256 *)&a, *(__m256 *)&b);
-	return *(__m256i *)&res;
-#endif
 }
 
 // horizontal sum
+BB_TARGET_AVX2
 inline __m256 bb_mm256_hsum_ps(__m256 r)
 {
 	r = _mm256_hadd_ps(r, r);
@@ -100,24 +95,217 @@ inline __m256 bb_mm256_hsum_ps(__m256 r)
 	return _mm256_hadd_ps(r, r);
 }
 
+// 8x8 転置 (r[i] の j 要素 を r[j] の i 要素へ)
+BB_TARGET_AVX2
+inline void bb_mm256_transpose8x8_ps(__m256 r[8])
+{
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
 }
 
+// 先頭 n 要素のみ有効なマスク(フレーム端数処理用)
+BB_TARGET_AVX2
+inline __m256 bb_mm256_mask_ps(int n)
+{
+	return _mm256_cmp_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps((float)n), _CMP_LT_OQ);
+}
 
-#ifndef __AVX2__
-#define _mm256_andnot_si256		bb_mm256_andnot_si256
-#define _mm256_and_si256		bb_mm256_and_si256
-#define _mm256_or_si256			bb_mm256_or_si256
-#define _mm256_fmadd_ps			bb_mm256_fmadd_ps
-#define _mm256_fmsub_ps			bb_mm256_fmsub_ps
-#define _mm256_fnmadd_ps		bb_mm256_fnmadd_ps
-#endif
+// 指数関数 (Cephes の expf と同じ多項式近似、相対誤差 2e-7 程度)
+//   NaN はそのまま返し、88.72 を超えると +inf、-87.33 未満(非正規化数の範囲)は 0 を返す
+BB_TARGET_AVX2
+inline __m256 bb_mm256_exp_ps(__m256 x)
+{
+	__m256 a = _mm256_min_ps(x, _mm256_set1_ps( 88.7228391116729f));
+	a = _mm256_max_ps(a, _mm256_set1_ps(-87.3365447505531f));
+
+	// a = n * ln2 + r
+	__m256 n = _mm256_round_ps(_mm256_mul_ps(a, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), a);
+	r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
 
+	__m256 p = _mm256_set1_ps(1.9875691500e-4f);
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+	p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
 
-#if !defined(__AVX__) && !defined(__AVX2__)
-// #error AVX is not supported 
+	// 2^n を指数部に直接作る (n = 128 は指数部に入らないので 2^127 にして最後に 2 倍する)
+	__m256  hi = _mm256_cmp_ps(n, _mm256_set1_ps(127.5f), _CMP_GT_OQ);
+	__m256i e  = _mm256_cvtps_epi32(_mm256_sub_ps(n, _mm256_and_ps(hi, _mm256_set1_ps(1.0f))));
+	e = _mm256_slli_epi32(_mm256_add_epi32(e, _mm256_set1_epi32(127)), 23);
+	__m256  y  = _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+	y = _mm256_add_ps(y, _mm256_and_ps(hi, y));
+
+	y = _mm256_blendv_ps(y, _mm256_set1_ps(HUGE_VALF), _mm256_cmp_ps(x, _mm256_set1_ps( 88.7228391116729f), _CMP_GT_OQ));
+	y = _mm256_blendv_ps(y, _mm256_setzero_ps(),       _mm256_cmp_ps(x, _mm256_set1_ps(-87.3365447505531f), _CMP_LT_OQ));
+	return _mm256_blendv_ps(y, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+}
+
+
+// 実行時CPU判定(AVX-512F)
+inline bool bb_cpu_has_avx512f(void)
+{
+	static bool const has_avx512f = []() -> bool {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if ( info[0] < 7 ) { return false; }
+		__cpuid(info, 1);
+		if ( (info[2] & (1 << 27)) == 0 ) { return false; }		// OSXSAVE
+		if ( (_xgetbv(0) & 0xe6) != 0xe6 ) { return false; }	// OS が ZMM/opmask を退避するか
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 16)) != 0;
+#elif defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx512f") != 0;
+#else
+		return false;
 #endif
+	}();
+	return has_avx512f;
+}
 
-#if defined(__AVX__) && !defined(__AVX2__)
-// #warning AVX2 is not supported (use AVX instruction only)
+// 実行時CPU判定(SSE4.2)
+inline bool bb_cpu_has_sse42(void)
+{
+	static bool const has_sse42 = []() -> bool {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#elif defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse4.2") != 0;
+#else
+		return false;
 #endif
+	}();
+	return has_sse42;
+}
+
+// 実行時CPU判定(AVX2 + FMA)
+inline bool bb_cpu_has_avx2(void)
+{
+	static bool const has_avx2 = []() -> bool {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if ( info[0] < 7 ) { return false; }
+		__cpuid(info, 1);
+		if ( (info[2] & (1 << 12)) == 0 ) { return false; }		// FMA
+		if ( (info[2] & (1 << 27)) == 0 ) { return false; }		// OSXSAVE
+		if ( (_xgetbv(0) & 0x06) != 0x06 ) { return false; }	// OS が YMM を退避するか
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0 && __builtin_cpu_supports("fma") != 0;
+#else
+		return false;
+#endif
+	}();
+	return has_avx2;
+}
+
+
+// SIMD 命令セットのレベル(実行時の選択用)
+enum {
+	BB_SIMD_SCALAR  = 0,
+	BB_SIMD_SSE42   = 1,
+	BB_SIMD_AVX2    = 2,
+	BB_SIMD_AVX512F = 3,
+};
+
+// 実行中の CPU で使える最上位のレベル
+inline int bb_simd_cpu_level(void)
+{
+	if ( bb_cpu_has_avx512f() && bb_cpu_has_avx2() ) { return BB_SIMD_AVX512F; }
+	if ( bb_cpu_has_avx2() )                         { return BB_SIMD_AVX2; }
+	if ( bb_cpu_has_sse42() )                        { return BB_SIMD_SSE42; }
+	return BB_SIMD_SCALAR;
+}
+
+// 使用するレベルの上限(初期値は環境変数 BB_SIMD_LEVEL = scalar/sse42/avx2/avx512 で指定可能)
+inline int &bb_simd_level_limit(void)
+{
+	static int limit = []() -> int {
+		char const *env = getenv("BB_SIMD_LEVEL");
+		if ( env != nullptr ) {
+			if ( strcmp(env, "scalar") == 0 ) { return BB_SIMD_SCALAR; }
+			if ( strcmp(env, "sse42")  == 0 ) { return BB_SIMD_SSE42; }
+			if ( strcmp(env, "avx2")   == 0 ) { return BB_SIMD_AVX2; }
+		}
+		return BB_SIMD_AVX512F;
+	}();
+	return limit;
+}
+
+//! 使用するレベルの上限を設定する(テストやベンチマークで下位の実装を選ぶ場合など)
+inline void bb_simd_set_level(int level)
+{
+	bb_simd_level_limit() = level;
+}
+
+//! 実際に使用するレベル
+inline int bb_simd_get_level(void)
+{
+	int level = bb_simd_cpu_level();
+	return (level < bb_simd_level_limit()) ? level : bb_simd_level_limit();
+}
+
+// 指数関数 AVX-512版 (bb_mm256_exp_ps と同じ近似、範囲外と NaN の扱いも同じ)
+BB_TARGET_AVX512F
+inline __m512 bb_mm512_exp_ps(__m512 x)
+{
+	__m512 a = _mm512_min_ps(x, _mm512_set1_ps( 88.7228391116729f));
+	a = _mm512_max_ps(a, _mm512_set1_ps(-87.3365447505531f));
+
+	__m512 n = _mm512_roundscale_ps(_mm512_mul_ps(a, _mm512_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(0.693359375f), a);
+	r = _mm512_fnmadd_ps(n, _mm512_set1_ps(-2.12194440e-4f), r);
+
+	__m512 p = _mm512_set1_ps(1.9875691500e-4f);
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.3981999507e-3f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(8.3334519073e-3f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(4.1665795894e-2f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.6666665459e-1f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(5.0000001201e-1f));
+	p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+
+	__mmask16 hi = _mm512_cmp_ps_mask(n, _mm512_set1_ps(127.5f), _CMP_GT_OQ);
+	__m512i e = _mm512_cvtps_epi32(_mm512_mask_sub_ps(n, hi, n, _mm512_set1_ps(1.0f)));
+	e = _mm512_slli_epi32(_mm512_add_epi32(e, _mm512_set1_epi32(127)), 23);
+	__m512  y = _mm512_mul_ps(p, _mm512_castsi512_ps(e));
+	y = _mm512_mask_add_ps(y, hi, y, y);
+
+	y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, _mm512_set1_ps( 88.7228391116729f), _CMP_GT_OQ), _mm512_set1_ps(HUGE_VALF));
+	y = _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, _mm512_set1_ps(-87.3365447505531f), _CMP_LT_OQ), _mm512_setzero_ps());
+	return _mm512_mask_mov_ps(y, _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q), x);
+}
+
+}
 
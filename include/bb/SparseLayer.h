@@ -77,6 +77,46 @@ protected:
 			}
 		}
 	}
+
+	// ノード毎に分けて計算した入力側誤差を足しこむ(SIMD版Backward用)
+	//   dx_tmp は (output_node * input_size + i) 番目のノードに入力 i への誤差を持つ
+	//   frame方向をブロック分割して並列化し、各要素はノード順に加算するので逐次版と同じ結果になる
+	BB_TARGET_AVX2
+	static void SumDxTmpHostFP32(FrameBuffer &dx_buf, FrameBuffer const &dx_tmp_buf, Tensor_<std::int32_t> const &input_index, int input_size)
+	{
+		BB_ASSERT(dx_buf.GetFrameStride() == dx_tmp_buf.GetFrameStride());
+
+		index_t const frame_stride     = dx_buf.GetFrameStride() / sizeof(float);
+		index_t const output_node_size = dx_tmp_buf.GetNodeSize() / input_size;
+		index_t const block_size       = 256;
+		index_t const block_num        = (frame_stride + block_size - 1) / block_size;
+
+		dx_buf.FillZero();
+
+		auto dx_ptr          = dx_buf.LockMemory();
+		auto dx_tmp_ptr      = dx_tmp_buf.LockMemoryConst();
+		auto input_index_ptr = input_index.LockConst();
+
+		auto dx_addr_base     = (float       *)dx_ptr.GetAddr();
+		auto dx_tmp_addr_base = (float const *)dx_tmp_ptr.GetAddr();
+
+		#pragma omp parallel for
+		for ( index_t block = 0; block < block_num; ++block ) {
+			index_t frame_start = block * block_size;
+			index_t frame_end   = std::min(frame_start + block_size, frame_stride);
+			for ( index_t node = 0; node < output_node_size; ++node ) {
+				for ( int i = 0; i < input_size; ++i ) {
+					float       *dx_addr  = &dx_addr_base[frame_stride * input_index_ptr(node, i)];
+					float const *tmp_addr = &dx_tmp_addr_base[frame_stride * (node * input_size + i)];
+					for ( index_t frame = frame_start; frame < frame_end; frame += 8 ) {
+						__m256 dx = _mm256_load_ps(&dx_addr[frame]);
+						dx = _mm256_add_ps(dx, _mm256_load_ps(&tmp_addr[frame]));
+						_mm256_store_ps(&dx_addr[frame], dx);
+					}
+				}
+			}
+		}
+	}
 };
 
 
@@ -27,6 +27,8 @@ class StochasticLut2 : public SparseLayer<T, T>
 protected:
     bool            m_binary_mode = false;
     bool            m_parameter_lock = false;
+    bool            m_host_simd = true;
+    bool            m_host_avx512 = true;
 
     index_t         m_input_node_size = 0;
     index_t         m_output_node_size = 0;
@@ -36,6 +38,7 @@ protected:
     FrameBuffer     m_x;
     FrameBuffer     m_y;
     FrameBuffer     m_dx;
+    FrameBuffer     m_dx_tmp;
 
     Tensor_<std::int32_t>   m_input_index;
 
@@ -57,6 +60,18 @@ protected:
         {
             m_binary_mode = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
+
+        // Host AVX-512 利用設定(CPUが対応している場合のみ有効)
+        if (args.size() == 2 && args[0] == "host_avx512")
+        {
+            m_host_avx512 = EvalBool(args[1]);
+        }
 	}
 
 public:
@@ -301,6 +316,17 @@ public:
             m_W->Clamp(0.0, 1.0);
         }
 
+        // SIMD版
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            if ( m_host_avx512 && bb_cpu_has_avx512f() ) {
+                ForwardHostAvx512FP32();
+            }
+            else {
+                ForwardHostAvx2FP32();
+            }
+            return m_y;
+        }
+
         {
             auto frame_size = m_x.GetFrameSize();
             auto x_ptr = x.LockConst<T>();
@@ -354,6 +380,18 @@ public:
         BB_ASSERT(dy.GetType() == DataType<T>::type);
 
         m_dx.Resize(DataType<T>::type, dy.GetFrameSize(), m_input_node_size);
+
+        // SIMD版
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            if ( m_host_avx512 && bb_cpu_has_avx512f() ) {
+                BackwardHostAvx512FP32(dy);
+            }
+            else {
+                BackwardHostAvx2FP32(dy);
+            }
+            return m_dx;
+        }
+
         m_dx.FillZero();
         m_dW->FillZero();
 
@@ -424,6 +462,284 @@ public:
 
         return m_dx;
     }
+
+
+protected:
+    // SIMD版の係数(バイナリモード時は0/1化)
+    inline float HostSimdW(float W) const
+    {
+        if ( m_binary_mode ) {
+            W = W > 0.5f ? 1.0f : 0.0f;
+        }
+        return W;
+    }
+
+    // AVX2版 Forward (8frame単位)
+    BB_TARGET_AVX2
+    void ForwardHostAvx2FP32(void)
+    {
+        index_t const frame_size   = m_x.GetFrameSize();
+        index_t const frame_stride = m_x.GetFrameStride() / sizeof(float);
+
+        auto x_ptr           = m_x.LockMemoryConst();
+        auto y_ptr           = m_y.LockMemory(true);
+        auto input_index_ptr = m_input_index.LockConst();
+        auto W_ptr           = lock_W_const();
+
+        auto x_buf = (float const *)x_ptr.GetAddr();
+        auto y_buf = (float       *)y_ptr.GetAddr();
+
+        __m256 const zero = _mm256_set1_ps(0.0f);
+        __m256 const one  = _mm256_set1_ps(1.0f);
+
+#pragma omp parallel for
+        for ( index_t node = 0; node < m_output_node_size; ++node ) {
+            float const *x0_addr = &x_buf[frame_stride * input_index_ptr(node, 0)];
+            float const *x1_addr = &x_buf[frame_stride * input_index_ptr(node, 1)];
+            float       *y_addr  = &y_buf[frame_stride * node];
+
+            __m256 W[4];
+            for ( int i = 0; i < 4; ++i ) {
+                W[i] = _mm256_set1_ps(HostSimdW((float)W_ptr(node, i)));
+            }
+
+            for ( index_t frame = 0; frame < frame_size; frame += 8 ) {
+                __m256 xp0 = _mm256_load_ps(&x0_addr[frame]);
+                __m256 xp1 = _mm256_load_ps(&x1_addr[frame]);
+                __m256 xn0 = _mm256_sub_ps(one, xp0);
+                __m256 xn1 = _mm256_sub_ps(one, xp1);
+
+                __m256 sig = zero;
+                sig = _mm256_add_ps(sig, _mm256_mul_ps(W[0], _mm256_mul_ps(xn1, xn0)));
+                sig = _mm256_add_ps(sig, _mm256_mul_ps(W[1], _mm256_mul_ps(xn1, xp0)));
+                sig = _mm256_add_ps(sig, _mm256_mul_ps(W[2], _mm256_mul_ps(xp1, xn0)));
+                sig = _mm256_add_ps(sig, _mm256_mul_ps(W[3], _mm256_mul_ps(xp1, xp0)));
+
+                _mm256_store_ps(&y_addr[frame], sig);
+            }
+        }
+    }
+
+    // AVX-512版 Forward (16frame単位)
+    BB_TARGET_AVX512F
+    void ForwardHostAvx512FP32(void)
+    {
+        index_t const frame_size   = m_x.GetFrameSize();
+        index_t const frame_stride = m_x.GetFrameStride() / sizeof(float);
+
+        auto x_ptr           = m_x.LockMemoryConst();
+        auto y_ptr           = m_y.LockMemory(true);
+        auto input_index_ptr = m_input_index.LockConst();
+        auto W_ptr           = lock_W_const();
+
+        auto x_buf = (float const *)x_ptr.GetAddr();
+        auto y_buf = (float       *)y_ptr.GetAddr();
+
+        __m512 const zero = _mm512_set1_ps(0.0f);
+        __m512 const one  = _mm512_set1_ps(1.0f);
+
+#pragma omp parallel for
+        for ( index_t node = 0; node < m_output_node_size; ++node ) {
+            float const *x0_addr = &x_buf[frame_stride * input_index_ptr(node, 0)];
+            float const *x1_addr = &x_buf[frame_stride * input_index_ptr(node, 1)];
+            float       *y_addr  = &y_buf[frame_stride * node];
+
+            __m512 W[4];
+            for ( int i = 0; i < 4; ++i ) {
+                W[i] = _mm512_set1_ps(HostSimdW((float)W_ptr(node, i)));
+            }
+
+            for ( index_t frame = 0; frame < frame_size; frame += 16 ) {
+                __mmask16 mask = (frame_size - frame >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (frame_size - frame)) - 1);
+
+                __m512 xp0 = _mm512_maskz_loadu_ps(mask, &x0_addr[frame]);
+                __m512 xp1 = _mm512_maskz_loadu_ps(mask, &x1_addr[frame]);
+                __m512 xn0 = _mm512_sub_ps(one, xp0);
+                __m512 xn1 = _mm512_sub_ps(one, xp1);
+
+                __m512 sig = zero;
+                sig = _mm512_add_ps(sig, _mm512_mul_ps(W[0], _mm512_mul_ps(xn1, xn0)));
+                sig = _mm512_add_ps(sig, _mm512_mul_ps(W[1], _mm512_mul_ps(xn1, xp0)));
+                sig = _mm512_add_ps(sig, _mm512_mul_ps(W[2], _mm512_mul_ps(xp1, xn0)));
+                sig = _mm512_add_ps(sig, _mm512_mul_ps(W[3], _mm512_mul_ps(xp1, xp0)));
+
+                _mm512_mask_storeu_ps(&y_addr[frame], mask, sig);
+            }
+        }
+    }
+
+
+    // AVX2版 Backward (8frame単位)
+    //   入力側の誤差はノード毎に m_dx_tmp に出力し、後でノード順に足しこむ
+    BB_TARGET_AVX2
+    void BackwardHostAvx2FP32(FrameBuffer const &dy_buf)
+    {
+        index_t const frame_size   = dy_buf.GetFrameSize();
+        index_t const frame_stride = dy_buf.GetFrameStride() / sizeof(float);
+        BB_ASSERT(m_x.GetFrameStride() == dy_buf.GetFrameStride());
+
+        m_dx_tmp.Resize(BB_TYPE_FP32, frame_size, m_output_node_size * 2);
+
+        {
+            auto x_ptr           = m_x.LockMemoryConst();
+            auto dy_ptr          = dy_buf.LockMemoryConst();
+            auto dx_tmp_ptr      = m_dx_tmp.LockMemory(true);
+            auto input_index_ptr = m_input_index.LockConst();
+            auto W_ptr           = lock_W_const();
+            auto dW_ptr          = lock_dW();
+
+            auto x_buf      = (float const *)x_ptr.GetAddr();
+            auto dy_buf_    = (float const *)dy_ptr.GetAddr();
+            auto dx_tmp_buf = (float       *)dx_tmp_ptr.GetAddr();
+
+            __m256 const zero = _mm256_set1_ps(0.0f);
+            __m256 const one  = _mm256_set1_ps(1.0f);
+
+#pragma omp parallel for
+            for ( index_t node = 0; node < m_output_node_size; ++node ) {
+                float const *x0_addr  = &x_buf[frame_stride * input_index_ptr(node, 0)];
+                float const *x1_addr  = &x_buf[frame_stride * input_index_ptr(node, 1)];
+                float const *dy_addr  = &dy_buf_[frame_stride * node];
+                float       *dx0_addr = &dx_tmp_buf[frame_stride * (node * 2 + 0)];
+                float       *dx1_addr = &dx_tmp_buf[frame_stride * (node * 2 + 1)];
+
+                __m256 W[4];
+                __m256 dW[4];
+                for ( int i = 0; i < 4; ++i ) {
+                    W[i]  = _mm256_set1_ps(HostSimdW((float)W_ptr(node, i)));
+                    dW[i] = zero;
+                }
+
+                for ( index_t frame = 0; frame < frame_size; frame += 8 ) {
+                    // 端数フレームは 0 として扱い dW に寄与させない
+                    __m256 mask = bb_mm256_mask_ps((int)std::min(frame_size - frame, (index_t)8));
+
+                    __m256 xp0 = _mm256_and_ps(_mm256_load_ps(&x0_addr[frame]), mask);
+                    __m256 xp1 = _mm256_and_ps(_mm256_load_ps(&x1_addr[frame]), mask);
+                    __m256 xn0 = _mm256_sub_ps(one, xp0);
+                    __m256 xn1 = _mm256_sub_ps(one, xp1);
+
+                    __m256 xi[4];
+                    xi[0] = _mm256_mul_ps(xn1, xn0);
+                    xi[1] = _mm256_mul_ps(xn1, xp0);
+                    xi[2] = _mm256_mul_ps(xp1, xn0);
+                    xi[3] = _mm256_mul_ps(xp1, xp0);
+
+                    __m256 grad = _mm256_and_ps(_mm256_load_ps(&dy_addr[frame]), mask);
+
+                    __m256 dxi[4];
+                    for ( int i = 0; i < 4; ++i ) {
+                        dW[i]  = _mm256_add_ps(dW[i], _mm256_mul_ps(xi[i], grad));
+                        dxi[i] = _mm256_mul_ps(W[i], grad);
+                    }
+
+                    __m256 dxn0 = _mm256_mul_ps(xn1, dxi[0]);
+                    __m256 dxn1 = _mm256_mul_ps(xn0, dxi[0]);
+                    __m256 dxp0 = _mm256_mul_ps(xn1, dxi[1]);
+                    dxn1 = _mm256_add_ps(dxn1, _mm256_mul_ps(xp0, dxi[1]));
+                    dxn0 = _mm256_add_ps(dxn0, _mm256_mul_ps(xp1, dxi[2]));
+                    __m256 dxp1 = _mm256_mul_ps(xn0, dxi[2]);
+                    dxp0 = _mm256_add_ps(dxp0, _mm256_mul_ps(xp1, dxi[3]));
+                    dxp1 = _mm256_add_ps(dxp1, _mm256_mul_ps(xp0, dxi[3]));
+
+                    _mm256_store_ps(&dx0_addr[frame], _mm256_sub_ps(dxp0, dxn0));
+                    _mm256_store_ps(&dx1_addr[frame], _mm256_sub_ps(dxp1, dxn1));
+                }
+
+                for ( int i = 0; i < 4; ++i ) {
+                    dW_ptr(node, i) = bb_mm256_cvtss_f32(bb_mm256_hsum_ps(dW[i]));
+                }
+            }
+        }
+
+        super::SumDxTmpHostFP32(m_dx, m_dx_tmp, m_input_index, 2);
+    }
+
+    // AVX-512版 Backward (16frame単位)
+    BB_TARGET_AVX512F
+    void BackwardHostAvx512FP32(FrameBuffer const &dy_buf)
+    {
+        index_t const frame_size   = dy_buf.GetFrameSize();
+        index_t const frame_stride = dy_buf.GetFrameStride() / sizeof(float);
+        BB_ASSERT(m_x.GetFrameStride() == dy_buf.GetFrameStride());
+
+        m_dx_tmp.Resize(BB_TYPE_FP32, frame_size, m_output_node_size * 2);
+
+        {
+            auto x_ptr           = m_x.LockMemoryConst();
+            auto dy_ptr          = dy_buf.LockMemoryConst();
+            auto dx_tmp_ptr      = m_dx_tmp.LockMemory(true);
+            auto input_index_ptr = m_input_index.LockConst();
+            auto W_ptr           = lock_W_const();
+            auto dW_ptr          = lock_dW();
+
+            auto x_buf      = (float const *)x_ptr.GetAddr();
+            auto dy_buf_    = (float const *)dy_ptr.GetAddr();
+            auto dx_tmp_buf = (float       *)dx_tmp_ptr.GetAddr();
+
+            __m512 const zero = _mm512_set1_ps(0.0f);
+            __m512 const one  = _mm512_set1_ps(1.0f);
+
+#pragma omp parallel for
+            for ( index_t node = 0; node < m_output_node_size; ++node ) {
+                float const *x0_addr  = &x_buf[frame_stride * input_index_ptr(node, 0)];
+                float const *x1_addr  = &x_buf[frame_stride * input_index_ptr(node, 1)];
+                float const *dy_addr  = &dy_buf_[frame_stride * node];
+                float       *dx0_addr = &dx_tmp_buf[frame_stride * (node * 2 + 0)];
+                float       *dx1_addr = &dx_tmp_buf[frame_stride * (node * 2 + 1)];
+
+                __m512 W[4];
+                __m512 dW[4];
+                for ( int i = 0; i < 4; ++i ) {
+                    W[i]  = _mm512_set1_ps(HostSimdW((float)W_ptr(node, i)));
+                    dW[i] = zero;
+                }
+
+                for ( index_t frame = 0; frame < frame_size; frame += 16 ) {
+                    __mmask16 mask = (frame_size - frame >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (frame_size - frame)) - 1);
+
+                    __m512 xp0 = _mm512_maskz_loadu_ps(mask, &x0_addr[frame]);
+                    __m512 xp1 = _mm512_maskz_loadu_ps(mask, &x1_addr[frame]);
+                    __m512 xn0 = _mm512_sub_ps(one, xp0);
+                    __m512 xn1 = _mm512_sub_ps(one, xp1);
+
+                    __m512 xi[4];
+                    xi[0] = _mm512_mul_ps(xn1, xn0);
+                    xi[1] = _mm512_mul_ps(xn1, xp0);
+                    xi[2] = _mm512_mul_ps(xp1, xn0);
+                    xi[3] = _mm512_mul_ps(xp1, xp0);
+
+                    __m512 grad = _mm512_maskz_loadu_ps(mask, &dy_addr[frame]);
+
+                    __m512 dxi[4];
+                    for ( int i = 0; i < 4; ++i ) {
+                        dW[i]  = _mm512_add_ps(dW[i], _mm512_mul_ps(xi[i], grad));
+                        dxi[i] = _mm512_mul_ps(W[i], grad);
+                    }
+
+                    __m512 dxn0 = _mm512_mul_ps(xn1, dxi[0]);
+                    __m512 dxn1 = _mm512_mul_ps(xn0, dxi[0]);
+                    __m512 dxp0 = _mm512_mul_ps(xn1, dxi[1]);
+                    dxn1 = _mm512_add_ps(dxn1, _mm512_mul_ps(xp0, dxi[1]));
+                    dxn0 = _mm512_add_ps(dxn0, _mm512_mul_ps(xp1, dxi[2]));
+                    __m512 dxp1 = _mm512_mul_ps(xn0, dxi[2]);
+                    dxp0 = _mm512_add_ps(dxp0, _mm512_mul_ps(xp1, dxi[3]));
+                    dxp1 = _mm512_add_ps(dxp1, _mm512_mul_ps(xp0, dxi[3]));
+
+                    // 端数フレームには 0 が入るので frame_stride まで書き込む
+                    __mmask16 store_mask = (frame_stride - frame >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (frame_stride - frame)) - 1);
+                    _mm512_mask_storeu_ps(&dx0_addr[frame], store_mask, _mm512_sub_ps(dxp0, dxn0));
+                    _mm512_mask_storeu_ps(&dx1_addr[frame], store_mask, _mm512_sub_ps(dxp1, dxn1));
+                }
+
+                for ( int i = 0; i < 4; ++i ) {
+                    dW_ptr(node, i) = _mm512_reduce_add_ps(dW[i]);
+                }
+            }
+        }
+
+        super::SumDxTmpHostFP32(m_dx, m_dx_tmp, m_input_index, 2);
+    }
 };
 
 
@@ -28,6 +28,8 @@ class StochasticLut4 : public SparseLayer<T, T>
 
 protected:
     bool            m_binary_mode = true;
+    bool            m_host_simd = true;
+    bool            m_host_avx512 = true;
 
     index_t         m_input_node_size = 0;
     index_t         m_output_node_size = 0;
@@ -37,6 +39,7 @@ protected:
     FrameBuffer     m_x;
     FrameBuffer     m_y;
     FrameBuffer     m_dx;
+    FrameBuffer     m_dx_tmp;
 
     Tensor_<std::int32_t>   m_input_index;
 
@@ -58,6 +61,18 @@ protected:
         {
             m_binary_mode = EvalBool(args[1]);
         }
+
+        // Host SIMDモード設定
+        if (args.size() == 2 && args[0] == "host_simd")
+        {
+            m_host_simd = EvalBool(args[1]);
+        }
+
+        // Host AVX-512 利用設定(CPUが対応している場合のみ有効)
+        if (args.size() == 2 && args[0] == "host_avx512")
+        {
+            m_host_avx512 = EvalBool(args[1]);
+        }
 	}
 
 public:
@@ -296,6 +311,17 @@ public:
         m_W->Clamp(0.0, 1.0);
 //        }
 
+        // SIMD版
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            if ( m_host_avx512 && bb_cpu_has_avx512f() ) {
+                ForwardHostAvx512FP32();
+            }
+            else {
+                ForwardHostAvx2FP32();
+            }
+            return m_y;
+        }
+
         {
             auto frame_size = m_x.GetFrameSize();
             auto x_ptr = x.LockConst<T>();
@@ -377,6 +403,17 @@ public:
 
         m_dx.Resize(DataType<T>::type, dy.GetFrameSize(), m_input_node_size);
 
+        // SIMD版
+        if ( DataType<T>::type == BB_TYPE_FP32 && m_host_simd && bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+            if ( m_host_avx512 && bb_cpu_has_avx512f() ) {
+                BackwardHostAvx512FP32(dy);
+            }
+            else {
+                BackwardHostAvx2FP32(dy);
+            }
+            return m_dx;
+        }
+
         m_dW->FillZero();
         m_dx.FillZero();
 
@@ -498,6 +535,357 @@ public:
 
         return m_dx;
     }
+
+
+protected:
+    // SIMD版の係数(バイナリモード時は0/1化)
+    inline float HostSimdW(float W) const
+    {
+        if ( m_binary_mode ) {
+            W = W > 0.5f ? 1.0f : 0.0f;
+        }
+        return W;
+    }
+
+    // AVX2版 Forward (8frame単位)
+    //   スカラ版と同じ順序で演算するので結果はビット一致する
+    BB_TARGET_AVX2
+    void ForwardHostAvx2FP32(void)
+    {
+        index_t const frame_size   = m_x.GetFrameSize();
+        index_t const frame_stride = m_x.GetFrameStride() / sizeof(float);
+
+        auto x_ptr           = m_x.LockMemoryConst();
+        auto y_ptr           = m_y.LockMemory(true);
+        auto input_index_ptr = m_input_index.LockConst();
+        auto W_ptr           = lock_W_const();
+
+        auto x_buf = (float const *)x_ptr.GetAddr();
+        auto y_buf = (float       *)y_ptr.GetAddr();
+
+        __m256 const zero = _mm256_set1_ps(0.0f);
+        __m256 const one  = _mm256_set1_ps(1.0f);
+
+#pragma omp parallel for
+        for ( index_t node = 0; node < m_output_node_size; ++node ) {
+            float const *x_addr[4];
+            for ( int i = 0; i < 4; ++i ) {
+                x_addr[i] = &x_buf[frame_stride * input_index_ptr(node, i)];
+            }
+            float *y_addr = &y_buf[frame_stride * node];
+
+            __m256 W[16];
+            for ( int i = 0; i < 16; ++i ) {
+                W[i] = _mm256_set1_ps(HostSimdW((float)W_ptr(node, i)));
+            }
+
+            for ( index_t frame = 0; frame < frame_size; frame += 8 ) {
+                __m256 xp[4], xn[4];
+                for ( int i = 0; i < 4; ++i ) {
+                    xp[i] = _mm256_load_ps(&x_addr[i][frame]);
+                    xn[i] = _mm256_sub_ps(one, xp[i]);
+                }
+
+                // 2入力毎の組み合わせ (x0:入力0-1, x1:入力2-3)
+                __m256 x0[4], x1[4];
+                for ( int j = 0; j < 4; ++j ) {
+                    x0[j] = _mm256_mul_ps((j & 2) ? xp[1] : xn[1], (j & 1) ? xp[0] : xn[0]);
+                    x1[j] = _mm256_mul_ps((j & 2) ? xp[3] : xn[3], (j & 1) ? xp[2] : xn[2]);
+                }
+
+                __m256 sig = zero;
+                for ( int i1 = 0; i1 < 4; ++i1 ) {
+                    for ( int i0 = 0; i0 < 4; ++i0 ) {
+                        __m256 xi = _mm256_mul_ps(x1[i1], x0[i0]);
+                        sig = _mm256_add_ps(sig, _mm256_mul_ps(W[(i1 << 2) | i0], xi));
+                    }
+                }
+
+                sig = _mm256_max_ps(sig, zero);
+                sig = _mm256_min_ps(sig, one);
+                _mm256_store_ps(&y_addr[frame], sig);
+            }
+        }
+    }
+
+    // AVX-512版 Forward (16frame単位)
+    BB_TARGET_AVX512F
+    void ForwardHostAvx512FP32(void)
+    {
+        index_t const frame_size   = m_x.GetFrameSize();
+        index_t const frame_stride = m_x.GetFrameStride() / sizeof(float);
+
+        auto x_ptr           = m_x.LockMemoryConst();
+        auto y_ptr           = m_y.LockMemory(true);
+        auto input_index_ptr = m_input_index.LockConst();
+        auto W_ptr           = lock_W_const();
+
+        auto x_buf = (float const *)x_ptr.GetAddr();
+        auto y_buf = (float       *)y_ptr.GetAddr();
+
+        __m512 const zero = _mm512_set1_ps(0.0f);
+        __m512 const one  = _mm512_set1_ps(1.0f);
+
+#pragma omp parallel for
+        for ( index_t node = 0; node < m_output_node_size; ++node ) {
+            float const *x_addr[4];
+            for ( int i = 0; i < 4; ++i ) {
+                x_addr[i] = &x_buf[frame_stride * input_index_ptr(node, i)];
+            }
+            float *y_addr = &y_buf[frame_stride * node];
+
+            __m512 W[16];
+            for ( int i = 0; i < 16; ++i ) {
+                W[i] = _mm512_set1_ps(HostSimdW((float)W_ptr(node, i)));
+            }
+
+            for ( index_t frame = 0; frame < frame_size; frame += 16 ) {
+                // frame_stride は 8 の倍数なので終端はマスクしてアクセス
+                __mmask16 mask = (frame_size - frame >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (frame_size - frame)) - 1);
+
+                __m512 xp[4], xn[4];
+                for ( int i = 0; i < 4; ++i ) {
+                    xp[i] = _mm512_maskz_loadu_ps(mask, &x_addr[i][frame]);
+                    xn[i] = _mm512_sub_ps(one, xp[i]);
+                }
+
+                __m512 x0[4], x1[4];
+                for ( int j = 0; j < 4; ++j ) {
+                    x0[j] = _mm512_mul_ps((j & 2) ? xp[1] : xn[1], (j & 1) ? xp[0] : xn[0]);
+                    x1[j] = _mm512_mul_ps((j & 2) ? xp[3] : xn[3], (j & 1) ? xp[2] : xn[2]);
+                }
+
+                __m512 sig = zero;
+                for ( int i1 = 0; i1 < 4; ++i1 ) {
+                    for ( int i0 = 0; i0 < 4; ++i0 ) {
+                        __m512 xi = _mm512_mul_ps(x1[i1], x0[i0]);
+                        sig = _mm512_add_ps(sig, _mm512_mul_ps(W[(i1 << 2) | i0], xi));
+                    }
+                }
+
+                sig = _mm512_max_ps(sig, zero);
+                sig = _mm512_min_ps(sig, one);
+                _mm512_mask_storeu_ps(&y_addr[frame], mask, sig);
+            }
+        }
+    }
+
+
+    // AVX2版 Backward (8frame単位)
+    //   入力側の誤差はノード毎に m_dx_tmp に出力し、後でノード順に足しこむ
+    BB_TARGET_AVX2
+    void BackwardHostAvx2FP32(FrameBuffer const &dy_buf)
+    {
+        index_t const frame_size   = dy_buf.GetFrameSize();
+        index_t const frame_stride = dy_buf.GetFrameStride() / sizeof(float);
+        BB_ASSERT(m_x.GetFrameStride() == dy_buf.GetFrameStride());
+
+        m_dx_tmp.Resize(BB_TYPE_FP32, frame_size, m_output_node_size * 4);
+
+        {
+            auto x_ptr           = m_x.LockMemoryConst();
+            auto dy_ptr          = dy_buf.LockMemoryConst();
+            auto dx_tmp_ptr      = m_dx_tmp.LockMemory(true);
+            auto input_index_ptr = m_input_index.LockConst();
+            auto W_ptr           = lock_W_const();
+            auto dW_ptr          = lock_dW();
+
+            auto x_buf      = (float const *)x_ptr.GetAddr();
+            auto dy_buf_    = (float const *)dy_ptr.GetAddr();
+            auto dx_tmp_buf = (float       *)dx_tmp_ptr.GetAddr();
+
+            __m256 const zero = _mm256_set1_ps(0.0f);
+            __m256 const one  = _mm256_set1_ps(1.0f);
+
+#pragma omp parallel for
+            for ( index_t node = 0; node < m_output_node_size; ++node ) {
+                float const *x_addr[4];
+                for ( int i = 0; i < 4; ++i ) {
+                    x_addr[i] = &x_buf[frame_stride * input_index_ptr(node, i)];
+                }
+                float const *dy_addr     = &dy_buf_[frame_stride * node];
+                float       *dx_tmp_addr = &dx_tmp_buf[frame_stride * node * 4];
+
+                __m256 W[16];
+                __m256 dW[16];
+                for ( int i = 0; i < 16; ++i ) {
+                    W[i]  = _mm256_set1_ps(HostSimdW((float)W_ptr(node, i)));
+                    dW[i] = zero;
+                }
+
+                for ( index_t frame = 0; frame < frame_size; frame += 8 ) {
+                    // 端数フレームは 0 として扱い dW に寄与させない
+                    __m256 mask = bb_mm256_mask_ps((int)std::min(frame_size - frame, (index_t)8));
+
+                    __m256 xp[4], xn[4];
+                    for ( int i = 0; i < 4; ++i ) {
+                        xp[i] = _mm256_and_ps(_mm256_load_ps(&x_addr[i][frame]), mask);
+                        xn[i] = _mm256_sub_ps(one, xp[i]);
+                    }
+
+                    __m256 x0[4], x1[4];
+                    for ( int j = 0; j < 4; ++j ) {
+                        x0[j] = _mm256_mul_ps((j & 2) ? xp[1] : xn[1], (j & 1) ? xp[0] : xn[0]);
+                        x1[j] = _mm256_mul_ps((j & 2) ? xp[3] : xn[3], (j & 1) ? xp[2] : xn[2]);
+                    }
+
+                    __m256 grad = _mm256_and_ps(_mm256_load_ps(&dy_addr[frame]), mask);
+
+                    __m256 dx0[4], dx1[4];
+                    for ( int j = 0; j < 4; ++j ) {
+                        dx0[j] = zero;
+                        dx1[j] = zero;
+                    }
+
+                    for ( int i1 = 0; i1 < 4; ++i1 ) {
+                        for ( int i0 = 0; i0 < 4; ++i0 ) {
+                            int    i   = (i1 << 2) | i0;
+                            __m256 xi  = _mm256_mul_ps(x1[i1], x0[i0]);
+                            __m256 dxi = _mm256_mul_ps(W[i], grad);
+                            dW[i]   = _mm256_add_ps(dW[i], _mm256_mul_ps(xi, grad));
+                            dx0[i0] = _mm256_add_ps(dx0[i0], _mm256_mul_ps(x1[i1], dxi));
+                            dx1[i1] = _mm256_add_ps(dx1[i1], _mm256_mul_ps(x0[i0], dxi));
+                        }
+                    }
+
+                    __m256 *dx_pair[2] = { dx0, dx1 };
+                    __m256 dxp[4], dxn[4];
+                    for ( int i = 0; i < 4; ++i ) {
+                        dxp[i] = zero;
+                        dxn[i] = zero;
+                    }
+                    for ( int p = 0; p < 2; ++p ) {
+                        int lo = p * 2;
+                        int hi = p * 2 + 1;
+                        for ( int j = 0; j < 4; ++j ) {
+                            __m256 &d_lo = (j & 1) ? dxp[lo] : dxn[lo];
+                            __m256 &d_hi = (j & 2) ? dxp[hi] : dxn[hi];
+                            d_lo = _mm256_add_ps(d_lo, _mm256_mul_ps((j & 2) ? xp[hi] : xn[hi], dx_pair[p][j]));
+                            d_hi = _mm256_add_ps(d_hi, _mm256_mul_ps((j & 1) ? xp[lo] : xn[lo], dx_pair[p][j]));
+                        }
+                    }
+
+                    for ( int i = 0; i < 4; ++i ) {
+                        _mm256_store_ps(&dx_tmp_addr[frame_stride * i + frame], _mm256_sub_ps(dxp[i], dxn[i]));
+                    }
+                }
+
+                for ( int i = 0; i < 16; ++i ) {
+                    dW_ptr(node, i) = bb_mm256_cvtss_f32(bb_mm256_hsum_ps(dW[i]));
+                }
+            }
+        }
+
+        super::SumDxTmpHostFP32(m_dx, m_dx_tmp, m_input_index, 4);
+    }
+
+    // AVX-512版 Backward (16frame単位)
+    BB_TARGET_AVX512F
+    void BackwardHostAvx512FP32(FrameBuffer const &dy_buf)
+    {
+        index_t const frame_size   = dy_buf.GetFrameSize();
+        index_t const frame_stride = dy_buf.GetFrameStride() / sizeof(float);
+        BB_ASSERT(m_x.GetFrameStride() == dy_buf.GetFrameStride());
+
+        m_dx_tmp.Resize(BB_TYPE_FP32, frame_size, m_output_node_size * 4);
+
+        {
+            auto x_ptr           = m_x.LockMemoryConst();
+            auto dy_ptr          = dy_buf.LockMemoryConst();
+            auto dx_tmp_ptr      = m_dx_tmp.LockMemory(true);
+            auto input_index_ptr = m_input_index.LockConst();
+            auto W_ptr           = lock_W_const();
+            auto dW_ptr          = lock_dW();
+
+            auto x_buf      = (float const *)x_ptr.GetAddr();
+            auto dy_buf_    = (float const *)dy_ptr.GetAddr();
+            auto dx_tmp_buf = (float       *)dx_tmp_ptr.GetAddr();
+
+            __m512 const zero = _mm512_set1_ps(0.0f);
+            __m512 const one  = _mm512_set1_ps(1.0f);
+
+#pragma omp parallel for
+            for ( index_t node = 0; node < m_output_node_size; ++node ) {
+                float const *x_addr[4];
+                for ( int i = 0; i < 4; ++i ) {
+                    x_addr[i] = &x_buf[frame_stride * input_index_ptr(node, i)];
+                }
+                float const *dy_addr     = &dy_buf_[frame_stride * node];
+                float       *dx_tmp_addr = &dx_tmp_buf[frame_stride * node * 4];
+
+                __m512 W[16];
+                __m512 dW[16];
+                for ( int i = 0; i < 16; ++i ) {
+                    W[i]  = _mm512_set1_ps(HostSimdW((float)W_ptr(node, i)));
+                    dW[i] = zero;
+                }
+
+                for ( index_t frame = 0; frame < frame_size; frame += 16 ) {
+                    __mmask16 mask = (frame_size - frame >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (frame_size - frame)) - 1);
+
+                    __m512 xp[4], xn[4];
+                    for ( int i = 0; i < 4; ++i ) {
+                        xp[i] = _mm512_maskz_loadu_ps(mask, &x_addr[i][frame]);
+                        xn[i] = _mm512_sub_ps(one, xp[i]);
+                    }
+
+                    __m512 x0[4], x1[4];
+                    for ( int j = 0; j < 4; ++j ) {
+                        x0[j] = _mm512_mul_ps((j & 2) ? xp[1] : xn[1], (j & 1) ? xp[0] : xn[0]);
+                        x1[j] = _mm512_mul_ps((j & 2) ? xp[3] : xn[3], (j & 1) ? xp[2] : xn[2]);
+                    }
+
+                    __m512 grad = _mm512_maskz_loadu_ps(mask, &dy_addr[frame]);
+
+                    __m512 dx0[4], dx1[4];
+                    for ( int j = 0; j < 4; ++j ) {
+                        dx0[j] = zero;
+                        dx1[j] = zero;
+                    }
+
+                    for ( int i1 = 0; i1 < 4; ++i1 ) {
+                        for ( int i0 = 0; i0 < 4; ++i0 ) {
+                            int    i   = (i1 << 2) | i0;
+                            __m512 xi  = _mm512_mul_ps(x1[i1], x0[i0]);
+                            __m512 dxi = _mm512_mul_ps(W[i], grad);
+                            dW[i]   = _mm512_add_ps(dW[i], _mm512_mul_ps(xi, grad));
+                            dx0[i0] = _mm512_add_ps(dx0[i0], _mm512_mul_ps(x1[i1], dxi));
+                            dx1[i1] = _mm512_add_ps(dx1[i1], _mm512_mul_ps(x0[i0], dxi));
+                        }
+                    }
+
+                    __m512 *dx_pair[2] = { dx0, dx1 };
+                    __m512 dxp[4], dxn[4];
+                    for ( int i = 0; i < 4; ++i ) {
+                        dxp[i] = zero;
+                        dxn[i] = zero;
+                    }
+                    for ( int p = 0; p < 2; ++p ) {
+                        int lo = p * 2;
+                        int hi = p * 2 + 1;
+                        for ( int j = 0; j < 4; ++j ) {
+                            __m512 &d_lo = (j & 1) ? dxp[lo] : dxn[lo];
+                            __m512 &d_hi = (j & 2) ? dxp[hi] : dxn[hi];
+                            d_lo = _mm512_add_ps(d_lo, _mm512_mul_ps((j & 2) ? xp[hi] : xn[hi], dx_pair[p][j]));
+                            d_hi = _mm512_add_ps(d_hi, _mm512_mul_ps((j & 1) ? xp[lo] : xn[lo], dx_pair[p][j]));
+                        }
+                    }
+
+                    // 端数フレームには 0 が入るので frame_stride まで書き込む
+                    __mmask16 store_mask = (frame_stride - frame >= 16) ? (__mmask16)0xffff : (__mmask16)((1u << (frame_stride - frame)) - 1);
+                    for ( int i = 0; i < 4; ++i ) {
+                        _mm512_mask_storeu_ps(&dx_tmp_addr[frame_stride * i + frame], store_mask, _mm512_sub_ps(dxp[i], dxn[i]));
+                    }
+                }
+
+                for ( int i = 0; i < 16; ++i ) {
+                    dW_ptr(node, i) = _mm512_reduce_add_ps(dW[i]);
+                }
+            }
+        }
+
+        super::SumDxTmpHostFP32(m_dx, m_dx_tmp, m_input_index, 4);
+    }
 };
 
 
@@ -295,6 +295,8 @@ template<typename T>    Tensor_<T> operator/(T src0, Tensor_<T> const &src1);
 //template<typename T>    Tensor_<T> Exp  (Tensor_<T> const &src);
 //template<typename T>    Tensor_<T> Clamp(Tensor_<T> const &src, T a, T b);
 
+template<class E>       class TensorExpr_;
+
 class Tensor;
 
 template<typename T>
@@ -663,6 +665,13 @@ public:
         return *this;
     }
 
+    // 遅延評価の式の代入 (TensorExpression.h)
+    template<class E> Tensor_& operator= (TensorExpr_<E> const &expr);
+    template<class E> Tensor_& operator+=(TensorExpr_<E> const &expr);
+    template<class E> Tensor_& operator-=(TensorExpr_<E> const &expr);
+    template<class E> Tensor_& operator*=(TensorExpr_<E> const &expr);
+    template<class E> Tensor_& operator/=(TensorExpr_<E> const &expr);
+
     inline Tensor_& Sqrt(void)
     {
         auto ptr = LockMemory();
@@ -1428,6 +1437,23 @@ public:
         m_mem = Memory::Create(0, hostOnly);
 		Resize(type, size);
 	}
+
+    // 確保済みのメモリを参照する (mem は shape 分のサイズを持つこと)
+   	explicit Tensor(int type, std::vector<index_t> shape, std::shared_ptr<Memory> mem)
+	{
+		m_type = type;
+		m_shape = shape;
+		index_t total = 1;
+		for (auto size : m_shape) {
+            BB_ASSERT(size > 0);
+			m_stride.push_back(total);
+			total *= size;
+		}
+        m_size = total;
+
+        BB_ASSERT(mem->GetSize() >= m_size * DataType_GetByteSize(type));
+        m_mem = mem;
+	}
     
    	Tensor(const Tensor& tensor)
 	{
@@ -1973,6 +1999,13 @@ public:
         }
         return *this;
     }
+
+    // 遅延評価の式の代入 (TensorExpression.h)
+    template<class E> Tensor& operator= (TensorExpr_<E> const &expr);
+    template<class E> Tensor& operator+=(TensorExpr_<E> const &expr);
+    template<class E> Tensor& operator-=(TensorExpr_<E> const &expr);
+    template<class E> Tensor& operator*=(TensorExpr_<E> const &expr);
+    template<class E> Tensor& operator/=(TensorExpr_<E> const &expr);
     
     
     inline Tensor& Sqrt(void)
@@ -2358,4 +2391,7 @@ inline std::ostream& operator<<(std::ostream& os, Tensor const &t)
 
 
 
-}
\ No newline at end of file
+}
+
+
+#include "bb/TensorExpression.h"
@@ -0,0 +1,544 @@
+﻿// --------------------------------------------------------------------------
+//  Binary Brain  -- binary neural net framework
+//
+//                                     Copyright (C) 2018 by Ryuji Fuchikami
+//                                     https://github.com/ryuz
+//                                     ryuji.fuchikami@nifty.com
+// --------------------------------------------------------------------------
+
+
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
+#include "bb/Tensor.h"
+
+
+namespace bb {
+
+
+// -------------------------------------
+//  遅延評価の式テンプレート
+// -------------------------------------
+//  Expr() で包んだ Tensor_ / Tensor / Variables を含む式は、演算子で一時領域を作らずに式の木を組み立て、
+//  Tensor_ / Tensor / Variables への代入時に 1ループ(FP32 は CPU が対応していれば AVX2) でまとめて評価する
+//
+//    dst = Expr(x) * a + Expr(y) * y - c;        // x, y, dst を 1回ずつ走査するだけ
+//    dst += Sqrt(Expr(v)) + 1e-7;
+//
+//  ・Expr() で包まない Tensor_ 同士の演算は従来通り即時評価される
+//  ・代入先の既存の領域に書き込む(代入先が空の場合のみ式の形状で確保する)
+//  ・要素毎の演算のみなので、代入先が式の中に現れてもよい
+
+// これ以上の要素数の時に OpenMP で並列化する
+#ifndef BB_TENSOR_EXPR_PARALLEL_SIZE
+#define BB_TENSOR_EXPR_PARALLEL_SIZE    (16 * 1024)
+#endif
+
+
+// 式の木のラッパー(演算子の対象を式に限定するための型)
+template<class E>
+class TensorExpr_
+{
+public:
+    E   node;
+    explicit TensorExpr_(E const &e) : node(e) {}
+};
+
+
+// -------------------------------------
+//  演算の定義
+// -------------------------------------
+
+struct TensorExprOp_Add
+{
+    template<typename T> static T Calc(T a, T b) { return a + b; }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+};
+
+struct TensorExprOp_Sub
+{
+    template<typename T> static T Calc(T a, T b) { return a - b; }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+};
+
+struct TensorExprOp_Mul
+{
+    template<typename T> static T Calc(T a, T b) { return a * b; }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+};
+
+struct TensorExprOp_Div
+{
+    template<typename T> static T Calc(T a, T b) { return a / b; }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+};
+
+struct TensorExprOp_Min
+{
+    template<typename T> static T Calc(T a, T b) { return std::min(a, b); }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+};
+
+struct TensorExprOp_Max
+{
+    template<typename T> static T Calc(T a, T b) { return std::max(a, b); }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+};
+
+struct TensorExprOp_Neg
+{
+    template<typename T> static T Calc(T a) { return -a; }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+};
+
+struct TensorExprOp_Sqrt
+{
+    template<typename T> static T Calc(T a) { return (T)std::sqrt(a); }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a) { return _mm256_sqrt_ps(a); }
+};
+
+struct TensorExprOp_Exp
+{
+    template<typename T> static T Calc(T a) { return (T)std::exp(a); }
+    BB_TARGET_AVX2 static __m256 Calc8(__m256 a) { return bb_mm256_exp_ps(a); }
+};
+
+
+// -------------------------------------
+//  式の木のノード
+// -------------------------------------
+//  各ノードは以下を持つ
+//    GetSize(k)  : 要素数 (スカラーは -1)
+//    GetShape(k) : 形状 (スカラーは空)
+//    Bind<T>(k)  : メモリをロックして、要素 i を Get(i) / Get8(i) で読める評価用オブジェクトを返す
+//  k は Variables の何番目の Tensor を評価中かを表す(Tensor_ / Tensor では無視する)
+
+// 評価用: メモリ参照
+template<typename T>
+struct TensorExprBound_Memory_
+{
+    Memory::ConstPtr    ptr;
+    T const             *addr;
+
+    inline T      Get(index_t i)  const { return addr[i]; }
+    BB_TARGET_AVX2 inline __m256 Get8(index_t i) const { return _mm256_loadu_ps(&addr[i]); }
+};
+
+// 評価用: スカラー
+template<typename T>
+struct TensorExprBound_Scalar_
+{
+    T   value;
+
+    inline T      Get(index_t)  const { return value; }
+    BB_TARGET_AVX2 inline __m256 Get8(index_t) const { return _mm256_set1_ps(value); }
+};
+
+// 評価用: 単項演算
+template<class Op, class B>
+struct TensorExprBound_Unary_
+{
+    B   src;
+
+    inline auto   Get(index_t i)  const -> decltype(src.Get(i)) { return Op::Calc(src.Get(i)); }
+    BB_TARGET_AVX2 inline __m256 Get8(index_t i) const { return Op::Calc8(src.Get8(i)); }
+};
+
+// 評価用: 二項演算
+template<class Op, class B0, class B1>
+struct TensorExprBound_Binary_
+{
+    B0  src0;
+    B1  src1;
+
+    inline auto   Get(index_t i)  const -> decltype(src0.Get(i)) { return Op::Calc(src0.Get(i), src1.Get(i)); }
+    BB_TARGET_AVX2 inline __m256 Get8(index_t i) const { return Op::Calc8(src0.Get8(i), src1.Get8(i)); }
+};
+
+
+// Tensor_ の参照
+template<typename Tp>
+class TensorExprNode_Tensor_
+{
+protected:
+    Tensor_<Tp>     m_tensor;
+
+public:
+    explicit TensorExprNode_Tensor_(Tensor_<Tp> const &tensor) : m_tensor(tensor) {}
+
+    index_t   GetSize(index_t)  const { return m_tensor.GetSize(); }
+    indices_t GetShape(index_t) const { return m_tensor.GetShape(); }
+
+    template<typename T>
+    TensorExprBound_Memory_<T> Bind(index_t) const
+    {
+        BB_ASSERT(DataType<Tp>::type == DataType<T>::type);
+        auto ptr = m_tensor.LockMemoryConst();
+        auto addr = (T const *)ptr.GetAddr();
+        return TensorExprBound_Memory_<T>{ptr, addr};
+    }
+};
+
+// Tensor の参照(型は評価時に一致を確認する)
+class TensorExprNode_Tensor
+{
+protected:
+    Tensor          m_tensor;
+
+public:
+    explicit TensorExprNode_Tensor(Tensor const &tensor) : m_tensor(tensor) {}
+
+    index_t   GetSize(index_t)  const { return m_tensor.GetSize(); }
+    indices_t GetShape(index_t) const { return m_tensor.GetShape(); }
+
+    template<typename T>
+    TensorExprBound_Memory_<T> Bind(index_t) const
+    {
+        BB_ASSERT(m_tensor.GetType() == DataType<T>::type);
+        auto ptr = m_tensor.LockMemoryConst();
+        auto addr = (T const *)ptr.GetAddr();
+        return TensorExprBound_Memory_<T>{ptr, addr};
+    }
+};
+
+// スカラー
+class TensorExprNode_Scalar
+{
+protected:
+    double  m_value;
+
+public:
+    explicit TensorExprNode_Scalar(double value) : m_value(value) {}
+
+    index_t   GetSize(index_t)  const { return -1; }
+    indices_t GetShape(index_t) const { return indices_t(); }
+
+    template<typename T>
+    TensorExprBound_Scalar_<T> Bind(index_t) const
+    {
+        return TensorExprBound_Scalar_<T>{(T)m_value};
+    }
+};
+
+// 単項演算
+template<class Op, class E>
+class TensorExprNode_Unary_
+{
+protected:
+    E   m_src;
+
+public:
+    explicit TensorExprNode_Unary_(E const &src) : m_src(src) {}
+
+    index_t   GetSize(index_t k)  const { return m_src.GetSize(k); }
+    indices_t GetShape(index_t k) const { return m_src.GetShape(k); }
+
+    template<typename T>
+    auto Bind(index_t k) const -> TensorExprBound_Unary_<Op, decltype(m_src.template Bind<T>(k))>
+    {
+        return {m_src.template Bind<T>(k)};
+    }
+};
+
+// 二項演算
+template<class Op, class E0, class E1>
+class TensorExprNode_Binary_
+{
+protected:
+    E0  m_src0;
+    E1  m_src1;
+
+public:
+    TensorExprNode_Binary_(E0 const &src0, E1 const &src1) : m_src0(src0), m_src1(src1) {}
+
+    index_t GetSize(index_t k) const
+    {
+        index_t size0 = m_src0.GetSize(k);
+        index_t size1 = m_src1.GetSize(k);
+        BB_ASSERT(size0 < 0 || size1 < 0 || size0 == size1);
+        return size0 >= 0 ? size0 : size1;
+    }
+
+    indices_t GetShape(index_t k) const
+    {
+        indices_t shape = m_src0.GetShape(k);
+        return !shape.empty() ? shape : m_src1.GetShape(k);
+    }
+
+    template<typename T>
+    auto Bind(index_t k) const -> TensorExprBound_Binary_<Op, decltype(m_src0.template Bind<T>(k)), decltype(m_src1.template Bind<T>(k))>
+    {
+        return {m_src0.template Bind<T>(k), m_src1.template Bind<T>(k)};
+    }
+};
+
+
+// -------------------------------------
+//  式への変換
+// -------------------------------------
+
+// 式の被演算子になれる型からノードへの変換
+template<class X, class Enable = void>
+struct TensorExpr_Traits
+{
+    static bool const is_expr    = false;
+    static bool const is_operand = false;
+};
+
+template<class E>
+struct TensorExpr_Traits< TensorExpr_<E> >
+{
+    static bool const is_expr    = true;
+    static bool const is_operand = true;
+    using node_t = E;
+    static node_t ToNode(TensorExpr_<E> const &x) { return x.node; }
+};
+
+template<class X>
+struct TensorExpr_Traits<X, typename std::enable_if<std::is_arithmetic<X>::value>::type>
+{
+    static bool const is_expr    = false;
+    static bool const is_operand = true;
+    using node_t = TensorExprNode_Scalar;
+    static node_t ToNode(X x) { return node_t((double)x); }
+};
+
+template<typename Tp>
+struct TensorExpr_Traits< Tensor_<Tp> >
+{
+    static bool const is_expr    = false;
+    static bool const is_operand = true;
+    using node_t = TensorExprNode_Tensor_<Tp>;
+    static node_t ToNode(Tensor_<Tp> const &x) { return node_t(x); }
+};
+
+template<>
+struct TensorExpr_Traits<Tensor>
+{
+    static bool const is_expr    = false;
+    static bool const is_operand = true;
+    using node_t = TensorExprNode_Tensor;
+    static node_t ToNode(Tensor const &x) { return node_t(x); }
+};
+
+// 少なくとも一方が式の時のみ演算子を有効にする(式を含まない演算は従来の即時評価)
+template<class A, class B>
+struct TensorExpr_IsBinaryOperand
+{
+    static bool const value = (TensorExpr_Traits<A>::is_expr || TensorExpr_Traits<B>::is_expr)
+                                && TensorExpr_Traits<A>::is_operand && TensorExpr_Traits<B>::is_operand;
+};
+
+
+//! 遅延評価の式を開始する
+template<typename Tp>
+inline TensorExpr_< TensorExprNode_Tensor_<Tp> > Expr(Tensor_<Tp> const &tensor)
+{
+    return TensorExpr_< TensorExprNode_Tensor_<Tp> >(TensorExprNode_Tensor_<Tp>(tensor));
+}
+
+inline TensorExpr_<TensorExprNode_Tensor> Expr(Tensor const &tensor)
+{
+    return TensorExpr_<TensorExprNode_Tensor>(TensorExprNode_Tensor(tensor));
+}
+
+
+#define BB_TENSOR_EXPR_BINARY_OPERATOR(op, Op)  \
+    template<class A, class B, typename std::enable_if<TensorExpr_IsBinaryOperand<A, B>::value, int>::type = 0> \
+    inline TensorExpr_< TensorExprNode_Binary_<Op, typename TensorExpr_Traits<A>::node_t, typename TensorExpr_Traits<B>::node_t> >  \
+        op(A const &a, B const &b)  \
+    {   \
+        using node_t = TensorExprNode_Binary_<Op, typename TensorExpr_Traits<A>::node_t, typename TensorExpr_Traits<B>::node_t>;    \
+        return TensorExpr_<node_t>(node_t(TensorExpr_Traits<A>::ToNode(a), TensorExpr_Traits<B>::ToNode(b)));  \
+    }
+
+BB_TENSOR_EXPR_BINARY_OPERATOR(operator+, TensorExprOp_Add)
+BB_TENSOR_EXPR_BINARY_OPERATOR(operator-, TensorExprOp_Sub)
+BB_TENSOR_EXPR_BINARY_OPERATOR(operator*, TensorExprOp_Mul)
+BB_TENSOR_EXPR_BINARY_OPERATOR(operator/, TensorExprOp_Div)
+BB_TENSOR_EXPR_BINARY_OPERATOR(Min,       TensorExprOp_Min)
+BB_TENSOR_EXPR_BINARY_OPERATOR(Max,       TensorExprOp_Max)
+
+#undef BB_TENSOR_EXPR_BINARY_OPERATOR
+
+
+template<class E>
+inline TensorExpr_< TensorExprNode_Unary_<TensorExprOp_Neg, E> > operator-(TensorExpr_<E> const &src)
+{
+    return TensorExpr_< TensorExprNode_Unary_<TensorExprOp_Neg, E> >(TensorExprNode_Unary_<TensorExprOp_Neg, E>(src.node));
+}
+
+template<class E>
+inline TensorExpr_< TensorExprNode_Unary_<TensorExprOp_Sqrt, E> > Sqrt(TensorExpr_<E> const &src)
+{
+    return TensorExpr_< TensorExprNode_Unary_<TensorExprOp_Sqrt, E> >(TensorExprNode_Unary_<TensorExprOp_Sqrt, E>(src.node));
+}
+
+template<class E>
+inline TensorExpr_< TensorExprNode_Unary_<TensorExprOp_Exp, E> > Exp(TensorExpr_<E> const &src)
+{
+    return TensorExpr_< TensorExprNode_Unary_<TensorExprOp_Exp, E> >(TensorExprNode_Unary_<TensorExprOp_Exp, E>(src.node));
+}
+
+template<class E>
+inline auto Clamp(TensorExpr_<E> const &src, double a, double b) -> decltype(Min(Max(src, a), b))
+{
+    return Min(Max(src, a), b);
+}
+
+
+// -------------------------------------
+//  評価
+// -------------------------------------
+
+// 汎用版
+template<typename T, class B>
+inline void TensorExpr_Evaluate(T *dst, B const &src, index_t size)
+{
+    #pragma omp parallel for if(size >= BB_TENSOR_EXPR_PARALLEL_SIZE)
+    for ( index_t i = 0; i < size; ++i ) {
+        dst[i] = src.Get(i);
+    }
+}
+
+// FP32 AVX2版
+template<class B>
+BB_TARGET_AVX2
+inline void TensorExpr_EvaluateAvx2(float *dst, B const &src, index_t size)
+{
+    index_t const size8 = size & ~(index_t)7;
+
+    #pragma omp parallel for if(size >= BB_TENSOR_EXPR_PARALLEL_SIZE)
+    for ( index_t i = 0; i < size8; i += 8 ) {
+        _mm256_storeu_ps(&dst[i], src.Get8(i));
+    }
+
+    for ( index_t i = size8; i < size; ++i ) {
+        dst[i] = src.Get(i);
+    }
+}
+
+// FP32 版 (実行時に命令セットを選択)
+template<class B>
+inline void TensorExpr_Evaluate(float *dst, B const &src, index_t size)
+{
+    if ( bb_simd_get_level() >= BB_SIMD_AVX2 ) {
+        TensorExpr_EvaluateAvx2(dst, src, size);
+        return;
+    }
+    TensorExpr_Evaluate<float, B>(dst, src, size);
+}
+
+// 代入先(Tensor_ または Tensor) へ k 番目の式を評価する
+template<typename T, class Dst, class E>
+inline void TensorExpr_Assign(Dst &dst, E const &node, index_t k)
+{
+    index_t size = node.GetSize(k);
+    BB_ASSERT(size < 0 || size == dst.GetSize());
+
+    // 読み出し側を先にロックする(代入先が式に含まれていてもよい)
+    auto src = node.template Bind<T>(k);
+    auto ptr = dst.LockMemory();
+    TensorExpr_Evaluate((T *)ptr.GetAddr(), src, dst.GetSize());
+}
+
+// Tensor の型に応じて評価する
+template<class E>
+inline void TensorExpr_AssignTensor(Tensor &dst, E const &node, index_t k)
+{
+    switch ( dst.GetType() ) {
+    case BB_TYPE_FP32: TensorExpr_Assign<float >(dst, node, k); break;
+    case BB_TYPE_FP64: TensorExpr_Assign<double>(dst, node, k); break;
+    default:    BB_ASSERT(0);  break;
+    }
+}
+
+
+// -------------------------------------
+//  代入演算子
+// -------------------------------------
+
+template<typename T>
+template<class E>
+inline Tensor_<T> & Tensor_<T>::operator=(TensorExpr_<E> const &expr)
+{
+    if ( m_size == 0 ) {
+        Resize(expr.node.GetShape(0));
+    }
+    TensorExpr_Assign<T>(*this, expr.node, 0);
+    return *this;
+}
+
+template<typename T>
+template<class E>
+inline Tensor_<T> & Tensor_<T>::operator+=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) + expr;
+}
+
+template<typename T>
+template<class E>
+inline Tensor_<T> & Tensor_<T>::operator-=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) - expr;
+}
+
+template<typename T>
+template<class E>
+inline Tensor_<T> & Tensor_<T>::operator*=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) * expr;
+}
+
+template<typename T>
+template<class E>
+inline Tensor_<T> & Tensor_<T>::operator/=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) / expr;
+}
+
+
+template<class E>
+inline Tensor & Tensor::operator=(TensorExpr_<E> const &expr)
+{
+    BB_ASSERT(m_size > 0);
+    TensorExpr_AssignTensor(*this, expr.node, 0);
+    return *this;
+}
+
+template<class E>
+inline Tensor & Tensor::operator+=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) + expr;
+}
+
+template<class E>
+inline Tensor & Tensor::operator-=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) - expr;
+}
+
+template<class E>
+inline Tensor & Tensor::operator*=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) * expr;
+}
+
+template<class E>
+inline Tensor & Tensor::operator/=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) / expr;
+}
+
+
+}
+
+
+// end of file
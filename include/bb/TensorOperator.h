@@ -13,6 +13,11 @@
 #include <array>
 #include <vector>
 #include <memory>
+#include <cmath>
+#include <algorithm>
+
+#include "bb/DataType.h"
+#include "bb/SimdSupport.h"
 
 
 namespace bb {
@@ -22,6 +27,11 @@ namespace bb {
 //  基本演算定義
 // -------------------------------------
 
+// これ以上の要素数の時に OpenMP で並列化する(小さなテンソルではスレッド起動の方が重い)
+#ifndef BB_TENSOR_OPERATOR_PARALLEL_SIZE
+#define BB_TENSOR_OPERATOR_PARALLEL_SIZE    (16 * 1024)
+#endif
+
 template<typename T>
 inline void Tensor_Vector_set
 (
@@ -30,7 +40,7 @@ inline void Tensor_Vector_set
     index_t size
 )
 {
-#pragma omp parallel for 
+#pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = a;
     }
@@ -49,7 +59,7 @@ inline void Tensor_Vector_add_ex
     index_t size
 )
 {
-#pragma omp parallel for 
+#pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = a * src0[i] + b * src1[i] + c;
     }
@@ -68,7 +78,7 @@ inline void Tensor_Vector_sub_ex
     index_t size
 )
 {
-#pragma omp parallel for 
+#pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = a * src0[i] - b * src1[i] - c;
     }
@@ -86,7 +96,7 @@ inline void Tensor_Vector_mul_ex
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = a * src0[i] * src1[i] + b;
     }
@@ -105,7 +115,7 @@ inline void Tensor_Vector_div_ex
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = (a * src0[i] + b) / (c * src1[i] + d);
     }
@@ -119,25 +129,12 @@ inline void Tensor_Vector_sqrt(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = (T)std::sqrt((double)src[i]);
     }
 }
 
-template<>
-inline void Tensor_Vector_sqrt<float>(
-    float       *dst,
-    float const *src,
-    index_t size
-)
-{
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
-        dst[i] = std::sqrt(src[i]);
-    }
-}
-
 
 template<typename T>
 inline void Tensor_Vector_exp(
@@ -146,25 +143,12 @@ inline void Tensor_Vector_exp(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = (T)std::exp((double)src[i]);
     }
 }
 
-template<>
-inline void Tensor_Vector_exp<float>(
-    float       *dst,
-    float const *src,
-    index_t size
-)
-{
-    #pragma omp parallel for 
-    for (index_t i = 0; i < size; ++i) {
-        dst[i] = std::exp(src[i]);
-    }
-}
-
 
 template<typename T>
 inline void Tensor_Vector_min(
@@ -174,7 +158,7 @@ inline void Tensor_Vector_min(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = std::min(src0[i], src1[i]);
     }
@@ -188,7 +172,7 @@ inline void Tensor_Vector_min_v(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = std::min(src0[i], src1);
     }
@@ -203,7 +187,7 @@ inline void Tensor_Vector_max(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = std::max(src0[i], src1[i]);
     }
@@ -217,7 +201,7 @@ inline void Tensor_Vector_max_v(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = std::max(src0[i], src1);
     }
@@ -233,7 +217,7 @@ inline void Tensor_Vector_clamp(
     index_t size
 )
 {
-    #pragma omp parallel for 
+    #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
     for (index_t i = 0; i < size; ++i) {
         dst[i] = std::max(a, std::min(b, src[i]));
     }
@@ -241,6 +225,294 @@ inline void Tensor_Vector_clamp(
 
 
 
+// -------------------------------------
+//  FP32 の SIMD 版 (実行時に CPU を判定して切り替える)
+// -------------------------------------
+//  要素毎の演算を Op (Calc / Calc8 / Calc16) として定義し、命令セット毎のループに渡す
+//  Tensor_Vector_xxx<float> は初回呼び出し時に CPUID で選んだ関数テーブルを経由する
+
+struct TensorOperator_Fp32_Set
+{
+    float a;
+    float  Calc(float, float) const { return a; }
+    BB_TARGET_AVX2 __m256 Calc8(__m256, __m256) const { return _mm256_set1_ps(a); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512, __m512) const { return _mm512_set1_ps(a); }
+};
+
+struct TensorOperator_Fp32_AddEx
+{
+    float a, b, c;
+    float  Calc(float x, float y) const { return a * x + b * y + c; }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256 y) const { return _mm256_fmadd_ps(_mm256_set1_ps(a), x, _mm256_fmadd_ps(_mm256_set1_ps(b), y, _mm256_set1_ps(c))); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512 y) const { return _mm512_fmadd_ps(_mm512_set1_ps(a), x, _mm512_fmadd_ps(_mm512_set1_ps(b), y, _mm512_set1_ps(c))); }
+};
+
+struct TensorOperator_Fp32_SubEx
+{
+    float a, b, c;
+    float  Calc(float x, float y) const { return a * x - b * y - c; }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256 y) const { return _mm256_fmsub_ps(_mm256_set1_ps(a), x, _mm256_fmadd_ps(_mm256_set1_ps(b), y, _mm256_set1_ps(c))); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512 y) const { return _mm512_fmsub_ps(_mm512_set1_ps(a), x, _mm512_fmadd_ps(_mm512_set1_ps(b), y, _mm512_set1_ps(c))); }
+};
+
+struct TensorOperator_Fp32_MulEx
+{
+    float a, b;
+    float  Calc(float x, float y) const { return a * x * y + b; }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256 y) const { return _mm256_fmadd_ps(_mm256_mul_ps(_mm256_set1_ps(a), x), y, _mm256_set1_ps(b)); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512 y) const { return _mm512_fmadd_ps(_mm512_mul_ps(_mm512_set1_ps(a), x), y, _mm512_set1_ps(b)); }
+};
+
+struct TensorOperator_Fp32_DivEx
+{
+    float a, b, c, d;
+    float  Calc(float x, float y) const { return (a * x + b) / (c * y + d); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256 y) const
+    {
+        return _mm256_div_ps(_mm256_fmadd_ps(_mm256_set1_ps(a), x, _mm256_set1_ps(b)), _mm256_fmadd_ps(_mm256_set1_ps(c), y, _mm256_set1_ps(d)));
+    }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512 y) const
+    {
+        return _mm512_div_ps(_mm512_fmadd_ps(_mm512_set1_ps(a), x, _mm512_set1_ps(b)), _mm512_fmadd_ps(_mm512_set1_ps(c), y, _mm512_set1_ps(d)));
+    }
+};
+
+struct TensorOperator_Fp32_Sqrt
+{
+    float  Calc(float x, float) const { return std::sqrt(x); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256) const { return _mm256_sqrt_ps(x); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512) const { return _mm512_sqrt_ps(x); }
+};
+
+struct TensorOperator_Fp32_Exp
+{
+    float  Calc(float x, float) const { return std::exp(x); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256) const { return bb_mm256_exp_ps(x); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512) const { return bb_mm512_exp_ps(x); }
+};
+
+// std::min(x, y) = (y < x) ? y : x と NaN の扱いを合わせる
+struct TensorOperator_Fp32_Min
+{
+    float  Calc(float x, float y) const { return std::min(x, y); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256 y) const { return _mm256_min_ps(y, x); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512 y) const { return _mm512_min_ps(y, x); }
+};
+
+struct TensorOperator_Fp32_Max
+{
+    float  Calc(float x, float y) const { return std::max(x, y); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256 y) const { return _mm256_max_ps(y, x); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512 y) const { return _mm512_max_ps(y, x); }
+};
+
+struct TensorOperator_Fp32_MinV
+{
+    float v;
+    float  Calc(float x, float) const { return std::min(x, v); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256) const { return _mm256_min_ps(_mm256_set1_ps(v), x); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512) const { return _mm512_min_ps(_mm512_set1_ps(v), x); }
+};
+
+struct TensorOperator_Fp32_MaxV
+{
+    float v;
+    float  Calc(float x, float) const { return std::max(x, v); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256) const { return _mm256_max_ps(_mm256_set1_ps(v), x); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512) const { return _mm512_max_ps(_mm512_set1_ps(v), x); }
+};
+
+struct TensorOperator_Fp32_Clamp
+{
+    float a, b;
+    float  Calc(float x, float) const { return std::max(a, std::min(b, x)); }
+    BB_TARGET_AVX2 __m256 Calc8(__m256 x, __m256) const { return _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(b)), _mm256_set1_ps(a)); }
+    BB_TARGET_AVX512F __m512 Calc16(__m512 x, __m512) const { return _mm512_max_ps(_mm512_min_ps(x, _mm512_set1_ps(b)), _mm512_set1_ps(a)); }
+};
+
+
+// 命令セット毎のループ (src1 を使わない演算には src0 を渡す)
+struct TensorOperator_Scalar
+{
+    template<class Op>
+    static void Run(float *dst, float const *src0, float const *src1, Op const op, index_t size)
+    {
+        #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
+        for (index_t i = 0; i < size; ++i) {
+            dst[i] = op.Calc(src0[i], src1[i]);
+        }
+    }
+};
+
+struct TensorOperator_Avx2
+{
+    template<class Op>
+    BB_TARGET_AVX2
+    static void Run(float *dst, float const *src0, float const *src1, Op const op, index_t size)
+    {
+        index_t const size8 = size & ~(index_t)7;
+
+        #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
+        for (index_t i = 0; i < size8; i += 8) {
+            _mm256_storeu_ps(&dst[i], op.Calc8(_mm256_loadu_ps(&src0[i]), _mm256_loadu_ps(&src1[i])));
+        }
+        for (index_t i = size8; i < size; ++i) {
+            dst[i] = op.Calc(src0[i], src1[i]);
+        }
+    }
+};
+
+struct TensorOperator_Avx512
+{
+    template<class Op>
+    BB_TARGET_AVX512F
+    static void Run(float *dst, float const *src0, float const *src1, Op const op, index_t size)
+    {
+        index_t const size16 = size & ~(index_t)15;
+
+        #pragma omp parallel for if(size >= BB_TENSOR_OPERATOR_PARALLEL_SIZE)
+        for (index_t i = 0; i < size16; i += 16) {
+            _mm512_storeu_ps(&dst[i], op.Calc16(_mm512_loadu_ps(&src0[i]), _mm512_loadu_ps(&src1[i])));
+        }
+
+        // 端数はマスク付きで処理
+        if ( size16 < size ) {
+            __mmask16 mask = (__mmask16)((1u << (size - size16)) - 1);
+            __m512 x = _mm512_maskz_loadu_ps(mask, &src0[size16]);
+            __m512 y = _mm512_maskz_loadu_ps(mask, &src1[size16]);
+            _mm512_mask_storeu_ps(&dst[size16], mask, op.Calc16(x, y));
+        }
+    }
+};
+
+
+// 関数テーブル
+struct TensorOperator_Fp32Table
+{
+    char const *name;
+    void (*set)   (float *dst, float a, index_t size);
+    void (*add_ex)(float *dst, float const *src0, float const *src1, float a, float b, float c, index_t size);
+    void (*sub_ex)(float *dst, float const *src0, float const *src1, float a, float b, float c, index_t size);
+    void (*mul_ex)(float *dst, float const *src0, float const *src1, float a, float b, index_t size);
+    void (*div_ex)(float *dst, float const *src0, float const *src1, float a, float b, float c, float d, index_t size);
+    void (*sqrt)  (float *dst, float const *src, index_t size);
+    void (*exp)   (float *dst, float const *src, index_t size);
+    void (*min)   (float *dst, float const *src0, float const *src1, index_t size);
+    void (*min_v) (float *dst, float const *src0, float src1, index_t size);
+    void (*max)   (float *dst, float const *src0, float const *src1, index_t size);
+    void (*max_v) (float *dst, float const *src0, float src1, index_t size);
+    void (*clamp) (float *dst, float const *src, float a, float b, index_t size);
+};
+
+template<class Isa>
+struct TensorOperator_Fp32Kernel
+{
+    static void set   (float *dst, float a, index_t size)                                                   { Isa::Run(dst, dst, dst, TensorOperator_Fp32_Set{a}, size); }
+    static void add_ex(float *dst, float const *src0, float const *src1, float a, float b, float c, index_t size)  { Isa::Run(dst, src0, src1, TensorOperator_Fp32_AddEx{a, b, c}, size); }
+    static void sub_ex(float *dst, float const *src0, float const *src1, float a, float b, float c, index_t size)  { Isa::Run(dst, src0, src1, TensorOperator_Fp32_SubEx{a, b, c}, size); }
+    static void mul_ex(float *dst, float const *src0, float const *src1, float a, float b, index_t size)           { Isa::Run(dst, src0, src1, TensorOperator_Fp32_MulEx{a, b}, size); }
+    static void div_ex(float *dst, float const *src0, float const *src1, float a, float b, float c, float d, index_t size) { Isa::Run(dst, src0, src1, TensorOperator_Fp32_DivEx{a, b, c, d}, size); }
+    static void sqrt  (float *dst, float const *src, index_t size)                                          { Isa::Run(dst, src, src, TensorOperator_Fp32_Sqrt{}, size); }
+    static void exp   (float *dst, float const *src, index_t size)                                          { Isa::Run(dst, src, src, TensorOperator_Fp32_Exp{}, size); }
+    static void min   (float *dst, float const *src0, float const *src1, index_t size)                      { Isa::Run(dst, src0, src1, TensorOperator_Fp32_Min{}, size); }
+    static void min_v (float *dst, float const *src0, float src1, index_t size)                             { Isa::Run(dst, src0, src0, TensorOperator_Fp32_MinV{src1}, size); }
+    static void max   (float *dst, float const *src0, float const *src1, index_t size)                      { Isa::Run(dst, src0, src1, TensorOperator_Fp32_Max{}, size); }
+    static void max_v (float *dst, float const *src0, float src1, index_t size)                             { Isa::Run(dst, src0, src0, TensorOperator_Fp32_MaxV{src1}, size); }
+    static void clamp (float *dst, float const *src, float a, float b, index_t size)                        { Isa::Run(dst, src, src, TensorOperator_Fp32_Clamp{a, b}, size); }
+
+    static TensorOperator_Fp32Table Table(char const *name)
+    {
+        return TensorOperator_Fp32Table{name, set, add_ex, sub_ex, mul_ex, div_ex, sqrt, exp, min, min_v, max, max_v, clamp};
+    }
+};
+
+// 実行中の CPU で使える最も速い関数テーブル
+inline TensorOperator_Fp32Table const &TensorOperator_GetFp32Table(void)
+{
+    // 初回呼び出し時の bb_simd_get_level() で決定する
+    static TensorOperator_Fp32Table const table = (bb_simd_get_level() >= BB_SIMD_AVX512F)
+            ? TensorOperator_Fp32Kernel<TensorOperator_Avx512>::Table("avx512")
+            : (bb_simd_get_level() >= BB_SIMD_AVX2)
+                ? TensorOperator_Fp32Kernel<TensorOperator_Avx2>::Table("avx2")
+                : TensorOperator_Fp32Kernel<TensorOperator_Scalar>::Table("scalar");
+    return table;
+}
+
+
+template<>
+inline void Tensor_Vector_set<float>(float *dst, float a, index_t size)
+{
+    TensorOperator_GetFp32Table().set(dst, a, size);
+}
+
+template<>
+inline void Tensor_Vector_add_ex<float>(float *dst, float const *src0, float const *src1, float a, float b, float c, index_t size)
+{
+    TensorOperator_GetFp32Table().add_ex(dst, src0, src1, a, b, c, size);
+}
+
+template<>
+inline void Tensor_Vector_sub_ex<float>(float *dst, float const *src0, float const *src1, float a, float b, float c, index_t size)
+{
+    TensorOperator_GetFp32Table().sub_ex(dst, src0, src1, a, b, c, size);
+}
+
+template<>
+inline void Tensor_Vector_mul_ex<float>(float *dst, float const *src0, float const *src1, float a, float b, index_t size)
+{
+    TensorOperator_GetFp32Table().mul_ex(dst, src0, src1, a, b, size);
+}
+
+template<>
+inline void Tensor_Vector_div_ex<float>(float *dst, float const *src0, float const *src1, float a, float b, float c, float d, index_t size)
+{
+    TensorOperator_GetFp32Table().div_ex(dst, src0, src1, a, b, c, d, size);
+}
+
+template<>
+inline void Tensor_Vector_sqrt<float>(float *dst, float const *src, index_t size)
+{
+    TensorOperator_GetFp32Table().sqrt(dst, src, size);
+}
+
+template<>
+inline void Tensor_Vector_exp<float>(float *dst, float const *src, index_t size)
+{
+    TensorOperator_GetFp32Table().exp(dst, src, size);
+}
+
+template<>
+inline void Tensor_Vector_min<float>(float *dst, float const *src0, float const *src1, index_t size)
+{
+    TensorOperator_GetFp32Table().min(dst, src0, src1, size);
+}
+
+template<>
+inline void Tensor_Vector_min_v<float>(float *dst, float const *src0, float src1, index_t size)
+{
+    TensorOperator_GetFp32Table().min_v(dst, src0, src1, size);
+}
+
+template<>
+inline void Tensor_Vector_max<float>(float *dst, float const *src0, float const *src1, index_t size)
+{
+    TensorOperator_GetFp32Table().max(dst, src0, src1, size);
+}
+
+template<>
+inline void Tensor_Vector_max_v<float>(float *dst, float const *src0, float src1, index_t size)
+{
+    TensorOperator_GetFp32Table().max_v(dst, src0, src1, size);
+}
+
+template<>
+inline void Tensor_Vector_clamp<float>(float *dst, float const *src, float a, float b, index_t size)
+{
+    TensorOperator_GetFp32Table().clamp(dst, src, a, b, size);
+}
+
+
+
 }
 
 //endof file
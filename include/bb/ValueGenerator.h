@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include "bb/DataType.h"
+
 namespace bb {
 
 template <typename T>
@@ -18,6 +20,14 @@ public:
     virtual ~ValueGenerator(){}
     virtual void Reset(void)    = 0;
     virtual T    GetValue(void) = 0;
+
+    // まとめて生成 (GetValue を size 回呼ぶのと同じ並びを返す)
+    virtual void GetValues(T *values, index_t size)
+    {
+        for ( index_t i = 0; i < size; ++i ) {
+            values[i] = GetValue();
+        }
+    }
 };
 
 
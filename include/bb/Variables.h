@@ -287,6 +287,13 @@ public:
         return *this;
     }
 
+    // x]̎̑ (Tensor 1[vŕ])
+    template<class E> Variables &operator= (TensorExpr_<E> const &expr);
+    template<class E> Variables &operator+=(TensorExpr_<E> const &expr);
+    template<class E> Variables &operator-=(TensorExpr_<E> const &expr);
+    template<class E> Variables &operator*=(TensorExpr_<E> const &expr);
+    template<class E> Variables &operator/=(TensorExpr_<E> const &expr);
+
     Variables &Sqrt(void)
     {
         for ( size_t i = 0; i < m_tensors.size(); ++i ) {
@@ -470,6 +477,82 @@ inline std::ostream& operator<<(std::ostream& os, Variables const &v)
 }
 
 
+// -------------------------------------
+//  x]̎ (TensorExpression.h)
+// -------------------------------------
+
+// Variables ̎Q (k Ԗڂ Tensor ])
+class TensorExprNode_Variables
+{
+protected:
+    Variables   m_vars;
+
+public:
+    explicit TensorExprNode_Variables(Variables const &vars) : m_vars(vars) {}
+
+    index_t   GetSize(index_t k)  const { return m_vars[k].GetSize(); }
+    indices_t GetShape(index_t k) const { return m_vars[k].GetShape(); }
+
+    template<typename T>
+    TensorExprBound_Memory_<T> Bind(index_t k) const
+    {
+        BB_ASSERT(k >= 0 && k < m_vars.GetSize());
+        BB_ASSERT(m_vars[k].GetType() == DataType<T>::type);
+        auto ptr = m_vars[k].LockMemoryConst();
+        auto addr = (T const *)ptr.GetAddr();
+        return TensorExprBound_Memory_<T>{ptr, addr};
+    }
+};
+
+template<>
+struct TensorExpr_Traits<Variables>
+{
+    static bool const is_expr    = false;
+    static bool const is_operand = true;
+    using node_t = TensorExprNode_Variables;
+    static node_t ToNode(Variables const &x) { return node_t(x); }
+};
+
+inline TensorExpr_<TensorExprNode_Variables> Expr(Variables const &vars)
+{
+    return TensorExpr_<TensorExprNode_Variables>(TensorExprNode_Variables(vars));
+}
+
+
+template<class E>
+inline Variables &Variables::operator=(TensorExpr_<E> const &expr)
+{
+    for ( size_t i = 0; i < m_tensors.size(); ++i ) {
+        TensorExpr_AssignTensor(*m_tensors[i], expr.node, (index_t)i);
+    }
+    return *this;
+}
+
+template<class E>
+inline Variables &Variables::operator+=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) + expr;
+}
+
+template<class E>
+inline Variables &Variables::operator-=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) - expr;
+}
+
+template<class E>
+inline Variables &Variables::operator*=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) * expr;
+}
+
+template<class E>
+inline Variables &Variables::operator/=(TensorExpr_<E> const &expr)
+{
+    return *this = Expr(*this) / expr;
+}
+
+
 
 }
 
@@ -0,0 +1,49 @@
+﻿
+#pragma once
+
+
+/*
+#ifdef DLL_EXPORT
+#define BBLUT_DLL_EXPORT __declspec(dllexport) 
+#else
+#define BBLUT_DLL_EXPORT __declspec(dllimport) 
+#endif
+*/
+
+#define	BBLUT_DLL_EXPORT	/**/
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// -------------------------------------
+//  LUT-Net 推論エンジン (bb::LutNetEngine の C インターフェース)
+// -------------------------------------
+
+typedef struct bblut_engine bblut_engine;
+
+// LutNetEngine::SaveBinary で保存したファイルを読み込む (失敗時 NULL)
+BBLUT_DLL_EXPORT bblut_engine *bblut_Load(char const *filename, int max_frame_size);
+BBLUT_DLL_EXPORT void          bblut_Delete(bblut_engine *engine);
+
+BBLUT_DLL_EXPORT int bblut_GetInputNodeSize(bblut_engine const *engine);
+BBLUT_DLL_EXPORT int bblut_GetOutputNodeSize(bblut_engine const *engine);
+
+// x[frame * 入力ノード数 + node], y[frame * 出力ノード数 + node] に 0/1 を格納
+BBLUT_DLL_EXPORT int bblut_Forward
+        (
+            bblut_engine        *engine,
+            unsigned char const *x,
+            unsigned char       *y,
+            int                 frame_size
+        );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+// end of file
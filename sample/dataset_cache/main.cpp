@@ -0,0 +1,215 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   dataset cache converter
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string.h>
+
+#include "bb/DataSet.h"
+#include "bb/DataSetCache.h"
+#include "bb/LoadMnist.h"
+#include "bb/LoadCifar10.h"
+
+
+// 経過時間[ms]
+template <class F>
+static double MeasureTime(F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// ダウンロード不要の確認用データ (MNIST と同じ形状)
+static bb::DataSet<float> MakeSyntheticDataSet(int train_size, int test_size)
+{
+    std::mt19937_64                         mt(1);
+    std::uniform_int_distribution<int>      dist(0, 255);
+
+    bb::DataSet<float> ds;
+    ds.x_shape = bb::indices_t({28, 28, 1});
+    ds.t_shape = bb::indices_t({10});
+    ds.x_train.Resize(train_size, 28*28);
+    ds.t_train.Resize(train_size, 10);
+    ds.x_test.Resize(test_size, 28*28);
+    ds.t_test.Resize(test_size, 10);
+
+    for (int i = 0; i < train_size + test_size; ++i) {
+        auto &x = (i < train_size) ? ds.x_train : ds.x_test;
+        auto &t = (i < train_size) ? ds.t_train : ds.t_test;
+        bb::index_t index = (i < train_size) ? i : i - train_size;
+        for (int j = 0; j < 28*28; ++j) {
+            x.GetWritableSample(index)[j] = (float)dist(mt) / 255.0f;
+        }
+        t.GetWritableSample(index)[i % 10] = 1.0f;
+    }
+    return ds;
+}
+
+
+static bb::DataSet<float> LoadDataSet(std::string name)
+{
+    if ( name == "mnist" )     { return bb::LoadMnist<float>::LoadDataSet(); }
+    if ( name == "cifar10" )   { return bb::LoadCifar10<float>::LoadDataSet(); }
+    if ( name == "synthetic" ) { return MakeSyntheticDataSet(60000, 10000); }
+    return bb::DataSet<float>();
+}
+
+
+static bool LoadTrainData(std::string name, bb::TrainData<float> &td)
+{
+    if ( name == "mnist" )     { td = bb::LoadMnist<float>::Load(); return !td.empty(); }
+    if ( name == "cifar10" )   { td = bb::LoadCifar10<float>::Load(); return !td.empty(); }
+    return false;
+}
+
+
+// 全ブロックを読み出す(ページを実際に参照させる)
+static double TouchAll(bb::DataSetCache const &cache)
+{
+    double sum = 0;
+    for (bb::index_t block = 0; block < cache.GetBlockSize(); ++block) {
+        auto buf = cache.GetBlock(block);
+        auto ptr = buf.LockMemoryConst();
+        auto addr = (std::uint8_t const *)ptr.GetAddr();
+        for (bb::index_t i = 0; i < buf.GetMemorySize(buf.GetType(), buf.GetFrameSize(), buf.GetShape()); i += 64) {
+            sum += addr[i];
+        }
+    }
+    return sum;
+}
+
+
+// メイン関数
+int main(int argc, char *argv[])
+{
+    std::string name;
+    std::string prefix;
+    int         data_type    = BB_TYPE_FP32;
+    int         block_frames = 256;
+    bool        bench        = false;
+
+	if ( argc < 2 ) {
+        std::cout << "usage:" << std::endl;
+        std::cout << argv[0] << " [options] <dataset>" << std::endl;
+        std::cout << "" << std::endl;
+        std::cout << "options" << std::endl;
+        std::cout << "  -type <fp32|bit>                   set cache data type (default fp32)" << std::endl;
+        std::cout << "  -block <frames>                    set frames per block (default 256, use mini batch size)" << std::endl;
+        std::cout << "  -o <prefix>                        set output file prefix (default <dataset>)" << std::endl;
+        std::cout << "  -bench                             measure loading time" << std::endl;
+        std::cout << "" << std::endl;
+        std::cout << "dataset" << std::endl;
+        std::cout << "  mnist      MNIST (train-images-idx3-ubyte etc. in current directory)" << std::endl;
+        std::cout << "  cifar10    CIFAR-10 (cifar-10-batches-bin/ in current directory)" << std::endl;
+        std::cout << "  synthetic  random data of MNIST shape" << std::endl;
+		return 1;
+	}
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-type") == 0 && i + 1 < argc) {
+            ++i;
+            data_type = (strcmp(argv[i], "bit") == 0) ? BB_TYPE_BIT : BB_TYPE_FP32;
+        }
+        else if (strcmp(argv[i], "-block") == 0 && i + 1 < argc) {
+            ++i;
+            block_frames = (int)strtoul(argv[i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            ++i;
+            prefix = argv[i];
+        }
+        else if (strcmp(argv[i], "-bench") == 0) {
+            bench = true;
+        }
+        else {
+            name = argv[i];
+        }
+    }
+    if ( prefix.empty() ) {
+        prefix = name;
+    }
+
+    // 読み込み
+    bb::DataSet<float> ds;
+    double time_dataset = MeasureTime([&]() { ds = LoadDataSet(name); });
+    if ( ds.empty() ) {
+        std::cerr << "load error : " << name << std::endl;
+        return 1;
+    }
+
+    // 変換
+    std::string const type_name = (data_type == BB_TYPE_BIT) ? "bit" : "fp32";
+    std::string const files[4] = {
+            prefix + "_x_train_" + type_name + ".bbc",
+            prefix + "_t_train.bbc",
+            prefix + "_x_test_" + type_name + ".bbc",
+            prefix + "_t_test.bbc",
+        };
+    bool ok = true;
+    double time_write = MeasureTime([&]() {
+            ok = ok && bb::DataSetCache::Write(files[0], ds.x_train, ds.x_shape, data_type,    block_frames);
+            ok = ok && bb::DataSetCache::Write(files[1], ds.t_train, ds.t_shape, BB_TYPE_FP32, block_frames);
+            ok = ok && bb::DataSetCache::Write(files[2], ds.x_test,  ds.x_shape, data_type,    block_frames);
+            ok = ok && bb::DataSetCache::Write(files[3], ds.t_test,  ds.t_shape, BB_TYPE_FP32, block_frames);
+        });
+    if ( !ok ) {
+        std::cerr << "write error" << std::endl;
+        return 1;
+    }
+    for (auto const &f : files) {
+        std::cout << "[write] " << f << std::endl;
+    }
+
+    if ( !bench ) {
+        return 0;
+    }
+
+    // 読み込み時間の比較
+    std::cout << std::fixed << std::setprecision(2);
+
+    bb::TrainData<float> td;
+    double time_train_data = -1;
+    if ( name != "synthetic" ) {
+        time_train_data = MeasureTime([&]() { LoadTrainData(name, td); });
+    }
+
+    std::shared_ptr<bb::DataSetCache> caches[4];
+    double time_open = MeasureTime([&]() {
+            for (int i = 0; i < 4; ++i) {
+                caches[i] = bb::DataSetCache::Open(files[i]);
+            }
+        });
+    for (int i = 0; i < 4; ++i) {
+        if ( !caches[i] ) {
+            std::cerr << "open error : " << files[i] << std::endl;
+            return 1;
+        }
+    }
+
+    double sum = 0;
+    double time_touch = MeasureTime([&]() {
+            for (int i = 0; i < 4; ++i) {
+                sum += TouchAll(*caches[i]);
+            }
+        });
+
+    if ( time_train_data >= 0 ) {
+        std::cout << "TrainData (vector of vector) load    : " << std::setw(10) << time_train_data << " ms" << std::endl;
+    }
+    std::cout << "DataSet (contiguous) load            : " << std::setw(10) << time_dataset << " ms" << std::endl;
+    std::cout << "DataSetCache write                   : " << std::setw(10) << time_write   << " ms" << std::endl;
+    std::cout << "DataSetCache open (mmap)             : " << std::setw(10) << time_open    << " ms" << std::endl;
+    std::cout << "DataSetCache wrap and read all blocks: " << std::setw(10) << time_touch   << " ms  (checksum " << sum << ")" << std::endl;
+
+	return 0;
+}
+
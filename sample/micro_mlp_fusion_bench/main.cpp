@@ -0,0 +1,138 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   MicroMlp layer fusion benchmark
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string.h>
+
+#include "bb/MicroMlp.h"
+
+
+// 1回あたりの経過時間[ms] (合計がおおよそ min_ms を超えるまで繰り返す)
+template <class F>
+static double MeasureTime(F func, double min_ms = 200.0)
+{
+    func();     // ウォームアップ
+
+    long    loop  = 0;
+    double  total = 0;
+    auto    start = std::chrono::steady_clock::now();
+    do {
+        func();
+        ++loop;
+        total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    } while ( total < min_ms );
+    return total / loop;
+}
+
+
+// backward のみの経過時間[ms] (forward は計測から除く)
+template <class Layer>
+static double MeasureBackward(Layer const &layer, bb::FrameBuffer const &x, bb::FrameBuffer const &dy, int loop = 10)
+{
+    layer->Forward(x, true);
+    layer->Backward(dy);     // ウォームアップ
+
+    double total = 0;
+    for ( int i = 0; i < loop; ++i ) {
+        layer->Forward(x, true);
+        auto start = std::chrono::steady_clock::now();
+        layer->Backward(dy);
+        total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return total / loop;
+}
+
+
+// 出力サイズのバッファを何回読み書きするか (入力と重みの読み出しは共通なので除く)
+//   推論     通常 : affine W, BN R/W, 活性化 R/W = 5  融合 : W = 1
+//   学習fwd  通常 : 5                              融合 : affine W, 正規化+活性化 R/W = 3
+//   学習bwd  通常 : 活性化 R/R/W, BN R/R/W = 6      融合 : R/R/R/W = 4
+struct Traffic { int inference; int forward; int backward; };
+static Traffic const    TrafficNormal = {5, 5, 6};
+static Traffic const    TrafficFused  = {1, 3, 4};
+
+
+template <class Activation>
+static void Bench(char const *name, bb::index_t input_node_size, bb::index_t output_node_size, bb::index_t frame_size)
+{
+    auto mm = bb::MicroMlp<6, 16, float, Activation>::Create(output_node_size);
+    mm->SetInputShape({input_node_size});
+    mm->SendCommand("host_only true");
+
+    bb::FrameBuffer x(BB_TYPE_FP32, frame_size, input_node_size);
+    bb::FrameBuffer dy(BB_TYPE_FP32, frame_size, output_node_size);
+    {
+        std::mt19937                            mt(1);
+        std::uniform_real_distribution<float>   dist(-1.0f, 1.0f);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < input_node_size; ++node ) {
+                x.SetFP32(frame, node, dist(mt));
+            }
+            for ( bb::index_t node = 0; node < output_node_size; ++node ) {
+                dy.SetFP32(frame, node, dist(mt));
+            }
+        }
+    }
+
+    double buf_mb = (double)output_node_size * (double)dy.GetFrameStride() / (1024.0 * 1024.0);
+
+    std::cout << std::endl << "[" << name << "]  " << input_node_size << " -> " << output_node_size << " nodes, " << frame_size << " frames" << std::endl;
+    std::cout << std::setw(12) << "" << std::setw(14) << "normal[ms]" << std::setw(14) << "fused[ms]" << std::setw(10) << "speedup"
+              << std::setw(14) << "normal[MB]" << std::setw(14) << "fused[MB]" << std::endl;
+
+    double t[2][3];
+    for ( int fused = 0; fused < 2; ++fused ) {
+        mm->SendCommand(fused ? "fusion true" : "fusion false");
+        t[fused][0] = MeasureTime([&]() { mm->Forward(x, false); });
+        t[fused][1] = MeasureTime([&]() { mm->Forward(x, true); });
+        t[fused][2] = MeasureBackward(mm, x, dy);
+    }
+
+    char const *labels[3] = {"inference", "train fwd", "train bwd"};
+    int normal_traffic[3] = {TrafficNormal.inference, TrafficNormal.forward, TrafficNormal.backward};
+    int fused_traffic[3]  = {TrafficFused.inference,  TrafficFused.forward,  TrafficFused.backward};
+    for ( int i = 0; i < 3; ++i ) {
+        std::cout << std::setw(12) << labels[i]
+                  << std::setw(14) << std::fixed << std::setprecision(3) << t[0][i]
+                  << std::setw(14) << t[1][i]
+                  << std::setw(9)  << std::setprecision(2) << t[0][i] / t[1][i] << "x"
+                  << std::setw(14) << std::setprecision(1) << normal_traffic[i] * buf_mb
+                  << std::setw(14) << fused_traffic[i] * buf_mb << std::endl;
+    }
+}
+
+
+// メイン関数
+int main(int argc, char *argv[])
+{
+    bb::index_t frame_size = 8192;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            ++i;
+            frame_size = (bb::index_t)strtoull(argv[i], NULL, 0);
+        }
+        else {
+            std::cout << "usage:" << std::endl;
+            std::cout << argv[0] << " [-frames <size>]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "simd level : " << bb::bb_simd_get_level() << std::endl;
+
+    // MnistMicroMlpLutMlp の各層と同じ大きさ
+    Bench< bb::ReLU<float> >    ("ReLU",     28*28, 1024, frame_size);
+    Bench< bb::ReLU<float> >    ("ReLU",     1024,  360,  frame_size);
+    Bench< bb::Binarize<float> >("Binarize", 1024,  360,  frame_size);
+
+    return 0;
+}
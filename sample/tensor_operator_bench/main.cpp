@@ -0,0 +1,107 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   TensorOperator micro benchmark
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string.h>
+
+#include "bb/TensorOperator.h"
+
+
+// 1回あたりの経過時間[us] (合計がおおよそ min_ms を超えるまで繰り返す)
+template <class F>
+static double MeasureTime(F func, double min_ms = 50.0)
+{
+    func();     // ウォームアップ
+
+    long    loop  = 0;
+    double  total = 0;
+    auto    start = std::chrono::steady_clock::now();
+    do {
+        func();
+        ++loop;
+        total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    } while ( total < min_ms );
+    return total * 1000.0 / loop;
+}
+
+
+// 演算1種類を全サイズ・全命令セットで計測
+template <class F>
+static void Bench(char const *name, std::vector<bb::TensorOperator_Fp32Table> const &tables, bb::index_t max_size, F func)
+{
+    std::cout << std::endl << "[" << name << "]" << std::endl;
+    std::cout << std::setw(10) << "size";
+    for ( auto const &tbl : tables ) {
+        std::cout << std::setw(14) << tbl.name << "[us]";
+    }
+    std::cout << std::setw(12) << "speedup" << std::endl;
+
+    for ( bb::index_t size = 64; size <= max_size; size *= 4 ) {
+        std::cout << std::setw(10) << size;
+        std::vector<double> times;
+        for ( auto const &tbl : tables ) {
+            times.push_back(MeasureTime([&]() { func(tbl, size); }));
+            std::cout << std::setw(18) << std::fixed << std::setprecision(3) << times.back();
+        }
+        std::cout << std::setw(11) << std::setprecision(2) << times.front() / times.back() << "x" << std::endl;
+    }
+}
+
+
+// メイン関数
+int main(int argc, char *argv[])
+{
+    bb::index_t max_size = 64 * 1024 * 1024;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-max") == 0 && i + 1 < argc) {
+            ++i;
+            max_size = (bb::index_t)strtoull(argv[i], NULL, 0);
+        }
+        else {
+            std::cout << "usage:" << std::endl;
+            std::cout << argv[0] << " [-max <size>]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<bb::TensorOperator_Fp32Table> tables;
+    tables.push_back(bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Scalar>::Table("scalar"));
+    tables.push_back(bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Avx2>::Table("avx2"));
+    if ( bb::bb_cpu_has_avx512f() ) {
+        tables.push_back(bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Avx512>::Table("avx512"));
+    }
+
+    std::cout << "dispatch         : " << bb::TensorOperator_GetFp32Table().name << std::endl;
+    std::cout << "parallel size    : " << BB_TENSOR_OPERATOR_PARALLEL_SIZE << std::endl;
+
+    std::vector<float> src0(max_size), src1(max_size), dst(max_size);
+    for ( bb::index_t i = 0; i < max_size; ++i ) {
+        src0[i] = (float)(i % 1000) * 0.001f;
+        src1[i] = (float)(i % 777)  * 0.002f + 0.5f;
+    }
+
+    Bench("add_ex", tables, max_size, [&](bb::TensorOperator_Fp32Table const &tbl, bb::index_t size) {
+            tbl.add_ex(&dst[0], &src0[0], &src1[0], 1.0f, 2.0f, 3.0f, size); });
+    Bench("mul_ex", tables, max_size, [&](bb::TensorOperator_Fp32Table const &tbl, bb::index_t size) {
+            tbl.mul_ex(&dst[0], &src0[0], &src1[0], 1.0f, 0.5f, size); });
+    Bench("div_ex", tables, max_size, [&](bb::TensorOperator_Fp32Table const &tbl, bb::index_t size) {
+            tbl.div_ex(&dst[0], &src0[0], &src1[0], 1.0f, 0.0f, 1.0f, 0.0f, size); });
+    Bench("sqrt", tables, max_size, [&](bb::TensorOperator_Fp32Table const &tbl, bb::index_t size) {
+            tbl.sqrt(&dst[0], &src1[0], size); });
+    Bench("exp", tables, max_size, [&](bb::TensorOperator_Fp32Table const &tbl, bb::index_t size) {
+            tbl.exp(&dst[0], &src0[0], size); });
+    Bench("clamp", tables, max_size, [&](bb::TensorOperator_Fp32Table const &tbl, bb::index_t size) {
+            tbl.clamp(&dst[0], &src0[0], 0.1f, 0.9f, size); });
+
+    return 0;
+}
+
@@ -0,0 +1,31 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include "Bench.h"
+
+#include "bb/MicroMlpAffine.h"
+#include "bb/DenseAffine.h"
+#include "bb/BatchNormalization.h"
+
+
+// 全結合・正規化の層
+void Bench_Affine(BenchRunner &runner)
+{
+    for ( auto frame_size : runner.frame_sizes ) {
+        for ( auto node_size : runner.node_sizes ) {
+            bb::indices_t shape({node_size});
+
+            Bench_Model(runner, "MicroMlpAffine<6,16>", bb::MicroMlpAffine<6, 16, float>::Create(shape), BB_TYPE_FP32, frame_size, shape);
+            Bench_Model(runner, "DenseAffine",          bb::DenseAffine<float>::Create(shape),           BB_TYPE_FP32, frame_size, shape);
+            Bench_Model(runner, "BatchNormalization",   bb::BatchNormalization<float>::Create(),         BB_TYPE_FP32, frame_size, shape);
+        }
+    }
+}
+
+
+// end of file
@@ -0,0 +1,294 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#pragma once
+
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "bb/FrameBuffer.h"
+#include "bb/Model.h"
+#include "bb/SimdSupport.h"
+
+
+//[BenchRunner クラス]
+//  ・計測条件(スイープするサイズ、計測時間、名前のフィルタ)を持ち、結果を表示しながら溜める
+//  ・溜めた結果はコミット間の比較用に JSON で出力する
+
+class BenchRunner
+{
+public:
+    struct Result
+    {
+        std::string         name;           // ベンチマーク名 (層の名前など)
+        std::string         type;           // データ型 ("fp32", "bit" など)
+        std::string         phase;          // "forward", "backward" など
+        bb::index_t         frame_size = 0;
+        bb::indices_t       input_shape;
+        bb::indices_t       output_shape;
+        double              time_us    = 0; // 1回あたりの時間
+        long                loops      = 0;
+    };
+
+    std::string                 filter;             // 名前に含まれる場合のみ実行 (空なら全部)
+    double                      min_ms     = 100.0; // 1項目あたりの最低計測時間
+    bool                        host_only  = false;
+    std::vector<bb::index_t>    frame_sizes;
+    std::vector<bb::index_t>    node_sizes;
+    std::vector<Result>         results;
+
+    BenchRunner()
+    {
+        SetSweep(false, false);
+    }
+
+    //! スイープするサイズの設定
+    void SetSweep(bool quick, bool full)
+    {
+        if ( quick ) {
+            frame_sizes = {256};
+            node_sizes  = {256};
+        }
+        else if ( full ) {
+            frame_sizes = {256, 1024, 4096};
+            node_sizes  = {256, 1024, 4096};
+        }
+        else {
+            frame_sizes = {256, 1024};
+            node_sizes  = {256, 1024};
+        }
+    }
+
+    bool Match(std::string const &name) const
+    {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // 1回あたりの経過時間[us] (合計がおおよそ min_ms を超えるまで繰り返す)
+    template <class F>
+    double Measure(F func, long &loops)
+    {
+        func();     // ウォームアップ
+
+        double  total = 0;
+        auto    start = std::chrono::steady_clock::now();
+        loops = 0;
+        do {
+            func();
+            ++loops;
+            total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        } while ( total < min_ms );
+        return total * 1000.0 / loops;
+    }
+
+    template <class F>
+    void Run(std::string name, std::string type, std::string phase, bb::index_t frame_size,
+                bb::indices_t input_shape, bb::indices_t output_shape, F func)
+    {
+        Result r;
+        r.name         = name;
+        r.type         = type;
+        r.phase        = phase;
+        r.frame_size   = frame_size;
+        r.input_shape  = input_shape;
+        r.output_shape = output_shape;
+        r.time_us      = Measure(func, r.loops);
+        Add(r);
+    }
+
+    void Add(Result const &r)
+    {
+        std::ostringstream shape;
+        shape << ShapeString(r.input_shape) << "->" << ShapeString(r.output_shape);
+
+        std::cout << std::left  << std::setw(28) << r.name
+                  << std::setw(6)  << r.type
+                  << std::setw(10) << r.phase
+                  << std::right << std::setw(7)  << r.frame_size << "  "
+                  << std::left  << std::setw(28) << shape.str()
+                  << std::right << std::fixed << std::setprecision(3) << std::setw(14) << r.time_us << " us"
+                  << std::endl;
+        results.push_back(r);
+    }
+
+    void PrintHeader(void) const
+    {
+        std::cout << std::left  << std::setw(28) << "name"
+                  << std::setw(6)  << "type"
+                  << std::setw(10) << "phase"
+                  << std::right << std::setw(7)  << "frames" << "  "
+                  << std::left  << std::setw(28) << "shape"
+                  << std::right << std::setw(17) << "time"
+                  << std::endl;
+        std::cout << std::string(100, '-') << std::endl;
+    }
+
+    //! 結果を JSON で出力
+    bool WriteJson(std::string filename, std::string label) const
+    {
+        std::ofstream ofs(filename);
+        if ( !ofs.is_open() ) {
+            return false;
+        }
+
+        ofs << "{" << std::endl;
+        ofs << "  \"label\": \"" << label << "\"," << std::endl;
+        ofs << "  \"simd_level\": " << bb::bb_simd_get_level() << "," << std::endl;
+        ofs << "  \"threads\": " << GetMaxThreads() << "," << std::endl;
+#ifdef BB_WITH_CUDA
+        ofs << "  \"cuda\": " << (host_only ? "false" : "true") << "," << std::endl;
+#else
+        ofs << "  \"cuda\": false," << std::endl;
+#endif
+        ofs << "  \"min_ms\": " << min_ms << "," << std::endl;
+        ofs << "  \"results\": [" << std::endl;
+        for ( size_t i = 0; i < results.size(); ++i ) {
+            auto const &r = results[i];
+            ofs << "    {\"name\": \"" << r.name << "\", \"type\": \"" << r.type << "\", \"phase\": \"" << r.phase << "\""
+                << ", \"frame_size\": " << r.frame_size
+                << ", \"input_shape\": " << ShapeJson(r.input_shape)
+                << ", \"output_shape\": " << ShapeJson(r.output_shape)
+                << std::fixed << std::setprecision(3)
+                << ", \"time_us\": " << r.time_us
+                << ", \"loops\": " << r.loops
+                << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        ofs << "  ]" << std::endl;
+        ofs << "}" << std::endl;
+
+        return !ofs.fail();
+    }
+
+    static int GetMaxThreads(void)
+    {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+protected:
+    static std::string ShapeString(bb::indices_t const &shape)
+    {
+        std::ostringstream os;
+        for ( size_t i = 0; i < shape.size(); ++i ) {
+            os << (i > 0 ? "x" : "") << shape[i];
+        }
+        return os.str();
+    }
+
+    static std::string ShapeJson(bb::indices_t const &shape)
+    {
+        std::ostringstream os;
+        os << "[";
+        for ( size_t i = 0; i < shape.size(); ++i ) {
+            os << (i > 0 ? ", " : "") << shape[i];
+        }
+        os << "]";
+        return os.str();
+    }
+};
+
+
+inline std::string Bench_TypeName(int type)
+{
+    switch ( type ) {
+    case BB_TYPE_BIT:   return "bit";
+    case BB_TYPE_FP32:  return "fp32";
+    case BB_TYPE_FP64:  return "fp64";
+    }
+    return "unknown";
+}
+
+
+//! 乱数で埋めた FrameBuffer の作成 (Bit は 0/1 、実数は [0, 1) )
+inline bb::FrameBuffer Bench_MakeFrameBuffer(int type, bb::index_t frame_size, bb::indices_t shape, std::uint64_t seed = 1)
+{
+    std::mt19937_64                         mt(seed);
+    std::uniform_real_distribution<float>   dist(0.0f, 1.0f);
+
+    bb::FrameBuffer buf(type, frame_size, shape);
+    if ( type == BB_TYPE_BIT ) {
+        auto ptr = buf.Lock<bb::Bit>(true);
+        for ( bb::index_t node = 0; node < buf.GetNodeSize(); ++node ) {
+            auto addr = (std::uint32_t *)ptr.GetAddr(node);
+            for ( bb::index_t i = 0; i < (frame_size + 31) / 32; ++i ) {
+                addr[i] = (std::uint32_t)mt();
+            }
+        }
+    }
+    else {
+        BB_ASSERT(type == BB_TYPE_FP32);
+        auto ptr = buf.Lock<float>(true);
+        for ( bb::index_t node = 0; node < buf.GetNodeSize(); ++node ) {
+            auto addr = ptr.GetAddr(node);
+            for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                addr[frame] = dist(mt);
+            }
+        }
+    }
+    return buf;
+}
+
+
+/**
+ * @brief  モデル1個の Forward/Backward の計測
+ * @param  x_type    入力の型
+ * @param  backward  Backward も計測する場合 true (dy は FP32)
+ */
+inline void Bench_Model(BenchRunner &runner, std::string name, std::shared_ptr<bb::Model> model,
+                int x_type, bb::index_t frame_size, bb::indices_t input_shape, bool backward = true)
+{
+    if ( !runner.Match(name) ) {
+        return;
+    }
+
+    if ( runner.host_only ) {
+        model->SendCommand("host_only true");
+    }
+    auto output_shape = model->SetInputShape(input_shape);
+    auto x = Bench_MakeFrameBuffer(x_type, frame_size, input_shape);
+
+    bb::FrameBuffer y;
+    runner.Run(name, Bench_TypeName(x_type), "forward", frame_size, input_shape, output_shape,
+                [&]() { y = model->Forward(x, true); });
+
+    runner.Run(name, Bench_TypeName(x_type), "inference", frame_size, input_shape, output_shape,
+                [&]() { y = model->Forward(x, false); });
+
+    if ( backward ) {
+        model->Forward(x, true);
+        auto dy = Bench_MakeFrameBuffer(BB_TYPE_FP32, y.GetFrameSize(), output_shape, 2);
+        runner.Run(name, Bench_TypeName(x_type), "backward", frame_size, input_shape, output_shape,
+                    [&]() { model->Backward(dy); });
+    }
+}
+
+
+// 各ベンチマーク (ファイル毎にまとめる)
+void Bench_Lut(BenchRunner &runner);
+void Bench_Affine(BenchRunner &runner);
+void Bench_Conv(BenchRunner &runner);
+void Bench_Modulation(BenchRunner &runner);
+void Bench_Train(BenchRunner &runner);
+
+
+// end of file
@@ -0,0 +1,58 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include "Bench.h"
+
+#include "bb/MaxPooling.h"
+#include "bb/ConvolutionIm2Col.h"
+#include "bb/ConvolutionCol2Im.h"
+
+
+// 畳み込み関連の層 (16x16 の画像で、チャネル数に node_sizes / 8 を使う)
+void Bench_Conv(BenchRunner &runner)
+{
+    bb::index_t const w_size = 16;
+    bb::index_t const h_size = 16;
+
+    for ( auto frame_size : runner.frame_sizes ) {
+        for ( auto node_size : runner.node_sizes ) {
+            bb::index_t   c_size = std::max((bb::index_t)1, node_size / 8);
+            bb::indices_t shape({w_size, h_size, c_size});
+
+            // 画素をフレームに展開するのでフレーム数を減らす
+            bb::index_t conv_frame_size = std::max((bb::index_t)1, frame_size / 16);
+
+            int types[] = {BB_TYPE_FP32, BB_TYPE_BIT};
+            for ( auto type : types ) {
+                if ( type == BB_TYPE_BIT ) {
+                    Bench_Model(runner, "MaxPooling<2,2>", bb::MaxPooling<bb::Bit, float>::Create(2, 2), type, frame_size, shape);
+                    Bench_Model(runner, "Im2Col<3,3>", bb::ConvolutionIm2Col<bb::Bit, float>::Create(3, 3), type, conv_frame_size, shape);
+                }
+                else {
+                    Bench_Model(runner, "MaxPooling<2,2>", bb::MaxPooling<float, float>::Create(2, 2), type, frame_size, shape);
+                    Bench_Model(runner, "Im2Col<3,3>", bb::ConvolutionIm2Col<float, float>::Create(3, 3), type, conv_frame_size, shape);
+                }
+            }
+
+            // Col2Im の入力は Im2Col の出力と同じ並び (フレーム数 × 画素数)
+            Bench_Model(runner, "Col2Im", bb::ConvolutionCol2Im<float, float>::Create(h_size, w_size), BB_TYPE_FP32,
+                            conv_frame_size * h_size * w_size, bb::indices_t({c_size}));
+            Bench_Model(runner, "Col2Im", bb::ConvolutionCol2Im<bb::Bit, float>::Create(h_size, w_size), BB_TYPE_BIT,
+                            conv_frame_size * h_size * w_size, bb::indices_t({c_size}));
+
+            // host_simd を使わない汎用版 (SIMD 版との比較用)
+            auto col2im_generic = bb::ConvolutionCol2Im<float, float>::Create(h_size, w_size);
+            col2im_generic->SendCommand("host_simd false");
+            Bench_Model(runner, "Col2Im(generic)", col2im_generic, BB_TYPE_FP32,
+                            conv_frame_size * h_size * w_size, bb::indices_t({c_size}));
+        }
+    }
+}
+
+
+// end of file
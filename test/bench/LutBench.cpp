@@ -0,0 +1,89 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include "Bench.h"
+
+#include "bb/BinaryLutN.h"
+#include "bb/StochasticLut2.h"
+#include "bb/StochasticLut4.h"
+#include "bb/StochasticLut6.h"
+#include "bb/MaxPooling.h"
+#include "bb/LoweringConvolution.h"
+#include "bb/LutNetEngine.h"
+
+
+// MNIST LUT-CNN 相当のネットの推論 (層毎の実行と LutNetEngine の比較)
+static void Bench_LutNet(BenchRunner &runner)
+{
+    if ( !runner.Match("LutNet") ) {
+        return;
+    }
+
+    auto cnv0_sub = bb::Sequential::Create();
+    cnv0_sub->Add(bb::BinaryLutN<6, bb::Bit, float>::Create(96));
+    cnv0_sub->Add(bb::BinaryLutN<6, bb::Bit, float>::Create(16));
+
+    auto cnv1_sub = bb::Sequential::Create();
+    cnv1_sub->Add(bb::BinaryLutN<6, bb::Bit, float>::Create(96));
+    cnv1_sub->Add(bb::BinaryLutN<4, bb::Bit, float>::Create(16));
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::LoweringConvolution<bb::Bit, float>::Create(cnv0_sub, 3, 3));
+    net->Add(bb::MaxPooling<bb::Bit, float>::Create(2, 2));
+    net->Add(bb::LoweringConvolution<bb::Bit, float>::Create(cnv1_sub, 3, 3, 2, 2, 1, 1));
+    net->Add(bb::BinaryLutN<6, bb::Bit, float>::Create(60));
+    net->Add(bb::BinaryLutN<5, bb::Bit, float>::Create(10));
+
+    bb::indices_t input_shape({28, 28, 1});
+    auto output_shape = net->SetInputShape(input_shape);
+    net->SendCommand("host_only true");     // エンジンは Host のみ
+
+    bb::LutNetEngine engine;
+    if ( !engine.Compile(net, 1024) ) {
+        return;
+    }
+
+    for ( bb::index_t frame_size : {(bb::index_t)1, (bb::index_t)256, (bb::index_t)1024} ) {
+        auto x = Bench_MakeFrameBuffer(BB_TYPE_BIT, frame_size, input_shape);
+        bb::FrameBuffer y;
+        runner.Run("LutNet(runtime)", "bit", "inference", frame_size, input_shape, output_shape,
+                    [&]() { y = net->Forward(x, false); });
+        runner.Run("LutNet(engine)", "bit", "inference", frame_size, input_shape, output_shape,
+                    [&]() { y = engine.Forward(x); });
+    }
+}
+
+
+// LUT 系の層 (入力ノード数 = 出力ノード数 で接続はランダム)
+void Bench_Lut(BenchRunner &runner)
+{
+    for ( auto frame_size : runner.frame_sizes ) {
+        for ( auto node_size : runner.node_sizes ) {
+            bb::indices_t shape({node_size});
+
+            // BinaryLutN は Backward を持たない
+            Bench_Model(runner, "BinaryLut6", bb::BinaryLutN<6, bb::Bit, float>::Create(shape), BB_TYPE_BIT,  frame_size, shape, false);
+            Bench_Model(runner, "BinaryLut6", bb::BinaryLutN<6, float, float>::Create(shape),   BB_TYPE_FP32, frame_size, shape, false);
+            Bench_Model(runner, "BinaryLut4", bb::BinaryLutN<4, bb::Bit, float>::Create(shape), BB_TYPE_BIT,  frame_size, shape, false);
+
+            // 論理演算プログラム版 (host_simd との比較用)
+            auto lut6_program = bb::BinaryLutN<6, bb::Bit, float>::Create(shape);
+            lut6_program->SendCommand("host_program true");
+            Bench_Model(runner, "BinaryLut6(program)", lut6_program, BB_TYPE_BIT, frame_size, shape, false);
+
+            Bench_Model(runner, "StochasticLut2", bb::StochasticLut2<float>::Create(shape), BB_TYPE_FP32, frame_size, shape);
+            Bench_Model(runner, "StochasticLut4", bb::StochasticLut4<float>::Create(shape), BB_TYPE_FP32, frame_size, shape);
+            Bench_Model(runner, "StochasticLut6", bb::StochasticLut6<float>::Create(shape), BB_TYPE_FP32, frame_size, shape);
+        }
+    }
+
+    Bench_LutNet(runner);
+}
+
+
+// end of file
@@ -0,0 +1,39 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include "Bench.h"
+
+#include "bb/RealToBinary.h"
+#include "bb/BinaryToReal.h"
+#include "bb/PhiloxGenerator.h"
+
+
+// 変調・復調の層 (frame_mux_size = 7 で変調し、同じ多重化数で戻す)
+void Bench_Modulation(BenchRunner &runner)
+{
+    bb::index_t const mux_size = 7;
+
+    for ( auto frame_size : runner.frame_sizes ) {
+        for ( auto node_size : runner.node_sizes ) {
+            bb::indices_t shape({node_size});
+
+            Bench_Model(runner, "RealToBinary<bit>",  bb::RealToBinary<float, bb::Bit, float>::Create(mux_size), BB_TYPE_FP32, frame_size, shape, false);
+            Bench_Model(runner, "RealToBinary<fp32>", bb::RealToBinary<float, float, float>::Create(mux_size),   BB_TYPE_FP32, frame_size, shape, false);
+            Bench_Model(runner, "RealToBinary<bit,philox>",
+                            bb::RealToBinary<float, bb::Bit, float>::Create(mux_size, bb::PhiloxGenerator<float>::Create(0.0f, 1.0f, 1)),
+                            BB_TYPE_FP32, frame_size, shape, false);
+
+            Bench_Model(runner, "BinaryToReal", bb::BinaryToReal<bb::Bit, float, float>::Create(shape, mux_size), BB_TYPE_BIT,  frame_size * mux_size, shape);
+            Bench_Model(runner, "BinaryToReal", bb::BinaryToReal<float, float, float>::Create(shape, mux_size),   BB_TYPE_FP32, frame_size * mux_size, shape);
+            Bench_Model(runner, "BinaryToReal(mux1)", bb::BinaryToReal<bb::Bit, float, float>::Create(shape, 1), BB_TYPE_BIT, frame_size, shape);
+        }
+    }
+}
+
+
+// end of file
@@ -0,0 +1,87 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include "Bench.h"
+
+#include "bb/LossSoftmaxCrossEntropy.h"
+#include "bb/LossMeanSquaredError.h"
+#include "bb/MetricsCategoricalAccuracy.h"
+#include "bb/MetricsBinaryAccuracy.h"
+#include "bb/MetricsMeanSquaredError.h"
+#include "bb/OptimizerAdam.h"
+#include "bb/OptimizerSgd.h"
+#include "bb/DenseAffine.h"
+
+
+// 損失関数 (クラス数 10 と node_sizes)
+static void Bench_Loss(BenchRunner &runner, std::string name, std::shared_ptr<bb::LossFunction> loss, bb::index_t frame_size, bb::index_t node_size)
+{
+    if ( !runner.Match(name) ) {
+        return;
+    }
+
+    bb::indices_t shape({node_size});
+    auto y = Bench_MakeFrameBuffer(BB_TYPE_FP32, frame_size, shape, 1);
+    auto t = Bench_MakeFrameBuffer(BB_TYPE_FP32, frame_size, shape, 2);
+    runner.Run(name, "fp32", "loss", frame_size, shape, shape, [&]() { loss->CalculateLoss(y, t); });
+}
+
+// 評価関数
+static void Bench_Metrics(BenchRunner &runner, std::string name, std::shared_ptr<bb::MetricsFunction> metrics, bb::index_t frame_size, bb::index_t node_size)
+{
+    if ( !runner.Match(name) ) {
+        return;
+    }
+
+    bb::indices_t shape({node_size});
+    auto y = Bench_MakeFrameBuffer(BB_TYPE_FP32, frame_size, shape, 1);
+    auto t = Bench_MakeFrameBuffer(BB_TYPE_FP32, frame_size, shape, 2);
+    runner.Run(name, "fp32", "metrics", frame_size, shape, bb::indices_t({1}), [&]() { metrics->CalculateMetrics(y, t); });
+}
+
+// 最適化 (node_size x node_size の DenseAffine のパラメータを更新)
+static void Bench_Optimizer(BenchRunner &runner, std::string name, std::shared_ptr<bb::Optimizer> optimizer, bb::index_t node_size)
+{
+    if ( !runner.Match(name) ) {
+        return;
+    }
+
+    auto affine = bb::DenseAffine<float>::Create(node_size);
+    if ( runner.host_only ) {
+        affine->SendCommand("host_only true");
+    }
+    affine->SetInputShape(bb::indices_t({node_size}));
+    optimizer->SetVariables(affine->GetParameters(), affine->GetGradients());
+
+    bb::index_t param_size = node_size * node_size + node_size;
+    runner.Run(name, "fp32", "update", 0, bb::indices_t({param_size}), bb::indices_t({param_size}), [&]() { optimizer->Update(); });
+}
+
+
+void Bench_Train(BenchRunner &runner)
+{
+    for ( auto frame_size : runner.frame_sizes ) {
+        bb::index_t class_sizes[] = {10, runner.node_sizes.back()};
+        for ( auto node_size : class_sizes ) {
+            Bench_Loss(runner, "LossSoftmaxCrossEntropy", bb::LossSoftmaxCrossEntropy<float>::Create(), frame_size, node_size);
+            Bench_Loss(runner, "LossMeanSquaredError",    bb::LossMeanSquaredError<float>::Create(),    frame_size, node_size);
+
+            Bench_Metrics(runner, "MetricsCategoricalAccuracy", bb::MetricsCategoricalAccuracy<float>::Create(), frame_size, node_size);
+            Bench_Metrics(runner, "MetricsBinaryAccuracy",      bb::MetricsBinaryAccuracy<float>::Create(),      frame_size, node_size);
+            Bench_Metrics(runner, "MetricsMeanSquaredError",    bb::MetricsMeanSquaredError<float>::Create(),    frame_size, node_size);
+        }
+    }
+
+    for ( auto node_size : runner.node_sizes ) {
+        Bench_Optimizer(runner, "OptimizerAdam", bb::OptimizerAdam<float>::Create(), node_size);
+        Bench_Optimizer(runner, "OptimizerSgd",  bb::OptimizerSgd<float>::Create(),  node_size);
+    }
+}
+
+
+// end of file
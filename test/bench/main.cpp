@@ -0,0 +1,90 @@
+﻿// --------------------------------------------------------------------------
+//  BinaryBrain  -- binary network evaluation platform
+//   layer micro benchmark suite
+//
+//                                Copyright (C) 2018-2019 by Ryuji Fuchikami
+// --------------------------------------------------------------------------
+
+
+#include <iostream>
+#include <string.h>
+
+#include "Bench.h"
+
+
+// メイン関数
+int main(int argc, char *argv[])
+{
+    BenchRunner runner;
+    std::string json_file;
+    std::string label;
+    bool        quick = false;
+    bool        full  = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc) {
+            ++i;
+            runner.filter = argv[i];
+        }
+        else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) {
+            ++i;
+            json_file = argv[i];
+        }
+        else if (strcmp(argv[i], "-label") == 0 && i + 1 < argc) {
+            ++i;
+            label = argv[i];
+        }
+        else if (strcmp(argv[i], "-min_ms") == 0 && i + 1 < argc) {
+            ++i;
+            runner.min_ms = strtod(argv[i], NULL);
+        }
+        else if (strcmp(argv[i], "-quick") == 0) {
+            quick = true;
+        }
+        else if (strcmp(argv[i], "-full") == 0) {
+            full = true;
+        }
+        else if (strcmp(argv[i], "-host_only") == 0) {
+            runner.host_only = true;
+        }
+        else {
+            std::cout << "usage:" << std::endl;
+            std::cout << argv[0] << " [options]" << std::endl;
+            std::cout << "" << std::endl;
+            std::cout << "options" << std::endl;
+            std::cout << "  -filter <name>     run only benchmarks whose name contains <name>" << std::endl;
+            std::cout << "  -json <file>       write results as JSON" << std::endl;
+            std::cout << "  -label <label>     label stored in JSON (e.g. commit hash)" << std::endl;
+            std::cout << "  -min_ms <ms>       minimum measuring time per item (default 100)" << std::endl;
+            std::cout << "  -quick             small sweep (frame 256, node 256)" << std::endl;
+            std::cout << "  -full              large sweep (up to frame 4096, node 4096)" << std::endl;
+            std::cout << "  -host_only         run on host even if CUDA is available" << std::endl;
+            return 1;
+        }
+    }
+    runner.SetSweep(quick, full);
+
+    std::cout << "simd level : " << bb::bb_simd_get_level() << std::endl;
+    std::cout << "threads    : " << BenchRunner::GetMaxThreads() << std::endl;
+    std::cout << std::endl;
+
+    runner.PrintHeader();
+    Bench_Lut(runner);
+    Bench_Affine(runner);
+    Bench_Conv(runner);
+    Bench_Modulation(runner);
+    Bench_Train(runner);
+
+    if ( !json_file.empty() ) {
+        if ( !runner.WriteJson(json_file, label) ) {
+            std::cerr << "write error : " << json_file << std::endl;
+            return 1;
+        }
+        std::cout << std::endl << "[write] " << json_file << std::endl;
+    }
+
+    return 0;
+}
+
+
+// end of file
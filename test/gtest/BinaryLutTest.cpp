@@ -1,6 +1,7 @@
 ﻿#include <string>
 #include <iostream>
 #include <fstream>
+#include <random>
 
 #include "gtest/gtest.h"
 
@@ -189,3 +190,186 @@ TEST(NeuralNetBinaryLut6, testLoweringConvolution_cmp_bit)
     testBinaryLut6_cmpare<6, bb::Bit, float>(2, 16, 16, 32);
 }
 
+
+
+// 論理演算プログラムへの変換が真理値表と一致するか
+void testLutProgram_table(int input_size, std::uint64_t table)
+{
+    std::uint64_t mask = (input_size >= 6) ? ~(std::uint64_t)0 : (((std::uint64_t)1 << (1 << input_size)) - 1);
+
+    auto prog_mux = bb::LutProgram::CompileShannon(input_size, table);
+    auto prog_sop = bb::LutProgram::CompileSop(input_size, table);
+    EXPECT_TRUE(prog_mux.IsValid());
+    for (int i = 0; i < (1 << input_size); ++i) {
+        bool exp = ((table & mask) >> i) & 1;
+        EXPECT_EQ(exp, prog_mux.Evaluate(i));
+        if ( prog_sop.IsValid() ) {
+            EXPECT_EQ(exp, prog_sop.Evaluate(i));
+        }
+    }
+}
+
+TEST(BinaryLutTest, testLutProgram)
+{
+    std::mt19937_64 mt(1);
+    for (int n = 1; n <= 6; ++n) {
+        testLutProgram_table(n, 0);
+        testLutProgram_table(n, ~(std::uint64_t)0);
+        testLutProgram_table(n, 0xaaaaaaaaaaaaaaaaULL);     // x0
+        testLutProgram_table(n, 0x6996966996696996ULL);     // parity
+        testLutProgram_table(n, 0x8000000000000000ULL);     // and
+        testLutProgram_table(n, 0xfffffffffffffffeULL);     // or
+        for (int i = 0; i < 200; ++i) {
+            testLutProgram_table(n, mt());
+        }
+    }
+
+    // 単純な関数は積和形の方が短くなる
+    auto prog_and = bb::LutProgram::Compile(6, 0x8000000000000000ULL, false);
+    EXPECT_EQ(5, prog_and.GetCost(false));
+
+    // 単一入力は演算不要
+    auto prog_x3 = bb::LutProgram::Compile(6, 0xff00ff00ff00ff00ULL, false);
+    EXPECT_EQ(0, prog_x3.GetCost(false));
+}
+
+
+template <int N>
+void testBinaryLut_program_cmp(int input_node_size, int output_node_size, int frame_size, bool avx512)
+{
+    auto lut_ref  = bb::BinaryLutN<N, bb::Bit, float>::Create(output_node_size);
+    auto lut_prog = bb::BinaryLutN<N, bb::Bit, float>::Create(output_node_size);
+
+    bb::FrameBuffer x_buf(BB_TYPE_BIT, frame_size, input_node_size, true);
+    lut_ref->SetInputShape(x_buf.GetShape());
+    lut_prog->SetInputShape(x_buf.GetShape());
+
+    for (int node = 0; node < output_node_size; ++node) {
+        for (int i = 0; i < N; ++i) {
+            lut_prog->SetNodeInput(node, i, lut_ref->GetNodeInput(node, i));
+        }
+        for (int i = 0; i < (1 << N); ++i) {
+            lut_prog->SetLutTable(node, i, lut_ref->GetLutTable(node, i));
+        }
+    }
+
+    // 定数や単純な関数のノードも混ぜる
+    for (int i = 0; i < (1 << N); ++i) {
+        lut_ref->SetLutTable(0, i, false);
+        lut_prog->SetLutTable(0, i, false);
+        if ( output_node_size > 1 ) {
+            lut_ref->SetLutTable(1, i, (i & 1) != 0);
+            lut_prog->SetLutTable(1, i, (i & 1) != 0);
+        }
+    }
+
+    lut_ref->SendCommand("host_only true");
+    lut_ref->SendCommand("host_simd false");
+    lut_prog->SendCommand("host_only true");
+    lut_prog->SendCommand("host_program true");
+    lut_prog->SendCommand(avx512 ? "host_avx512 true" : "host_avx512 false");
+
+    std::mt19937_64 mt(1);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < input_node_size; ++node) {
+            x_buf.SetBit(frame, node, (mt() & 1) != 0);
+        }
+    }
+
+    auto y_ref  = lut_ref->Forward(x_buf, false);
+    auto y_prog = lut_prog->Forward(x_buf, false);
+
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < output_node_size; ++node) {
+            EXPECT_EQ(y_ref.GetBit(frame, node), y_prog.GetBit(frame, node));
+        }
+    }
+
+    // テーブル変更が反映されること
+    for (int i = 0; i < (1 << N); ++i) {
+        lut_ref->SetLutTable(0, i, true);
+        lut_prog->SetLutTable(0, i, true);
+    }
+    y_ref  = lut_ref->Forward(x_buf, false);
+    y_prog = lut_prog->Forward(x_buf, false);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        EXPECT_EQ(y_ref.GetBit(frame, 0), y_prog.GetBit(frame, 0));
+    }
+}
+
+TEST(BinaryLutTest, testBinaryLut_program)
+{
+    for (int avx512 = 0; avx512 < 2; ++avx512) {
+        if ( avx512 && !bb::bb_cpu_has_avx512f() ) {
+            continue;
+        }
+        testBinaryLut_program_cmp<6>(16,  1,   1,         avx512 != 0);
+        testBinaryLut_program_cmp<6>(16,  33,  256,       avx512 != 0);
+        testBinaryLut_program_cmp<6>(64,  130, 256*5 + 3, avx512 != 0);
+        testBinaryLut_program_cmp<4>(16,  33,  256*3 + 1, avx512 != 0);
+        testBinaryLut_program_cmp<2>(8,   17,  300,       avx512 != 0);
+    }
+}
+
+
+// SIMD版と汎用版の比較
+template <int N, typename FT>
+void testBinaryLut_simd_cmp(int input_node_size, int output_node_size, int frame_size)
+{
+    auto lut_ref  = bb::BinaryLutN<N, FT, float>::Create(output_node_size);
+    auto lut_simd = bb::BinaryLutN<N, FT, float>::Create(output_node_size);
+
+    bb::FrameBuffer x_buf(bb::DataType<FT>::type, frame_size, input_node_size, true);
+    lut_ref->SetInputShape(x_buf.GetShape());
+    lut_simd->SetInputShape(x_buf.GetShape());
+
+    for (int node = 0; node < output_node_size; ++node) {
+        for (int i = 0; i < N; ++i) {
+            lut_simd->SetNodeInput(node, i, lut_ref->GetNodeInput(node, i));
+        }
+        for (int i = 0; i < (1 << N); ++i) {
+            lut_simd->SetLutTable(node, i, lut_ref->GetLutTable(node, i));
+        }
+    }
+
+    lut_ref->SendCommand("host_only true");
+    lut_ref->SendCommand("host_simd false");
+    lut_simd->SendCommand("host_only true");
+    lut_simd->SendCommand("host_simd true");
+
+    std::mt19937_64 mt(1);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < input_node_size; ++node) {
+            x_buf.SetFP32(frame, node, (mt() & 1) ? 1.0f : 0.0f);
+        }
+    }
+
+    auto y_ref  = lut_ref->Forward(x_buf, false);
+    auto y_simd = lut_simd->Forward(x_buf, false);
+
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < output_node_size; ++node) {
+            EXPECT_EQ(y_ref.GetFP32(frame, node), y_simd.GetFP32(frame, node));
+        }
+    }
+}
+
+template <typename FT>
+void testBinaryLut_simd_cmp_all(void)
+{
+    testBinaryLut_simd_cmp<1, FT>(4,  5,  256 + 7);
+    testBinaryLut_simd_cmp<2, FT>(8,  17, 300);
+    testBinaryLut_simd_cmp<3, FT>(8,  17, 256*2 + 1);
+    testBinaryLut_simd_cmp<4, FT>(16, 33, 256*3 + 1);
+    testBinaryLut_simd_cmp<5, FT>(16, 33, 255);
+    testBinaryLut_simd_cmp<6, FT>(16, 33, 256*2 + 3);
+    testBinaryLut_simd_cmp<7, FT>(32, 9,  513);
+    testBinaryLut_simd_cmp<8, FT>(32, 9,  17);
+}
+
+TEST(BinaryLutTest, testBinaryLut_simd)
+{
+    testBinaryLut_simd_cmp_all<bb::Bit>();
+    testBinaryLut_simd_cmp_all<float>();
+}
+
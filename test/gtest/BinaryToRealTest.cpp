@@ -1,5 +1,6 @@
 ﻿#include <stdio.h>
 #include <iostream>
+#include <random>
 #include "gtest/gtest.h"
 #include "bb/BinaryToReal.h"
 #include "bb/NormalDistributionGenerator.h"
@@ -116,6 +117,77 @@ TEST(BinaryToRealTest, testBinaryToReal_fp32)
 #endif
 
 
+// 多重化数がワード境界を跨ぐ場合の Bit入力を FP32入力と比較
+TEST(BinaryToRealTest, testBinaryToReal_BitPopcnt)
+{
+    const int node_mux_size  = 3;
+    const int y_node_size    = 5;
+    const int y_frame_size   = 45;
+    const int x_node_size    = y_node_size * node_mux_size;
+
+    std::mt19937_64 mt(1);
+    std::uniform_int_distribution<int> dist(0, 1);
+
+    int const level_limit = bb::bb_simd_level_limit();
+    int mux_list[] = {1, 7, 32, 45};
+    for ( auto frame_mux_size : mux_list ) {
+        const int x_frame_size = y_frame_size * frame_mux_size;
+
+        bb::FrameBuffer x_bit(BB_TYPE_BIT,  x_frame_size, x_node_size);
+        bb::FrameBuffer x_fp32(BB_TYPE_FP32, x_frame_size, x_node_size);
+        for ( int frame = 0; frame < x_frame_size; ++frame) {
+            for ( int node = 0; node < x_node_size; ++node ) {
+                int v = dist(mt);
+                x_bit.SetBit(frame, node, v != 0);
+                x_fp32.SetFP32(frame, node, (float)v);
+            }
+        }
+
+        bb::FrameBuffer dy_buf(BB_TYPE_FP32, y_frame_size, y_node_size);
+        for ( int frame = 0; frame < y_frame_size; ++frame) {
+            for ( int node = 0; node < y_node_size; ++node ) {
+                dy_buf.SetFP32(frame, node, (float)(frame * 3 + node) - 10.0f);
+            }
+        }
+
+        for ( int level = bb::BB_SIMD_SCALAR; level <= std::min(level_limit, bb::bb_simd_cpu_level()); ++level ) {
+            bb::bb_simd_set_level(level);
+
+            auto bin2real_bit  = bb::BinaryToReal<bb::Bit, float, float>::Create(bb::indices_t({y_node_size}), frame_mux_size);
+            auto bin2real_fp32 = bb::BinaryToReal<float,   float, float>::Create(bb::indices_t({y_node_size}), frame_mux_size);
+
+            auto y_bit  = bin2real_bit->Forward(x_bit);
+            auto y_fp32 = bin2real_fp32->Forward(x_fp32);
+            EXPECT_EQ(y_frame_size, y_bit.GetFrameSize());
+
+            for ( int frame = 0; frame < y_frame_size; ++frame) {
+                for ( int node = 0; node < y_node_size; ++node ) {
+                    int cnt = 0;
+                    for ( int i = 0; i < node_mux_size; ++i ) {
+                        for ( int j = 0; j < frame_mux_size; ++j ) {
+                            cnt += x_bit.GetBit(frame * frame_mux_size + j, node + i * y_node_size) ? 1 : 0;
+                        }
+                    }
+                    float exp = (float)cnt / (float)(node_mux_size * frame_mux_size);
+                    EXPECT_FLOAT_EQ(exp, y_bit.GetFP32(frame, node));
+                    EXPECT_FLOAT_EQ(exp, y_fp32.GetFP32(frame, node));
+                }
+            }
+
+            auto dx_buf = bin2real_bit->Backward(dy_buf);
+            EXPECT_EQ(x_frame_size, dx_buf.GetFrameSize());
+            float gain = 1.0f / (float)(node_mux_size * frame_mux_size);
+            for ( int frame = 0; frame < x_frame_size; ++frame) {
+                for ( int node = 0; node < x_node_size; ++node ) {
+                    EXPECT_FLOAT_EQ(dy_buf.GetFP32(frame / frame_mux_size, node % y_node_size) * gain, dx_buf.GetFP32(frame, node));
+                }
+            }
+        }
+    }
+    bb::bb_simd_set_level(level_limit);
+}
+
+
 #ifdef BB_WITH_CUDA
 
 TEST(BinaryToRealTest, testBinaryToRealTest_cmp)
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <iostream>
+#include <random>
 #include "gtest/gtest.h"
 
 #include "bb/ConvolutionCol2Im.h"
@@ -119,3 +120,58 @@ TEST(ConvolutionCol2ImTest, testConvolutionCol2ImTest)
 }
 
 
+// SIMD版と汎用版の比較
+template <typename FT>
+void testConvolutionCol2Im_cmp(bb::index_t frame_size, bb::index_t c_size, bb::index_t h_size, bb::index_t w_size)
+{
+    auto col2im_ref  = bb::ConvolutionCol2Im<FT>::Create(h_size, w_size);
+    auto col2im_simd = bb::ConvolutionCol2Im<FT>::Create(h_size, w_size);
+    col2im_ref->SendCommand("host_only true");
+    col2im_ref->SendCommand("host_simd false");
+    col2im_simd->SendCommand("host_only true");
+    col2im_simd->SendCommand("host_simd true");
+
+    std::mt19937_64 mt(1);
+    bb::FrameBuffer x_buf(bb::DataType<FT>::type, frame_size * h_size * w_size, c_size);
+    for (bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame) {
+        for (bb::index_t node = 0; node < c_size; ++node) {
+            x_buf.SetFP32(frame, node, (float)(mt() % 2));
+        }
+    }
+
+    auto y_ref  = col2im_ref->Forward(x_buf);
+    auto y_simd = col2im_simd->Forward(x_buf);
+    ASSERT_EQ(frame_size, y_simd.GetFrameSize());
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < y_ref.GetNodeSize(); ++node) {
+            EXPECT_EQ(y_ref.GetFP32(frame, node), y_simd.GetFP32(frame, node));
+        }
+    }
+
+    bb::FrameBuffer dy_buf(BB_TYPE_FP32, frame_size, y_ref.GetShape());
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < dy_buf.GetNodeSize(); ++node) {
+            dy_buf.SetFP32(frame, node, (float)(mt() % 16));
+        }
+    }
+
+    auto dx_ref  = col2im_ref->Backward(dy_buf);
+    auto dx_simd = col2im_simd->Backward(dy_buf);
+    for (bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame) {
+        for (bb::index_t node = 0; node < c_size; ++node) {
+            EXPECT_EQ(dx_ref.GetFP32(frame, node), dx_simd.GetFP32(frame, node));
+        }
+    }
+}
+
+TEST(ConvolutionCol2ImTest, testConvolutionCol2Im_cmp)
+{
+    testConvolutionCol2Im_cmp<float>(1, 1, 1, 1);
+    testConvolutionCol2Im_cmp<float>(3, 2, 3, 4);
+    testConvolutionCol2Im_cmp<float>(37, 3, 5, 7);
+    testConvolutionCol2Im_cmp<bb::Bit>(1, 1, 1, 1);
+    testConvolutionCol2Im_cmp<bb::Bit>(3, 2, 3, 4);
+    testConvolutionCol2Im_cmp<bb::Bit>(70, 3, 5, 7);
+}
+
+
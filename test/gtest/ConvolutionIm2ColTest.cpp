@@ -1,5 +1,6 @@
 ﻿#include <stdio.h>
 #include <iostream>
+#include <random>
 #include "gtest/gtest.h"
 
 #include "bb/ConvolutionIm2Col.h"
@@ -375,3 +376,136 @@ TEST(ConvolutionIm2ColTest, testConvolutionIm2Col_bit)
 	EXPECT_EQ((bb::Bit)1, buf_y.GetBit(7, { 0, 1, 1 }));
 	EXPECT_EQ((bb::Bit)0, buf_y.GetBit(7, { 1, 1, 1 }));
 }
+
+
+TEST(ConvolutionIm2ColTest, testConvolutionIm2Col_stride)
+{
+    // 5x5 入力, 3x3 フィルタ, stride 2, padding 1 -> 3x3 出力
+	auto cnvim2col = bb::ConvolutionIm2Col<>::Create(3, 3, 2, 2, 1, 1);
+	
+    bb::FrameBuffer buf_x(BB_TYPE_FP32, 1, {5, 5, 1});
+	for (bb::index_t y = 0; y < 5; ++y) {
+		for (bb::index_t x = 0; x < 5; ++x) {
+			buf_x.SetFP32(0, { x, y, 0 }, (float)(10 * y + x + 1));
+		}
+	}
+
+	auto buf_y = cnvim2col->Forward(buf_x);
+    EXPECT_EQ(9, buf_y.GetFrameSize());
+
+    // 出力(0,0) はパディング領域を含む
+	EXPECT_EQ(0,  buf_y.GetFP32(0, { 0, 0, 0 }));
+	EXPECT_EQ(0,  buf_y.GetFP32(0, { 1, 0, 0 }));
+	EXPECT_EQ(0,  buf_y.GetFP32(0, { 0, 1, 0 }));
+	EXPECT_EQ(1,  buf_y.GetFP32(0, { 1, 1, 0 }));
+	EXPECT_EQ(2,  buf_y.GetFP32(0, { 2, 1, 0 }));
+	EXPECT_EQ(12, buf_y.GetFP32(0, { 2, 2, 0 }));
+
+    // 出力(1,1) は入力(1,1)-(3,3)
+	EXPECT_EQ(12, buf_y.GetFP32(4, { 0, 0, 0 }));
+	EXPECT_EQ(34, buf_y.GetFP32(4, { 2, 2, 0 }));
+
+    // 出力(2,2) は右下がパディング
+	EXPECT_EQ(45, buf_y.GetFP32(8, { 1, 1, 0 }));
+	EXPECT_EQ(0,  buf_y.GetFP32(8, { 2, 2, 0 }));
+}
+
+
+TEST(ConvolutionIm2ColTest, testConvolutionIm2Col_dilation)
+{
+    // 5x5 入力, 2x2 フィルタ, dilation 2 -> 3x3 出力
+	auto cnvim2col = bb::ConvolutionIm2Col<>::Create(2, 2, 1, 1, 0, 0, 2, 2);
+	
+    bb::FrameBuffer buf_x(BB_TYPE_FP32, 1, {5, 5, 1});
+	for (bb::index_t y = 0; y < 5; ++y) {
+		for (bb::index_t x = 0; x < 5; ++x) {
+			buf_x.SetFP32(0, { x, y, 0 }, (float)(10 * y + x));
+		}
+	}
+
+	auto buf_y = cnvim2col->Forward(buf_x);
+    EXPECT_EQ(9, buf_y.GetFrameSize());
+
+	EXPECT_EQ(0,  buf_y.GetFP32(0, { 0, 0, 0 }));
+	EXPECT_EQ(2,  buf_y.GetFP32(0, { 1, 0, 0 }));
+	EXPECT_EQ(20, buf_y.GetFP32(0, { 0, 1, 0 }));
+	EXPECT_EQ(22, buf_y.GetFP32(0, { 1, 1, 0 }));
+	EXPECT_EQ(22, buf_y.GetFP32(8, { 0, 0, 0 }));
+	EXPECT_EQ(44, buf_y.GetFP32(8, { 1, 1, 0 }));
+}
+
+
+// SIMD版と汎用版の比較
+template <typename FT>
+void testConvolutionIm2Col_cmp(bb::index_t frame_size, bb::indices_t shape, typename bb::ConvolutionIm2Col<FT>::create_t create)
+{
+    auto im2col_ref  = bb::ConvolutionIm2Col<FT>::Create(create);
+    auto im2col_simd = bb::ConvolutionIm2Col<FT>::Create(create);
+    im2col_ref->SendCommand("host_only true");
+    im2col_ref->SendCommand("host_simd false");
+    im2col_simd->SendCommand("host_only true");
+    im2col_simd->SendCommand("host_simd true");
+
+    std::mt19937_64 mt(1);
+    bb::FrameBuffer x_buf(bb::DataType<FT>::type, frame_size, shape);
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node) {
+            x_buf.SetFP32(frame, node, (float)(mt() % 2));
+        }
+    }
+
+    auto y_ref  = im2col_ref->Forward(x_buf);
+    auto y_simd = im2col_simd->Forward(x_buf);
+    ASSERT_EQ(y_ref.GetFrameSize(), y_simd.GetFrameSize());
+    for (bb::index_t frame = 0; frame < y_ref.GetFrameSize(); ++frame) {
+        for (bb::index_t node = 0; node < y_ref.GetNodeSize(); ++node) {
+            EXPECT_EQ(y_ref.GetFP32(frame, node), y_simd.GetFP32(frame, node));
+        }
+    }
+
+    bb::FrameBuffer dy_buf(BB_TYPE_FP32, y_ref.GetFrameSize(), y_ref.GetShape());
+    for (bb::index_t frame = 0; frame < dy_buf.GetFrameSize(); ++frame) {
+        for (bb::index_t node = 0; node < dy_buf.GetNodeSize(); ++node) {
+            dy_buf.SetFP32(frame, node, (float)(mt() % 16));
+        }
+    }
+
+    auto dx_ref  = im2col_ref->Backward(dy_buf);
+    auto dx_simd = im2col_simd->Backward(dy_buf);
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node) {
+            EXPECT_EQ(dx_ref.GetFP32(frame, node), dx_simd.GetFP32(frame, node));
+        }
+    }
+}
+
+template <typename FT>
+void testConvolutionIm2Col_cmp_all(void)
+{
+    typename bb::ConvolutionIm2Col<FT>::create_t create;
+    create.filter_h_size = 3;
+    create.filter_w_size = 3;
+    testConvolutionIm2Col_cmp<FT>(3, {7, 6, 2}, create);
+
+    create.h_stride  = 2;
+    create.w_stride  = 2;
+    create.h_padding = 1;
+    create.w_padding = 1;
+    testConvolutionIm2Col_cmp<FT>(9, {11, 9, 3}, create);
+
+    create.filter_h_size = 2;
+    create.filter_w_size = 3;
+    create.h_stride      = 1;
+    create.w_stride      = 3;
+    create.h_padding     = 2;
+    create.w_padding     = 0;
+    create.h_dilation    = 2;
+    create.w_dilation    = 1;
+    testConvolutionIm2Col_cmp<FT>(37, {10, 8, 2}, create);
+}
+
+TEST(ConvolutionIm2ColTest, testConvolutionIm2Col_cmp)
+{
+    testConvolutionIm2Col_cmp_all<float>();
+    testConvolutionIm2Col_cmp_all<bb::Bit>();
+}
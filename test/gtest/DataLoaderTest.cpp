@@ -0,0 +1,127 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/DataLoader.h"
+
+
+static void testDataLoader_MakeData(std::vector< std::vector<float> > &x, std::vector< std::vector<float> > &t, bb::index_t size)
+{
+    x.resize(size);
+    t.resize(size);
+    for ( bb::index_t i = 0; i < size; ++i ) {
+        x[i].resize(12);
+        t[i].resize(3);
+        for ( bb::index_t j = 0; j < 12; ++j ) {
+            x[i][j] = (float)(i * 100 + j);
+        }
+        for ( bb::index_t j = 0; j < 3; ++j ) {
+            t[i][j] = (float)(i * 10 + j);
+        }
+    }
+}
+
+static void testDataLoader_Augmentation(bb::FrameBuffer &x_buf, bb::FrameBuffer &t_buf, std::uint64_t seed, void *user)
+{
+    for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+        x_buf.SetFP32(frame, 0, (float)seed);
+    }
+}
+
+
+TEST(DataLoaderTest, testDataLoader_order)
+{
+    std::vector< std::vector<float> > x, t;
+    testDataLoader_MakeData(x, t, 103);
+
+    for ( bb::index_t thread_size = 1; thread_size <= 3; ++thread_size ) {
+        auto loader = bb::DataLoader<float>::Create(2, thread_size);
+
+        for ( int pass = 0; pass < 2; ++pass ) {
+            loader->Start(x, {4, 3}, t, {3}, 16);
+
+            bb::index_t index = 0;
+            bb::FrameBuffer x_buf, t_buf;
+            while ( loader->Pop(x_buf, t_buf) ) {
+                EXPECT_EQ(index, loader->GetFrameIndex());
+                bb::index_t frame_size = std::min((bb::index_t)16, 103 - index);
+                ASSERT_EQ(frame_size, x_buf.GetFrameSize());
+                ASSERT_EQ(frame_size, t_buf.GetFrameSize());
+                EXPECT_EQ(bb::indices_t({4, 3}), x_buf.GetShape());
+                for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                    for ( bb::index_t node = 0; node < 12; ++node ) {
+                        EXPECT_EQ(x[index + frame][node], x_buf.GetFP32(frame, node));
+                    }
+                    for ( bb::index_t node = 0; node < 3; ++node ) {
+                        EXPECT_EQ(t[index + frame][node], t_buf.GetFP32(frame, node));
+                    }
+                }
+                index += frame_size;
+            }
+            EXPECT_EQ(103, index);
+            loader->Stop();
+        }
+
+        EXPECT_EQ(14, loader->GetBatchCount());
+        EXPECT_LE(loader->GetStallCount(), loader->GetBatchCount());
+        EXPECT_GE(loader->GetStallTime(), 0.0);
+        loader->ClearStatistics();
+        EXPECT_EQ(0, loader->GetBatchCount());
+    }
+}
+
+
+TEST(DataLoaderTest, testDataLoader_min_batch)
+{
+    std::vector< std::vector<float> > x, t;
+    testDataLoader_MakeData(x, t, 100);
+
+    auto loader = bb::DataLoader<float>::Create(3, 2);
+
+    // 最後の端数(4フレーム)は min_batch_size 未満なので生成しない
+    loader->Start(x, {12}, t, {3}, 32, 32);
+    bb::FrameBuffer x_buf, t_buf;
+    int count = 0;
+    while ( loader->Pop(x_buf, t_buf) ) {
+        EXPECT_EQ(32, x_buf.GetFrameSize());
+        ++count;
+    }
+    EXPECT_EQ(3, count);
+
+    // 途中で止めても良い
+    loader->Start(x, {12}, t, {3}, 10);
+    EXPECT_TRUE(loader->Pop(x_buf, t_buf));
+    loader->Stop();
+    EXPECT_FALSE(loader->Pop(x_buf, t_buf));
+}
+
+
+TEST(DataLoaderTest, testDataLoader_augmentation)
+{
+    std::vector< std::vector<float> > x, t;
+    testDataLoader_MakeData(x, t, 64);
+
+    bb::DataLoader<float>::create_t create;
+    create.queue_size        = 2;
+    create.thread_size       = 2;
+    create.augmentation_proc = testDataLoader_Augmentation;
+    auto loader = bb::DataLoader<float>::Create(create);
+
+    // seed はミニバッチ毎に seed + バッチ番号
+    loader->Start(x, {12}, t, {3}, 16, 0, true, 100);
+    bb::FrameBuffer x_buf, t_buf;
+    for ( int batch = 0; batch < 4; ++batch ) {
+        ASSERT_TRUE(loader->Pop(x_buf, t_buf));
+        EXPECT_EQ((float)(100 + batch), x_buf.GetFP32(0, 0));
+        EXPECT_EQ(x[batch * 16][1], x_buf.GetFP32(0, 1));
+    }
+    EXPECT_FALSE(loader->Pop(x_buf, t_buf));
+
+    // 拡張無し
+    loader->Start(x, {12}, t, {3}, 16, 0, false);
+    ASSERT_TRUE(loader->Pop(x_buf, t_buf));
+    EXPECT_EQ(x[0][0], x_buf.GetFP32(0, 0));
+    loader->Stop();
+}
+
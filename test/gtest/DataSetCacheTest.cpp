@@ -0,0 +1,161 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include "gtest/gtest.h"
+
+#include "bb/DataSetCache.h"
+
+
+static std::vector< std::vector<float> > testDataSetCache_MakeData(bb::index_t size, bb::index_t sample_size)
+{
+    std::vector< std::vector<float> > data(size);
+    for ( bb::index_t i = 0; i < size; ++i ) {
+        data[i].resize(sample_size);
+        for ( bb::index_t j = 0; j < sample_size; ++j ) {
+            data[i][j] = (float)((i * 7 + j * 3) % 11) / 10.0f;
+        }
+    }
+    return data;
+}
+
+
+TEST(DataSetCacheTest, testDataSetCache_fp32)
+{
+    std::string filename = "DataSetCacheTest_fp32.bin";
+    auto data = testDataSetCache_MakeData(100, 12);
+    EXPECT_TRUE(bb::DataSetCache::Write(filename, data, {4, 3}, BB_TYPE_FP32, 32));
+
+    auto cache = bb::DataSetCache::Open(filename);
+    ASSERT_TRUE(cache != nullptr);
+    EXPECT_EQ(BB_TYPE_FP32, cache->GetType());
+    EXPECT_EQ(100, cache->GetFrameSize());
+    EXPECT_EQ(32, cache->GetBlockFrames());
+    EXPECT_EQ(4, cache->GetBlockSize());
+    EXPECT_EQ(bb::indices_t({4, 3}), cache->GetShape());
+
+    for ( bb::index_t block = 0; block < cache->GetBlockSize(); ++block ) {
+        auto buf = cache->GetBlock(block);
+        EXPECT_EQ(block < 3 ? 32 : 4, buf.GetFrameSize());
+        EXPECT_EQ(bb::indices_t({4, 3}), buf.GetShape());
+        for ( bb::index_t frame = 0; frame < buf.GetFrameSize(); ++frame ) {
+            for ( bb::index_t node = 0; node < 12; ++node ) {
+                EXPECT_EQ(data[block * 32 + frame][node], buf.GetFP32(frame, node));
+            }
+        }
+    }
+
+    // ブロック単位ならファイルを直接参照する
+    {
+        auto buf0 = cache->GetFrames(32, 32);
+        auto buf1 = cache->GetBlock(1);
+        EXPECT_EQ(buf0.LockMemoryConst().GetAddr(), buf1.LockMemoryConst().GetAddr());
+    }
+
+    // ブロックを跨ぐ範囲はコピー
+    {
+        auto buf = cache->GetFrames(20, 70);
+        EXPECT_EQ(70, buf.GetFrameSize());
+        for ( bb::index_t frame = 0; frame < 70; ++frame ) {
+            for ( bb::index_t node = 0; node < 12; ++node ) {
+                EXPECT_EQ(data[20 + frame][node], buf.GetFP32(frame, node));
+            }
+        }
+    }
+
+    // 書き込みはコピーに対して行われ、ファイルは変わらない
+    {
+        auto buf = cache->GetBlock(0);
+        buf.SetFP32(0, 0, 100.0f);
+        EXPECT_EQ(100.0f, buf.GetFP32(0, 0));
+        EXPECT_EQ(data[0][0], cache->GetBlock(0).GetFP32(0, 0));
+    }
+
+    cache.reset();
+    remove(filename.c_str());
+}
+
+
+TEST(DataSetCacheTest, testDataSetCache_bit)
+{
+    std::string filename = "DataSetCacheTest_bit.bin";
+    auto data = testDataSetCache_MakeData(77, 5);
+
+    bb::DataArray<float> arr;
+    arr.Assign(data);
+    EXPECT_TRUE(bb::DataSetCache::Write(filename, arr, {5}, BB_TYPE_BIT, 16, 0.5f));
+
+    auto cache = bb::DataSetCache::Open(filename);
+    ASSERT_TRUE(cache != nullptr);
+    EXPECT_EQ(BB_TYPE_BIT, cache->GetType());
+    EXPECT_EQ(5, cache->GetBlockSize());
+
+    auto buf = cache->GetFrames(0, 77);
+    EXPECT_EQ(BB_TYPE_BIT, buf.GetType());
+    for ( bb::index_t frame = 0; frame < 77; ++frame ) {
+        for ( bb::index_t node = 0; node < 5; ++node ) {
+            EXPECT_EQ(data[frame][node] > 0.5f, (bool)buf.GetBit(frame, node));
+        }
+    }
+
+    // Bit の端数位置からの取り出し
+    auto part = cache->GetFrames(13, 9);
+    for ( bb::index_t frame = 0; frame < 9; ++frame ) {
+        EXPECT_EQ(data[13 + frame][2] > 0.5f, (bool)part.GetBit(frame, 2));
+    }
+
+    cache.reset();
+    remove(filename.c_str());
+}
+
+
+TEST(DataSetCacheTest, testDataSetCache_invalid)
+{
+    std::string filename = "DataSetCacheTest_invalid.bin";
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        std::vector<char> dummy(8192, 'x');
+        ofs.write(dummy.data(), dummy.size());
+    }
+    EXPECT_TRUE(bb::DataSetCache::Open(filename) == nullptr);
+    EXPECT_TRUE(bb::DataSetCache::Open("DataSetCacheTest_none.bin") == nullptr);
+
+    // 途中で切れたファイル
+    auto data = testDataSetCache_MakeData(64, 8);
+    EXPECT_TRUE(bb::DataSetCache::Write(filename, data, {8}, BB_TYPE_FP32, 32));
+    {
+        std::ifstream ifs(filename, std::ios::binary);
+        std::vector<char> buf(4096 + 100);
+        ifs.read(buf.data(), buf.size());
+        ifs.close();
+        std::ofstream ofs(filename, std::ios::binary);
+        ofs.write(buf.data(), buf.size());
+    }
+    EXPECT_TRUE(bb::DataSetCache::Open(filename) == nullptr);
+
+    // ヘッダの値が壊れたファイル (offset はヘッダ内の位置)
+    struct { int offset; std::int64_t value; } broken[] = {
+        {16, -1},                       // frame_size
+        {24, (std::int64_t)1 << 60},    // block_frames
+        {32, 0},                        // data_offset がヘッダに重なる
+        {32, 4096 + 32},                // data_offset が境界に無い
+        {48, 0},                        // shape[0]
+        {48, -8},
+        {48, (std::int64_t)1 << 62},    // サイズの積が溢れる
+    };
+    for ( auto const &b : broken ) {
+        EXPECT_TRUE(bb::DataSetCache::Write(filename, data, {8}, BB_TYPE_FP32, 32));
+        {
+            std::fstream fs(filename, std::ios::binary | std::ios::in | std::ios::out);
+            fs.seekp(b.offset);
+            fs.write((char const *)&b.value, sizeof(b.value));
+        }
+        EXPECT_TRUE(bb::DataSetCache::Open(filename) == nullptr) << "offset " << b.offset;
+    }
+
+    // 書き換えなければ開ける
+    EXPECT_TRUE(bb::DataSetCache::Write(filename, data, {8}, BB_TYPE_FP32, 32));
+    EXPECT_TRUE(bb::DataSetCache::Open(filename) != nullptr);
+
+    remove(filename.c_str());
+}
+
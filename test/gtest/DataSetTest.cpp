@@ -0,0 +1,204 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+
+#include "bb/DataSet.h"
+#include "bb/DataLoader.h"
+#include "bb/LoadMnist.h"
+#include "bb/Utility.h"
+
+
+static std::vector< std::vector<float> > testDataSet_MakeData(bb::index_t size, bb::index_t sample_size, float base)
+{
+    std::vector< std::vector<float> > data(size);
+    for ( bb::index_t i = 0; i < size; ++i ) {
+        data[i].resize(sample_size);
+        for ( bb::index_t j = 0; j < sample_size; ++j ) {
+            data[i][j] = base + (float)(i * 100 + j);
+        }
+    }
+    return data;
+}
+
+
+TEST(DataSetTest, testDataArray)
+{
+    auto data = testDataSet_MakeData(5, 7, 0);
+
+    bb::DataArray<float> arr;
+    arr.Assign(data);
+    EXPECT_EQ(5, arr.GetSize());
+    EXPECT_EQ(7, arr.GetSampleSize());
+    EXPECT_FALSE(arr.IsMapped());
+
+    // サンプルは連続して並ぶ
+    for ( bb::index_t i = 0; i < 5; ++i ) {
+        EXPECT_EQ(arr.GetData() + i * 7, arr.GetSample(i));
+        for ( bb::index_t j = 0; j < 7; ++j ) {
+            EXPECT_EQ(data[i][j], arr.GetSample(i)[j]);
+        }
+    }
+    EXPECT_EQ(data, arr.ToVector());
+
+    arr.Resize(3, 2);
+    EXPECT_EQ(0.0f, arr.GetSample(2)[1]);
+}
+
+
+TEST(DataSetTest, testDataArray_map)
+{
+    std::string filename = "DataSetTest.bin";
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        std::uint32_t header[4] = {1, 2, 3, 4};
+        ofs.write((char const *)header, sizeof(header));
+        for ( int i = 0; i < 6 * 4; ++i ) {
+            float v = (float)i * 0.5f;
+            ofs.write((char const *)&v, sizeof(v));
+        }
+    }
+
+    bb::DataArray<float> arr;
+    EXPECT_TRUE(arr.Map(filename, 16, 6, 4));
+    EXPECT_TRUE(arr.IsMapped());
+    EXPECT_EQ(6, arr.GetSize());
+    EXPECT_EQ(4, arr.GetSampleSize());
+    for ( bb::index_t i = 0; i < 6; ++i ) {
+        for ( bb::index_t j = 0; j < 4; ++j ) {
+            EXPECT_EQ((float)(i * 4 + j) * 0.5f, arr.GetSample(i)[j]);
+        }
+    }
+
+    // コピーはマップを共有する
+    bb::DataArray<float> arr2 = arr;
+    EXPECT_EQ(arr.GetData(), arr2.GetData());
+
+    // 範囲外
+    bb::DataArray<float> arr3;
+    EXPECT_FALSE(arr3.Map(filename, 16, 7, 4));
+    EXPECT_FALSE(arr3.Map(filename, 18, 1, 4));
+    EXPECT_FALSE(arr3.Map("DataSetTest_none.bin", 0, 1, 1));
+
+    arr.clear();
+    arr2.clear();
+    remove(filename.c_str());
+}
+
+
+TEST(DataSetTest, testDataSet_shuffle)
+{
+    bb::TrainData<float> td;
+    td.x_train = testDataSet_MakeData(50, 3, 0);
+    td.t_train = testDataSet_MakeData(50, 2, 0.5f);
+
+    bb::DataSet<float> ds;
+    ds.x_train.Assign(td.x_train);
+    ds.t_train.Assign(td.t_train);
+
+    // 同じ seed なら ShuffleDataSet と同じ順序になり、データ本体は動かない
+    for ( std::uint64_t seed = 1; seed <= 3; ++seed ) {
+        bb::ShuffleDataSet(seed, td.x_train, td.t_train);
+        ds.Shuffle(seed);
+
+        bb::SampleSource<float> x(ds.x_train, &ds.train_order);
+        bb::SampleSource<float> t(ds.t_train, &ds.train_order);
+        for ( bb::index_t i = 0; i < 50; ++i ) {
+            EXPECT_EQ(td.x_train[i][0], x.GetSample(i)[0]);
+            EXPECT_EQ(td.t_train[i][1], t.GetSample(i)[1]);
+        }
+        EXPECT_EQ(100.0f, ds.x_train.GetSample(1)[0]);
+        EXPECT_EQ(td.x_train, ds.ToTrainData().x_train);
+    }
+
+    ds.ResetOrder();
+    EXPECT_EQ(10, ds.train_order[10]);
+}
+
+
+TEST(DataSetTest, testSampleSource_copy)
+{
+    auto data = testDataSet_MakeData(20, 6, 0);
+
+    bb::DataArray<float> arr;
+    arr.Assign(data);
+    std::vector<bb::index_t> order(20);
+    for ( bb::index_t i = 0; i < 20; ++i ) {
+        order[i] = 19 - i;
+    }
+
+    bb::FrameBuffer buf0(BB_TYPE_FP32, 8, 6);
+    bb::FrameBuffer buf1(BB_TYPE_FP32, 8, 6);
+    bb::SampleSource<float>(data).CopyTo(buf0, 4);
+    bb::SampleSource<float>(arr, &order).CopyTo(buf1, 4);
+    for ( bb::index_t frame = 0; frame < 8; ++frame ) {
+        for ( bb::index_t node = 0; node < 6; ++node ) {
+            EXPECT_EQ(data[4 + frame][node],  buf0.GetFP32(frame, node));
+            EXPECT_EQ(data[15 - frame][node], buf1.GetFP32(frame, node));
+        }
+    }
+
+    // DataLoader も参照順で読み出す
+    bb::DataArray<float> t;
+    t.Assign(testDataSet_MakeData(20, 2, 0));
+    auto loader = bb::DataLoader<float>::Create(2, 2);
+    loader->Start(bb::SampleSource<float>(arr, &order), {6}, bb::SampleSource<float>(t, &order), {2}, 8);
+    bb::FrameBuffer x_buf, t_buf;
+    bb::index_t index = 0;
+    while ( loader->Pop(x_buf, t_buf) ) {
+        for ( bb::index_t frame = 0; frame < x_buf.GetFrameSize(); ++frame ) {
+            EXPECT_EQ(data[19 - (index + frame)][5], x_buf.GetFP32(frame, 5));
+            EXPECT_EQ(t.GetSample(19 - (index + frame))[1], t_buf.GetFP32(frame, 1));
+        }
+        index += x_buf.GetFrameSize();
+    }
+    EXPECT_EQ(20, index);
+}
+
+
+static void testDataSet_WriteWord(std::ostream &os, int v)
+{
+    std::uint8_t b[4] = {(std::uint8_t)(v >> 24), (std::uint8_t)(v >> 16), (std::uint8_t)(v >> 8), (std::uint8_t)v};
+    os.write((char const *)b, 4);
+}
+
+TEST(DataSetTest, testLoadMnist)
+{
+    // 4x3 画像 5枚
+    std::stringstream image_ss, label_ss;
+    testDataSet_WriteWord(image_ss, 0x00000803);
+    testDataSet_WriteWord(image_ss, 5);
+    testDataSet_WriteWord(image_ss, 4);
+    testDataSet_WriteWord(image_ss, 3);
+    testDataSet_WriteWord(label_ss, 0x00000801);
+    testDataSet_WriteWord(label_ss, 5);
+    for ( int i = 0; i < 5; ++i ) {
+        for ( int j = 0; j < 12; ++j ) {
+            image_ss.put((char)(i * 40 + j));
+        }
+        label_ss.put((char)(i * 2));
+    }
+    std::string image_str = image_ss.str();
+    std::string label_str = label_ss.str();
+
+    std::vector< std::vector<float> > image_vec, label_vec;
+    bb::DataArray<float>              image_arr, label_arr;
+    {
+        std::istringstream is0(image_str), is1(image_str);
+        EXPECT_TRUE(bb::LoadMnist<float>::ReadImageFile(is0, image_vec, 4));
+        EXPECT_TRUE(bb::LoadMnist<float>::ReadImageFile(is1, image_arr, 4));
+    }
+    {
+        std::istringstream is0(label_str), is1(label_str);
+        EXPECT_TRUE(bb::LoadMnist<float>::ReadLabelFile(is0, label_vec, 10, 4));
+        EXPECT_TRUE(bb::LoadMnist<float>::ReadLabelFile(is1, label_arr, 10, 4));
+    }
+
+    EXPECT_EQ(4, image_arr.GetSize());
+    EXPECT_EQ(12, image_arr.GetSampleSize());
+    EXPECT_EQ(image_vec, image_arr.ToVector());
+    EXPECT_EQ(label_vec, label_arr.ToVector());
+    EXPECT_EQ(1.0f, label_arr.GetSample(3)[6]);
+}
+
@@ -1,6 +1,7 @@
 ﻿
 #include <stdio.h>
 #include <iostream>
+#include <random>
 
 #include "gtest/gtest.h"
 #include "bb/DenseAffine.h"
@@ -67,6 +68,140 @@ TEST(DenseAffineTest, testAffine)
     }
 }
 
+// ホスト版SGEMMを素朴な実装と比較
+void DenseAffine_cmp_HostSgemm(bool trans_a, bool trans_b, int m, int n, int k, float alpha, float beta)
+{
+    std::mt19937_64                       mt(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    int lda = (trans_a ? k : m) + 3;
+    int ldb = (trans_b ? n : k) + 5;
+    int ldc = m + 7;
+    std::vector<float> A(lda * (trans_a ? m : k));
+    std::vector<float> B(ldb * (trans_b ? k : n));
+    std::vector<float> C(ldc * n);
+    for (auto &v : A) { v = dist(mt); }
+    for (auto &v : B) { v = dist(mt); }
+    for (auto &v : C) { v = dist(mt); }
+
+    std::vector<float> exp = C;
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < m; ++i) {
+            double sum = 0;
+            for (int p = 0; p < k; ++p) {
+                float a = trans_a ? A[p + i * lda] : A[i + p * lda];
+                float b = trans_b ? B[j + p * ldb] : B[p + j * ldb];
+                sum += (double)a * (double)b;
+            }
+            exp[i + j * ldc] = (float)(alpha * sum + (beta != 0 ? beta * C[i + j * ldc] : 0));
+        }
+    }
+
+    bb::HostSgemm(trans_a, trans_b, m, n, k, alpha, &A[0], lda, &B[0], ldb, beta, &C[0], ldc);
+
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < m; ++i) {
+            EXPECT_NEAR(exp[i + j * ldc], C[i + j * ldc], 1.0e-4f * (k + 1));
+        }
+    }
+}
+
+TEST(DenseAffineTest, testAffine_HostSgemm)
+{
+    for (int trans_a = 0; trans_a < 2; ++trans_a) {
+        for (int trans_b = 0; trans_b < 2; ++trans_b) {
+            DenseAffine_cmp_HostSgemm(trans_a != 0, trans_b != 0, 1,   1,   1,   1.0f, 0.0f);
+            DenseAffine_cmp_HostSgemm(trans_a != 0, trans_b != 0, 16,  6,   8,   1.0f, 0.0f);
+            DenseAffine_cmp_HostSgemm(trans_a != 0, trans_b != 0, 37,  23,  19,  1.0f, 1.0f);
+            DenseAffine_cmp_HostSgemm(trans_a != 0, trans_b != 0, 150, 101, 300, 0.5f, -2.0f);
+        }
+    }
+}
+
+
+// SIMD(SGEMM)版とスカラ版の比較
+void DenseAffine_cmp_host_simd(int input_node_size, int output_node_size, int frame_size)
+{
+    auto affine_ref  = bb::DenseAffine<float>::Create(output_node_size);
+    auto affine_simd = bb::DenseAffine<float>::Create(output_node_size);
+
+    affine_ref->SendCommand("host_only true");
+    affine_simd->SendCommand("host_only true");
+    affine_ref->SendCommand("host_simd false");
+    affine_simd->SendCommand("host_simd true");
+
+    affine_ref->SetInputShape({input_node_size});
+    affine_simd->SetInputShape({input_node_size});
+
+    {
+        auto W_ref  = affine_ref->lock_W_const();
+        auto b_ref  = affine_ref->lock_b_const();
+        auto W_simd = affine_simd->lock_W();
+        auto b_simd = affine_simd->lock_b();
+        for (int output_node = 0; output_node < output_node_size; ++output_node) {
+            for (int input_node = 0; input_node < input_node_size; ++input_node) {
+                W_simd(output_node, input_node) = W_ref(output_node, input_node);
+            }
+            b_simd(output_node) = b_ref(output_node);
+        }
+    }
+
+    std::mt19937_64                       mt(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, frame_size, input_node_size);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < input_node_size; ++node) {
+            x_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    auto y_ref  = affine_ref->Forward(x_buf);
+    auto y_simd = affine_simd->Forward(x_buf);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < output_node_size; ++node) {
+            EXPECT_NEAR(y_ref.GetFP32(frame, node), y_simd.GetFP32(frame, node), 1.0e-3f);
+        }
+    }
+
+    bb::FrameBuffer dy_buf(BB_TYPE_FP32, frame_size, output_node_size);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < output_node_size; ++node) {
+            dy_buf.SetFP32(frame, node, dist(mt));
+        }
+    }
+
+    auto dx_ref  = affine_ref->Backward(dy_buf);
+    auto dx_simd = affine_simd->Backward(dy_buf);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < input_node_size; ++node) {
+            EXPECT_NEAR(dx_ref.GetFP32(frame, node), dx_simd.GetFP32(frame, node), 1.0e-3f);
+        }
+    }
+
+    {
+        auto dW_ref  = affine_ref->lock_dW_const();
+        auto db_ref  = affine_ref->lock_db_const();
+        auto dW_simd = affine_simd->lock_dW_const();
+        auto db_simd = affine_simd->lock_db_const();
+        for (int output_node = 0; output_node < output_node_size; ++output_node) {
+            for (int input_node = 0; input_node < input_node_size; ++input_node) {
+                EXPECT_NEAR(dW_ref(output_node, input_node), dW_simd(output_node, input_node), 1.0e-3f);
+            }
+            EXPECT_NEAR(db_ref(output_node), db_simd(output_node), 1.0e-3f);
+        }
+    }
+}
+
+TEST(DenseAffineTest, testAffine_host_simd)
+{
+    DenseAffine_cmp_host_simd(1,   1,   1);
+    DenseAffine_cmp_host_simd(7,   5,   3);
+    DenseAffine_cmp_host_simd(33,  17,  21);
+    DenseAffine_cmp_host_simd(300, 130, 270);
+}
+
+
 #ifdef BB_WITH_CUDA
 TEST(DenseAffineTest, testAffine_cudaBlas1)
 {
@@ -233,6 +233,80 @@ TEST(FrameBufferTest, FrameBuffer_SetVector)
 }
 
 
+TEST(FrameBufferTest, FrameBuffer_GetVector_fp32)
+{
+    // 8 の倍数と端数の両方を含むサイズ
+    bb::index_t const frame_size = 29;
+    bb::index_t const node_size  = 21;
+
+    // スカラー版と AVX2 版の両方を確認
+    int const level_limit = bb::bb_simd_level_limit();
+    for ( int level : {bb::BB_SIMD_SCALAR, bb::BB_SIMD_AVX2} ) {
+        bb::bb_simd_set_level(level);
+
+        bb::FrameBuffer buf(BB_TYPE_FP32, frame_size, node_size);
+
+        std::vector< std::vector<float> > vec(frame_size + 3, std::vector<float>(node_size));
+        for ( bb::index_t frame = 0; frame < frame_size + 3; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                vec[frame][node] = (float)(frame * 1000 + node);
+            }
+        }
+
+        buf.SetVector(vec, 3);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                EXPECT_EQ(buf.GetFP32(frame, node), (float)((frame + 3) * 1000 + node));
+            }
+        }
+
+        auto out = buf.GetVector<float>();
+        EXPECT_EQ((size_t)frame_size, out.size());
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            EXPECT_EQ(vec[frame + 3], out[frame]);
+        }
+    }
+    bb::bb_simd_set_level(level_limit);
+}
+
+
+TEST(FrameBufferTest, FrameBuffer_GetVector_bit)
+{
+    bb::index_t const frame_size = 45;
+    bb::index_t const node_size  = 70;
+
+    // スカラー版と AVX2 版の両方を確認
+    int const level_limit = bb::bb_simd_level_limit();
+    for ( int level : {bb::BB_SIMD_SCALAR, bb::BB_SIMD_AVX2} ) {
+        bb::bb_simd_set_level(level);
+
+        bb::FrameBuffer buf(BB_TYPE_BIT, frame_size, node_size);
+
+        std::vector< std::vector<bb::Bit> > vec(frame_size, std::vector<bb::Bit>(node_size));
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                vec[frame][node] = bb::Bit(((frame * 7 + node * 13) % 5) < 2);
+            }
+        }
+
+        buf.SetVector(vec);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                EXPECT_EQ((bool)vec[frame][node], (bool)buf.GetBit(frame, node));
+            }
+        }
+
+        auto out = buf.GetVector<bb::Bit>();
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < node_size; ++node ) {
+                EXPECT_EQ((bool)vec[frame][node], (bool)out[frame][node]);
+            }
+        }
+    }
+    bb::bb_simd_set_level(level_limit);
+}
+
+
 
 TEST(FrameBufferTest, testFrameBuffer_Json)
 {
@@ -1,5 +1,6 @@
 ﻿#include <stdio.h>
 #include <iostream>
+#include <random>
 #include "gtest/gtest.h"
 #include "bb/LossSoftmaxCrossEntropy.h"
 
@@ -92,3 +93,41 @@ TEST(LossSoftmaxCrossEntropyTest, testLossSoftmaxCrossEntropy)
 }
 
 
+
+TEST(LossSoftmaxCrossEntropyTest, testLossSoftmaxCrossEntropy_batch)
+{
+    // SIMD 版(FP32)とスカラー版(FP64)の比較 (端数フレームを含む)
+    int const frame_size = 37;
+    int const node_size  = 13;
+
+    std::mt19937_64                         mt(1);
+    std::uniform_real_distribution<double>  dist(-5.0, 5.0);
+
+    bb::FrameBuffer y_fp32(BB_TYPE_FP32, frame_size, node_size);
+    bb::FrameBuffer t_fp32(BB_TYPE_FP32, frame_size, node_size);
+    bb::FrameBuffer y_fp64(BB_TYPE_FP64, frame_size, node_size);
+    bb::FrameBuffer t_fp64(BB_TYPE_FP64, frame_size, node_size);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < node_size; ++node) {
+            float y = (float)dist(mt);
+            float t = (node == frame % node_size) ? 1.0f : 0.0f;
+            y_fp32.SetFP32(frame, node, y);
+            t_fp32.SetFP32(frame, node, t);
+            y_fp64.SetFP64(frame, node, y);
+            t_fp64.SetFP64(frame, node, t);
+        }
+    }
+
+    auto loss_fp32 = bb::LossSoftmaxCrossEntropy<float>::Create();
+    auto loss_fp64 = bb::LossSoftmaxCrossEntropy<double>::Create();
+    auto dy_fp32 = loss_fp32->CalculateLoss(y_fp32, t_fp32);
+    auto dy_fp64 = loss_fp64->CalculateLoss(y_fp64, t_fp64);
+
+    EXPECT_NEAR(loss_fp64->GetLoss(), loss_fp32->GetLoss(), 1.0e-5);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < node_size; ++node) {
+            EXPECT_NEAR(dy_fp64.GetFP64(frame, node), dy_fp32.GetFP32(frame, node), 1.0e-6);
+        }
+    }
+}
+
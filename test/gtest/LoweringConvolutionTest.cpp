@@ -1,5 +1,6 @@
 ﻿#include <stdio.h>
 #include <iostream>
+#include <random>
 #include "gtest/gtest.h"
 
 #include "bb/NormalDistributionGenerator.h"
@@ -8,6 +9,7 @@
 #include "bb/DenseAffine.h"
 #include "bb/BinaryLutN.h"
 #include "bb/Sequential.h"
+#include "bb/BatchNormalization.h"
 
 
 TEST(LoweringConvolutionTest, testLoweringConvolution)
@@ -202,6 +204,159 @@ TEST(LoweringConvolutionTest, testLoweringConvolution_cmp_bit)
 }
 
 
+TEST(LoweringConvolutionTest, testLoweringConvolution_stride)
+{
+    // 28x28 入力, 3x3 フィルタ, stride 2, padding 1 -> 14x14 出力
+    auto cnv = bb::LoweringConvolution<>::Create(bb::DenseAffine<>::Create(8), 3, 3, 2, 2, 1, 1);
+
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, 4, {28, 28, 3});
+    auto shape = cnv->SetInputShape(x_buf.GetShape());
+    EXPECT_EQ(bb::indices_t({14, 14, 8}), shape);
+
+    auto y_buf = cnv->Forward(x_buf);
+    EXPECT_EQ(4, y_buf.GetFrameSize());
+    EXPECT_EQ(bb::indices_t({14, 14, 8}), y_buf.GetShape());
+
+    auto dx_buf = cnv->Backward(y_buf);
+    EXPECT_EQ(4, dx_buf.GetFrameSize());
+    EXPECT_EQ(bb::indices_t({28, 28, 3}), dx_buf.GetShape());
+
+    // dilation 2 (5x5 相当の受容野) -> 24x24 出力
+    auto cnv_dil = bb::LoweringConvolution<>::Create(bb::DenseAffine<>::Create(8), 3, 3, 1, 1, 0, 0, 2, 2);
+    EXPECT_EQ(bb::indices_t({24, 24, 8}), cnv_dil->SetInputShape(x_buf.GetShape()));
+}
+
+
+// fused モードと一括処理の比較
+template <typename FT>
+void testLoweringConvolution_fused_cmp(std::shared_ptr<bb::Model> layer_ref, std::shared_ptr<bb::Model> layer_fused, bb::index_t frame_size, bb::index_t tile_size)
+{
+    auto cnv_ref   = bb::LoweringConvolution<FT>::Create(layer_ref,   3, 3, 2, 2, 1, 1);
+    auto cnv_fused = bb::LoweringConvolution<FT>::Create(layer_fused, 3, 3, 2, 2, 1, 1);
+
+    bb::FrameBuffer x_buf(bb::DataType<FT>::type, frame_size, {9, 7, 3});
+    cnv_ref->SetInputShape(x_buf.GetShape());
+    cnv_fused->SetInputShape(x_buf.GetShape());
+    cnv_ref->SendCommand("host_only true");
+    cnv_fused->SendCommand("host_only true");
+    cnv_fused->SendCommand("fused_tile_size " + std::to_string(tile_size));
+
+    // 同じ係数にそろえる
+    auto param_fused = layer_fused->GetParameters();
+    param_fused *= 0;
+    param_fused += layer_ref->GetParameters();
+
+    std::mt19937_64 mt(1);
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node) {
+            x_buf.SetFP32(frame, node, (float)(mt() % 2));
+        }
+    }
+
+    auto y_ref   = cnv_ref->Forward(x_buf);
+    auto y_fused = cnv_fused->Forward(x_buf);
+    ASSERT_EQ(y_ref.GetShape(), y_fused.GetShape());
+    ASSERT_EQ(frame_size, y_fused.GetFrameSize());
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < y_ref.GetNodeSize(); ++node) {
+            EXPECT_NEAR(y_ref.GetFP32(frame, node), y_fused.GetFP32(frame, node), 0.0001f);
+        }
+    }
+
+    bb::FrameBuffer dy_buf(BB_TYPE_FP32, frame_size, y_ref.GetShape());
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < dy_buf.GetNodeSize(); ++node) {
+            dy_buf.SetFP32(frame, node, (float)(mt() % 16) / 16.0f);
+        }
+    }
+
+    auto dx_ref   = cnv_ref->Backward(dy_buf);
+    auto dx_fused = cnv_fused->Backward(dy_buf);
+    ASSERT_EQ(frame_size, dx_fused.GetFrameSize());
+    if ( bb::DataType<FT>::type == BB_TYPE_BIT ) {
+        return;     // BinaryLutN は逆伝播しない
+    }
+
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < dx_ref.GetNodeSize(); ++node) {
+            EXPECT_NEAR(dx_ref.GetFP32(frame, node), dx_fused.GetFP32(frame, node), 0.0001f);
+        }
+    }
+
+    auto grad_ref   = layer_ref->GetGradients();
+    auto grad_fused = layer_fused->GetGradients();
+    for (bb::index_t i = 0; i < grad_ref.GetSize(); ++i) {
+        auto ref_ptr   = grad_ref[i].LockConst<float>();
+        auto fused_ptr = grad_fused[i].LockConst<float>();
+        for (bb::index_t j = 0; j < grad_ref[i].GetSize(); ++j) {
+            EXPECT_NEAR(ref_ptr[j], fused_ptr[j], 0.001f);
+        }
+    }
+}
+
+TEST(LoweringConvolutionTest, testLoweringConvolution_fused)
+{
+    testLoweringConvolution_fused_cmp<float>(bb::DenseAffine<>::Create(6), bb::DenseAffine<>::Create(6), 37, 1);
+    testLoweringConvolution_fused_cmp<float>(bb::DenseAffine<>::Create(6), bb::DenseAffine<>::Create(6), 37, 20 * 16);
+    testLoweringConvolution_fused_cmp<bb::Bit>(bb::BinaryLutN<6, bb::Bit>::Create(6), bb::BinaryLutN<6, bb::Bit>::Create(6), 37, 1);
+    testLoweringConvolution_fused_cmp<bb::Bit>(bb::BinaryLutN<6, bb::Bit>::Create(6), bb::BinaryLutN<6, bb::Bit>::Create(6), 37, 3 * 20);
+    testLoweringConvolution_fused_cmp<bb::Bit>(bb::BinaryLutN<6, bb::Bit>::Create(6), bb::BinaryLutN<6, bb::Bit>::Create(6), 70, 20 * 16);
+}
+
+
+// fused モードの backward での forward 再計算が running_mean/var を更新しないこと
+TEST(LoweringConvolutionTest, testLoweringConvolution_fused_running_stat)
+{
+    bb::index_t frame_size = 37;
+
+    auto bn  = bb::BatchNormalization<float>::Create(0.5f);
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<>::Create(4));
+    net->Add(bn);
+    auto cnv = bb::LoweringConvolution<float>::Create(net, 3, 3, 2, 2, 1, 1);
+
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, frame_size, {9, 7, 3});
+    cnv->SetInputShape(x_buf.GetShape());
+    cnv->SendCommand("host_only true");
+    cnv->SendCommand("fused_tile_size 64");
+
+    std::mt19937_64 mt(1);
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node) {
+            x_buf.SetFP32(frame, node, (float)(mt() % 16));
+        }
+    }
+
+    auto y_buf = cnv->Forward(x_buf, true);
+
+    bb::index_t node_size = bn->GetOutputNodeSize();
+    std::vector<float> mean(node_size), var(node_size);
+    {
+        auto mean_ptr = bn->lock_mean_const();
+        auto var_ptr  = bn->lock_var_const();
+        for (bb::index_t node = 0; node < node_size; ++node) {
+            mean[node] = mean_ptr[node];
+            var[node]  = var_ptr[node];
+        }
+    }
+
+    bb::FrameBuffer dy_buf(BB_TYPE_FP32, frame_size, y_buf.GetShape());
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < dy_buf.GetNodeSize(); ++node) {
+            dy_buf.SetFP32(frame, node, (float)(mt() % 16) / 16.0f);
+        }
+    }
+    cnv->Backward(dy_buf);
+
+    auto mean_ptr = bn->lock_mean_const();
+    auto var_ptr  = bn->lock_var_const();
+    for (bb::index_t node = 0; node < node_size; ++node) {
+        EXPECT_EQ(mean[node], mean_ptr[node]);
+        EXPECT_EQ(var[node],  var_ptr[node]);
+    }
+}
+
+
 #if 0
 
 TEST(NeuralNetLoweringConvolutionTest, testNeuralNetLoweringConvolution2)
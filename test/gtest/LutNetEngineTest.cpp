@@ -0,0 +1,188 @@
+﻿#include <string>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "bb/LutNetEngine.h"
+#include "bblut/bblut.h"
+
+
+// MNIST LUT-CNN 相当の構成 (畳み込みは stride/padding 付きも含む)
+static std::shared_ptr<bb::Sequential> testLutNetEngine_MakeNet(bb::indices_t input_shape)
+{
+    auto cnv0_sub = bb::Sequential::Create();
+    cnv0_sub->Add(bb::BinaryLutN<6, bb::Bit>::Create(96, 1));
+    cnv0_sub->Add(bb::BinaryLutN<6, bb::Bit>::Create(16, 2));
+
+    auto cnv1_sub = bb::Sequential::Create();
+    cnv1_sub->Add(bb::BinaryLutN<6, bb::Bit>::Create(96, 3));
+    cnv1_sub->Add(bb::BinaryLutN<4, bb::Bit>::Create(16, 4));
+
+    auto net = bb::Sequential::Create();
+    net->Add(bb::LoweringConvolution<bb::Bit>::Create(cnv0_sub, 3, 3));
+    net->Add(bb::MaxPooling<bb::Bit>::Create(2, 2));
+    net->Add(bb::LoweringConvolution<bb::Bit>::Create(cnv1_sub, 3, 3, 2, 2, 1, 1));
+    net->Add(bb::BinaryLutN<6, bb::Bit>::Create(60, 5));
+    net->Add(bb::BinaryLutN<5, bb::Bit>::Create(10, 6));
+    net->SetInputShape(input_shape);
+    net->SendCommand("host_only true");
+    return net;
+}
+
+static bb::FrameBuffer testLutNetEngine_MakeInput(bb::index_t frame_size, bb::indices_t shape)
+{
+    std::mt19937_64 mt(1);
+    bb::FrameBuffer x_buf(BB_TYPE_BIT, frame_size, shape);
+    for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+        for (bb::index_t node = 0; node < x_buf.GetNodeSize(); ++node) {
+            x_buf.SetBit(frame, node, (mt() & 1) != 0);
+        }
+    }
+    return x_buf;
+}
+
+
+TEST(LutNetEngineTest, testLutNetEngine_cmp)
+{
+    bb::indices_t input_shape({14, 14, 2});
+    auto net = testLutNetEngine_MakeNet(input_shape);
+
+    bb::LutNetEngine engine;
+    ASSERT_TRUE(engine.Compile(net, 256));
+    EXPECT_EQ(input_shape, engine.GetInputShape());
+    EXPECT_EQ(10, engine.GetOutputNodeSize());
+
+    // 最大フレーム数を超える分は分割して処理される
+    bb::index_t frame_size = 300;
+    auto x_buf = testLutNetEngine_MakeInput(frame_size, input_shape);
+
+    auto y_ref = net->Forward(x_buf, false);
+
+    // スカラー版と SIMD 版(CPU が対応する範囲)の両方を確認
+    int const level_limit = bb::bb_simd_level_limit();
+    for ( int level : {bb::BB_SIMD_SCALAR, bb::BB_SIMD_AVX2, bb::BB_SIMD_AVX512F} ) {
+        bb::bb_simd_set_level(level);
+
+        auto y_eng = engine.Forward(x_buf);
+        ASSERT_EQ(frame_size, y_eng.GetFrameSize());
+        for (bb::index_t frame = 0; frame < frame_size; ++frame) {
+            for (bb::index_t node = 0; node < 10; ++node) {
+                EXPECT_EQ(y_ref.GetBit(frame, node), y_eng.GetBit(frame, node));
+            }
+        }
+    }
+    bb::bb_simd_set_level(level_limit);
+}
+
+
+TEST(LutNetEngineTest, testLutNetEngine_capi)
+{
+    bb::indices_t input_shape({14, 14, 2});
+    auto net = testLutNetEngine_MakeNet(input_shape);
+
+    bb::LutNetEngine engine;
+    ASSERT_TRUE(engine.Compile(net));
+    ASSERT_TRUE(engine.SaveBinary("LutNetEngineTest.bin"));
+
+    bblut_engine *capi = bblut_Load("LutNetEngineTest.bin", 64);
+    ASSERT_TRUE(capi != nullptr);
+    ASSERT_EQ(14 * 14 * 2, bblut_GetInputNodeSize(capi));
+    ASSERT_EQ(10, bblut_GetOutputNodeSize(capi));
+
+    int  frame_size = 150;
+    auto x_buf = testLutNetEngine_MakeInput(frame_size, input_shape);
+    auto y_ref = net->Forward(x_buf, false);
+
+    std::vector<unsigned char> x(frame_size * 14 * 14 * 2);
+    std::vector<unsigned char> y(frame_size * 10);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < 14 * 14 * 2; ++node) {
+            x[frame * 14 * 14 * 2 + node] = x_buf.GetBit(frame, node) ? 1 : 0;
+        }
+    }
+
+    EXPECT_EQ(0, bblut_Forward(capi, &x[0], &y[0], frame_size));
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < 10; ++node) {
+            EXPECT_EQ(y_ref.GetBit(frame, node) ? 1 : 0, y[frame * 10 + node]);
+        }
+    }
+
+    bblut_Delete(capi);
+
+    EXPECT_TRUE(bblut_Load("not_exist.bin", 64) == nullptr);
+}
+
+
+TEST(LutNetEngineTest, testLutNetEngine_load_error)
+{
+    bb::indices_t input_shape({14, 14, 2});
+    auto net = testLutNetEngine_MakeNet(input_shape);
+
+    bb::LutNetEngine engine;
+    ASSERT_TRUE(engine.Compile(net));
+
+    std::stringstream ss;
+    engine.Save(ss);
+    std::string data = ss.str();
+
+    // 正常なデータ
+    {
+        bb::LutNetEngine load;
+        std::istringstream is(data);
+        EXPECT_TRUE(load.Load(is));
+        EXPECT_EQ(engine.GetOpSize(), load.GetOpSize());
+        EXPECT_EQ(engine.GetInputNodeSize(),  load.GetInputNodeSize());
+        EXPECT_EQ(engine.GetOutputNodeSize(), load.GetOutputNodeSize());
+    }
+
+    // 途中で切れたデータ
+    for (size_t size : {(size_t)0, (size_t)4, (size_t)12, data.size() / 3, data.size() - 1}) {
+        bb::LutNetEngine load;
+        std::istringstream is(data.substr(0, size));
+        EXPECT_FALSE(load.Load(is));
+        EXPECT_EQ(0, load.GetStageSize());
+    }
+
+    // 別形式のデータ
+    {
+        std::string foreign = data;
+        foreign[0] = 'X';
+        bb::LutNetEngine load;
+        std::istringstream is(foreign);
+        EXPECT_FALSE(load.Load(is));
+    }
+
+    // 巨大なサイズ(入力形状の要素数を書き換え)
+    {
+        std::string broken = data;
+        std::uint64_t size = 0xffffffffffffULL;
+        memcpy(&broken[12], &size, sizeof(size));
+        bb::LutNetEngine load;
+        std::istringstream is(broken);
+        EXPECT_FALSE(load.Load(is));
+    }
+
+    // 範囲外のノード番号(末尾のテーブル直前にある入力ノード番号を書き換え)
+    {
+        std::string broken = data;
+        size_t tail = (size_t)(8 + engine.GetTableSize() * 8 + 8 + engine.GetTableSize() * 4);
+        std::int32_t node = 0x7fffffff;
+        memcpy(&broken[broken.size() - tail - 4], &node, sizeof(node));
+        bb::LutNetEngine load;
+        std::istringstream is(broken);
+        EXPECT_FALSE(load.Load(is));
+    }
+
+    // C API からも読めないこと
+    {
+        std::ofstream ofs("LutNetEngineTest_broken.bin", std::ios::binary);
+        ofs.write(data.data(), data.size() / 2);
+    }
+    EXPECT_TRUE(bblut_Load("LutNetEngineTest_broken.bin", 64) == nullptr);
+}
+
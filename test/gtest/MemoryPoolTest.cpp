@@ -0,0 +1,142 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include "gtest/gtest.h"
+
+#include "bb/Memory.h"
+#include "bb/MemoryPool.h"
+#include "bb/FrameBuffer.h"
+
+
+TEST(MemoryPoolTest, testMemoryPool_class)
+{
+    EXPECT_EQ(256u, bb::MemoryPool::GetAllocationSize(0));
+    EXPECT_EQ(256u, bb::MemoryPool::GetAllocationSize(256));
+    EXPECT_EQ(320u, bb::MemoryPool::GetAllocationSize(257));
+    EXPECT_EQ(448u, bb::MemoryPool::GetAllocationSize(400));
+    EXPECT_EQ(512u, bb::MemoryPool::GetAllocationSize(449));
+    EXPECT_EQ(1280u * 1024, bb::MemoryPool::GetAllocationSize(1024 * 1024 + 1));
+
+    // 切り上げは 25% 以内
+    for ( size_t size = 1; size < (1 << 20); size = size * 3 / 2 + 1 ) {
+        size_t alloc = bb::MemoryPool::GetAllocationSize(size);
+        EXPECT_GE(alloc, size);
+        EXPECT_LE(alloc, std::max((size_t)256, size + size / 4));
+    }
+}
+
+
+TEST(MemoryPoolTest, testMemoryPool_reuse)
+{
+    bb::MemoryPool::Trim();
+    bb::MemoryPool::ResetStatistics();
+    auto stat0 = bb::MemoryPool::GetStatistics();
+
+    void *p0 = bb::MemoryPool::Allocate(1000);
+    EXPECT_EQ(0u, (size_t)p0 % 64);
+    memset(p0, 0x55, 1000);
+    bb::MemoryPool::Free(p0);
+
+    // 同じクラスは再利用される
+    void *p1 = bb::MemoryPool::Allocate(900);
+    EXPECT_EQ(p0, p1);
+
+    // 大きなブロックは共有のキャッシュ経由
+    void *p2 = bb::MemoryPool::Allocate(8 * 1024 * 1024);
+    bb::MemoryPool::Free(p2);
+    void *p3 = bb::MemoryPool::Allocate(8 * 1024 * 1024 - 100);
+    EXPECT_EQ(p2, p3);
+
+    auto stat1 = bb::MemoryPool::GetStatistics();
+    EXPECT_EQ(4u, stat1.alloc_count - stat0.alloc_count);
+    EXPECT_EQ(2u, stat1.hit_count   - stat0.hit_count);
+    EXPECT_EQ(0u, stat1.bytes_held);
+    EXPECT_EQ(stat0.bytes_in_use + 1024 + 8 * 1024 * 1024, stat1.bytes_in_use);
+    EXPECT_GE(stat1.peak_bytes_in_use, stat1.bytes_in_use);
+    EXPECT_DOUBLE_EQ(0.5, stat1.GetHitRate());
+
+    bb::MemoryPool::Free(p1);
+    bb::MemoryPool::Free(p3);
+    auto stat2 = bb::MemoryPool::GetStatistics();
+    EXPECT_EQ(stat0.bytes_in_use, stat2.bytes_in_use);
+    EXPECT_EQ((size_t)1024 + 8 * 1024 * 1024, stat2.bytes_held);
+
+    bb::MemoryPool::Trim();
+    EXPECT_EQ(0u, bb::MemoryPool::GetStatistics().bytes_held);
+}
+
+
+TEST(MemoryPoolTest, testMemoryPool_thread)
+{
+    bb::MemoryPool::Trim();
+
+    // 他スレッドのキャッシュはスレッド終了時に共有のキャッシュに移る
+    void *p0 = nullptr;
+    std::thread th([&]() {
+        p0 = bb::MemoryPool::Allocate(2000);
+        bb::MemoryPool::Free(p0);
+    });
+    th.join();
+
+    EXPECT_EQ(2048u, bb::MemoryPool::GetStatistics().bytes_held);
+    void *p1 = bb::MemoryPool::Allocate(2000);
+    EXPECT_EQ(p0, p1);
+    bb::MemoryPool::Free(p1);
+    bb::MemoryPool::Trim();
+}
+
+
+TEST(MemoryPoolTest, testMemoryPool_thread_trim)
+{
+    bb::MemoryPool::Trim();
+
+    // Trim() は待機中の他スレッドのキャッシュも直ちに返す
+    std::atomic<int> step(0);
+    std::thread th([&]() {
+        bb::MemoryPool::Free(bb::MemoryPool::Allocate(2000));
+        step = 1;
+        while ( step != 2 ) { std::this_thread::yield(); }
+        bb::MemoryPool::Free(bb::MemoryPool::Allocate(100));
+        step = 3;
+        while ( step != 4 ) { std::this_thread::yield(); }
+    });
+
+    while ( step != 1 ) { std::this_thread::yield(); }
+    EXPECT_EQ(2048u, bb::MemoryPool::GetStatistics().bytes_held);
+    bb::MemoryPool::Trim();
+    EXPECT_EQ(0u, bb::MemoryPool::GetStatistics().bytes_held);
+
+    // Trim() 後もそのスレッドのキャッシュは使える
+    step = 2;
+    while ( step != 3 ) { std::this_thread::yield(); }
+    EXPECT_EQ(256u, bb::MemoryPool::GetStatistics().bytes_held);
+    step = 4;
+    th.join();
+    bb::MemoryPool::Trim();
+
+    // スレッド毎のキャッシュも上限に含める
+    bb::MemoryPool::SetCacheLimit(0);
+    bb::MemoryPool::Free(bb::MemoryPool::Allocate(2000));
+    EXPECT_EQ(0u, bb::MemoryPool::GetStatistics().bytes_held);
+    bb::MemoryPool::SetCacheLimit((size_t)1024 * 1024 * 1024);
+}
+
+
+TEST(MemoryPoolTest, testMemoryPool_framebuffer)
+{
+    bb::MemoryPool::Trim();
+    bb::MemoryPool::ResetStatistics();
+
+    // 最終ミニバッチのようにフレーム数が変わっても、確保はキャッシュから行われる
+    bb::FrameBuffer buf;
+    for ( int i = 0; i < 10; ++i ) {
+        buf.Resize(BB_TYPE_FP32, (i % 2 == 0) ? 256 : 100, 1024);
+        buf.FillZero();
+    }
+
+    auto stat = bb::MemoryPool::GetStatistics();
+    EXPECT_GE(stat.alloc_count, 10u);
+    EXPECT_GE(stat.GetHitRate(), 0.7);
+}
+
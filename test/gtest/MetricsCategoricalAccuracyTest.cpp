@@ -1,5 +1,6 @@
 ﻿#include <stdio.h>
 #include <iostream>
+#include <random>
 #include "gtest/gtest.h"
 #include "bb/MetricsCategoricalAccuracy.h"
 
@@ -35,3 +36,38 @@ TEST(MetricsCategoricalAccuracyTest, testMetricsCategoricalAccuracyTest)
 }
 
 
+
+
+TEST(MetricsCategoricalAccuracyTest, testMetricsCategoricalAccuracy_batch)
+{
+    // SIMD 版(FP32)とスカラー版(FP64)の比較 (端数フレームを含む)
+    int const frame_size = 45;
+    int const node_size  = 10;
+
+    std::mt19937_64                         mt(1);
+    std::uniform_real_distribution<double>  dist(0.0, 1.0);
+
+    bb::FrameBuffer y_fp32(BB_TYPE_FP32, frame_size, node_size);
+    bb::FrameBuffer t_fp32(BB_TYPE_FP32, frame_size, node_size);
+    bb::FrameBuffer y_fp64(BB_TYPE_FP64, frame_size, node_size);
+    bb::FrameBuffer t_fp64(BB_TYPE_FP64, frame_size, node_size);
+    for (int frame = 0; frame < frame_size; ++frame) {
+        for (int node = 0; node < node_size; ++node) {
+            float y = (float)dist(mt);
+            float t = (node == frame % node_size) ? 1.0f : 0.0f;
+            y_fp32.SetFP32(frame, node, y);
+            t_fp32.SetFP32(frame, node, t);
+            y_fp64.SetFP64(frame, node, y);
+            t_fp64.SetFP64(frame, node, t);
+        }
+    }
+
+    auto acc_fp32 = bb::MetricsCategoricalAccuracy<float>::Create();
+    auto acc_fp64 = bb::MetricsCategoricalAccuracy<double>::Create();
+    acc_fp32->CalculateMetrics(y_fp32, t_fp32);
+    acc_fp64->CalculateMetrics(y_fp64, t_fp64);
+
+    EXPECT_DOUBLE_EQ(acc_fp64->GetMetrics(), acc_fp32->GetMetrics());
+    EXPECT_GT(acc_fp32->GetMetrics(), 0.0);
+}
+
@@ -0,0 +1,239 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/MicroMlp.h"
+#include "bb/Sigmoid.h"
+#include "bb/LoweringConvolution.h"
+
+
+static void MicroMlpTest_SetRandom(bb::FrameBuffer &x, int seed)
+{
+    std::mt19937                            mt(seed);
+    std::uniform_real_distribution<float>   dist(-1.0f, 1.0f);
+    for ( bb::index_t frame = 0; frame < x.GetFrameSize(); ++frame ) {
+        for ( bb::index_t node = 0; node < x.GetNodeSize(); ++node ) {
+            x.SetFP32(frame, node, dist(mt));
+        }
+    }
+}
+
+static void MicroMlpTest_ExpectNear(bb::FrameBuffer const &exp, bb::FrameBuffer const &act, float abs_error)
+{
+    ASSERT_EQ(exp.GetFrameSize(), act.GetFrameSize());
+    ASSERT_EQ(exp.GetNodeSize(),  act.GetNodeSize());
+    for ( bb::index_t frame = 0; frame < exp.GetFrameSize(); ++frame ) {
+        for ( bb::index_t node = 0; node < exp.GetNodeSize(); ++node ) {
+            EXPECT_NEAR(exp.GetFP32(frame, node), act.GetFP32(frame, node), abs_error);
+        }
+    }
+}
+
+// 融合版と通常版で結果が一致すること
+template <class Activation>
+static void MicroMlpTest_Fusion(bool binary_mode)
+{
+    bb::index_t const input_node_size  = 24;
+    bb::index_t const output_node_size = 19;
+    bb::index_t const frame_size       = 77;
+
+    auto mm_ref   = bb::MicroMlp<6, 16, float, Activation>::Create(output_node_size);
+    auto mm_fused = bb::MicroMlp<6, 16, float, Activation>::Create(output_node_size);
+    mm_ref  ->SetInputShape({input_node_size});
+    mm_fused->SetInputShape({input_node_size});
+    mm_fused->SendCommand("fusion true");
+    if ( binary_mode ) {
+        mm_ref  ->SendCommand("binary true");
+        mm_fused->SendCommand("binary true");
+    }
+
+    // 同じ接続にそろえる
+    for ( bb::index_t node = 0; node < output_node_size; ++node ) {
+        for ( bb::index_t i = 0; i < 6; ++i ) {
+            mm_fused->SetNodeInput(node, i, mm_ref->GetNodeInput(node, i));
+        }
+    }
+
+    bb::FrameBuffer x(BB_TYPE_FP32, frame_size, input_node_size);
+    bb::FrameBuffer dy(BB_TYPE_FP32, frame_size, output_node_size);
+
+    for ( int loop = 0; loop < 3; ++loop ) {
+        MicroMlpTest_SetRandom(x,  loop * 2 + 1);
+        MicroMlpTest_SetRandom(dy, loop * 2 + 2);
+
+        // 学習
+        auto y_ref   = mm_ref  ->Forward(x, true);
+        auto y_fused = mm_fused->Forward(x, true);
+        MicroMlpTest_ExpectNear(y_ref, y_fused, 1.0e-4f);
+
+        auto dx_ref   = mm_ref  ->Backward(dy);
+        auto dx_fused = mm_fused->Backward(dy);
+        MicroMlpTest_ExpectNear(dx_ref, dx_fused, 1.0e-4f);
+
+        auto grad_ref   = mm_ref  ->GetGradients();
+        auto grad_fused = mm_fused->GetGradients();
+        ASSERT_EQ(grad_ref.GetSize(), grad_fused.GetSize());
+        for ( int i = 0; i < grad_ref.GetSize(); ++i ) {
+            auto ref_ptr   = grad_ref[i].template LockConst<float>();
+            auto fused_ptr = grad_fused[i].template LockConst<float>();
+            for ( bb::index_t j = 0; j < grad_ref[i].GetSize(); ++j ) {
+                EXPECT_NEAR(ref_ptr[j], fused_ptr[j], 1.0e-3f);
+            }
+        }
+
+        // 推論 (正規化を重みに畳み込む)
+        y_ref   = mm_ref  ->Forward(x, false);
+        y_fused = mm_fused->Forward(x, false);
+        if ( binary_mode || std::is_same< Activation, bb::Binarize<float> >::value ) {
+            // 閾値付近は丸め誤差で反転し得るので一致率で確認
+            int diff = 0;
+            for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+                for ( bb::index_t node = 0; node < output_node_size; ++node ) {
+                    diff += (y_ref.GetFP32(frame, node) != y_fused.GetFP32(frame, node)) ? 1 : 0;
+                }
+            }
+            EXPECT_LE(diff, 2);
+        }
+        else {
+            MicroMlpTest_ExpectNear(y_ref, y_fused, 1.0e-4f);
+        }
+    }
+}
+
+
+TEST(MicroMlpTest, testMicroMlp_FusionReLU)
+{
+    MicroMlpTest_Fusion< bb::ReLU<float> >(false);
+}
+
+TEST(MicroMlpTest, testMicroMlp_FusionReLUBinary)
+{
+    MicroMlpTest_Fusion< bb::ReLU<float> >(true);
+}
+
+TEST(MicroMlpTest, testMicroMlp_FusionBinarize)
+{
+    MicroMlpTest_Fusion< bb::Binarize<float> >(false);
+}
+
+
+TEST(MicroMlpTest, testMicroMlp_FusePass)
+{
+    auto affine0 = bb::MicroMlpAffine<6, 16>::Create(20);
+    auto bn0     = bb::BatchNormalization<>::Create();
+    auto affine1 = bb::MicroMlpAffine<6, 16>::Create(10);
+    auto bn1     = bb::BatchNormalization<>::Create();
+    auto affine2 = bb::MicroMlpAffine<4, 16>::Create(5);
+    auto bn2     = bb::BatchNormalization<>::Create();
+
+    auto sub = bb::Sequential::Create();
+    sub->Add(affine1);
+    sub->Add(bn1);
+    sub->Add(bb::Binarize<>::Create());
+
+    auto net = bb::Sequential::Create();
+    net->Add(affine0);
+    net->Add(bn0);
+    net->Add(bb::ReLU<>::Create());
+    net->Add(sub);
+    net->Add(affine2);      // N が異なるので対象外
+    net->Add(bn2);
+    net->Add(bb::ReLU<>::Create());
+    net->SetInputShape({32});
+
+    bb::FrameBuffer x(BB_TYPE_FP32, 45, 32);
+    MicroMlpTest_SetRandom(x, 1);
+    for ( int i = 0; i < 3; ++i ) {
+        net->Forward(x, true);
+    }
+    auto y_exp = net->Forward(x, false);
+
+    EXPECT_EQ(2, (bb::FuseMicroMlp<6, 16>(net)));
+    EXPECT_EQ(5, net->GetSize());
+    EXPECT_EQ(1, sub->GetSize());
+    EXPECT_EQ("MicroMlp", net->Get(0)->GetClassName());
+    EXPECT_EQ("MicroMlp", sub->Get(0)->GetClassName());
+    EXPECT_EQ("MicroMlpAffine", net->Get(2)->GetClassName());
+
+    // パラメータは元のレイヤーと共有
+    EXPECT_EQ(affine0->GetParameters().GetSize() + bn0->GetParameters().GetSize(), net->Get(0)->GetParameters().GetSize());
+
+    auto y = net->Forward(x, false);
+    MicroMlpTest_ExpectNear(y_exp, y, 1.0e-4f);
+}
+
+
+// Sigmoid は Binarize の派生だが融合しない
+TEST(MicroMlpTest, testMicroMlp_FusionSigmoid)
+{
+    auto affine = bb::MicroMlpAffine<6, 16>::Create(10);
+    auto bn     = bb::BatchNormalization<>::Create();
+
+    auto net = bb::Sequential::Create();
+    net->Add(affine);
+    net->Add(bn);
+    net->Add(bb::Sigmoid<>::Create());
+    net->SetInputShape({32});
+
+    bb::FrameBuffer x(BB_TYPE_FP32, 45, 32);
+    MicroMlpTest_SetRandom(x, 1);
+    net->Forward(x, true);
+    auto y_exp = net->Forward(x, false);
+
+    EXPECT_EQ(0, (bb::FuseMicroMlp<6, 16>(net)));
+    EXPECT_EQ(3, net->GetSize());
+    MicroMlpTest_ExpectNear(y_exp, net->Forward(x, false), 1.0e-6f);
+
+    // MicroMlp の活性化に Sigmoid を指定した場合も融合しない
+    auto mm_ref   = bb::MicroMlp<6, 16, float, bb::Sigmoid<float> >::Create(affine, bn, bb::Sigmoid<>::Create());
+    auto mm_fused = bb::MicroMlp<6, 16, float, bb::Sigmoid<float> >::Create(affine, bn, bb::Sigmoid<>::Create());
+    mm_fused->SendCommand("fusion true");
+    MicroMlpTest_ExpectNear(mm_ref->Forward(x, false), mm_fused->Forward(x, false), 1.0e-6f);
+    MicroMlpTest_ExpectNear(mm_ref->Forward(x, true),  mm_fused->Forward(x, true),  1.0e-6f);
+}
+
+
+// LoweringConvolution の fused モードの forward 再計算で、融合版 MicroMlp も running_mean/var を更新しない
+TEST(MicroMlpTest, testMicroMlp_FusionRunningStatLock)
+{
+    bb::index_t const frame_size = 13;
+
+    auto affine = bb::MicroMlpAffine<6, 16>::Create(8);
+    auto bn     = bb::BatchNormalization<>::Create(0.5f);
+    auto mm     = bb::MicroMlp<6, 16>::Create(affine, bn, bb::ReLU<>::Create());
+    auto cnv    = bb::LoweringConvolution<>::Create(mm, 3, 3, 1, 1, 1, 1);
+
+    bb::FrameBuffer x(BB_TYPE_FP32, frame_size, {8, 8, 3});
+    cnv->SetInputShape(x.GetShape());
+    cnv->SendCommand("host_only true");
+    cnv->SendCommand("fusion true");
+    cnv->SendCommand("fused_tile_size 128");
+    MicroMlpTest_SetRandom(x, 1);
+
+    auto y = cnv->Forward(x, true);
+
+    std::vector<float> mean(8), var(8);
+    {
+        auto mean_ptr = bn->lock_mean_const();
+        auto var_ptr  = bn->lock_var_const();
+        for ( int node = 0; node < 8; ++node ) {
+            mean[node] = mean_ptr[node];
+            var[node]  = var_ptr[node];
+        }
+    }
+
+    bb::FrameBuffer dy(BB_TYPE_FP32, frame_size, y.GetShape());
+    MicroMlpTest_SetRandom(dy, 2);
+    cnv->Backward(dy);
+
+    auto mean_ptr = bn->lock_mean_const();
+    auto var_ptr  = bn->lock_var_const();
+    for ( int node = 0; node < 8; ++node ) {
+        EXPECT_EQ(mean[node], mean_ptr[node]);
+        EXPECT_EQ(var[node],  var_ptr[node]);
+    }
+}
+
+
+// end of file
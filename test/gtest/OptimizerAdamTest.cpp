@@ -205,3 +205,82 @@ TEST(OptimizerAdamTest, testOptimizerAdam_Cmp)
 }
 
 
+
+TEST(OptimizerAdamTest, testOptimizerAdam_ClipDecay)
+{
+    // SIMD の端数を含むサイズで、勾配クリッピングと L2 正則化を含めて要素毎のモデルと比較
+    bb::index_t const   size  = 37;
+    float const         clip  = 1.0f;
+    float const         decay = 0.01f;
+
+    bb::OptimizerAdam<float>::create_t create;
+    create.weight_decay  = decay;
+    create.gradient_clip = clip;
+    auto opt_adam = bb::OptimizerAdam<float>::Create(create);
+
+    auto param_tensor = std::shared_ptr<bb::Tensor>(new bb::Tensor(BB_TYPE_FP32, size));
+    auto grad_tensor  = std::shared_ptr<bb::Tensor>(new bb::Tensor(BB_TYPE_FP32, size));
+    bb::Variables param_var;
+    bb::Variables grad_var;
+    param_var.PushBack(param_tensor);
+    grad_var.PushBack(grad_tensor);
+    opt_adam->SetVariables(param_var, grad_var);
+
+    std::mt19937_64                 mt(1);
+    std::normal_distribution<float> norm_dist(0.0f, 2.0f);
+
+    std::vector<ModelAdam>  models(size);
+    std::vector<float>      exp_p(size);
+    {
+        auto param_ptr = param_tensor->Lock<float>();
+        for ( bb::index_t i = 0; i < size; ++i ) {
+            exp_p[i]     = norm_dist(mt);
+            param_ptr[i] = exp_p[i];
+        }
+    }
+
+    for ( int loop = 0; loop < 10; ++loop ) {
+        {
+            auto grad_ptr = grad_tensor->Lock<float>();
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                float grad   = norm_dist(mt);
+                grad_ptr[i]  = grad;
+                grad = std::min(std::max(grad, -clip), clip) + decay * exp_p[i];
+                models[i].update(exp_p[i], grad);
+            }
+        }
+
+        opt_adam->Update();
+
+        {
+            auto param_ptr = param_tensor->LockConst<float>();
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_NEAR(exp_p[i], param_ptr[i], 1.0e-6f);
+            }
+        }
+    }
+}
+
+
+// NaN の勾配は SIMD の本体と端数のどちらの位置でも NaN のまま伝わる
+TEST(OptimizerAdamTest, testOptimizerAdam_NaN)
+{
+    bb::index_t const size = 13;
+    int const level_limit = bb::bb_simd_level_limit();
+    for ( int level : {bb::BB_SIMD_SCALAR, bb::BB_SIMD_AVX2} ) {
+        bb::bb_simd_set_level(level);
+        for ( float clip : {0.0f, 1.0f} ) {
+            std::vector<float> param(size, 1.0f);
+            std::vector<float> grad(size, 0.5f);
+            std::vector<float> m(size, 0.0f);
+            std::vector<float> v(size, 0.0f);
+            grad[2]  = std::numeric_limits<float>::quiet_NaN();
+            grad[10] = std::numeric_limits<float>::quiet_NaN();
+            bb::HostAdam_Update(size, param.data(), grad.data(), m.data(), v.data(), 0.001f, 0.9f, 0.999f, clip, 0.0f);
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_EQ(i == 2 || i == 10, std::isnan(param[i])) << "level " << level << " clip " << clip << " index " << i;
+            }
+        }
+    }
+    bb::bb_simd_set_level(level_limit);
+}
@@ -0,0 +1,122 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include "gtest/gtest.h"
+
+#include "bb/Profiler.h"
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/ReLU.h"
+
+
+static std::shared_ptr<bb::Sequential> testProfiler_MakeNet(void)
+{
+    auto net = bb::Sequential::Create();
+    auto sub = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<float>::Create(32));
+    sub->Add(bb::ReLU<float>::Create());
+    sub->Add(bb::DenseAffine<float>::Create(10));
+    sub->SetName("sub");
+    net->Add(sub);
+    net->SetInputShape({16});
+    net->SendCommand("host_only true");
+    return net;
+}
+
+
+TEST(ProfilerTest, testProfiler_disabled)
+{
+    bb::Profiler::Disable();
+    bb::Profiler::Clear();
+
+    auto net = testProfiler_MakeNet();
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, 8, 16);
+    auto y_buf = net->Forward(x_buf);
+    net->Backward(y_buf);
+
+    EXPECT_TRUE(bb::Profiler::GetEvents().empty());
+}
+
+
+TEST(ProfilerTest, testProfiler_sequential)
+{
+    auto net = testProfiler_MakeNet();
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, 8, 16);
+    bb::FrameBuffer dy_buf(BB_TYPE_FP32, 8, 10);
+
+    bb::Profiler::Enable();
+    for ( int i = 0; i < 2; ++i ) {
+        net->Forward(x_buf);
+        net->Backward(dy_buf);
+    }
+    bb::Profiler::Disable();
+
+    // 2回 × (forward 4区間 + backward 4区間)
+    auto events = bb::Profiler::GetEvents();
+    EXPECT_EQ(16, (int)events.size());
+
+    int forward = 0, backward = 0;
+    for ( auto const &ev : events ) {
+        EXPECT_GE(ev.time_us, 0.0);
+        if ( ev.category == "forward" ) {
+            forward++;
+            if ( ev.name == "sub" || ev.name == "DenseAffine" ) {
+                EXPECT_EQ(8, ev.frame_size);
+            }
+            if ( ev.name == "sub" ) {
+                EXPECT_EQ(0, ev.depth);
+                EXPECT_EQ(10, ev.node_size);
+                EXPECT_GE(ev.buffer_bytes, (std::uint64_t)(8 * 10 * 4));
+            }
+            if ( ev.name == "ReLU" ) {
+                EXPECT_EQ(1, ev.depth);
+                EXPECT_EQ(32, ev.node_size);
+            }
+        }
+        if ( ev.category == "backward" ) {
+            backward++;
+            if ( ev.name == "sub" ) {
+                EXPECT_EQ(32, ev.node_size);
+            }
+        }
+        EXPECT_GT(ev.counter.host_lock, 0u);
+    }
+    EXPECT_EQ(8, forward);
+    EXPECT_EQ(8, backward);
+
+    // 集計表はインスタンス毎
+    std::ostringstream summary;
+    bb::Profiler::PrintSummary(summary);
+    auto text = summary.str();
+    EXPECT_NE(std::string::npos, text.find("  ReLU"));
+    EXPECT_NE(std::string::npos, text.find("sub"));
+    EXPECT_NE(std::string::npos, text.find("8x10"));
+
+    std::ostringstream trace;
+    bb::Profiler::WriteChromeTrace(trace);
+    auto json = trace.str();
+    EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"ReLU\",\"cat\":\"forward\",\"ph\":\"X\""));
+}
+
+
+TEST(ProfilerTest, testProfiler_alloc)
+{
+    bb::Profiler::Enable();
+    {
+        bb::Profiler::Scope prof("alloc", "test");
+        bb::FrameBuffer buf(BB_TYPE_FP32, 64, 100);
+        buf.SetFP32(0, 0, 1.0f);
+        prof.SetOutput(buf);
+    }
+    bb::Profiler::Disable();
+
+    auto events = bb::Profiler::GetEvents();
+    ASSERT_EQ(1, (int)events.size());
+    EXPECT_EQ("alloc", events[0].name);
+    EXPECT_EQ("test",  events[0].category);
+    EXPECT_GE(events[0].counter.alloc_bytes, (std::uint64_t)(64 * 100 * 4));
+    EXPECT_EQ(64,  events[0].frame_size);
+    EXPECT_EQ(100, events[0].node_size);
+    EXPECT_GE(events[0].buffer_bytes, (std::uint64_t)(64 * 100 * 4));
+}
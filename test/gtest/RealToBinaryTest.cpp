@@ -1,7 +1,9 @@
 ﻿#include <stdio.h>
 #include <iostream>
+#include <omp.h>
 #include "gtest/gtest.h"
 #include "bb/RealToBinary.h"
+#include "bb/UniformDistributionGenerator.h"
 
 
 #define USE_BACKWARD    0
@@ -110,3 +112,101 @@ TEST(RealToBinaryTest, testRealToBinaryyBatch)
 #endif
 }
 
+
+TEST(RealToBinaryTest, testPhiloxGenerator)
+{
+    // Random123 の既知の値 (counter = 0, key = 0)
+    std::uint32_t ctr[4] = {0, 0, 0, 0};
+    bb::Philox4x32_10(ctr, 0, 0);
+    EXPECT_EQ(0x6627e8d5u, ctr[0]);
+    EXPECT_EQ(0xe169c58du, ctr[1]);
+    EXPECT_EQ(0xbc57ac4cu, ctr[2]);
+    EXPECT_EQ(0x9b00dbd8u, ctr[3]);
+
+    // 1個ずつ、まとめて、位置指定のいずれも同じ並び
+    auto gen0 = bb::PhiloxGenerator<float>::Create(0.0f, 1.0f, 123);
+    auto gen1 = bb::PhiloxGenerator<float>::Create(0.0f, 1.0f, 123);
+    std::vector<float> v0(103), v1(103), v2(103);
+    for ( auto &v : v0 ) { v = gen0->GetValue(); }
+    gen1->GetValues(&v1[0], 3);
+    gen1->GetValues(&v1[3], 100);
+    gen1->Generate(0, &v2[0], 103);
+    EXPECT_EQ(v0, v1);
+    EXPECT_EQ(v0, v2);
+    for ( auto v : v0 ) {
+        EXPECT_GE(v, 0.0f);
+        EXPECT_LT(v, 1.0f);
+    }
+
+    gen1->Reset();
+    EXPECT_EQ(v0[0], gen1->GetValue());
+}
+
+
+// スレッド数によらず同じ結果になり、位置 (ノード, 出力フレーム) の乱数と比較した結果になる
+TEST(RealToBinaryTest, testRealToBinaryPhilox)
+{
+    int const node_size  = 37;
+    int const mux_size   = 3;
+    int const frame_size = 45;
+
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, frame_size, node_size);
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < node_size; ++node ) {
+            x_buf.SetFP32(frame, node, (float)((frame * 7 + node * 13) % 100) / 100.0f);
+        }
+    }
+
+    for ( int framewise = 0; framewise < 2; ++framewise ) {
+        bb::FrameBuffer y_bit[2];
+        bb::FrameBuffer y_fp32[2];
+        for ( int i = 0; i < 2; ++i ) {
+            int num_threads = omp_get_max_threads();
+            omp_set_num_threads(i == 0 ? 1 : 4);
+            auto real2bit  = bb::RealToBinary<float, bb::Bit>::Create(mux_size, bb::PhiloxGenerator<float>::Create(0.0f, 1.0f, 7), framewise != 0);
+            auto real2fp32 = bb::RealToBinary<float, float>::Create(mux_size, bb::PhiloxGenerator<float>::Create(0.0f, 1.0f, 7), framewise != 0);
+            y_bit[i]  = real2bit->Forward(x_buf);
+            y_fp32[i] = real2fp32->Forward(x_buf);
+            omp_set_num_threads(num_threads);
+        }
+
+        auto gen = bb::PhiloxGenerator<float>::Create(0.0f, 1.0f, 7);
+        for ( int node = 0; node < node_size; ++node ) {
+            for ( int frame = 0; frame < frame_size * mux_size; ++frame ) {
+                float th = gen->GetValueAt(framewise ? frame : node * frame_size * mux_size + frame);
+                bool  y  = x_buf.GetFP32(frame / mux_size, node) > th;
+                EXPECT_EQ(y, (bool)y_bit[0].GetBit(frame, node));
+                EXPECT_EQ(y, (bool)y_bit[1].GetBit(frame, node));
+                EXPECT_EQ(y ? 1.0f : 0.0f, y_fp32[0].GetFP32(frame, node));
+                EXPECT_EQ(y ? 1.0f : 0.0f, y_fp32[1].GetFP32(frame, node));
+            }
+        }
+    }
+}
+
+
+// 固定ステップの閾値は従来の計算と一致する
+TEST(RealToBinaryTest, testRealToBinaryStep)
+{
+    int const node_size  = 5;
+    int const mux_size   = 7;
+    int const frame_size = 11;
+
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, frame_size, node_size);
+    for ( int frame = 0; frame < frame_size; ++frame ) {
+        for ( int node = 0; node < node_size; ++node ) {
+            x_buf.SetFP32(frame, node, (float)((frame * 3 + node * 5) % 17) / 16.0f);
+        }
+    }
+
+    auto real2bin = bb::RealToBinary<float, bb::Bit>::Create(mux_size);
+    auto y_buf = real2bin->Forward(x_buf);
+
+    float th_step = 1.0f / (float)(mux_size + 1);
+    for ( int node = 0; node < node_size; ++node ) {
+        for ( int frame = 0; frame < frame_size * mux_size; ++frame ) {
+            float th = 0.0f + th_step * (float)(frame % mux_size + 1);
+            EXPECT_EQ(x_buf.GetFP32(frame / mux_size, node) > th, (bool)y_buf.GetBit(frame, node));
+        }
+    }
+}
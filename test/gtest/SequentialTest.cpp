@@ -0,0 +1,101 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/Sequential.h"
+#include "bb/DenseAffine.h"
+#include "bb/Sigmoid.h"
+#include "bb/ReLU.h"
+
+
+static std::shared_ptr<bb::Sequential> testSequential_MakeNet(void)
+{
+    auto net = bb::Sequential::Create();
+    net->Add(bb::DenseAffine<float>::Create(64));
+    net->Add(bb::Sigmoid<float>::Create());
+    net->Add(bb::ReLU<float>::Create());
+    net->Add(bb::DenseAffine<float>::Create(32));
+    net->Add(bb::ReLU<float>::Create());
+    net->Add(bb::DenseAffine<float>::Create(10));
+    net->SetInputShape({48});
+    return net;
+}
+
+
+TEST(SequentialTest, testSequential_memory_plan)
+{
+    auto net_ref  = testSequential_MakeNet();
+    auto net_plan = testSequential_MakeNet();
+    net_ref->SendCommand("host_only true");
+    net_plan->SendCommand("host_only true");
+    net_plan->SendCommand("memory_plan true");
+
+    std::mt19937_64 mt(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // 記録前, 記録, 計画通り, フレーム数減少(計画内), フレーム数増加(記録しなおし), 再計画 ...
+    bb::index_t frame_sizes[] = {64, 64, 64, 64, 37, 80, 80, 80, 64};
+    for ( auto frame_size : frame_sizes ) {
+        bb::FrameBuffer x_buf(BB_TYPE_FP32, frame_size, 48);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < 48; ++node ) {
+                x_buf.SetFP32(frame, node, dist(mt));
+            }
+        }
+
+        bb::FrameBuffer dy_buf(BB_TYPE_FP32, frame_size, 10);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < 10; ++node ) {
+                dy_buf.SetFP32(frame, node, dist(mt));
+            }
+        }
+
+        auto y_ref  = net_ref->Forward(x_buf);
+        auto dx_ref = net_ref->Backward(dy_buf);
+
+        // 計画の区間は Forward(train) ～ Backward
+        auto y_plan = net_plan->Forward(x_buf);
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < 10; ++node ) {
+                EXPECT_EQ(y_ref.GetFP32(frame, node), y_plan.GetFP32(frame, node));
+            }
+        }
+        auto dx_plan = net_plan->Backward(dy_buf);
+
+        for ( bb::index_t frame = 0; frame < frame_size; ++frame ) {
+            for ( bb::index_t node = 0; node < 48; ++node ) {
+                EXPECT_EQ(dx_ref.GetFP32(frame, node), dx_plan.GetFP32(frame, node));
+            }
+        }
+
+        auto dW_ref  = net_ref->GetGradients();
+        auto dW_plan = net_plan->GetGradients();
+        ASSERT_EQ(dW_ref.GetSize(), dW_plan.GetSize());
+        for ( bb::index_t i = 0; i < dW_ref.GetSize(); ++i ) {
+            auto ptr_ref  = dW_ref[i].LockConst<float>();
+            auto ptr_plan = dW_plan[i].LockConst<float>();
+            for ( bb::index_t j = 0; j < dW_ref[i].GetSize(); ++j ) {
+                EXPECT_EQ(ptr_ref[j], ptr_plan[j]);
+            }
+        }
+    }
+
+    // 推論は計画の対象外
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, 16, 48);
+    x_buf.FillZero();
+    auto y_ref  = net_ref->Forward(x_buf, false);
+    auto y_plan = net_plan->Forward(x_buf, false);
+    for ( bb::index_t frame = 0; frame < 16; ++frame ) {
+        for ( bb::index_t node = 0; node < 10; ++node ) {
+            EXPECT_EQ(y_ref.GetFP32(frame, node), y_plan.GetFP32(frame, node));
+        }
+    }
+
+    size_t peak  = net_plan->GetMemoryPlanPeakSize();
+    size_t total = net_plan->GetMemoryPlanTotalSize();
+    std::cout << "memory plan peak : " << peak << " / total : " << total << std::endl;
+    EXPECT_GT(peak, (size_t)0);
+    EXPECT_LT(peak, total);
+}
+
@@ -0,0 +1,350 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/SimdKernel.h"
+#include "bb/ReLU.h"
+
+
+// レベル指定でカーネルを取り出す
+#define SIMD_KERNEL_AT(level, ...)  bb::SimdKernel_Select(&bb::simd_scalar::__VA_ARGS__, &bb::simd_sse42::__VA_ARGS__, &bb::simd_avx2::__VA_ARGS__, &bb::simd_avx512::__VA_ARGS__, level)
+
+
+static std::vector<float> SimdKernelTest_MakeData(bb::index_t size, int seed)
+{
+    std::mt19937                            mt(seed);
+    std::uniform_real_distribution<float>   dist(-1.0f, 1.0f);
+    std::vector<float> v(size);
+    for ( auto &x : v ) {
+        x = dist(mt);
+        if ( mt() % 7 == 0 ) { x = 0; }
+    }
+    return v;
+}
+
+static std::vector<std::int32_t> SimdKernelTest_MakeBits(bb::index_t size, int seed)
+{
+    std::mt19937 mt(seed);
+    std::vector<std::int32_t> v(size);
+    for ( auto &x : v ) {
+        x = (std::int32_t)mt();
+    }
+    return v;
+}
+
+
+// 端数を含むサイズ
+static bb::index_t const    SimdKernelTest_Sizes[] = {1, 3, 8, 15, 16, 17, 61, 133};
+
+
+TEST(SimdKernelTest, testSimdKernel_ReLU)
+{
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            auto x  = SimdKernelTest_MakeData(size, 1);
+            auto dy = SimdKernelTest_MakeData(size, 2);
+            std::vector<float> y_exp(size + 1, 9.0f), y(size + 1, 9.0f);
+            std::vector<float> dx_exp(size + 1, 9.0f), dx(size + 1, 9.0f);
+
+            bb::simd_scalar::ReLU_Forward(y_exp.data(), x.data(), size);
+            SIMD_KERNEL_AT(level, ReLU_Forward)(y.data(), x.data(), size);
+            bb::simd_scalar::ReLU_Backward(dx_exp.data(), y_exp.data(), dy.data(), size);
+            SIMD_KERNEL_AT(level, ReLU_Backward)(dx.data(), y.data(), dy.data(), size);
+
+            // 範囲外(末尾)は書き換えない
+            EXPECT_EQ(y_exp, y);
+            EXPECT_EQ(dx_exp, dx);
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_Binarize)
+{
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            auto x  = SimdKernelTest_MakeData(size, 1);
+            auto dy = SimdKernelTest_MakeData(size, 2);
+            for ( auto &v : x ) { v *= 2.0f; }     // hard-tanh の範囲外も含める
+            if ( size > 2 ) { x[0] = 1.0f; x[1] = -1.0f; }
+
+            std::vector<float> y_exp(size + 1, 9.0f), y(size + 1, 9.0f);
+            std::vector<float> dx_exp(size + 1, 9.0f), dx(size + 1, 9.0f);
+
+            bb::simd_scalar::Binarize_Forward(y_exp.data(), x.data(), size);
+            SIMD_KERNEL_AT(level, Binarize_Forward)(y.data(), x.data(), size);
+            bb::simd_scalar::Binarize_Backward(dx_exp.data(), x.data(), dy.data(), size);
+            SIMD_KERNEL_AT(level, Binarize_Backward)(dx.data(), x.data(), dy.data(), size);
+
+            EXPECT_EQ(y_exp, y);
+            EXPECT_EQ(dx_exp, dx);
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_EQ(x[i] > 0.0f ? 1.0f : 0.0f, y_exp[i]);
+                EXPECT_EQ((x[i] >= -1.0f && x[i] <= 1.0f) ? dy[i] : 0.0f, dx_exp[i]);
+            }
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_RealToBinary)
+{
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            auto x  = SimdKernelTest_MakeData(size, 1);
+            auto th = SimdKernelTest_MakeData(size, 2);
+
+            std::vector<float> y_exp(size + 1, 9.0f), y(size + 1, 9.0f);
+            bb::simd_scalar::RealToBinary_ForwardFp32(y_exp.data(), x.data(), th.data(), size);
+            SIMD_KERNEL_AT(level, RealToBinary_ForwardFp32)(y.data(), x.data(), th.data(), size);
+            EXPECT_EQ(y_exp, y);
+
+            bb::index_t words = (size + 31) / 32;
+            std::vector<std::int32_t> yb_exp(words + 1, 9), yb(words + 1, 9);
+            bb::simd_scalar::RealToBinary_ForwardBit(yb_exp.data(), x.data(), th.data(), size);
+            SIMD_KERNEL_AT(level, RealToBinary_ForwardBit)(yb.data(), x.data(), th.data(), size);
+            EXPECT_EQ(yb_exp, yb);
+            for ( bb::index_t i = 0; i < words * 32; ++i ) {
+                bool exp = (i < size) && (x[i] > th[i]);
+                EXPECT_EQ(exp, ((yb_exp[i / 32] >> (i % 32)) & 1) != 0);
+            }
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_MaxPooling)
+{
+    int const n = 4;
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            std::vector<float>          x[n];
+            std::vector<std::int32_t>   xb[n];
+            float const                 *x_ptr[n];
+            std::int32_t const          *xb_ptr[n];
+            for ( int k = 0; k < n; ++k ) {
+                x[k]  = SimdKernelTest_MakeData(size, 10 + k);
+                xb[k] = SimdKernelTest_MakeBits(size, 20 + k);
+                x_ptr[k]  = x[k].data();
+                xb_ptr[k] = xb[k].data();
+            }
+
+            // FP32 forward
+            std::vector<float> y_exp(size + 1, 9.0f), y(size + 1, 9.0f);
+            bb::simd_scalar::MaxPooling_ForwardFp32(y_exp.data(), x_ptr, n, size);
+            SIMD_KERNEL_AT(level, MaxPooling_ForwardFp32)(y.data(), x_ptr, n, size);
+            EXPECT_EQ(y_exp, y);
+
+            // Bit forward
+            std::vector<std::int32_t> yb_exp(size + 1, 9), yb(size + 1, 9);
+            bb::simd_scalar::MaxPooling_ForwardBit(yb_exp.data(), xb_ptr, n, size);
+            SIMD_KERNEL_AT(level, MaxPooling_ForwardBit)(yb.data(), xb_ptr, n, size);
+            EXPECT_EQ(yb_exp, yb);
+
+            // FP32 backward
+            auto dy = SimdKernelTest_MakeData(size, 3);
+            std::vector<float>  dx_exp[n], dx[n];
+            float               *dx_exp_ptr[n], *dx_ptr[n];
+            for ( int k = 0; k < n; ++k ) {
+                dx_exp[k].assign(size + 1, 9.0f);
+                dx[k].assign(size + 1, 9.0f);
+                dx_exp_ptr[k] = dx_exp[k].data();
+                dx_ptr[k]     = dx[k].data();
+            }
+            bb::simd_scalar::MaxPooling_BackwardFp32(dx_exp_ptr, x_ptr, n, y_exp.data(), dy.data(), size);
+            SIMD_KERNEL_AT(level, MaxPooling_BackwardFp32)(dx_ptr, x_ptr, n, y.data(), dy.data(), size);
+            for ( int k = 0; k < n; ++k ) {
+                EXPECT_EQ(dx_exp[k], dx[k]);
+            }
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_BatchNormalization)
+{
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            auto x  = SimdKernelTest_MakeData(size, 4);
+            auto dy = SimdKernelTest_MakeData(size, 5);
+
+            std::vector<float> y_exp(size), y(size);
+            float mean_exp, var_exp, rstd_exp;
+            float mean, var, rstd;
+            bb::simd_scalar::BatchNormalization_ForwardTraining(y_exp.data(), x.data(), size, 1.5f, 0.25f, mean_exp, var_exp, rstd_exp);
+            SIMD_KERNEL_AT(level, BatchNormalization_ForwardTraining)(y.data(), x.data(), size, 1.5f, 0.25f, mean, var, rstd);
+            EXPECT_NEAR(mean_exp, mean, 1.0e-5f);
+            EXPECT_NEAR(var_exp,  var,  1.0e-5f);
+            EXPECT_NEAR(rstd_exp, rstd, 1.0e-3f * rstd_exp);
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_NEAR(y_exp[i], y[i], 1.0e-3f);
+            }
+
+            bb::simd_scalar::BatchNormalization_ForwardInference(y_exp.data(), x.data(), size, 0.1f, 2.0f, 1.5f, 0.25f);
+            SIMD_KERNEL_AT(level, BatchNormalization_ForwardInference)(y.data(), x.data(), size, 0.1f, 2.0f, 1.5f, 0.25f);
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_NEAR(y_exp[i], y[i], 1.0e-5f);
+            }
+
+            std::vector<float> dx_exp(size), dx(size);
+            float dgamma_exp, dbeta_exp, dgamma, dbeta;
+            bb::simd_scalar::BatchNormalization_Backward(dx_exp.data(), x.data(), dy.data(), size, mean_exp, rstd_exp, 1.5f, dgamma_exp, dbeta_exp);
+            SIMD_KERNEL_AT(level, BatchNormalization_Backward)(dx.data(), x.data(), dy.data(), size, mean_exp, rstd_exp, 1.5f, dgamma, dbeta);
+            EXPECT_NEAR(dgamma_exp, dgamma, 1.0e-3f);
+            EXPECT_NEAR(dbeta_exp,  dbeta,  1.0e-3f);
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_NEAR(dx_exp[i], dx[i], 1.0e-3f);
+            }
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_MicroMlpAffine)
+{
+    int const N = 6;
+    int const M = 16;
+
+    float W0[M][N], b0[M], W1[M], b1 = 0.125f;
+    {
+        auto w = SimdKernelTest_MakeData(M * N + M + M, 6);
+        int k = 0;
+        for ( int i = 0; i < M; ++i ) {
+            for ( int j = 0; j < N; ++j ) { W0[i][j] = w[k++]; }
+            b0[i] = w[k++];
+            W1[i] = w[k++];
+        }
+    }
+
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            std::vector<float>  x[N];
+            float const         *x_ptr[N];
+            for ( int j = 0; j < N; ++j ) {
+                x[j]     = SimdKernelTest_MakeData(size, 30 + j);
+                x_ptr[j] = x[j].data();
+            }
+            auto dy = SimdKernelTest_MakeData(size, 7);
+
+            std::vector<float> y_exp(size + 1, 9.0f), y(size + 1, 9.0f);
+            bb::simd_scalar::MicroMlpAffine_Forward<N, M>(y_exp.data(), x_ptr, W0, b0, W1, b1, size);
+            SIMD_KERNEL_AT(level, MicroMlpAffine_Forward<N, M>)(y.data(), x_ptr, W0, b0, W1, b1, size);
+            EXPECT_EQ(9.0f, y[size]);
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_NEAR(y_exp[i], y[i], 1.0e-4f);
+            }
+
+            std::vector<float>  dx_exp[N], dx[N];
+            float               *dx_exp_ptr[N], *dx_ptr[N];
+            for ( int j = 0; j < N; ++j ) {
+                dx_exp[j].assign(size, 0.0f);
+                dx[j].assign(size, 0.0f);
+                dx_exp_ptr[j] = dx_exp[j].data();
+                dx_ptr[j]     = dx[j].data();
+            }
+            float dW0_exp[M][N] = {}, db0_exp[M] = {}, dW1_exp[M] = {}, db1_exp = 0;
+            float dW0[M][N]     = {}, db0[M]     = {}, dW1[M]     = {}, db1     = 0;
+            bb::simd_scalar::MicroMlpAffine_Backward<N, M>(dx_exp_ptr, x_ptr, dy.data(), W0, b0, W1, dW0_exp, db0_exp, dW1_exp, db1_exp, size);
+            SIMD_KERNEL_AT(level, MicroMlpAffine_Backward<N, M>)(dx_ptr, x_ptr, dy.data(), W0, b0, W1, dW0, db0, dW1, db1, size);
+            EXPECT_NEAR(db1_exp, db1, 1.0e-3f);
+            for ( int i = 0; i < M; ++i ) {
+                EXPECT_NEAR(db0_exp[i], db0[i], 1.0e-3f);
+                EXPECT_NEAR(dW1_exp[i], dW1[i], 1.0e-3f);
+                for ( int j = 0; j < N; ++j ) {
+                    EXPECT_NEAR(dW0_exp[i][j], dW0[i][j], 1.0e-3f);
+                }
+            }
+            for ( int j = 0; j < N; ++j ) {
+                for ( bb::index_t i = 0; i < size; ++i ) {
+                    EXPECT_NEAR(dx_exp[j][i], dx[j][i], 1.0e-4f);
+                }
+            }
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_BinaryLutN)
+{
+    int const N = 6;
+
+    std::uint32_t   table[2];
+    std::int32_t    table8[8] = {0};
+    table[0] = 0x9e3779b9;
+    table[1] = 0x7f4a7c15;
+    table8[0] = (std::int32_t)table[0];
+    table8[1] = (std::int32_t)table[1];
+
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        for ( auto size : SimdKernelTest_Sizes ) {
+            std::vector<std::int32_t>   xb[N];
+            std::int32_t const          *xb_ptr[N];
+            std::vector<float>          x[N];
+            float const                 *x_ptr[N];
+            for ( int j = 0; j < N; ++j ) {
+                xb[j]     = SimdKernelTest_MakeBits(size, 40 + j);
+                xb_ptr[j] = xb[j].data();
+                x[j]      = SimdKernelTest_MakeData(size, 50 + j);
+                x_ptr[j]  = x[j].data();
+            }
+
+            std::vector<std::int32_t> yb_exp(size + 1, 9), yb(size + 1, 9);
+            bb::simd_scalar::BinaryLutN_ForwardBit<N>(yb_exp.data(), xb_ptr, table, size);
+            SIMD_KERNEL_AT(level, BinaryLutN_ForwardBit<N>)(yb.data(), xb_ptr, table, size);
+            EXPECT_EQ(yb_exp, yb);
+
+            // スカラー版はビット毎にテーブルを引いた結果と一致する
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                for ( int b = 0; b < 32; ++b ) {
+                    int index = 0;
+                    for ( int j = 0; j < N; ++j ) {
+                        index |= ((xb[j][i] >> b) & 1) << j;
+                    }
+                    ASSERT_EQ((int)((table[index / 32] >> (index % 32)) & 1), (yb_exp[i] >> b) & 1);
+                }
+            }
+
+            std::vector<float> y_exp(size + 1, 9.0f), y(size + 1, 9.0f);
+            bb::simd_scalar::BinaryLutN_ForwardFp32<N>(y_exp.data(), x_ptr, table8, size);
+            SIMD_KERNEL_AT(level, BinaryLutN_ForwardFp32<N>)(y.data(), x_ptr, table8, size);
+            EXPECT_EQ(y_exp, y);
+        }
+    }
+}
+
+
+TEST(SimdKernelTest, testSimdKernel_SetLevel)
+{
+    int const level_org = bb::bb_simd_level_limit();
+
+    bb::FrameBuffer x(BB_TYPE_FP32, 37, 5);
+    auto data = SimdKernelTest_MakeData(37 * 5, 8);
+    for ( bb::index_t frame = 0; frame < 37; ++frame ) {
+        for ( bb::index_t node = 0; node < 5; ++node ) {
+            x.SetFP32(frame, node, data[frame * 5 + node]);
+        }
+    }
+
+    // レベルを下げても同じ結果になる
+    bb::bb_simd_set_level(bb::BB_SIMD_SCALAR);
+    EXPECT_EQ(bb::BB_SIMD_SCALAR, bb::bb_simd_get_level());
+    auto y_exp = bb::ReLU<>::Create()->Forward(x);
+
+    for ( int level = bb::BB_SIMD_SSE42; level <= bb::bb_simd_cpu_level(); ++level ) {
+        bb::bb_simd_set_level(level);
+        EXPECT_EQ(level, bb::bb_simd_get_level());
+        auto y = bb::ReLU<>::Create()->Forward(x);
+        for ( bb::index_t frame = 0; frame < 37; ++frame ) {
+            for ( bb::index_t node = 0; node < 5; ++node ) {
+                EXPECT_EQ(y_exp.GetFP32(frame, node), y.GetFP32(frame, node));
+            }
+        }
+    }
+
+    bb::bb_simd_set_level(level_org);
+}
+
+
+// end of file
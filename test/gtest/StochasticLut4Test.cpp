@@ -0,0 +1,112 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+
+#include "bb/StochasticLut4.h"
+#include "bb/UniformDistributionGenerator.h"
+
+
+
+// SIMD版とスカラ版の比較
+//   演算順序を揃えているのでビット一致するが、最適化ビルドでは FMA への縮約(-ffp-contract)
+//   がスカラ版とSIMD版で異なり得るので誤差を許容する
+#if defined(__OPTIMIZE__)
+#define EXPECT_SIMD_EQ(ref, val)    EXPECT_NEAR(ref, val, 1.0e-5f * std::max(1.0f, std::abs(ref)))
+#else
+#define EXPECT_SIMD_EQ(ref, val)    EXPECT_EQ(ref, val)
+#endif
+
+void StochasticLut4_cmp_host_simd(int const input_node_size, int const output_node_size, int const frame_size, int loop_num, bool avx512, bool binary)
+{
+    auto lut_ref  = bb::StochasticLut4<float>::Create(output_node_size);
+    auto lut_simd = bb::StochasticLut4<float>::Create(output_node_size);
+
+    lut_ref->SendCommand("host_only true");
+    lut_simd->SendCommand("host_only true");
+    lut_ref->SendCommand("host_simd false");
+    lut_simd->SendCommand("host_simd true");
+    lut_simd->SendCommand(avx512 ? "host_avx512 true" : "host_avx512 false");
+    lut_ref->SendCommand(binary ? "binary true" : "binary false");
+    lut_simd->SendCommand(binary ? "binary true" : "binary false");
+
+    bb::FrameBuffer x_buf(BB_TYPE_FP32, frame_size, input_node_size, true);
+    lut_ref->SetInputShape(x_buf.GetShape());
+    lut_simd->SetInputShape(x_buf.GetShape());
+
+    // 接続と係数を同一化
+    for (int node = 0; node < output_node_size; ++node) {
+        for (int i = 0; i < 4; ++i) {
+            lut_simd->SetNodeInput(node, i, lut_ref->GetNodeInput(node, i));
+        }
+    }
+    {
+        auto W_ref  = lut_ref->lock_W_const();
+        auto W_simd = lut_simd->lock_W();
+        for (int node = 0; node < output_node_size; ++node) {
+            for (int i = 0; i < 16; ++i) {
+                W_simd(node, i) = W_ref(node, i);
+            }
+        }
+    }
+
+    auto valgen = bb::UniformDistributionGenerator<float>::Create(0.0f, 1.0f, 1);
+
+    for ( int loop = 0; loop < loop_num; ++ loop ) {
+        for ( int frame = 0; frame < frame_size; ++frame) {
+            for ( int node = 0; node < input_node_size; ++node ) {
+                x_buf.SetFP32(frame, node, valgen->GetValue());
+            }
+        }
+
+        auto y_ref  = lut_ref->Forward(x_buf);
+        auto y_simd = lut_simd->Forward(x_buf);
+        for ( int frame = 0; frame < frame_size; ++frame) {
+            for ( int node = 0; node < output_node_size; ++node ) {
+                EXPECT_SIMD_EQ(y_ref.GetFP32(frame, node), y_simd.GetFP32(frame, node));
+            }
+        }
+
+        bb::FrameBuffer dy_buf(BB_TYPE_FP32, frame_size, output_node_size, true);
+        for ( int frame = 0; frame < frame_size; ++frame) {
+            for ( int node = 0; node < output_node_size; ++node ) {
+                dy_buf.SetFP32(frame, node, valgen->GetValue() - 0.5f);
+            }
+        }
+
+        auto dx_ref  = lut_ref->Backward(dy_buf);
+        auto dx_simd = lut_simd->Backward(dy_buf);
+        for ( int frame = 0; frame < frame_size; ++frame) {
+            for ( int node = 0; node < input_node_size; ++node ) {
+                EXPECT_SIMD_EQ(dx_ref.GetFP32(frame, node), dx_simd.GetFP32(frame, node));
+            }
+        }
+
+        // dW はフレーム方向の加算順序が異なる
+        {
+            auto dW_ref  = lut_ref->lock_dW_const();
+            auto dW_simd = lut_simd->lock_dW_const();
+            for (int node = 0; node < output_node_size; ++node) {
+                for (int i = 0; i < 16; ++i) {
+                    EXPECT_NEAR(dW_ref(node, i), dW_simd(node, i), 0.0001f * frame_size);
+                }
+            }
+        }
+    }
+}
+
+
+TEST(StochasticLut4Test, testStochasticLut4_host_simd)
+{
+    for ( int avx512 = 0; avx512 < 2; ++avx512 ) {
+        if ( avx512 && !bb::bb_cpu_has_avx512f() ) {
+            continue;
+        }
+        for ( int binary = 0; binary < 2; ++binary ) {
+            StochasticLut4_cmp_host_simd(4,  1,   1,        2, avx512 != 0, binary != 0);
+            StochasticLut4_cmp_host_simd(14, 21,  8,        2, avx512 != 0, binary != 0);
+            StochasticLut4_cmp_host_simd(13, 17,  16 + 5,   2, avx512 != 0, binary != 0);
+            StochasticLut4_cmp_host_simd(32, 64,  256 + 13, 2, avx512 != 0, binary != 0);
+        }
+    }
+}
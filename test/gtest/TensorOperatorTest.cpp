@@ -0,0 +1,124 @@
+﻿#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <limits>
+#include "gtest/gtest.h"
+
+#include "bb/TensorOperator.h"
+
+
+// 命令セット毎の FP32 カーネルをスカラー版と比較する (端数の出る要素数を含める)
+static void testTensorOperator_Compare(bb::TensorOperator_Fp32Table const &ref, bb::TensorOperator_Fp32Table const &tbl)
+{
+    bb::index_t const sizes[] = {1, 7, 8, 9, 15, 16, 17, 31, 100, 1023, 20001};
+
+    std::mt19937_64                         mt(1);
+    std::uniform_real_distribution<float>   dist(-4.0f, 4.0f);
+
+    for ( auto size : sizes ) {
+        std::vector<float> src0(size), src1(size), pos(size);
+        for ( bb::index_t i = 0; i < size; ++i ) {
+            src0[i] = dist(mt);
+            src1[i] = dist(mt);
+            pos[i]  = std::abs(src1[i]) + 0.5f;
+        }
+
+        std::vector<float> exp(size + 1, -99.0f), dst(size + 1, -99.0f);
+        auto check = [&](char const *name, float tol) {
+            for ( bb::index_t i = 0; i < size; ++i ) {
+                EXPECT_NEAR(exp[i], dst[i], tol * (1.0f + std::abs(exp[i]))) << tbl.name << " " << name << " size=" << size << " i=" << i;
+            }
+            EXPECT_EQ(-99.0f, dst[size]) << tbl.name << " " << name << " size=" << size;   // 範囲外に書き込まない
+        };
+
+        ref.set(&exp[0], 1.5f, size);                                       tbl.set(&dst[0], 1.5f, size);                                       check("set", 0);
+        ref.add_ex(&exp[0], &src0[0], &src1[0], 2.0f, -3.0f, 0.5f, size);   tbl.add_ex(&dst[0], &src0[0], &src1[0], 2.0f, -3.0f, 0.5f, size);   check("add_ex", 1e-6f);
+        ref.sub_ex(&exp[0], &src0[0], &src1[0], 2.0f, -3.0f, 0.5f, size);   tbl.sub_ex(&dst[0], &src0[0], &src1[0], 2.0f, -3.0f, 0.5f, size);   check("sub_ex", 1e-6f);
+        ref.mul_ex(&exp[0], &src0[0], &src1[0], 0.7f, 0.1f, size);          tbl.mul_ex(&dst[0], &src0[0], &src1[0], 0.7f, 0.1f, size);          check("mul_ex", 1e-6f);
+        ref.div_ex(&exp[0], &src0[0], &pos[0], 2.0f, 1.0f, 1.5f, 0.2f, size); tbl.div_ex(&dst[0], &src0[0], &pos[0], 2.0f, 1.0f, 1.5f, 0.2f, size); check("div_ex", 1e-6f);
+        ref.sqrt(&exp[0], &pos[0], size);                                   tbl.sqrt(&dst[0], &pos[0], size);                                   check("sqrt", 1e-6f);
+        ref.exp(&exp[0], &src0[0], size);                                   tbl.exp(&dst[0], &src0[0], size);                                   check("exp", 1e-6f);
+        ref.min(&exp[0], &src0[0], &src1[0], size);                         tbl.min(&dst[0], &src0[0], &src1[0], size);                         check("min", 0);
+        ref.min_v(&exp[0], &src0[0], 0.5f, size);                           tbl.min_v(&dst[0], &src0[0], 0.5f, size);                           check("min_v", 0);
+        ref.max(&exp[0], &src0[0], &src1[0], size);                         tbl.max(&dst[0], &src0[0], &src1[0], size);                         check("max", 0);
+        ref.max_v(&exp[0], &src0[0], 0.5f, size);                           tbl.max_v(&dst[0], &src0[0], 0.5f, size);                           check("max_v", 0);
+        ref.clamp(&exp[0], &src0[0], -1.0f, 2.0f, size);                    tbl.clamp(&dst[0], &src0[0], -1.0f, 2.0f, size);                    check("clamp", 0);
+    }
+}
+
+
+TEST(TensorOperatorTest, testTensorOperator_Avx2)
+{
+    if ( !bb::bb_cpu_has_avx2() ) {
+        return;
+    }
+    auto ref = bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Scalar>::Table("scalar");
+    testTensorOperator_Compare(ref, bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Avx2>::Table("avx2"));
+}
+
+
+TEST(TensorOperatorTest, testTensorOperator_Avx512)
+{
+    if ( !bb::bb_cpu_has_avx512f() ) {
+        return;
+    }
+    auto ref = bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Scalar>::Table("scalar");
+    testTensorOperator_Compare(ref, bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Avx512>::Table("avx512"));
+}
+
+
+TEST(TensorOperatorTest, testTensorOperator_Dispatch)
+{
+    // Tensor_Vector_xxx<float> は選択済みのテーブルを通る
+    float src0[19], src1[19], dst[19];
+    for ( int i = 0; i < 19; ++i ) {
+        src0[i] = (float)i;
+        src1[i] = (float)(19 - i);
+    }
+    bb::Tensor_Vector_add_ex<float>(dst, src0, src1, 1.0f, 2.0f, 3.0f, 19);
+    for ( int i = 0; i < 19; ++i ) {
+        EXPECT_EQ(src0[i] + 2.0f * src1[i] + 3.0f, dst[i]);
+    }
+    bb::Tensor_Vector_clamp<float>(dst, src0, 3.0f, 10.0f, 19);
+    for ( int i = 0; i < 19; ++i ) {
+        EXPECT_EQ(std::max(3.0f, std::min(10.0f, src0[i])), dst[i]);
+    }
+}
+
+
+// exp の範囲外と NaN の扱い(スカラー版の std::exp と合わせる)
+static void testTensorOperator_ExpSpecial(bb::TensorOperator_Fp32Table const &tbl)
+{
+    float const src[] = {std::numeric_limits<float>::quiet_NaN(), 100.0f, -100.0f, 88.5f, 88.7f, 88.8f, -87.0f, -88.0f,
+                         std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0f, 1.0f, -1.0f, 10.0f, -10.0f, 50.0f};
+    int const n = (int)(sizeof(src) / sizeof(src[0]));
+    float dst[n];
+    tbl.exp(dst, src, n);
+
+    EXPECT_TRUE(std::isnan(dst[0])) << tbl.name;
+    EXPECT_TRUE(std::isinf(dst[1]) && dst[1] > 0) << tbl.name;
+    EXPECT_NEAR(0.0f, dst[2], 1e-37f) << tbl.name;
+    EXPECT_NEAR(std::exp(88.5f), dst[3], 1e-6f * std::exp(88.5f)) << tbl.name;
+    EXPECT_NEAR(std::exp(88.7f), dst[4], 1e-6f * std::exp(88.7f)) << tbl.name;
+    EXPECT_TRUE(std::isinf(dst[5]) && dst[5] > 0) << tbl.name;
+    EXPECT_NEAR(std::exp(-87.0f), dst[6], 1e-6f * std::exp(-87.0f)) << tbl.name;
+    EXPECT_NEAR(0.0f, dst[7], 1e-37f) << tbl.name;  // 非正規化数の範囲は 0 になってもよい
+    EXPECT_TRUE(std::isinf(dst[8]) && dst[8] > 0) << tbl.name;
+    EXPECT_EQ(0.0f, dst[9]) << tbl.name;
+    for ( int i = 10; i < n; ++i ) {
+        EXPECT_NEAR(std::exp(src[i]), dst[i], 1e-6f * std::exp(src[i])) << tbl.name << " x=" << src[i];
+    }
+}
+
+TEST(TensorOperatorTest, testTensorOperator_ExpSpecial)
+{
+    testTensorOperator_ExpSpecial(bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Scalar>::Table("scalar"));
+    if ( bb::bb_cpu_has_avx2() ) {
+        testTensorOperator_ExpSpecial(bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Avx2>::Table("avx2"));
+    }
+    if ( bb::bb_cpu_has_avx512f() ) {
+        testTensorOperator_ExpSpecial(bb::TensorOperator_Fp32Kernel<bb::TensorOperator_Avx512>::Table("avx512"));
+    }
+    testTensorOperator_ExpSpecial(bb::TensorOperator_GetFp32Table());
+}
@@ -1620,3 +1620,66 @@ TEST(TensorTest, testTensorX_Operator)
     test_OperatorX<std::uint32_t>({1, 2, 3, 7});
 //    test_OperatorX<std::uint64_t>({1, 2, 3});
 }
+
+
+TEST(TensorTest, testTensor_Expression)
+{
+    // [܂ރTCYő]̌ʂƔr
+    bb::index_t const size = 37;
+
+    std::mt19937_64                         mt(1);
+    std::uniform_real_distribution<float>   dist(0.1f, 2.0f);
+
+    bb::Tensor_<float>  x(bb::indices_t({size}));
+    bb::Tensor_<float>  y(bb::indices_t({size}));
+    {
+        auto x_ptr = x.Lock();
+        auto y_ptr = y.Lock();
+        for ( bb::index_t i = 0; i < size; ++i ) {
+            x_ptr[i] = dist(mt);
+            y_ptr[i] = dist(mt);
+        }
+    }
+
+    float const a = 2.0f, b = 0.5f, c = 3.0f;
+
+    bb::Tensor_<float> exp0 = a * x + b * y * y - c;
+    bb::Tensor_<float> dst0;
+    dst0 = a * bb::Expr(x) + b * bb::Expr(y) * y - c;
+    EXPECT_EQ(exp0.GetShape(), dst0.GetShape());
+
+    bb::Tensor_<float> exp1 = x / (bb::Sqrt(y) + 1e-7f);
+    bb::Tensor_<float> dst1 = x.Clone();
+    dst1 -= -(bb::Expr(x) / (bb::Sqrt(bb::Expr(y)) + 1e-7f));
+    dst1 -= x;
+    dst1 += x;
+    dst1 -= x;
+
+    bb::Tensor_<float> exp2 = bb::Clamp(bb::Exp(x - y), 0.5f, 2.0f);
+    bb::Tensor_<float> dst2(bb::indices_t({size}));
+    dst2 = bb::Clamp(bb::Exp(bb::Expr(x) - y), 0.5, 2.0);
+
+    // ^Ȃ Tensor (FP64)
+    bb::Tensor  t64(BB_TYPE_FP64, bb::indices_t({size}));
+    bb::Tensor  d64(BB_TYPE_FP64, bb::indices_t({size}));
+    t64 = 1.5;
+    d64 = 2.0;
+    d64 *= bb::Expr(t64) * t64 + 1;
+
+    {
+        auto exp0_ptr = exp0.LockConst();
+        auto dst0_ptr = dst0.LockConst();
+        auto exp1_ptr = exp1.LockConst();
+        auto dst1_ptr = dst1.LockConst();
+        auto exp2_ptr = exp2.LockConst();
+        auto dst2_ptr = dst2.LockConst();
+        auto d64_ptr  = d64.LockConst<double>();
+        for ( bb::index_t i = 0; i < size; ++i ) {
+            EXPECT_NEAR(exp0_ptr[i], dst0_ptr[i], 1.0e-5f);
+            EXPECT_NEAR(exp1_ptr[i], dst1_ptr[i], 1.0e-5f);
+            EXPECT_NEAR(exp2_ptr[i], dst2_ptr[i], 1.0e-6f);
+            EXPECT_EQ(2.0 * (1.5 * 1.5 + 1), d64_ptr[i]);
+        }
+    }
+}
+
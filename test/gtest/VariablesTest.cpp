@@ -66,3 +66,36 @@ TEST(VariablesTest, VariablesTest_Test)
     var3 = 2 / var1;
 }
 
+
+TEST(VariablesTest, VariablesTest_Expression)
+{
+    auto t0 = std::make_shared<bb::Tensor>(BB_TYPE_FP32, bb::indices_t({3, 7}));
+    auto t1 = std::make_shared<bb::Tensor>(BB_TYPE_FP64, bb::indices_t({5}));
+
+    bb::Variables   x;
+    x.PushBack(t0);
+    x.PushBack(t1);
+
+    bb::Variables   y(x.GetTypes(), x.GetShapes());
+    bb::Variables   z(x.GetTypes(), x.GetShapes());
+
+    x = 2;
+    y = 3;
+    z = 1;
+
+    // Tensor 毎に 1ループで評価される
+    z += 0.5 * bb::Expr(x) * x - y / 3.0;
+    z = bb::Sqrt(bb::Expr(z) * 8.0);
+
+    {
+        auto ptr0 = z[0].LockConst<float>();
+        auto ptr1 = z[1].LockConst<double>();
+        for ( bb::index_t i = 0; i < 21; ++i ) {
+            EXPECT_FLOAT_EQ(4.0f, ptr0[i]);
+        }
+        for ( bb::index_t i = 0; i < 5; ++i ) {
+            EXPECT_DOUBLE_EQ(4.0, ptr1[i]);
+        }
+    }
+}
+